@@ -0,0 +1,285 @@
+#include "AsioDatagramTransport.hpp"
+
+#include <boost/format.hpp>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+#include <poll.h>
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED 1
+#endif
+
+using namespace std;
+using namespace boost;
+using namespace camera;
+
+namespace camera {
+    /**
+     * Number of frame buffers when zero-copy sending is enabled. Each buffer stays in use
+     * until the kernel reports that the packet was transmitted.
+     */
+    constexpr unsigned int ZEROCOPY_FRAME_BUFFERS = 4;
+
+    constexpr int ZEROCOPY_COMPLETION_WAIT_MS = 10;
+}
+
+camera::AsioDatagramTransport::AsioDatagramTransport(boost::asio::ip::udp::socket &socket,
+                                                     unsigned int zeroCopyThreshold)
+        : logger(log4cpp::Category::getInstance("AsioDatagramTransport")),
+          socket(socket),
+          recvBuffer(new char[RECEIVED_DATA_MAX_LENGTH]),
+          zeroCopyThreshold(zeroCopyThreshold) {
+
+    if (zeroCopyThreshold > 0) {
+        enableZeroCopy();
+    }
+
+    // without zero-copy the buffer is free again as soon as send_to() returns
+    frameBufferPool.reset(new FrameBufferPool(this->zeroCopyThreshold > 0 ? ZEROCOPY_FRAME_BUFFERS : 1,
+                                              HEADER_RESERVED_SIZE + SEND_BUFFER_SIZE));
+
+    logger.notice("Instance created.");
+}
+
+camera::AsioDatagramTransport::~AsioDatagramTransport() {
+    logger.notice("Instance destroyed.");
+}
+
+void camera::AsioDatagramTransport::start(DatagramHandler datagramHandler,
+                                          BatchFinishedHandler batchFinishedHandler) {
+    this->datagramHandler = datagramHandler;
+    this->batchFinishedHandler = batchFinishedHandler;
+
+    doReceive();
+}
+
+void camera::AsioDatagramTransport::doReceive() {
+    socket.async_receive_from(
+            asio::buffer(recvBuffer.get(), RECEIVED_DATA_MAX_LENGTH),
+            senderEndpoint,
+            [this](boost::system::error_code ec, std::size_t bytesReceived) {
+                if (ec) {
+                    throw NetworkException(
+                            (format("error at receiving request: %s") % ec.message()).str());
+                }
+
+                // epoll_wait() of the reactor and recvfrom()
+                statistics.syscalls += 2;
+                statistics.datagramsReceived++;
+
+                datagramHandler(recvBuffer.get(), bytesReceived, senderEndpoint);
+                poll();
+
+                batchFinishedHandler();
+
+                doReceive();
+            });
+}
+
+void camera::AsioDatagramTransport::poll() {
+    using boost::asio::ip::udp;
+
+    system::error_code err;
+
+    while (true) {
+        statistics.syscalls++;
+        if (socket.available(err) == 0 or err) {
+            break;
+        }
+
+        udp::endpoint sender;
+        statistics.syscalls++;
+        auto bytesReceived = socket.receive_from(asio::buffer(recvBuffer.get(), RECEIVED_DATA_MAX_LENGTH),
+                                                 sender, 0, err);
+        if (err) {
+            break;
+        }
+
+        statistics.datagramsReceived++;
+        datagramHandler(recvBuffer.get(), bytesReceived, sender);
+    }
+
+    if (err) {
+        logger.error("Error when draining socket: %s.", err.message().c_str());
+    }
+}
+
+FrameBufferPtr camera::AsioDatagramTransport::acquireFrameBuffer() {
+    auto frame = frameBufferPool->acquire();
+
+    if (frame == nullptr and zeroCopyThreshold > 0) {
+        reapZeroCopyCompletions();
+        frame = frameBufferPool->acquire();
+
+        if (frame == nullptr) {
+            logger.warn("All frame buffers are held by the kernel, waiting for zero-copy completion.");
+
+            // POLLERR is always reported, it signals the pending completion notification
+            pollfd pfd = {};
+            pfd.fd = socket.native_handle();
+            ::poll(&pfd, 1, ZEROCOPY_COMPLETION_WAIT_MS);
+            statistics.syscalls++;
+
+            reapZeroCopyCompletions();
+            frame = frameBufferPool->acquire();
+        }
+    }
+
+    if (frame == nullptr) {
+        throw NetworkException("no free frame buffer");
+    }
+
+    return frame;
+}
+
+void camera::AsioDatagramTransport::sendFrame(const boost::asio::ip::udp::endpoint &destination,
+                                              FrameBufferPtr frame,
+                                              unsigned int headerLength,
+                                              unsigned int jpegLength) {
+    unsigned int packetLength = headerLength + jpegLength;
+
+    if (packetLength > UDP_MAX_PAYLOAD_SIZE) {
+        logger.warn("Payload size %d B, limiting to %d B.", packetLength, UDP_MAX_PAYLOAD_SIZE);
+        jpegLength = UDP_MAX_PAYLOAD_SIZE - headerLength;
+        packetLength = UDP_MAX_PAYLOAD_SIZE;
+    }
+
+    unsigned char *jpegData = frame->data + HEADER_RESERVED_SIZE;
+
+    if (zeroCopyThreshold > 0 and packetLength >= zeroCopyThreshold) {
+        reapZeroCopyCompletions();
+
+        iovec iov[2];
+        iov[0].iov_base = frame->data;
+        iov[0].iov_len = headerLength;
+        iov[1].iov_base = jpegData;
+        iov[1].iov_len = jpegLength;
+
+        msghdr msg = {};
+        msg.msg_name = const_cast<sockaddr *>(destination.data());
+        msg.msg_namelen = destination.size();
+        msg.msg_iov = iov;
+        msg.msg_iovlen = 2;
+
+        auto sentBytes = ::sendmsg(socket.native_handle(), &msg, MSG_ZEROCOPY);
+        statistics.syscalls++;
+
+        if (sentBytes >= 0) {
+            // the buffer is referenced by the kernel till the completion notification comes
+            zeroCopyInFlight[zeroCopyNextSequence++] = frame;
+            statistics.datagramsSent++;
+            statistics.zeroCopyDatagramsSent++;
+
+            if (static_cast<unsigned int>(sentBytes) != packetLength) {
+                logger.error("Not whole packet sent (%u < %u).", sentBytes, packetLength);
+            } else {
+                logger.info("Sent packet (%u B, zero-copy).", packetLength);
+            }
+            return;
+        }
+
+        logger.warn("Zero-copy send failed (%s), falling back to regular send.", std::strerror(errno));
+    }
+
+    std::array<asio::const_buffer, 2> buffers = {{
+                                                         asio::buffer(frame->data, headerLength),
+                                                         asio::buffer(jpegData, jpegLength)
+                                                 }};
+
+    auto sentBytes = socket.send_to(buffers, destination);
+    statistics.syscalls++;
+    statistics.datagramsSent++;
+
+    if (sentBytes != packetLength) {
+        logger.error("Not whole packet sent (%u < %u).", sentBytes, packetLength);
+    } else {
+        logger.info("Sent packet (%u B).", packetLength);
+    }
+}
+
+TransportStatistics camera::AsioDatagramTransport::getStatistics() {
+    reapZeroCopyCompletions();
+
+    TransportStatistics result = statistics;
+    result.frameBuffers = frameBufferPool->getNumberOfBuffers();
+    result.freeFrameBuffers = frameBufferPool->getNumberOfFreeBuffers();
+
+    return result;
+}
+
+void camera::AsioDatagramTransport::enableZeroCopy() {
+    int one = 1;
+
+    if (setsockopt(socket.native_handle(), SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) != 0) {
+        logger.warn("Kernel doesn't support SO_ZEROCOPY (%s). Zero-copy sending disabled.", std::strerror(errno));
+        zeroCopyThreshold = 0;
+        return;
+    }
+
+    logger.notice("Zero-copy sending enabled for frames from %u B.", zeroCopyThreshold);
+}
+
+void camera::AsioDatagramTransport::reapZeroCopyCompletions() {
+    if (zeroCopyInFlight.empty()) {
+        return;
+    }
+
+    char control[128];
+
+    while (true) {
+        msghdr msg = {};
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        statistics.syscalls++;
+        if (::recvmsg(socket.native_handle(), &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == -1) {
+            if (errno != EAGAIN and errno != EWOULDBLOCK) {
+                logger.error("Error when reading socket error queue: %s.", std::strerror(errno));
+            }
+            break;
+        }
+
+        for (cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+            bool isRecvErr = (cm->cmsg_level == SOL_IP and cm->cmsg_type == IP_RECVERR)
+                             or (cm->cmsg_level == SOL_IPV6 and cm->cmsg_type == IPV6_RECVERR);
+            if (not isRecvErr) {
+                continue;
+            }
+
+            auto *err = reinterpret_cast<sock_extended_err *>(CMSG_DATA(cm));
+            if (err->ee_origin != SO_EE_ORIGIN_ZEROCOPY or err->ee_errno != 0) {
+                continue;
+            }
+
+            if (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                zeroCopyCopiedCount++;
+                logger.debug("Kernel copied the zero-copy frame anyway (%lu times so far).", zeroCopyCopiedCount);
+            }
+
+            // notification covers the inclusive range of send sequence numbers
+            for (uint32_t seq = err->ee_info; seq != err->ee_data + 1; ++seq) {
+                zeroCopyInFlight.erase(seq);
+            }
+        }
+    }
+
+    logger.debug("%u frames still held by zero-copy sends.", zeroCopyInFlight.size());
+}
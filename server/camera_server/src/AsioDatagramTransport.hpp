@@ -0,0 +1,73 @@
+#pragma once
+
+#include "DatagramTransport.hpp"
+
+#include <log4cpp/Category.hh>
+
+#include <map>
+#include <memory>
+#include <cstdint>
+
+namespace camera {
+
+    /**
+     * Transport built on asio reactor: one recvfrom() and one sendmsg() per frame.
+     */
+    class AsioDatagramTransport : public IDatagramTransport {
+    public:
+        /**
+         * @param zeroCopyThreshold frames of at least this size are sent with MSG_ZEROCOPY. 0 disables it.
+         */
+        AsioDatagramTransport(boost::asio::ip::udp::socket &socket, unsigned int zeroCopyThreshold);
+
+        ~AsioDatagramTransport();
+
+        void start(DatagramHandler datagramHandler, BatchFinishedHandler batchFinishedHandler) override;
+
+        void poll() override;
+
+        FrameBufferPtr acquireFrameBuffer() override;
+
+        void sendFrame(const boost::asio::ip::udp::endpoint &destination,
+                       FrameBufferPtr frame,
+                       unsigned int headerLength,
+                       unsigned int jpegLength) override;
+
+        TransportStatistics getStatistics() override;
+
+        std::string getName() override {
+            return "asio";
+        }
+
+    private:
+        log4cpp::Category &logger;
+
+        boost::asio::ip::udp::socket &socket;
+        boost::asio::ip::udp::endpoint senderEndpoint;
+
+        std::unique_ptr<char[]> recvBuffer;
+
+        DatagramHandler datagramHandler;
+        BatchFinishedHandler batchFinishedHandler;
+
+        std::unique_ptr<FrameBufferPool> frameBufferPool;
+
+        TransportStatistics statistics;
+
+        unsigned int zeroCopyThreshold;
+        uint32_t zeroCopyNextSequence = 0;
+        unsigned long zeroCopyCopiedCount = 0;
+
+        /**
+         * Buffers handed to the kernel by MSG_ZEROCOPY sends, keyed by the send sequence number.
+         * They are released when the completion notification arrives on the error queue.
+         */
+        std::map<uint32_t, FrameBufferPtr> zeroCopyInFlight;
+
+        void doReceive();
+
+        void enableZeroCopy();
+
+        void reapZeroCopyCompletions();
+    };
+}
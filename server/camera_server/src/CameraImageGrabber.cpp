@@ -1,6 +1,7 @@
 #include "CameraImageGrabber.hpp"
 #include "utils.hpp"
 #include "Configuration.hpp"
+#include "FrameBus.hpp"
 
 #include <opencv2/opencv.hpp>
 
@@ -14,6 +15,7 @@
 #include <boost/format.hpp>
 #include <cstring>
 #include <cstdlib>
+#include <cerrno>
 #include <numeric>
 #include <string>
 
@@ -52,9 +54,31 @@ namespace camera {
 
     struct VideoBuffer {
         uint8_t *video4linuxBuffer;
+        uint8_t *uyvyBuffer;
         uint8_t *rgbBuffer;
     };
 
+    /**
+     * Mirrors UYVY image in place. Horizontal flip reverses the order of the macropixels (U Y0 V Y1)
+     * and swaps the luma samples inside each of them.
+     */
+    static void flipUyvy(cv::Mat &uyvy, int flipCode) {
+        if (flipCode == 0) {
+            cv::flip(uyvy, uyvy, 0);
+            return;
+        }
+
+        cv::Mat macropixels(uyvy.rows, uyvy.cols / 2, CV_8UC4, uyvy.data, uyvy.step);
+        cv::flip(macropixels, macropixels, flipCode);
+
+        for (int y = 0; y < uyvy.rows; ++y) {
+            uint8_t *p = uyvy.ptr(y);
+            for (int x = 0; x < uyvy.cols; x += 2, p += 4) {
+                std::swap(p[1], p[3]);
+            }
+        }
+    }
+
     class Video4LinuxImageGrabber : public IImageGrabber, public wallaroo::Part {
     public:
         Video4LinuxImageGrabber(const std::string &prefix)
@@ -76,6 +100,7 @@ namespace camera {
             destroy_pixfc(pixfc);
 
             for (auto vb : buffers) {
+                free(vb.uyvyBuffer);
                 free(vb.rgbBuffer);
             }
         }
@@ -89,17 +114,31 @@ namespace camera {
             }
         }
 
-        virtual std::tuple<long, double, cv::Mat> getFrame(bool wait) {
+        virtual std::tuple<long, double, cv::Mat, int64_t> getFrame(bool wait) {
             std::unique_lock<std::mutex> lk(dataMutex);
 
-            if (not wait) {
-                cond.wait(lk);
-                logger.info("Got frame.");
-            } else {
-                logger.info("Got frame without waiting.");
+            waitForFrame(lk, wait);
+
+            // BGR conversion is done only for the frames somebody asks for
+            if (currentFrame.empty()) {
+                int elapsedTime = common::utils::measureTime<std::chrono::microseconds>([&]() {
+                    auto *buffer = &buffers[currentBufferIndex];
+                    pixfc->convert(pixfc, buffer->uyvyBuffer, buffer->rgbBuffer);
+                    currentFrame = cv::Mat(height, width, CV_8UC3, buffer->rgbBuffer);
+                });
+
+                logger.info("Converted frame %d from UYUV to RGB in %d us.", currentFrameNo, elapsedTime);
             }
 
-            return std::tuple<long, double, cv::Mat>(currentFrameNo, currentFps, currentFrame);
+            return std::make_tuple(long(currentFrameNo), currentFps, currentFrame, currentCaptureTimestampUs);
+        }
+
+        virtual std::tuple<long, double, cv::Mat, int64_t> getUyvyFrame(bool wait) {
+            std::unique_lock<std::mutex> lk(dataMutex);
+
+            waitForFrame(lk, wait);
+
+            return std::make_tuple(long(currentFrameNo), currentFps, currentUyvyFrame, currentCaptureTimestampUs);
         }
 
     private:
@@ -116,15 +155,31 @@ namespace camera {
         std::mutex dataMutex;
         std::condition_variable cond;
 
+        /**
+         * Empty until the BGR frame is requested.
+         */
         cv::Mat currentFrame;
+        cv::Mat currentUyvyFrame;
+        unsigned int currentBufferIndex = 0;
 
         int prevVideoInput = -1;
 
         FlipParams flipParams = FlipParams::NONE;
 
+        /**
+         * If set, only the newest of the frames waiting in the driver queue is used.
+         */
+        bool latestOnly = false;
+        unsigned long skippedFramesCount = 0;
+
         int currentFrameNo;
         double currentFps;
 
+        /**
+         * Microseconds since the epoch, taken when the frame was dequeued from the driver.
+         */
+        int64_t currentCaptureTimestampUs = 0;
+
         vector<VideoBuffer> buffers;
 
         volatile bool finishThread = false;
@@ -136,12 +191,18 @@ namespace camera {
 
         PixFcSSE *pixfc;
 
+        /**
+         * Publishes the captured frames for the local processes. Null if disabled in the config.
+         */
+        std::unique_ptr<common::framebus::FrameBusWriter> frameBus;
+
         virtual void Init() {
             logger.info("Starting the initialization of Video4LinuxImageGrabber.");
 
             string videoDevice = "/dev/video" + to_string(config->getInt(getFullConfigPath("device")));
 
-            fd = open(videoDevice.c_str(), O_RDWR);
+            // non-blocking, so the ready buffers can be drained without waiting for the next one
+            fd = open(videoDevice.c_str(), O_RDWR | O_NONBLOCK);
             if (fd == -1) {
                 throw ImageGrabberException(string("cannot open device ") + videoDevice);
             }
@@ -200,8 +261,10 @@ namespace camera {
                 input.index++;
             }
 
+            latestOnly = config->getBool(getFullConfigPath("latest_only"));
+
             v4l2_requestbuffers req = {};
-            req.count = 16; // some high value
+            req.count = config->getInt(getFullConfigPath("buffers"));
             req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
             req.memory = V4L2_MEMORY_MMAP;
             checkedXioctl(fd, VIDIOC_REQBUFS, &req, "error when requesting memory buffers");
@@ -210,6 +273,8 @@ namespace camera {
                 throw ImageGrabberException("insufficient buffer memory");
             }
 
+            logger.notice("Got %d buffers, %s queue policy.", req.count, latestOnly ? "latest only" : "FIFO");
+
             for (unsigned int i = 0; i < req.count; ++i) {
                 v4l2_buffer buf = {};
                 buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
@@ -225,9 +290,11 @@ namespace camera {
                 logger.debug("Initialized buffer %d: address: %p, length: %d.", i,
                              buffer.video4linuxBuffer, buf.length);
 
+                unsigned int uyvyBufferSize = fmt.fmt.pix.width * fmt.fmt.pix.height * 2;
                 unsigned int rgbBufferSize = fmt.fmt.pix.width * fmt.fmt.pix.height * 3;
 
-                if (posix_memalign(reinterpret_cast<void **>(&buffer.rgbBuffer), 16, rgbBufferSize) != 0) {
+                if (posix_memalign(reinterpret_cast<void **>(&buffer.uyvyBuffer), 16, uyvyBufferSize) != 0
+                    or posix_memalign(reinterpret_cast<void **>(&buffer.rgbBuffer), 16, rgbBufferSize) != 0) {
                     throw ImageGrabberException("cannot allocate buffer " + to_string(i));
                 }
 
@@ -248,6 +315,18 @@ namespace camera {
                 throw ImageGrabberException("cannot create struct for pixfc: " + to_string(status));
             }
 
+            int frameBusSlots = config->getInt(getFullConfigPath("frame_bus_slots"));
+            if (frameBusSlots > 0) {
+                string frameBusName = "SZARK_frames_" + prefix;
+                logger.notice("Publishing frames to frame bus '%s' with %d slots.", frameBusName.c_str(), frameBusSlots);
+                try {
+                    frameBus.reset(new common::framebus::FrameBusWriter(frameBusName, frameBusSlots,
+                                                                        width * height * 2));
+                } catch (common::framebus::FrameBusException &e) {
+                    throw ImageGrabberException(e.what());
+                }
+            }
+
             grabberThread.reset(new std::thread(&Video4LinuxImageGrabber::grabberThreadFunction, this));
             common::utils::setThreadName(logger, grabberThread.get(), prefix + "ImgGrab");
 
@@ -271,6 +350,8 @@ namespace camera {
                 v4l2_buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
                 v4l2_buf.memory = V4L2_MEMORY_MMAP;
 
+                bool dequeued = false;
+
                 int elapsedTime = common::utils::measureTime<std::chrono::milliseconds>([&]() {
 
                     fd_set fds;
@@ -279,18 +360,27 @@ namespace camera {
                     timeval tv = {};
                     tv.tv_sec = 2;
                     int r = select(fd + 1, &fds, nullptr, nullptr, &tv);
-                    if (-1 == r) {
+                    if (-1 == r and errno != EINTR) {
                         throw ImageGrabberException("Waiting for Frame");
                     }
 
-                    checkedXioctl(fd, VIDIOC_DQBUF, &v4l2_buf, "error during dequeing buffer");
+                    dequeued = dequeueBuffer(v4l2_buf);
 
-                    auto *buffer = &buffers[v4l2_buf.index];
-
-                    logger.debug("Buffer %d (%p), bytes used: %d.", v4l2_buf.index, buffer->video4linuxBuffer,
-                                 v4l2_buf.bytesused);
+                    if (dequeued and latestOnly) {
+                        dequeueNewestBuffer(v4l2_buf);
+                    }
                 });
 
+                if (not dequeued) {
+                    logger.warn("No frame ready after %d ms.", elapsedTime);
+                    continue;
+                }
+
+                int64_t captureTimestampUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::system_clock::now().time_since_epoch()).count();
+
+                logger.debug("Buffer %d (%p), bytes used: %d.", v4l2_buf.index,
+                             buffers[v4l2_buf.index].video4linuxBuffer, v4l2_buf.bytesused);
 
                 captureTimesAvgBuffer.push_back(elapsedTime);
 
@@ -301,37 +391,104 @@ namespace camera {
 
                 cv::Mat frame;
 
-                elapsedTime = common::utils::measureTime<std::chrono::microseconds>([&]() {
+                {
+                    // the copy lets the driver refill the buffer, the conversion to BGR is left for getFrame()
                     auto *buffer = &buffers[v4l2_buf.index];
-
-                    pixfc->convert(pixfc, buffer->video4linuxBuffer, buffer->rgbBuffer);
+                    std::memcpy(buffer->uyvyBuffer, buffer->video4linuxBuffer, width * height * 2);
                     // todo timecode can be used
-                    frame = cv::Mat(height, width, CV_8UC3, buffer->rgbBuffer);
+                    frame = cv::Mat(height, width, CV_8UC2, buffer->uyvyBuffer);
 
                     logger.debug("Mat: height: %d, width: %d.", frame.rows, frame.cols);
-                });
-
-                logger.info("Converted frame %d from UYUV to RGB in %d us.", currentFrameNo, elapsedTime);
+                }
 
                 if (flipParams != FlipParams::NONE) {
                     elapsedTime = common::utils::measureTime<std::chrono::microseconds>([&]() {
-                        cv::flip(frame, frame, flipMap.at(flipParams));
+                        flipUyvy(frame, flipMap.at(flipParams));
                     });
                     logger.info("Flipped image in %d us.", elapsedTime);
                 }
 
                 checkedXioctl(fd, VIDIOC_QBUF, &v4l2_buf, "error during querying buffer");
 
+                // published before the consumers get the frame, they draw the HUD on it in place
+                if (frameBus) {
+                    publishToFrameBus(frame, currentFrameNo + 1);
+                }
+
                 dataMutex.lock();
-                this->currentFrame = frame;
+                this->currentUyvyFrame = frame;
+                this->currentFrame = cv::Mat();
+                this->currentBufferIndex = v4l2_buf.index;
                 this->currentFrameNo++;
                 this->currentFps = fps;
+                this->currentCaptureTimestampUs = captureTimestampUs;
                 dataMutex.unlock();
 
                 cond.notify_all();
             }
         }
 
+        /**
+         * The frame is published in UYVY, the consumers convert it only if they need to.
+         * Called before the frame is handed to the consumers, so nobody has modified it yet.
+         */
+        void publishToFrameBus(cv::Mat &uyvyFrame, long frameNo) {
+            common::framebus::FrameInfo info = {};
+            info.frameNo = frameNo;
+            info.timestampUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+            info.width = uyvyFrame.cols;
+            info.height = uyvyFrame.rows;
+            info.rowLength = uyvyFrame.cols * 2;
+            info.format = common::framebus::PixelFormat::UYVY;
+            info.input = prevVideoInput;
+
+            int elapsedTime = common::utils::measureTime<std::chrono::microseconds>([&]() {
+                frameBus->publish(info, uyvyFrame.data, uyvyFrame.step);
+            });
+            logger.debug("Published frame no %d to frame bus in %d us.", frameNo, elapsedTime);
+        }
+
+        /**
+         * @return false if no buffer is ready.
+         */
+        bool dequeueBuffer(v4l2_buffer &buf) {
+            if (xioctl(fd, VIDIOC_DQBUF, &buf) == 0) {
+                return true;
+            } else if (errno == EAGAIN) {
+                return false;
+            }
+
+            throw ImageGrabberException((format("error during dequeing buffer: %s") % strerror(errno)).str());
+        }
+
+        /**
+         * Takes all the buffers the driver has already filled and keeps only the newest one,
+         * the older ones are given back to the driver at once.
+         */
+        void dequeueNewestBuffer(v4l2_buffer &buf) {
+            v4l2_buffer newer = {};
+            newer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            newer.memory = V4L2_MEMORY_MMAP;
+
+            while (dequeueBuffer(newer)) {
+                checkedXioctl(fd, VIDIOC_QBUF, &buf, "error during querying buffer");
+                buf = newer;
+
+                skippedFramesCount++;
+                logger.info("Skipped stale frame, %lu frames skipped so far.", skippedFramesCount);
+            }
+        }
+
+        void waitForFrame(std::unique_lock<std::mutex> &lk, bool wait) {
+            if (not wait) {
+                cond.wait(lk);
+                logger.info("Got frame.");
+            } else {
+                logger.info("Got frame without waiting.");
+            }
+        }
+
         std::string getFullConfigPath(std::string property) {
             return "ImageGrabber." + prefix + "_" + property;
         }
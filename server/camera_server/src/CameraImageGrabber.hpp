@@ -14,6 +14,8 @@
 #include <condition_variable>
 #include <memory>
 #include <utility>
+#include <tuple>
+#include <cstdint>
 
 namespace camera {
     class ImageGrabberException : public std::runtime_error {
@@ -36,7 +38,12 @@ namespace camera {
 
         virtual void setVideoParams(int input, FlipParams flipParams) = 0;
 
-        // tuple: frame no, fps, image data
-        virtual std::tuple<long, double, cv::Mat> getFrame(bool wait) = 0;
+        // tuple: frame no, fps, image data, capture timestamp (microseconds since the epoch)
+        virtual std::tuple<long, double, cv::Mat, int64_t> getFrame(bool wait) = 0;
+
+        /**
+         * Returns the frame as captured, in UYVY format (CV_8UC2), without the BGR conversion.
+         */
+        virtual std::tuple<long, double, cv::Mat, int64_t> getUyvyFrame(bool wait) = 0;
     };
 }
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "FrameBufferPool.hpp"
+
+#include <boost/noncopyable.hpp>
+#include <boost/asio.hpp>
+
+#include <functional>
+#include <string>
+#include <stdexcept>
+
+namespace camera {
+
+    class NetworkException : public std::runtime_error {
+    public:
+        NetworkException(const std::string &message)
+                : std::runtime_error(message) {
+        }
+    };
+
+    constexpr int RECEIVED_DATA_MAX_LENGTH = 256;
+
+    constexpr unsigned int UDP_MAX_PAYLOAD_SIZE = 65506;
+
+    /**
+     * Each frame buffer starts with the space for the JSON header, the JPEG data follows it.
+     */
+    constexpr unsigned int HEADER_RESERVED_SIZE = 1024;
+
+    constexpr unsigned int SEND_BUFFER_SIZE = 0x20000;
+
+    /**
+     * Called for each received datagram. The data buffer belongs to the transport and may be modified
+     * by the handler, it's valid only during the call.
+     */
+    typedef std::function<void(char *data,
+                               std::size_t length,
+                               const boost::asio::ip::udp::endpoint &sender)> DatagramHandler;
+
+    /**
+     * Called after all datagrams available at the wake-up were passed to DatagramHandler.
+     */
+    typedef std::function<void()> BatchFinishedHandler;
+
+    struct TransportStatistics {
+        /**
+         * Number of system calls made by the transport, including the wake-ups of the event loop.
+         */
+        unsigned long syscalls = 0;
+        unsigned long datagramsReceived = 0;
+        unsigned long datagramsSent = 0;
+
+        /**
+         * Datagrams sent with MSG_ZEROCOPY, they are included in datagramsSent.
+         */
+        unsigned long zeroCopyDatagramsSent = 0;
+
+        unsigned int frameBuffers = 0;
+
+        /**
+         * Frame buffers back in the pool, the others are held by the sends the kernel hasn't completed.
+         */
+        unsigned int freeFrameBuffers = 0;
+    };
+
+    /**
+     * UDP transport used by NetworkServer. All handlers are called from the io_context thread.
+     */
+    class IDatagramTransport : boost::noncopyable {
+    public:
+        virtual ~IDatagramTransport() = default;
+
+        virtual void start(DatagramHandler datagramHandler, BatchFinishedHandler batchFinishedHandler) = 0;
+
+        /**
+         * Flushes the queued sends and passes datagrams which arrived in the meantime to DatagramHandler.
+         * Never blocks.
+         */
+        virtual void poll() = 0;
+
+        virtual FrameBufferPtr acquireFrameBuffer() = 0;
+
+        /**
+         * Sends the header located at the beginning of the frame buffer followed by the JPEG
+         * placed at HEADER_RESERVED_SIZE offset. The buffer is kept referenced as long as the kernel needs it.
+         */
+        virtual void sendFrame(const boost::asio::ip::udp::endpoint &destination,
+                               FrameBufferPtr frame,
+                               unsigned int headerLength,
+                               unsigned int jpegLength) = 0;
+
+        /**
+         * Frame buffers held by the sends in progress aren't counted as free.
+         * Must be called from the io_context thread or when it doesn't run.
+         */
+        virtual TransportStatistics getStatistics() = 0;
+
+        virtual std::string getName() = 0;
+    };
+}
@@ -0,0 +1,67 @@
+#include "FrameBufferPool.hpp"
+
+#include <boost/format.hpp>
+
+#include <mutex>
+#include <vector>
+#include <cstdlib>
+
+using namespace std;
+using namespace camera;
+
+constexpr int FRAME_BUFFER_ALIGNMENT = 32;
+
+namespace camera {
+    struct FrameBufferPoolImpl {
+        std::mutex mutex;
+        std::vector<FrameBuffer> buffers;
+        std::vector<FrameBuffer *> freeBuffers;
+
+        ~FrameBufferPoolImpl() {
+            for (auto &b : buffers) {
+                free(b.data);
+            }
+        }
+    };
+}
+
+camera::FrameBufferPool::FrameBufferPool(unsigned int numberOfBuffers, unsigned int bufferSize)
+        : impl(new FrameBufferPoolImpl()) {
+
+    impl->buffers.resize(numberOfBuffers);
+
+    for (auto &b : impl->buffers) {
+        if (posix_memalign(reinterpret_cast<void **>(&b.data), FRAME_BUFFER_ALIGNMENT, bufferSize) != 0) {
+            throw FrameBufferPoolException((boost::format("cannot allocate buffer of %u B") % bufferSize).str());
+        }
+        b.capacity = bufferSize;
+        impl->freeBuffers.push_back(&b);
+    }
+}
+
+FrameBufferPtr camera::FrameBufferPool::acquire() {
+    lock_guard<mutex> lk(impl->mutex);
+
+    if (impl->freeBuffers.empty()) {
+        return nullptr;
+    }
+
+    FrameBuffer *buffer = impl->freeBuffers.back();
+    impl->freeBuffers.pop_back();
+
+    // the deleter keeps the pool memory alive as long as any buffer is still referenced
+    auto poolImpl = impl;
+    return FrameBufferPtr(buffer, [poolImpl](FrameBuffer *b) {
+        lock_guard<mutex> lk(poolImpl->mutex);
+        poolImpl->freeBuffers.push_back(b);
+    });
+}
+
+unsigned int camera::FrameBufferPool::getNumberOfFreeBuffers() {
+    lock_guard<mutex> lk(impl->mutex);
+    return impl->freeBuffers.size();
+}
+
+unsigned int camera::FrameBufferPool::getNumberOfBuffers() {
+    return impl->buffers.size();
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <boost/noncopyable.hpp>
+
+#include <memory>
+#include <stdexcept>
+
+namespace camera {
+
+    class FrameBufferPoolException : public std::runtime_error {
+    public:
+        FrameBufferPoolException(const std::string &message)
+                : std::runtime_error(message) {
+        }
+    };
+
+    struct FrameBuffer {
+        unsigned char *data = nullptr;
+        unsigned int capacity = 0;
+    };
+
+    typedef std::shared_ptr<FrameBuffer> FrameBufferPtr;
+
+    struct FrameBufferPoolImpl;
+
+    /**
+     * Fixed set of aligned buffers used for the encoded frames. The buffer goes back to the pool
+     * when the last FrameBufferPtr pointing to it is released, so it can be kept alive as long
+     * as the kernel or any cache still refers to its memory.
+     */
+    class FrameBufferPool : boost::noncopyable {
+    public:
+        FrameBufferPool(unsigned int numberOfBuffers, unsigned int bufferSize);
+
+        ~FrameBufferPool() = default;
+
+        /**
+         * Returns the free buffer or nullptr if all buffers are in use.
+         */
+        FrameBufferPtr acquire();
+
+        unsigned int getNumberOfFreeBuffers();
+
+        unsigned int getNumberOfBuffers();
+
+    private:
+        std::shared_ptr<FrameBufferPoolImpl> impl;
+    };
+}
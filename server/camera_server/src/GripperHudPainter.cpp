@@ -1,17 +1,38 @@
 #include "GripperHudPainter.hpp"
+#include "convert.hpp"
 
 #include <opencv2/opencv.hpp>
 #include <wallaroo/registered.h>
+#include <boost/functional/hash.hpp>
+#include <boost/format.hpp>
 
 using namespace std;
 using namespace boost;
 using namespace camera;
+using namespace common::bridge;
 
 WALLAROO_REGISTER(GripperHudPainter)
 
+namespace camera {
+    const cv::Scalar TELEMETRY_COLOR(0x55, 0xD4, 0x19);
+    const cv::Scalar GRIPPER_BAR_COLOR(0xD4, 0x9B, 0x19);
+
+    constexpr double TELEMETRY_FONT_SCALE = 0.6;
+    constexpr int TELEMETRY_FONT_THICKNESS = 2;
+
+    /**
+     * Position of fully opened gripper, as limited by the interface.
+     */
+    constexpr unsigned int GRIPPER_MAX_POSITION = 255;
+
+    const cv::Size GRIPPER_BAR_SIZE(200, 16);
+}
+
 camera::GripperHudPainter::GripperHudPainter()
         : logger(log4cpp::Category::getInstance("GripperHudPainter")),
-          config("config", RegistrationToken()) {
+          config("config", RegistrationToken()),
+          interfaceProvider("interfaceProvider", RegistrationToken()),
+          frameNumberDigits("0123456789", 1, 4, cv::Scalar(0, 200, 20)) {
     logger.notice("Instance created.");
 }
 
@@ -24,12 +45,78 @@ cv::Mat camera::GripperHudPainter::drawContent(cv::Mat rawImage, boost::any addi
 
     tie(leftFrameNo, rightFrameNo) = any_cast<pair<long, long>>(additionalArg);
 
-    using namespace cv;
-    //TODO draw hud
+    frameNumberDigits.drawText(rawImage, to_string(leftFrameNo), cv::Point(30, 30));
+    frameNumberDigits.drawText(rawImage, to_string(rightFrameNo), cv::Point(300, 30));
+
+    auto hash = calculateTelemetryHash(rawImage.size());
 
-    putText(rawImage, to_string(leftFrameNo).c_str(), Point(30, 30), FONT_HERSHEY_SIMPLEX, 1, Scalar(0, 200, 20), 4);
-    putText(rawImage, to_string(rightFrameNo).c_str(), Point(300, 30), FONT_HERSHEY_SIMPLEX, 1, Scalar(0, 200, 20), 4);
+    if (hash != telemetryHash or telemetryLayer.getSize() != rawImage.size()) {
+        renderTelemetryLayer(rawImage.size());
+        telemetryHash = hash;
+    }
+
+    telemetryLayer.blendInto(rawImage);
 
     return rawImage;
 }
 
+std::size_t camera::GripperHudPainter::calculateTelemetryHash(cv::Size imageSize) {
+    std::size_t hash = 0;
+
+    hash_combine(hash, imageSize.width);
+    hash_combine(hash, imageSize.height);
+
+    bool valid = interfaceProvider->isValid();
+    hash_combine(hash, valid);
+
+    if (not valid) {
+        return hash;
+    }
+
+    auto &arm = interfaceProvider->getInterface()->arm;
+
+    hash_combine(hash, arm.shoulder.getPosition());
+    hash_combine(hash, arm.elbow.getPosition());
+    hash_combine(hash, arm.gripper.getPosition());
+    hash_combine(hash, static_cast<int>(arm.getCalibrationStatus()));
+    hash_combine(hash, static_cast<int>(arm.getMode()));
+
+    return hash;
+}
+
+void camera::GripperHudPainter::renderTelemetryLayer(cv::Size imageSize) {
+    logger.debug("Rendering arm telemetry layer.");
+    telemetryRendersCount++;
+
+    telemetryLayer.reset(imageSize);
+
+    if (not interfaceProvider->isValid()) {
+        return;
+    }
+
+    auto &arm = interfaceProvider->getInterface()->arm;
+
+    auto drawLine = [&](int lineNo, const string &text) {
+        telemetryLayer.drawText(text, cv::Point(30, 60 + 25 * lineNo),
+                                TELEMETRY_FONT_SCALE, TELEMETRY_COLOR, TELEMETRY_FONT_THICKNESS);
+    };
+
+    drawLine(0, (format("shoulder: %u") % arm.shoulder.getPosition()).str());
+    drawLine(1, (format("elbow: %u") % arm.elbow.getPosition()).str());
+    drawLine(2, (format("gripper: %u") % arm.gripper.getPosition()).str());
+    drawLine(3, (format("cal: %s, %s")
+                 % armCalibrationStatusToString(arm.getCalibrationStatus())
+                 % armDriverModeToString(arm.getMode())).str());
+
+    cv::Point barTopLeft(imageSize.width / 2 - GRIPPER_BAR_SIZE.width / 2, imageSize.height - 40);
+    cv::Rect bar(barTopLeft, GRIPPER_BAR_SIZE);
+
+    int opening = GRIPPER_BAR_SIZE.width * std::min(arm.gripper.getPosition(), GRIPPER_MAX_POSITION)
+                  / GRIPPER_MAX_POSITION;
+
+    if (opening > 0) {
+        telemetryLayer.drawRectangle(cv::Rect(barTopLeft, cv::Size(opening, GRIPPER_BAR_SIZE.height)),
+                                     GRIPPER_BAR_COLOR, cv::FILLED);
+    }
+    telemetryLayer.drawRectangle(bar, GRIPPER_BAR_COLOR, 2);
+}
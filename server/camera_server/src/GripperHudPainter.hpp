@@ -2,6 +2,8 @@
 
 #include "Configuration.hpp"
 #include "Painter.hpp"
+#include "HudOverlay.hpp"
+#include "SharedInterfaceProvider.hpp"
 
 #include <wallaroo/part.h>
 #include <log4cpp/Category.hh>
@@ -15,8 +17,26 @@ namespace camera {
 
         virtual cv::Mat drawContent(cv::Mat rawImage, boost::any additionalArg);
 
+        unsigned long getNumOfTelemetryRenders() {
+            return telemetryRendersCount;
+        }
+
     private:
         log4cpp::Category &logger;
         wallaroo::Collaborator<common::config::Configuration> config;
+        wallaroo::Collaborator<common::bridge::InterfaceProvider> interfaceProvider;
+
+        GlyphAtlas frameNumberDigits;
+
+        /**
+         * Arm telemetry. It's rendered again only when any of the watched values changes.
+         */
+        HudLayer telemetryLayer;
+        std::size_t telemetryHash = 0;
+        unsigned long telemetryRendersCount = 0;
+
+        std::size_t calculateTelemetryHash(cv::Size imageSize);
+
+        void renderTelemetryLayer(cv::Size imageSize);
     };
 }
@@ -1,6 +1,8 @@
 #include "utils.hpp"
 #include "GripperImageSource.hpp"
 
+#include <algorithm>
+
 using namespace camera;
 
 WALLAROO_REGISTER(GripperImageSource);
@@ -23,15 +25,19 @@ camera::GripperImageSource::~GripperImageSource() {
     logger.notice("Instance destroyed.");
 }
 
-cv::Mat camera::GripperImageSource::getImage(std::string &videoInput, bool drawHud) {
+cv::Mat camera::GripperImageSource::getImage(std::string &videoInput, bool drawHud, cv::Rect &roi) {
     long leftFrameNo, rightFrameNo;
     double leftFps, rightFps;
     cv::Mat leftFrame, rightFrame;
+    int64_t leftTimestampUs, rightTimestampUs;
 
     videoInput = "default";
 
-    std::tie(leftFrameNo, leftFps, leftFrame) = leftCameraGrabber->getFrame(leftCameraIsFaster);
-    std::tie(rightFrameNo, rightFps, rightFrame) = rightCameraGrabber->getFrame(not leftCameraIsFaster);
+    std::tie(leftFrameNo, leftFps, leftFrame, leftTimestampUs) = leftCameraGrabber->getFrame(leftCameraIsFaster);
+    std::tie(rightFrameNo, rightFps, rightFrame, rightTimestampUs) =
+            rightCameraGrabber->getFrame(not leftCameraIsFaster);
+
+    captureTimestampUs = std::min(leftTimestampUs, rightTimestampUs);
 
     bool newLeftIsFaster = leftFps > rightFps;
 
@@ -70,6 +76,8 @@ cv::Mat camera::GripperImageSource::getImage(std::string &videoInput, bool drawH
 
     logger.info("Combined image in %u us.", us);
 
+    result = cropToRegionOfInterest(result, roi);
+
     if (drawHud) {
         result = hudPainter->drawContent(result, std::make_pair(leftFrameNo, rightFrameNo));
     }
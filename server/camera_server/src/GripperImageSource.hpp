@@ -18,13 +18,24 @@ namespace camera {
 
         virtual ~GripperImageSource();
 
-        virtual cv::Mat getImage(std::string &videoInput, bool drawHud);
+        using IImageSource::getImage;
+
+        virtual cv::Mat getImage(std::string &videoInput, bool drawHud, cv::Rect &roi);
+
+        /**
+         * The older of the two combined frames.
+         */
+        virtual int64_t getCaptureTimestampUs() {
+            return captureTimestampUs;
+        }
 
     private:
         log4cpp::Category &logger;
 
         bool leftCameraIsFaster;
 
+        int64_t captureTimestampUs = 0;
+
         wallaroo::Collaborator<common::config::Configuration> config;
         wallaroo::Collaborator<IImageGrabber> leftCameraGrabber;
         wallaroo::Collaborator<IImageGrabber> rightCameraGrabber;
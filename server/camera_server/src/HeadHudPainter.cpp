@@ -1,5 +1,7 @@
 #include "Configuration.hpp"
 #include "Painter.hpp"
+#include "HudOverlay.hpp"
+#include "UyvyImage.hpp"
 #include "SharedInterfaceProvider.hpp"
 
 #include <opencv2/opencv.hpp>
@@ -12,13 +14,18 @@ using namespace cv;
 namespace camera {
     const Scalar GREEN(0x55, 0xD4, 0x19);
     const Scalar RED(0x19, 0x1B, 0xD4);
+    const Scalar GRAY(0xC0, 0xC0, 0xC0);
+
+    const char *const HUD_DIGITS = "0123456789.-";
 
     class HeadHudPainter : public IPainter, public wallaroo::Part {
     public:
         HeadHudPainter()
                 : logger(log4cpp::Category::getInstance("HeadHudPainter")),
                   config("config", RegistrationToken()),
-                  interfaceProvider("interfaceProvider", RegistrationToken()) {
+                  interfaceProvider("interfaceProvider", RegistrationToken()),
+                  greenDigits(HUD_DIGITS, 1, 4, GREEN),
+                  redDigits(HUD_DIGITS, 1, 4, RED) {
             logger.notice("Instance created.");
         }
 
@@ -27,34 +34,72 @@ namespace camera {
         }
 
         virtual cv::Mat drawContent(cv::Mat rawImage, boost::any additionalArg) {
+            drawHud(rawImage, additionalArg);
+            return rawImage;
+        }
+
+        virtual bool drawContentOnUyvy(cv::Mat uyvyImage, boost::any additionalArg) {
+            drawHud(uyvyImage, additionalArg);
+            return true;
+        }
+
+    private:
+        log4cpp::Category &logger;
+        wallaroo::Collaborator<common::config::Configuration> config;
+        wallaroo::Collaborator<common::bridge::InterfaceProvider> interfaceProvider;
+
+        GlyphAtlas greenDigits;
+        GlyphAtlas redDigits;
+
+        /**
+         * Frames of the progress bars. The layer depends only on the image size, which changes with ROI requests.
+         */
+        HudLayer staticLayer;
+
+        const Point PROGRESS_BAR_SIZE = Point(100, 20);
+
+        Point getMotorInfoPivot(cv::Size imageSize) {
+            return Point(imageSize.width / 2, imageSize.height - 40);
+        }
+
+        /**
+         * Draws on BGR or UYVY image.
+         */
+        void drawHud(cv::Mat &image, boost::any additionalArg) {
             long frameNo;
             double fps;
 
             std::tie(frameNo, fps) = boost::any_cast<std::pair<long, double>>(additionalArg);
 
-            putText(rawImage, std::to_string(frameNo).c_str(),
-                    Point(30, 30), FONT_HERSHEY_SIMPLEX, 1, GREEN, 4);
-
-            putText(rawImage, (boost::format("%.1f") % fps).str().c_str(),
-                    Point(30, 63), FONT_HERSHEY_SIMPLEX, 1, RED, 4);
+            greenDigits.drawText(image, std::to_string(frameNo), Point(30, 30));
+            redDigits.drawText(image, (boost::format("%.1f") % fps).str(), Point(30, 63));
 
             if (interfaceProvider->isValid()) {
-                drawMotorInfo(rawImage);
-            }
+                if (staticLayer.getSize() != image.size()) {
+                    renderStaticLayer(image.size());
+                }
 
-            return rawImage;
+                staticLayer.blendInto(image);
+                drawMotorInfo(image);
+            }
         }
 
-    private:
-        log4cpp::Category &logger;
-        wallaroo::Collaborator<common::config::Configuration> config;
-        wallaroo::Collaborator<common::bridge::InterfaceProvider> interfaceProvider;
+        void renderStaticLayer(cv::Size imageSize) {
+            logger.info("Rendering static HUD layer for %dx%d image.", imageSize.width, imageSize.height);
+
+            staticLayer.reset(imageSize);
+
+            const Point pivot = getMotorInfoPivot(imageSize);
+
+            staticLayer.drawRectangle(Rect(pivot + Point(-120, 0), pivot + Point(-120, 0) + PROGRESS_BAR_SIZE), GRAY, 2);
+            staticLayer.drawRectangle(Rect(pivot + Point(20, 0), pivot + Point(20, 0) + PROGRESS_BAR_SIZE), GRAY, 2);
+        }
 
         void drawMotorInfo(cv::Mat &img) {
             using namespace common::bridge;
-            const Point size(100, 20);
+            const Point size = PROGRESS_BAR_SIZE;
 
-            const Point pivot(img.cols / 2, img.rows - 40);
+            const Point pivot = getMotorInfoPivot(img.size());
 
             auto drawMotorSpeed = [&](Interface::MotorClass::SingleMotor &motor,
                                       Point offset,
@@ -70,6 +115,9 @@ namespace camera {
             drawMotorSpeed(interfaceProvider->getInterface()->motor.right, Point(20, 0), false);
         }
 
+        /**
+         * Fills the bar, its frame comes from the static layer.
+         */
         void drawProgressBar(cv::Mat &img,
                              cv::Point topLeft,
                              cv::Point size,
@@ -77,14 +125,26 @@ namespace camera {
                              float progress,
                              bool invert = false) {
 
-            rectangle(img, topLeft, topLeft + size, color, 2);
+            Rect filledArea;
 
             if (invert) {
                 Point filledAreaOffset(size.x * (1.0 - progress), 0);
-                rectangle(img, topLeft + filledAreaOffset, topLeft + size, color, FILLED);
+                filledArea = Rect(topLeft + filledAreaOffset, topLeft + size);
             } else {
                 Point filledAreaSize(size.x * progress, size.y);
-                rectangle(img, topLeft, topLeft + filledAreaSize, color, FILLED);
+                filledArea = Rect(topLeft, topLeft + filledAreaSize);
+            }
+
+            filledArea &= Rect(0, 0, img.cols, img.rows);
+
+            if (filledArea.area() == 0) {
+                return;
+            }
+
+            if (img.type() == CV_8UC2) {
+                fillUyvy(img, filledArea, color);
+            } else {
+                img(filledArea).setTo(color);
             }
         }
     };
@@ -1,6 +1,7 @@
 #include "ImageSource.hpp"
 #include "Painter.hpp"
 #include "CameraImageGrabber.hpp"
+#include "UyvyImage.hpp"
 
 #include "utils.hpp"
 
@@ -26,6 +27,8 @@ namespace camera {
         int gripperInputNo;
         int backInputNo;
 
+        int64_t captureTimestampUs = 0;
+
     public:
         HeadImageSource()
                 : logger(log4cpp::Category::getInstance("HeadImageSource")),
@@ -49,8 +52,55 @@ namespace camera {
             logger.notice("Instance destroyed.");
         }
 
-        virtual cv::Mat getImage(std::string &videoInput, bool drawHud) {
+        using IImageSource::getImage;
+
+        virtual cv::Mat getImage(std::string &videoInput, bool drawHud, cv::Rect &roi) {
+            long frameNo;
+            double fps;
+            cv::Mat frame;
+
+            selectVideoInput(videoInput);
+            std::tie(frameNo, fps, frame, captureTimestampUs) = cameraGrabber->getFrame(true);
+
+            // HUD and encoder work only on the region
+            frame = cropToRegionOfInterest(frame, roi);
+
+            // the grabber buffer is shared by all requests for the frame, so the HUD is drawn on a copy
+            if (drawHud) {
+                frame = hudPainter->drawContent(frame.clone(), std::make_pair(frameNo, fps));
+            }
+
+            return frame;
+        }
+
+        virtual cv::Mat getUyvyImage(std::string &videoInput, bool drawHud, cv::Rect &roi) {
+            long frameNo;
+            double fps;
+            cv::Mat frame;
+
+            selectVideoInput(videoInput);
+            std::tie(frameNo, fps, frame, captureTimestampUs) = cameraGrabber->getUyvyFrame(true);
+
+            roi = alignRegionToUyvy(roi);
+            frame = cropToRegionOfInterest(frame, roi);
+
+            if (drawHud) {
+                frame = frame.clone();
+
+                if (not hudPainter->drawContentOnUyvy(frame, std::make_pair(frameNo, fps))) {
+                    return cv::Mat();
+                }
+            }
+
+            return frame;
+        }
+
+        virtual int64_t getCaptureTimestampUs() {
+            return captureTimestampUs;
+        }
 
+    private:
+        void selectVideoInput(std::string &videoInput) {
             FlipParams flipParams;
             int input = 0;
 
@@ -64,18 +114,7 @@ namespace camera {
                 logger.info("Taking frame from gripper camera.");
             }
 
-            long frameNo;
-            double fps;
-            cv::Mat frame;
-
             cameraGrabber->setVideoParams(input, flipParams);
-            std::tie(frameNo, fps, frame) = cameraGrabber->getFrame(true);
-
-            if (drawHud) {
-                frame = hudPainter->drawContent(frame, std::make_pair(frameNo, fps));
-            }
-
-            return frame;
         }
     };
 }
@@ -0,0 +1,199 @@
+#include "HudOverlay.hpp"
+#include "UyvyImage.hpp"
+
+#include <algorithm>
+
+#ifdef __SSE2__
+
+#include <emmintrin.h>
+
+#endif
+
+using namespace std;
+using namespace camera;
+
+static void blendRow(unsigned char *dst, const unsigned char *src, const unsigned char *alpha, int length) {
+    int i = 0;
+
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i max = _mm_set1_epi16(255);
+    const __m128i half = _mm_set1_epi16(128);
+
+    // x / 255 is computed as (x + 128 + ((x + 128) >> 8)) >> 8, exact for the whole range used here
+    auto blend = [&](__m128i d, __m128i s, __m128i a) {
+        __m128i x = _mm_add_epi16(_mm_mullo_epi16(d, _mm_sub_epi16(max, a)), _mm_mullo_epi16(s, a));
+        x = _mm_add_epi16(x, half);
+        return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+    };
+
+    for (; i + 16 <= length; i += 16) {
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(alpha + i));
+
+        __m128i lo = blend(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(a, zero));
+        __m128i hi = blend(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(a, zero));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(lo, hi));
+    }
+#endif
+
+    for (; i < length; ++i) {
+        unsigned int x = dst[i] * (255 - alpha[i]) + src[i] * alpha[i] + 128;
+        dst[i] = (x + (x >> 8)) >> 8;
+    }
+}
+
+void camera::blendImages(cv::Mat dst, const cv::Mat &src, const cv::Mat &alpha) {
+    CV_Assert(dst.size() == src.size() and dst.size() == alpha.size());
+    CV_Assert(dst.type() == src.type() and dst.type() == alpha.type());
+
+    int rowLength = dst.cols * dst.elemSize();
+
+    for (int y = 0; y < dst.rows; ++y) {
+        blendRow(dst.ptr(y), src.ptr(y), alpha.ptr(y), rowLength);
+    }
+}
+
+/**
+ * Blends the part of the overlay placed at the given position which fits in the image.
+ */
+static void blendClipped(cv::Mat image, const cv::Mat &color, const cv::Mat &alpha, cv::Point position) {
+    cv::Rect target(position, color.size());
+    cv::Rect clipped = target & cv::Rect(0, 0, image.cols, image.rows);
+
+    if (clipped.area() == 0) {
+        return;
+    }
+
+    cv::Rect source(clipped.tl() - position, clipped.size());
+    blendImages(image(clipped), color(source), alpha(source));
+}
+
+static bool isUyvy(const cv::Mat &image) {
+    return image.type() == CV_8UC2;
+}
+
+void camera::HudLayer::reset(cv::Size size) {
+    color = cv::Mat(size, CV_8UC3, cv::Scalar::all(0));
+    alpha = cv::Mat(size, CV_8UC3, cv::Scalar::all(0));
+    uyvyColor.release();
+    uyvyAlpha.release();
+    dirtyRects.clear();
+}
+
+void camera::HudLayer::drawRectangle(cv::Rect rect, cv::Scalar rectColor, int thickness) {
+    uyvyColor.release();
+
+    cv::rectangle(color, rect, rectColor, thickness);
+    cv::rectangle(alpha, rect, cv::Scalar::all(255), thickness);
+
+    // negative thickness means filled rectangle
+    int margin = std::max(thickness, 0);
+    markDirty(cv::Rect(rect.x - margin, rect.y - margin, rect.width + 2 * margin, rect.height + 2 * margin));
+}
+
+void camera::HudLayer::drawText(const std::string &text,
+                                cv::Point origin,
+                                double fontScale,
+                                cv::Scalar textColor,
+                                int thickness) {
+    int baseline = 0;
+    auto size = cv::getTextSize(text, cv::FONT_HERSHEY_SIMPLEX, fontScale, thickness, &baseline);
+
+    uyvyColor.release();
+
+    cv::putText(color, text, origin, cv::FONT_HERSHEY_SIMPLEX, fontScale, textColor, thickness, cv::LINE_AA);
+    cv::putText(alpha, text, origin, cv::FONT_HERSHEY_SIMPLEX, fontScale, cv::Scalar::all(255), thickness,
+                cv::LINE_AA);
+
+    markDirty(cv::Rect(origin.x - thickness, origin.y - size.height - thickness,
+                       size.width + 2 * thickness, size.height + baseline + 2 * thickness));
+}
+
+void camera::HudLayer::markDirty(cv::Rect rect) {
+    rect &= cv::Rect(0, 0, color.cols, color.rows);
+
+    if (rect.area() > 0) {
+        dirtyRects.push_back(rect);
+    }
+}
+
+void camera::HudLayer::blendInto(cv::Mat image) {
+    CV_Assert(image.size() == color.size());
+
+    if (not isUyvy(image)) {
+        for (auto &rect : dirtyRects) {
+            blendImages(image(rect), color(rect), alpha(rect));
+        }
+        return;
+    }
+
+    if (uyvyColor.empty()) {
+        // UYVY conversion needs even width, the odd last column is transparent anyway
+        cv::Rect evenArea(0, 0, color.cols & ~1, color.rows);
+        convertBgrToUyvy(color(evenArea), uyvyColor);
+        convertAlphaToUyvy(alpha(evenArea), uyvyAlpha);
+    }
+
+    cv::Rect evenImageArea(0, 0, uyvyColor.cols, uyvyColor.rows);
+
+    for (auto &rect : dirtyRects) {
+        cv::Rect aligned = alignRegionToUyvy(rect) & evenImageArea;
+        blendImages(image(aligned), uyvyColor(aligned), uyvyAlpha(aligned));
+    }
+}
+
+camera::GlyphAtlas::GlyphAtlas(const std::string &characters, double fontScale, int thickness, cv::Scalar color)
+        : ascent(0), padding(thickness) {
+
+    for (char c : characters) {
+        int baseline = 0;
+        auto size = cv::getTextSize(std::string(1, c), cv::FONT_HERSHEY_SIMPLEX, fontScale, thickness, &baseline);
+        ascent = std::max(ascent, size.height);
+    }
+
+    for (char c : characters) {
+        std::string character(1, c);
+        int baseline = 0;
+        auto size = cv::getTextSize(character, cv::FONT_HERSHEY_SIMPLEX, fontScale, thickness, &baseline);
+
+        auto &glyph = glyphs.at(static_cast<unsigned char>(c));
+        glyph.advance = size.width;
+
+        // even width lets the glyph keep whole chroma pairs on UYVY images
+        cv::Size glyphSize((size.width + 2 * padding + 1) & ~1, ascent + baseline + 2 * padding);
+
+        cv::Mat mask(glyphSize, CV_8UC1, cv::Scalar::all(0));
+        cv::putText(mask, character, cv::Point(padding, padding + ascent), cv::FONT_HERSHEY_SIMPLEX, fontScale,
+                    cv::Scalar::all(255), thickness, cv::LINE_AA);
+
+        cv::cvtColor(mask, glyph.alpha, cv::COLOR_GRAY2BGR);
+        glyph.color = cv::Mat(glyphSize, CV_8UC3, color);
+
+        convertBgrToUyvy(glyph.color, glyph.uyvyColor);
+        convertAlphaToUyvy(glyph.alpha, glyph.uyvyAlpha);
+    }
+}
+
+void camera::GlyphAtlas::drawText(cv::Mat image, const std::string &text, cv::Point origin) {
+    cv::Point position(origin.x - padding, origin.y - ascent - padding);
+
+    for (char c : text) {
+        auto index = static_cast<unsigned char>(c);
+        if (index >= glyphs.size() or glyphs[index].advance == 0) {
+            continue;
+        }
+
+        auto &glyph = glyphs[index];
+
+        if (isUyvy(image)) {
+            blendClipped(image, glyph.uyvyColor, glyph.uyvyAlpha, cv::Point(position.x & ~1, position.y));
+        } else {
+            blendClipped(image, glyph.color, glyph.alpha, position);
+        }
+
+        position.x += glyph.advance;
+    }
+}
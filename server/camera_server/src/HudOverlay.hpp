@@ -0,0 +1,83 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <array>
+#include <string>
+#include <vector>
+
+namespace camera {
+
+    /**
+     * Blends src onto dst: dst = dst * (255 - alpha) / 255 + src * alpha / 255.
+     * All matrices are of the same size and type, alpha holds the value for each byte,
+     * so the same function blends BGR and UYVY images.
+     */
+    void blendImages(cv::Mat dst, const cv::Mat &src, const cv::Mat &alpha);
+
+    /**
+     * Layer of the HUD which doesn't change between frames. It's rendered once per frame size
+     * and only its dirty rectangles are blended into each frame. Both BGR and UYVY images are supported.
+     */
+    class HudLayer : boost::noncopyable {
+    public:
+        void reset(cv::Size size);
+
+        cv::Size getSize() {
+            return color.size();
+        }
+
+        bool isEmpty() {
+            return dirtyRects.empty();
+        }
+
+        void drawRectangle(cv::Rect rect, cv::Scalar rectColor, int thickness);
+
+        void drawText(const std::string &text, cv::Point origin, double fontScale, cv::Scalar textColor, int thickness);
+
+        void blendInto(cv::Mat image);
+
+    private:
+        cv::Mat color;
+        cv::Mat alpha;
+        std::vector<cv::Rect> dirtyRects;
+
+        /**
+         * Converted from color and alpha at the first use on UYVY image.
+         */
+        cv::Mat uyvyColor;
+        cv::Mat uyvyAlpha;
+
+        void markDirty(cv::Rect rect);
+    };
+
+    /**
+     * Characters rasterized once with cv::putText, so drawing the text costs only the blending of the glyphs.
+     * On UYVY images the glyphs are placed at even columns.
+     */
+    class GlyphAtlas : boost::noncopyable {
+    public:
+        GlyphAtlas(const std::string &characters, double fontScale, int thickness, cv::Scalar color);
+
+        /**
+         * Draws the text like cv::putText does, origin is the bottom-left corner of the text.
+         * Characters missing in the atlas are skipped.
+         */
+        void drawText(cv::Mat image, const std::string &text, cv::Point origin);
+
+    private:
+        struct Glyph {
+            cv::Mat color;
+            cv::Mat alpha;
+            cv::Mat uyvyColor;
+            cv::Mat uyvyAlpha;
+            int advance = 0;
+        };
+
+        std::array<Glyph, 128> glyphs;
+
+        int ascent;
+        int padding;
+    };
+}
@@ -5,6 +5,7 @@
 
 #include <stdexcept>
 #include <functional>
+#include <cstdint>
 
 namespace camera {
     class ImageSourceException : public std::runtime_error {
@@ -20,6 +21,48 @@ namespace camera {
     public:
         virtual ~IImageSource() = default;
 
-        virtual cv::Mat getImage(std::string &videoInput, bool drawHud) = 0;
+        /**
+         * @param roi region of the frame which is drawn and returned, empty rectangle means the whole frame.
+         * It's clipped to the frame boundaries, so after the call it holds the region actually returned.
+         */
+        virtual cv::Mat getImage(std::string &videoInput, bool drawHud, cv::Rect &roi) = 0;
+
+        virtual cv::Mat getImage(std::string &videoInput, bool drawHud) {
+            cv::Rect wholeFrame;
+            return getImage(videoInput, drawHud, wholeFrame);
+        }
+
+        /**
+         * Same as getImage(), but returns the image in UYVY format (CV_8UC2), skipping the BGR conversion.
+         * The region is aligned to even columns.
+         * @return empty matrix if the source can't provide such image, getImage() has to be used then.
+         */
+        virtual cv::Mat getUyvyImage(std::string &videoInput, bool drawHud, cv::Rect &roi) {
+            return cv::Mat();
+        }
+
+        /**
+         * @return capture time of the frame returned by the last getImage() or getUyvyImage() call,
+         * in microseconds since the epoch, 0 if the source doesn't know it.
+         */
+        virtual int64_t getCaptureTimestampUs() {
+            return 0;
+        }
     };
+
+    /**
+     * Returns the view of the region of interest, no data is copied.
+     */
+    inline cv::Mat cropToRegionOfInterest(cv::Mat image, cv::Rect &roi) {
+        cv::Rect frameRect(0, 0, image.cols, image.rows);
+
+        roi &= frameRect;
+
+        if (roi.area() == 0) {
+            roi = frameRect;
+            return image;
+        }
+
+        return image(roi);
+    }
 }
@@ -1,4 +1,5 @@
 #include "JpegEncoder.hpp"
+#include "UyvyImage.hpp"
 
 #include "utils.hpp"
 
@@ -63,7 +64,9 @@ public:
 
         int us = common::utils::measureTime<std::chrono::microseconds>([&]() {
 
-            int status = tjCompress2(_jpegCompressor, inputImage.data, inputImage.cols, 0, inputImage.rows, TJPF_BGR,
+            // explicit pitch, the image may be a view of the larger frame
+            int status = tjCompress2(_jpegCompressor, inputImage.data, inputImage.cols, inputImage.step,
+                                     inputImage.rows, TJPF_BGR,
                                      &outputBuffer, &_jpegSize, TJSAMP_422, quality,
                                      TJFLAG_FASTDCT | TJFLAG_NOREALLOC);
 
@@ -77,7 +80,39 @@ public:
         return _jpegSize;
     }
 
+    unsigned int encodeUyvyImage(cv::Mat inputImage,
+                                 unsigned char *outputBuffer,
+                                 unsigned int maxOutputLength,
+                                 int quality) override {
+        long unsigned int _jpegSize = maxOutputLength;
+
+        int us = common::utils::measureTime<std::chrono::microseconds>([&]() {
+            // no color conversion at all, only the planes are separated
+            splitUyvyToPlanes(inputImage, yPlane, uPlane, vPlane);
+
+            const unsigned char *planes[3] = {yPlane.data, uPlane.data, vPlane.data};
+            int strides[3] = {static_cast<int>(yPlane.step), static_cast<int>(uPlane.step),
+                              static_cast<int>(vPlane.step)};
+
+            int status = tjCompressFromYUVPlanes(_jpegCompressor, planes, inputImage.cols, strides, inputImage.rows,
+                                                 TJSAMP_422, &outputBuffer, &_jpegSize, quality,
+                                                 TJFLAG_FASTDCT | TJFLAG_NOREALLOC);
+
+            if (status != 0) {
+                throw std::runtime_error((boost::format("tjCompressFromYUVPlanes error: %s") % tjGetErrorStr()).str());
+            }
+        });
+
+        logger.info((boost::format("Converted UYVY image to JPEG in %u us.") % us).str());
+
+        return _jpegSize;
+    }
+
 private:
+    cv::Mat yPlane;
+    cv::Mat uPlane;
+    cv::Mat vPlane;
+
     log4cpp::Category &logger = log4cpp::Category::getInstance("TurboJpegEncoder");
 
     tjhandle _jpegCompressor;
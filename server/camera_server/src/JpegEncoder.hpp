@@ -23,5 +23,18 @@ namespace camera {
                                          unsigned int maxOutputLength) {
             return encodeImage(inputImage, outputBuffer, maxOutputLength, DEFAULT_JPEG_QUALITY);
         }
+
+        /**
+         * Encodes the UYVY image (CV_8UC2). This implementation converts it to BGR first,
+         * encoders able to take the YUV data directly should override it.
+         */
+        virtual unsigned int encodeUyvyImage(cv::Mat inputImage,
+                                             unsigned char *outputBuffer,
+                                             unsigned int maxOutputLength,
+                                             int quality) {
+            cv::Mat bgrImage;
+            cv::cvtColor(inputImage, bgrImage, cv::COLOR_YUV2BGR_UYVY);
+            return encodeImage(bgrImage, outputBuffer, maxOutputLength, quality);
+        }
     };
 }
\ No newline at end of file
@@ -0,0 +1,300 @@
+#include "MjpegRecorder.hpp"
+
+#include "utils.hpp"
+
+#include <boost/format.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+
+using namespace std;
+using namespace boost;
+using namespace camera;
+
+namespace camera {
+    constexpr unsigned int RECORDER_BUFFER_SIZE = 0x100000;
+
+    /**
+     * At 30 fps and 40 kB per frame this gives about 7 s of slack for the disk.
+     */
+    constexpr unsigned int RECORDER_NUMBER_OF_BUFFERS = 8;
+
+    /**
+     * O_DIRECT requires both the memory and the file offsets to be aligned to the logical block size.
+     */
+    constexpr unsigned int RECORDER_BLOCK_SIZE = 4096;
+
+    /**
+     * The I/O thread takes the entries after each written buffer or when the ring is half full,
+     * so the ring is full only when the disk doesn't keep up anyway.
+     */
+    constexpr unsigned int RECORDER_INDEX_RING_SIZE = 4096;
+
+    constexpr unsigned char JPEG_SOI[] = {0xff, 0xd8};
+
+    constexpr unsigned char APP9_MARKER = 0xe9;
+
+    /**
+     * Marker, length, "SZARK\0" identifier, frame number and timestamp, both 64-bit big-endian.
+     */
+    constexpr unsigned int APP9_SEGMENT_LENGTH = 2 + 2 + 6 + 8 + 8;
+
+    static void putBigEndian(unsigned char *dest, uint64_t value) {
+        for (int i = 7; i >= 0; --i) {
+            dest[i] = value & 0xff;
+            value >>= 8;
+        }
+    }
+}
+
+camera::MjpegRecorder::MjpegRecorder(const std::string &fileName)
+        : logger(log4cpp::Category::getInstance("MjpegRecorder")),
+          fileName(fileName),
+          buffers(RECORDER_NUMBER_OF_BUFFERS),
+          indexRing(RECORDER_INDEX_RING_SIZE) {
+
+    fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+
+    if (fd == -1 and errno == EINVAL) {
+        logger.warn("File system doesn't support O_DIRECT, recording through the page cache.");
+        fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+
+    if (fd == -1) {
+        throw RecorderException((format("cannot create file %s: %s") % fileName % strerror(errno)).str());
+    }
+
+    string indexFileName = fileName + ".idx";
+    indexFile.open(indexFileName, ios::binary | ios::trunc);
+
+    if (not indexFile) {
+        close(fd);
+        throw RecorderException((format("cannot create index file %s") % indexFileName).str());
+    }
+
+    indexEntriesToWrite.reserve(RECORDER_INDEX_RING_SIZE);
+
+    for (auto &b : buffers) {
+        if (posix_memalign(reinterpret_cast<void **>(&b.data), RECORDER_BLOCK_SIZE, RECORDER_BUFFER_SIZE) != 0) {
+            throw RecorderException((format("cannot allocate buffer of %u B") % RECORDER_BUFFER_SIZE).str());
+        }
+        freeBuffers.push_back(&b);
+    }
+
+    currentBuffer = freeBuffers.back();
+    freeBuffers.pop_back();
+
+    ioThread.reset(new std::thread(&MjpegRecorder::ioThreadFunction, this));
+    common::utils::setThreadName(logger, ioThread.get(), "MjpegRecorder");
+
+    logger.notice("Recording to %s.", fileName.c_str());
+
+    logger.notice("Instance created.");
+}
+
+camera::MjpegRecorder::~MjpegRecorder() {
+    {
+        std::lock_guard<std::mutex> lk(mutex);
+        finishThread = true;
+    }
+    cond.notify_all();
+
+    ioThread->join();
+
+    for (auto &b : buffers) {
+        free(b.data);
+    }
+
+    logger.notice("Recorded %lu frames (%lu B), %lu frames dropped.",
+                  recordedFramesCount, static_cast<unsigned long>(streamLength), droppedFramesCount);
+
+    logger.notice("Instance destroyed.");
+}
+
+bool camera::MjpegRecorder::record(const unsigned char *jpegData,
+                                   unsigned int jpegLength,
+                                   long frameNo,
+                                   int64_t timestampUs) {
+
+    if (jpegLength < sizeof(JPEG_SOI) or std::memcmp(jpegData, JPEG_SOI, sizeof(JPEG_SOI)) != 0) {
+        logger.error("Frame %ld is not a JPEG, not recording it.", frameNo);
+        return false;
+    }
+
+    unsigned char segment[APP9_SEGMENT_LENGTH] = {0xff, APP9_MARKER, 0, APP9_SEGMENT_LENGTH - 2,
+                                                  'S', 'Z', 'A', 'R', 'K', 0};
+    putBigEndian(segment + 10, frameNo);
+    putBigEndian(segment + 18, timestampUs);
+
+    const unsigned int recordLength = jpegLength + APP9_SEGMENT_LENGTH;
+
+    // the I/O thread holds the mutex only for taking and returning the buffers, never during writing
+    std::unique_lock<std::mutex> lk(mutex);
+
+    const uint64_t available = (RECORDER_BUFFER_SIZE - currentBuffer->length)
+                               + uint64_t(freeBuffers.size()) * RECORDER_BUFFER_SIZE;
+
+    if (recordLength > available or indexRingCount == indexRing.size()) {
+        droppedFramesCount++;
+        logger.warn("Disk doesn't keep up, dropping frame %ld. %lu frames dropped so far.",
+                    frameNo, droppedFramesCount);
+        return false;
+    }
+
+    indexRing[(indexRingHead + indexRingCount) % indexRing.size()] = {frameNo, timestampUs, streamLength,
+                                                                       recordLength, 0};
+    indexRingCount++;
+
+    size_t fullBuffersBefore = fullBuffers.size();
+
+    appendToStream(jpegData, sizeof(JPEG_SOI));
+    appendToStream(segment, sizeof(segment));
+    appendToStream(jpegData + sizeof(JPEG_SOI), jpegLength - sizeof(JPEG_SOI));
+
+    recordedFramesCount++;
+
+    bool wakeUpIoThread = fullBuffers.size() != fullBuffersBefore or indexRingCount == indexRing.size() / 2;
+    lk.unlock();
+
+    if (wakeUpIoThread) {
+        cond.notify_all();
+    }
+
+    return true;
+}
+
+unsigned long camera::MjpegRecorder::getRecordedFramesCount() {
+    std::lock_guard<std::mutex> lk(mutex);
+    return recordedFramesCount;
+}
+
+unsigned long camera::MjpegRecorder::getDroppedFramesCount() {
+    std::lock_guard<std::mutex> lk(mutex);
+    return droppedFramesCount;
+}
+
+void camera::MjpegRecorder::appendToStream(const unsigned char *data, unsigned int length) {
+    streamLength += length;
+
+    while (length > 0) {
+        unsigned int chunk = std::min(length, RECORDER_BUFFER_SIZE - currentBuffer->length);
+        std::memcpy(currentBuffer->data + currentBuffer->length, data, chunk);
+
+        currentBuffer->length += chunk;
+        data += chunk;
+        length -= chunk;
+
+        if (currentBuffer->length == RECORDER_BUFFER_SIZE) {
+            // record() has checked that there are enough free buffers
+            fullBuffers.push_back(currentBuffer);
+            currentBuffer = freeBuffers.back();
+            freeBuffers.pop_back();
+        }
+    }
+}
+
+void camera::MjpegRecorder::ioThreadFunction() {
+    while (true) {
+        WriteBuffer *buffer = nullptr;
+
+        {
+            std::unique_lock<std::mutex> lk(mutex);
+            cond.wait(lk, [this]() {
+                return finishThread or not fullBuffers.empty() or indexRingCount >= indexRing.size() / 2;
+            });
+
+            if (not fullBuffers.empty()) {
+                buffer = fullBuffers.front();
+                fullBuffers.pop_front();
+            } else if (finishThread) {
+                break;
+            }
+
+            takeIndexEntries();
+        }
+
+        if (buffer != nullptr) {
+            writeBuffer(buffer, false);
+
+            std::lock_guard<std::mutex> lk(mutex);
+            buffer->length = 0;
+            freeBuffers.push_back(buffer);
+        }
+
+        writeIndexEntries();
+    }
+
+    // record() isn't called any more, the current buffer can be used without locking
+    writeBuffer(currentBuffer, true);
+
+    // the last buffer was padded to the block size
+    if (ftruncate(fd, streamLength) != 0) {
+        logger.error("Cannot truncate %s: %s.", fileName.c_str(), strerror(errno));
+    }
+
+    close(fd);
+
+    takeIndexEntries();
+    writeIndexEntries();
+
+    indexFile.close();
+}
+
+void camera::MjpegRecorder::writeBuffer(WriteBuffer *buffer, bool last) {
+    unsigned int length = buffer->length;
+
+    if (last) {
+        length = (length + RECORDER_BLOCK_SIZE - 1) / RECORDER_BLOCK_SIZE * RECORDER_BLOCK_SIZE;
+        std::memset(buffer->data + buffer->length, 0, length - buffer->length);
+    }
+
+    unsigned int written = 0;
+
+    int elapsedTime = common::utils::measureTime<std::chrono::milliseconds>([&]() {
+        while (written < length) {
+            ssize_t ret = write(fd, buffer->data + written, length - written);
+
+            if (ret == -1 and errno == EINTR) {
+                continue;
+            } else if (ret <= 0) {
+                logger.error("Error when writing to %s: %s.", fileName.c_str(), strerror(errno));
+                return;
+            }
+
+            written += ret;
+        }
+    });
+
+    logger.info("Written %u B in %d ms.", written, elapsedTime);
+}
+
+/**
+ * Has to be called with the mutex locked, or after record() isn't called any more.
+ */
+void camera::MjpegRecorder::takeIndexEntries() {
+    indexEntriesToWrite.clear();
+
+    for (; indexRingCount > 0; indexRingCount--) {
+        indexEntriesToWrite.push_back(indexRing[indexRingHead]);
+        indexRingHead = (indexRingHead + 1) % indexRing.size();
+    }
+}
+
+void camera::MjpegRecorder::writeIndexEntries() {
+    if (indexEntriesToWrite.empty() or not indexFile) {
+        return;
+    }
+
+    indexFile.write(reinterpret_cast<const char *>(indexEntriesToWrite.data()),
+                    indexEntriesToWrite.size() * sizeof(RecordedFrameIndexEntry));
+    indexFile.flush();
+
+    if (not indexFile) {
+        logger.error("Cannot write index file %s.idx.", fileName.c_str());
+    }
+}
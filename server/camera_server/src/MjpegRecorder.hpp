@@ -0,0 +1,133 @@
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <log4cpp/Category.hh>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <stdexcept>
+#include <cstdint>
+
+namespace camera {
+
+    class RecorderException : public std::runtime_error {
+    public:
+        RecorderException(const std::string &message)
+                : std::runtime_error(message) {
+        }
+    };
+
+    /**
+     * Entry of the index file written next to the recording.
+     */
+    struct RecordedFrameIndexEntry {
+        int64_t frameNo;
+        /**
+         * Microseconds since the epoch.
+         */
+        int64_t timestampUs;
+        /**
+         * Offset of the JPEG in the recording file.
+         */
+        uint64_t offset;
+        uint32_t length;
+        uint32_t reserved;
+    };
+
+    /**
+     * Appends the already encoded JPEGs to the file, producing the plain MJPEG stream which can be played
+     * by ffmpeg or VLC. The frame number and the capture timestamp are put in an APP9 segment
+     * right after the SOI marker of each JPEG. The index of the frames is written to <file>.idx.
+     *
+     * The frames are copied into large aligned buffers which are written by the separate I/O thread
+     * with O_DIRECT. The index entries go through the preallocated ring and are appended to the index file
+     * by the same thread. record() never waits for the disk: if all buffers are waiting for being written
+     * or the ring is full, the frame is dropped.
+     */
+    class MjpegRecorder : boost::noncopyable {
+    public:
+        /**
+         * @throws RecorderException if the file or the index file can't be created.
+         */
+        MjpegRecorder(const std::string &fileName);
+
+        /**
+         * Writes the remaining data and index entries and closes the files.
+         */
+        ~MjpegRecorder();
+
+        /**
+         * @return false if the frame was dropped.
+         */
+        bool record(const unsigned char *jpegData, unsigned int jpegLength, long frameNo, int64_t timestampUs);
+
+        unsigned long getRecordedFramesCount();
+
+        unsigned long getDroppedFramesCount();
+
+        std::string getFileName() {
+            return fileName;
+        }
+
+    private:
+        struct WriteBuffer {
+            unsigned char *data = nullptr;
+            unsigned int length = 0;
+        };
+
+        log4cpp::Category &logger;
+
+        std::string fileName;
+        int fd;
+
+        std::vector<WriteBuffer> buffers;
+
+        std::mutex mutex;
+        std::condition_variable cond;
+
+        std::vector<WriteBuffer *> freeBuffers;
+        std::deque<WriteBuffer *> fullBuffers;
+        WriteBuffer *currentBuffer;
+
+        /**
+         * Number of bytes passed to the recorder so far, i.e. the offset of the next frame.
+         */
+        uint64_t streamLength = 0;
+
+        std::ofstream indexFile;
+
+        /**
+         * Index entries of the recorded frames which aren't passed to the I/O thread yet.
+         */
+        std::vector<RecordedFrameIndexEntry> indexRing;
+        std::size_t indexRingHead = 0;
+        std::size_t indexRingCount = 0;
+
+        /**
+         * Used only by the I/O thread, has the capacity of the ring.
+         */
+        std::vector<RecordedFrameIndexEntry> indexEntriesToWrite;
+
+        unsigned long recordedFramesCount = 0;
+        unsigned long droppedFramesCount = 0;
+
+        bool finishThread = false;
+        std::unique_ptr<std::thread> ioThread;
+
+        void ioThreadFunction();
+
+        void appendToStream(const unsigned char *data, unsigned int length);
+
+        void writeBuffer(WriteBuffer *buffer, bool last);
+
+        void takeIndexEntries();
+
+        void writeIndexEntries();
+    };
+}
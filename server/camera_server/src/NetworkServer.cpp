@@ -1,4 +1,6 @@
 #include "NetworkServer.hpp"
+#include "AsioDatagramTransport.hpp"
+#include "UringDatagramTransport.hpp"
 #include "Configuration.hpp"
 
 #include "utils.hpp"
@@ -9,15 +11,13 @@
 #include <boost/format.hpp>
 
 #include <cstdlib>
+#include <cstring>
+#include <ctime>
 
 using namespace std;
 using namespace boost;
 using namespace camera;
 
-namespace camera {
-    constexpr int RECEIVED_DATA_MAX_LENGTH = 256;
-}
-
 WALLAROO_REGISTER(NetworkServer);
 
 camera::NetworkServer::NetworkServer()
@@ -44,8 +44,6 @@ void NetworkServer::Init() {
         port = config->getInt("NetworkServer.port");
     }
 
-    recvBuffer.reset(new char[RECEIVED_DATA_MAX_LENGTH]);
-
     logger.notice("Opening listener socket with port %u.", port);
 
     system::error_code err;
@@ -63,112 +61,267 @@ void NetworkServer::Init() {
         throw NetworkException("error at binding socket: " + err.message());
     }
 
-    if (posix_memalign(reinterpret_cast<void **>(&sendBuffer), 32, SEND_BUFFER_SIZE) != 0
-        or posix_memalign(reinterpret_cast<void **>(&sendImgBuffer), 32, SEND_BUFFER_SIZE) != 0) {
-        throw NetworkException("cannot allocate buffer");
+    createTransport();
+
+    int staticSceneThreshold = config->getInt("NetworkServer.static_scene_threshold");
+    if (staticSceneThreshold > 0) {
+        staticSceneDetector.reset(new StaticSceneDetector(staticSceneThreshold));
+        logger.notice("Static scene detection enabled, threshold %d.", staticSceneThreshold);
     }
 
-    doReceive();
+    createRecorder();
 
-    logger.notice("Started UDP listener on port %u%s.", port, ipv6enabled ? " (IPv6 enabled)" : "");
+    transport->start(
+            [this](char *data, std::size_t length, const udp::endpoint &sender) {
+                queueRequest(data, length, sender);
+            },
+            [this]() {
+                processPendingRequests();
+            });
+
+    logger.notice("Started UDP listener on port %u%s, %s backend.", port,
+                  ipv6enabled ? " (IPv6 enabled)" : "", transport->getName().c_str());
 
     logger.notice("Instance created.");
 }
 
 camera::NetworkServer::~NetworkServer() {
-    if (sendBuffer != nullptr) {
-        free(sendBuffer);
+    logger.notice("Instance destroyed.");
+}
+
+void camera::NetworkServer::createTransport() {
+    string backend = config->getString("NetworkServer.backend");
+    unsigned int zeroCopyThreshold = config->getInt("NetworkServer.zerocopy_threshold");
+
+    if (backend == "io_uring") {
+#ifdef SZARK_HAVE_LIBURING
+        try {
+            transport.reset(new UringDatagramTransport(*udpSocket, ioServiceProvider->getIoContext()));
+        } catch (NetworkException &e) {
+            logger.warn("io_uring backend not available (%s), falling back to asio.", e.what());
+        }
+#else
+        logger.warn("Compiled without liburing, falling back to asio backend.");
+#endif
+    } else if (backend != "asio") {
+        throw NetworkException("invalid network backend: " + backend);
     }
 
-    if (sendImgBuffer != nullptr) {
-        free(sendImgBuffer);
+    if (not transport) {
+        transport.reset(new AsioDatagramTransport(*udpSocket, zeroCopyThreshold));
     }
+}
 
-    logger.notice("Instance destroyed.");
+void camera::NetworkServer::createRecorder() {
+    string recordingDirectory = config->getString("NetworkServer.recording_directory");
+
+    if (recordingDirectory.empty()) {
+        return;
+    }
+
+    char fileName[64];
+    time_t now = time(nullptr);
+    strftime(fileName, sizeof(fileName), "szark-%Y%m%d-%H%M%S.mjpeg", localtime(&now));
+
+    try {
+        recorder.reset(new MjpegRecorder(recordingDirectory + "/" + fileName));
+    } catch (RecorderException &e) {
+        logger.error("Recording disabled: %s.", e.what());
+    }
 }
 
-void camera::NetworkServer::doReceive() {
-    udpSocket->async_receive_from(
-            asio::buffer(recvBuffer.get(), RECEIVED_DATA_MAX_LENGTH),
-            endpoint,
-            [this](boost::system::error_code ec, std::size_t bytesReceived) {
-                if (ec) {
-                    throw NetworkException(
-                            (format("error at receiving request: %s") % ec.message()).str());
-                }
-
-                long serial = 0;
-                bool drawHud = false;
-                int quality = camera::DEFAULT_JPEG_QUALITY;
-                string videoInput = "default";
-                string receivedTimestamp = common::utils::getTimestamp();
-                string sendTimestamp = common::utils::getTimestamp();
-
-                try {
-                    minijson::buffer_context ctx(recvBuffer.get(), RECEIVED_DATA_MAX_LENGTH);
-                    minijson::parse_object(ctx, [&](const char *k, minijson::value v) {
-                        minijson::dispatch(k)
-                        << "serial" >> [&] { serial = v.as_long(); }
-                        << "input" >> [&] { videoInput = v.as_string(); }
-                        << "drawHud" >> [&] { drawHud = v.as_bool(); }
-                        << "quality" >> [&] { quality = v.as_long(); }
-                        << "tss" >> [&] { sendTimestamp = v.as_string(); };
-                    });
-
-                    quality = std::min(100, quality);
-                    quality = std::max(5, quality);
-
-                    logger.info("Received request from %s: serial %d, input: %s, %s HUD, quality: %d.",
-                                endpoint.address().to_string().c_str(),
-                                serial,
-                                videoInput.c_str(),
-                                (drawHud ? "with" : "without"),
-                                quality);
-
-                    stringstream headerStream;
-                    minijson::object_writer writer(headerStream);
-                    writer.write("serial", serial);
-                    writer.write("input", videoInput);
-                    writer.write("drawHud", drawHud);
-                    writer.write("quality", quality);
-                    writer.write("tss", sendTimestamp);
-                    writer.write("tsr", receivedTimestamp);
-
-                    auto img = imageSource->getImage(videoInput, drawHud);
-                    auto encodedLength = jpegEncoder->encodeImage(img, sendImgBuffer, SEND_BUFFER_SIZE, quality);
-
-                    logger.debug("JPEG file length: %d B.", encodedLength);
-
-                    writer.write("tssr", common::utils::getTimestamp());
-                    writer.close();
-
-                    string header = headerStream.str();
-
-                    std::memcpy(sendBuffer, header.c_str(), header.size());
-                    sendBuffer[header.size()] = 0;
-                    std::memcpy(sendBuffer + header.size() + 1, sendImgBuffer, encodedLength);
-
-                    unsigned int packetLength = encodedLength + header.size() + 1;
-
-                    if (packetLength > UDP_MAX_PAYLOAD_SIZE) {
-                        logger.warn("Payload size %d B, limiting to %d B.", packetLength, UDP_MAX_PAYLOAD_SIZE);
-                        packetLength = min(packetLength, UDP_MAX_PAYLOAD_SIZE);
-                    }
-
-                    auto sentBytes = udpSocket->send_to(asio::buffer(sendBuffer, packetLength), endpoint);
-
-                    if (sentBytes != packetLength) {
-                        logger.error("Not whole packet sent (%u < %u).", sentBytes, packetLength);
-                    } else {
-                        logger.info("Sent packet (%u B).", packetLength);
-                    }
-
-                } catch (boost::system::system_error &err) {
-                    logger.error("send_to error: %s", err.what());
-                } catch (minijson::parse_error &exp) {
-                    logger.error("Malformed request error: %s", exp.what());
-                }
-
-                doReceive();
-            });
+void camera::NetworkServer::processPendingRequests() {
+    while (not pendingOrder.empty()) {
+        auto pending = pendingRequests.find(pendingOrder.front());
+        pendingOrder.pop_front();
+
+        auto request = pending->second;
+        pendingRequests.erase(pending);
+
+        processRequest(request);
+
+        // requests which came during encoding may supersede the pending ones
+        transport->poll();
+    }
+}
+
+void camera::NetworkServer::queueRequest(char *data,
+                                         std::size_t bytesReceived,
+                                         const boost::asio::ip::udp::endpoint &sender) {
+    ImageRequest request;
+    request.endpoint = sender;
+    request.receivedTimestamp = common::utils::getTimestamp();
+    request.sendTimestamp = request.receivedTimestamp;
+
+    try {
+        minijson::buffer_context ctx(data, bytesReceived);
+        minijson::parse_object(ctx, [&](const char *k, minijson::value v) {
+            minijson::dispatch(k)
+            << "serial" >> [&] { request.serial = v.as_long(); }
+            << "input" >> [&] { request.videoInput = v.as_string(); }
+            << "drawHud" >> [&] { request.drawHud = v.as_bool(); }
+            << "quality" >> [&] { request.quality = v.as_long(); }
+            << "tss" >> [&] { request.sendTimestamp = v.as_string(); }
+            << "roi" >> [&] {
+                minijson::parse_object(ctx, [&](const char *k, minijson::value v) {
+                    minijson::dispatch(k)
+                    << "x" >> [&] { request.roi.x = v.as_long(); }
+                    << "y" >> [&] { request.roi.y = v.as_long(); }
+                    << "w" >> [&] { request.roi.width = v.as_long(); }
+                    << "h" >> [&] { request.roi.height = v.as_long(); }
+                    << minijson::any >> [&] { minijson::ignore(ctx); };
+                });
+            };
+        });
+    } catch (minijson::parse_error &exp) {
+        logger.error("Malformed request error: %s", exp.what());
+        return;
+    }
+
+    request.quality = std::min(100, request.quality);
+    request.quality = std::max(5, request.quality);
+
+    logger.info("Received request from %s: serial %ld, input: %s, %s HUD, quality: %d, ROI: %dx%d+%d+%d.",
+                sender.address().to_string().c_str(),
+                request.serial,
+                request.videoInput.c_str(),
+                (request.drawHud ? "with" : "without"),
+                request.quality,
+                request.roi.width, request.roi.height, request.roi.x, request.roi.y);
+
+    auto pending = pendingRequests.find(sender);
+
+    if (pending == pendingRequests.end()) {
+        pendingRequests.insert(make_pair(sender, request));
+        pendingOrder.push_back(sender);
+        return;
+    }
+
+    droppedRequestsCount++;
+
+    if (pending->second.serial > request.serial) {
+        logger.info("Dropping request with serial %ld, newer one (%ld) is pending. %lu requests dropped so far.",
+                    request.serial, pending->second.serial, droppedRequestsCount);
+    } else {
+        logger.info("Dropping stale request with serial %ld, superseded by %ld. %lu requests dropped so far.",
+                    pending->second.serial, request.serial, droppedRequestsCount);
+        pending->second = request;
+    }
+}
+
+void camera::NetworkServer::processRequest(ImageRequest &request) {
+    try {
+        stringstream headerStream;
+        minijson::object_writer writer(headerStream);
+        writer.write("serial", request.serial);
+        writer.write("input", request.videoInput);
+        writer.write("drawHud", request.drawHud);
+        writer.write("quality", request.quality);
+        writer.write("tss", request.sendTimestamp);
+        writer.write("tsr", request.receivedTimestamp);
+
+        auto frame = transport->acquireFrameBuffer();
+        unsigned char *jpegData = frame->data + HEADER_RESERVED_SIZE;
+
+        cv::Rect requestedRoi = request.roi;
+        auto img = imageSource->getUyvyImage(request.videoInput, request.drawHud, request.roi);
+        if (img.empty()) {
+            img = imageSource->getImage(request.videoInput, request.drawHud, request.roi);
+        }
+
+        // the region with negative size has positive area, but gets the whole frame like the empty one;
+        // the clipped region is echoed, so the client knows which part of the frame it got
+        bool roiRequested = requestedRoi.width > 0 and requestedRoi.height > 0 and request.roi.area() > 0;
+
+        int64_t captureTimestampUs = imageSource->getCaptureTimestampUs();
+        if (captureTimestampUs == 0) {
+            captureTimestampUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+        auto encodedLength = encodeImage(request, img, jpegData);
+
+        logger.debug("JPEG file length: %d B.", encodedLength);
+
+        if (roiRequested) {
+            auto roiWriter = writer.nested_object("roi");
+            roiWriter.write("x", request.roi.x);
+            roiWriter.write("y", request.roi.y);
+            roiWriter.write("w", request.roi.width);
+            roiWriter.write("h", request.roi.height);
+            roiWriter.close();
+        }
+
+        writer.write("frame", ++frameCounter);
+
+        if (recorder) {
+            recorder->record(jpegData, encodedLength, frameCounter, captureTimestampUs);
+        }
+
+        writer.write("tssr", common::utils::getTimestamp());
+        writer.close();
+
+        string header = headerStream.str();
+
+        if (header.size() + 1 > HEADER_RESERVED_SIZE) {
+            throw NetworkException((format("header too long: %u B") % header.size()).str());
+        }
+
+        // the header is stored in the frame buffer, so it lives as long as the kernel may read it
+        std::memcpy(frame->data, header.c_str(), header.size() + 1);
+
+        transport->sendFrame(request.endpoint, frame, header.size() + 1, encodedLength);
+
+    } catch (boost::system::system_error &err) {
+        logger.error("send_to error: %s", err.what());
+    } catch (NetworkException &err) {
+        logger.error("Cannot send frame: %s.", err.what());
+    }
+}
+
+unsigned int camera::NetworkServer::encodeImage(ImageRequest &request, cv::Mat image, unsigned char *jpegData) {
+    cv::Mat thumbnail;
+    string cacheKey;
+
+    // the HUD changes (frame number, fps) stay below the threshold, so the cached JPEG would show it frozen
+    bool useCache = staticSceneDetector and not request.drawHud;
+
+    if (useCache) {
+        cacheKey.reserve(64);
+        cacheKey = request.videoInput;
+        for (int param : {request.quality, request.roi.x, request.roi.y, request.roi.width, request.roi.height}) {
+            cacheKey += '/';
+            cacheKey += std::to_string(param);
+        }
+
+        thumbnail = staticSceneDetector->createThumbnail(image);
+
+        auto cachedJpeg = staticSceneDetector->findUnchanged(cacheKey, thumbnail);
+
+        if (cachedJpeg != nullptr) {
+            skippedEncodesCount++;
+            std::memcpy(jpegData, cachedJpeg->data(), cachedJpeg->size());
+
+            logger.info("Scene is static, reusing previous JPEG. %lu encodes skipped, about %lu ms of CPU time saved.",
+                        skippedEncodesCount, skippedEncodesCount * encodingTimeUs / std::max(1ul, encodesCount) / 1000);
+
+            return cachedJpeg->size();
+        }
+    }
+
+    unsigned int encodedLength = 0;
+
+    encodingTimeUs += common::utils::measureTime<chrono::microseconds>([&]() {
+        if (image.type() == CV_8UC2) {
+            encodedLength = jpegEncoder->encodeUyvyImage(image, jpegData, SEND_BUFFER_SIZE, request.quality);
+        } else {
+            encodedLength = jpegEncoder->encodeImage(image, jpegData, SEND_BUFFER_SIZE, request.quality);
+        }
+    });
+    encodesCount++;
+
+    if (useCache) {
+        staticSceneDetector->store(cacheKey, thumbnail, jpegData, encodedLength);
+    }
+
+    return encodedLength;
 }
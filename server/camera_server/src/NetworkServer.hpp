@@ -4,6 +4,9 @@
 #include "IoServiceProvider.hpp"
 #include "GripperImageSource.hpp"
 #include "JpegEncoder.hpp"
+#include "DatagramTransport.hpp"
+#include "StaticSceneDetector.hpp"
+#include "MjpegRecorder.hpp"
 
 #include <boost/noncopyable.hpp>
 #include <boost/asio.hpp>
@@ -12,24 +15,56 @@
 
 #include <stdexcept>
 #include <memory>
+#include <map>
+#include <deque>
+#include <string>
 
 namespace camera {
 
-    class NetworkException : public std::runtime_error {
-    public:
-        NetworkException(const std::string &message)
-                : std::runtime_error(message) {
-        }
-    };
-
     class INetworkServer : boost::noncopyable {
     public:
         virtual ~INetworkServer() = default;
-    };
 
-    constexpr unsigned int UDP_MAX_PAYLOAD_SIZE = 65506;
+        /**
+         * Returns the number of requests which were superseded by a newer request from the same client
+         * before any work was done for them.
+         */
+        virtual unsigned long getDroppedRequestsCount() = 0;
+
+        /**
+         * Returns the number of frames for which the previous JPEG was sent again because the scene didn't change.
+         */
+        virtual unsigned long getSkippedEncodesCount() = 0;
+
+        /**
+         * Returns the number of sent frames which weren't recorded because the disk didn't keep up.
+         */
+        virtual unsigned long getRecorderDroppedFramesCount() = 0;
 
-    constexpr unsigned int SEND_BUFFER_SIZE = 0x20000;
+        virtual TransportStatistics getTransportStatistics() = 0;
+
+        /**
+         * Returns the name of the backend in use, which differs from the configured one after the fallback.
+         */
+        virtual std::string getTransportName() = 0;
+    };
+
+    /**
+     * Parsed image request waiting for being served.
+     */
+    struct ImageRequest {
+        boost::asio::ip::udp::endpoint endpoint;
+        long serial = 0;
+        bool drawHud = false;
+        int quality = DEFAULT_JPEG_QUALITY;
+        std::string videoInput = "default";
+        /**
+         * Empty rectangle means the whole frame.
+         */
+        cv::Rect roi;
+        std::string sendTimestamp;
+        std::string receivedTimestamp;
+    };
 
     class NetworkServer : public wallaroo::Part, public INetworkServer {
     public:
@@ -39,6 +74,26 @@ namespace camera {
 
         ~NetworkServer();
 
+        unsigned long getDroppedRequestsCount() override {
+            return droppedRequestsCount;
+        }
+
+        unsigned long getSkippedEncodesCount() override {
+            return skippedEncodesCount;
+        }
+
+        unsigned long getRecorderDroppedFramesCount() override {
+            return recorder ? recorder->getDroppedFramesCount() : 0;
+        }
+
+        TransportStatistics getTransportStatistics() override {
+            return transport->getStatistics();
+        }
+
+        std::string getTransportName() override {
+            return transport->getName();
+        }
+
     private:
         log4cpp::Category &logger;
 
@@ -49,15 +104,50 @@ namespace camera {
 
         int port;
         std::unique_ptr<boost::asio::ip::udp::socket> udpSocket;
-        boost::asio::ip::udp::endpoint endpoint;
+        std::unique_ptr<IDatagramTransport> transport;
+
+        /**
+         * Only the newest request per client endpoint is kept here. The older ones are dropped.
+         */
+        std::map<boost::asio::ip::udp::endpoint, ImageRequest> pendingRequests;
+
+        /**
+         * Clients with the pending request in the order of arrival. The superseding request keeps the place
+         * of the older one, so no client is served twice while another one waits.
+         */
+        std::deque<boost::asio::ip::udp::endpoint> pendingOrder;
+        unsigned long droppedRequestsCount = 0;
+
+        /**
+         * Number of frames sent so far, it's put in the header of each frame.
+         */
+        unsigned long frameCounter = 0;
+
+        /**
+         * Null if static scene detection is disabled.
+         */
+        std::unique_ptr<StaticSceneDetector> staticSceneDetector;
+        unsigned long skippedEncodesCount = 0;
+        unsigned long encodesCount = 0;
+        unsigned long encodingTimeUs = 0;
+
+        /**
+         * Records the sent frames. Null if recording is disabled.
+         */
+        std::unique_ptr<MjpegRecorder> recorder;
 
-        std::unique_ptr<char> recvBuffer;
+        void Init();
 
-        unsigned char *sendBuffer = nullptr;
-        unsigned char *sendImgBuffer = nullptr;
+        void createTransport();
 
-        void Init();
+        void createRecorder();
+
+        void queueRequest(char *data, std::size_t bytesReceived, const boost::asio::ip::udp::endpoint &sender);
+
+        void processPendingRequests();
+
+        void processRequest(ImageRequest &request);
 
-        void doReceive();
+        unsigned int encodeImage(ImageRequest &request, cv::Mat image, unsigned char *jpegData);
     };
 }
@@ -19,6 +19,14 @@ namespace camera {
     public:
         virtual cv::Mat drawContent(cv::Mat rawImage, boost::any additionalArg) = 0;
 
+        /**
+         * Draws the content in place on the UYVY (CV_8UC2) image.
+         * @return false if the painter supports only BGR images, the image is left untouched then.
+         */
+        virtual bool drawContentOnUyvy(cv::Mat uyvyImage, boost::any additionalArg) {
+            return false;
+        }
+
         virtual ~IPainter() = default;
     };
 }
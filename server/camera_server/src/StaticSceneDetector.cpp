@@ -0,0 +1,55 @@
+#include "StaticSceneDetector.hpp"
+
+using namespace std;
+using namespace camera;
+
+namespace camera {
+    const cv::Size THUMBNAIL_SIZE(80, 60);
+}
+
+camera::StaticSceneDetector::StaticSceneDetector(double threshold)
+        : threshold(threshold) { }
+
+cv::Mat camera::StaticSceneDetector::createThumbnail(cv::Mat image) {
+    cv::Mat small, thumbnail;
+
+    if (image.type() == CV_8UC2) {
+        // UYVY image carries luma in the second channel of each pixel
+        cv::Mat luma;
+        cv::extractChannel(image, luma, 1);
+        cv::resize(luma, thumbnail, THUMBNAIL_SIZE, 0, 0, cv::INTER_AREA);
+        return thumbnail;
+    }
+
+    // resizing first makes the color conversion nearly free
+    cv::resize(image, small, THUMBNAIL_SIZE, 0, 0, cv::INTER_AREA);
+    cv::cvtColor(small, thumbnail, cv::COLOR_BGR2GRAY);
+
+    return thumbnail;
+}
+
+const std::vector<unsigned char> *camera::StaticSceneDetector::findUnchanged(const std::string &key,
+                                                                              cv::Mat thumbnail) {
+    auto cached = cache.find(key);
+
+    if (cached == cache.end()) {
+        return nullptr;
+    }
+
+    double meanDifference = cv::norm(thumbnail, cached->second.thumbnail, cv::NORM_L1) / thumbnail.total();
+
+    if (meanDifference >= threshold) {
+        return nullptr;
+    }
+
+    return &cached->second.jpeg;
+}
+
+void camera::StaticSceneDetector::store(const std::string &key,
+                                        cv::Mat thumbnail,
+                                        const unsigned char *jpegData,
+                                        unsigned int jpegLength) {
+    auto &cached = cache[key];
+    cached.thumbnail = thumbnail;
+    cached.jpeg.assign(jpegData, jpegData + jpegLength);
+}
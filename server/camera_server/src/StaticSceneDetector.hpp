@@ -0,0 +1,50 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace camera {
+
+    /**
+     * Remembers the last encoded JPEG together with a small luma thumbnail of the image it was made from.
+     * If the next image doesn't differ more than the threshold, the remembered JPEG can be sent again
+     * instead of encoding the new one.
+     */
+    class StaticSceneDetector : boost::noncopyable {
+    public:
+        /**
+         * @param threshold mean absolute difference of the thumbnail pixels (0-255) below which the scene is static.
+         */
+        StaticSceneDetector(double threshold);
+
+        ~StaticSceneDetector() = default;
+
+        /**
+         * Creates the downsampled luma plane used for the comparison. Takes BGR or UYVY image.
+         */
+        cv::Mat createThumbnail(cv::Mat image);
+
+        /**
+         * Returns the JPEG stored under the key if the thumbnail matches the one it was encoded from,
+         * nullptr otherwise.
+         * @param key identifies the encoding parameters, JPEGs made with different ones are never reused.
+         */
+        const std::vector<unsigned char> *findUnchanged(const std::string &key, cv::Mat thumbnail);
+
+        void store(const std::string &key, cv::Mat thumbnail, const unsigned char *jpegData, unsigned int jpegLength);
+
+    private:
+        struct CachedJpeg {
+            cv::Mat thumbnail;
+            std::vector<unsigned char> jpeg;
+        };
+
+        double threshold;
+
+        std::map<std::string, CachedJpeg> cache;
+    };
+}
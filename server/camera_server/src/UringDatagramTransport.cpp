@@ -0,0 +1,338 @@
+#ifdef SZARK_HAVE_LIBURING
+
+#include "UringDatagramTransport.hpp"
+
+#include <boost/format.hpp>
+
+#include <cerrno>
+#include <cstring>
+
+using namespace std;
+using namespace boost;
+using namespace camera;
+
+namespace camera {
+    constexpr unsigned int URING_QUEUE_DEPTH = 64;
+
+    /**
+     * Receive operations kept armed in the ring. Datagrams arriving in a burst are picked up
+     * without returning to the kernel for each of them.
+     */
+    constexpr unsigned int URING_RECEIVE_OPERATIONS = 8;
+
+    constexpr unsigned int URING_SEND_OPERATIONS = 8;
+
+    /**
+     * Each queued send pins its frame buffer until the completion, so there is one buffer per send
+     * operation plus one for the frame being encoded.
+     */
+    constexpr unsigned int URING_FRAME_BUFFERS = URING_SEND_OPERATIONS + 1;
+
+    /**
+     * Index of the socket in the registered files table.
+     */
+    constexpr int URING_SOCKET_FILE_INDEX = 0;
+}
+
+camera::UringDatagramTransport::UringDatagramTransport(boost::asio::ip::udp::socket &socket,
+                                                       boost::asio::io_context &ioContext)
+        : logger(log4cpp::Category::getInstance("UringDatagramTransport")),
+          socket(socket),
+          operations(URING_RECEIVE_OPERATIONS + URING_SEND_OPERATIONS) {
+
+    int ret = io_uring_queue_init(URING_QUEUE_DEPTH, &ring, 0);
+    if (ret < 0) {
+        throw NetworkException((format("cannot initialize io_uring: %s") % strerror(-ret)).str());
+    }
+
+    // registered socket saves the file table lookup and reference counting on each operation
+    int fd = socket.native_handle();
+    ret = io_uring_register_files(&ring, &fd, 1);
+    if (ret < 0) {
+        io_uring_queue_exit(&ring);
+        throw NetworkException((format("cannot register socket in io_uring: %s") % strerror(-ret)).str());
+    }
+
+    for (unsigned int i = 0; i < operations.size(); ++i) {
+        auto &op = operations[i];
+        std::memset(&op.msg, 0, sizeof(op.msg));
+        op.msg.msg_name = &op.address;
+        op.msg.msg_iov = op.iov;
+
+        if (i < URING_RECEIVE_OPERATIONS) {
+            op.type = UringOperation::Type::RECEIVE;
+            op.receiveBuffer.reset(new char[RECEIVED_DATA_MAX_LENGTH]);
+        } else {
+            op.type = UringOperation::Type::SEND;
+            freeSendOperations.push_back(&op);
+        }
+    }
+
+    frameBufferPool.reset(new FrameBufferPool(URING_FRAME_BUFFERS, HEADER_RESERVED_SIZE + SEND_BUFFER_SIZE));
+
+    ringDescriptor.reset(new asio::posix::stream_descriptor(ioContext, ring.ring_fd));
+
+    logger.notice("Instance created.");
+}
+
+camera::UringDatagramTransport::~UringDatagramTransport() {
+    // the descriptor belongs to the ring, asio mustn't close it
+    ringDescriptor->release();
+
+    // io_uring_queue_exit() doesn't wait for the pending operations, the kernel could still write
+    // to their buffers after they are freed
+    cancelPendingOperations();
+
+    io_uring_queue_exit(&ring);
+
+    logger.notice("Instance destroyed.");
+}
+
+void camera::UringDatagramTransport::cancelPendingOperations() {
+    unsigned int pendingCount = 0;
+
+    for (auto &op : operations) {
+        if (not op.pending) {
+            continue;
+        }
+
+        pendingCount++;
+
+        auto sqe = io_uring_get_sqe(&ring);
+        if (sqe == nullptr) {
+            io_uring_submit(&ring);
+            sqe = io_uring_get_sqe(&ring);
+        }
+
+        if (sqe != nullptr) {
+            io_uring_prep_cancel(sqe, &op, 0);
+            io_uring_sqe_set_data(sqe, nullptr);
+        }
+    }
+
+    io_uring_submit(&ring);
+
+    // the cancelled operations complete with -ECANCELED, the sends in progress may still complete normally
+    while (pendingCount > 0) {
+        io_uring_cqe *cqe;
+        int ret = io_uring_wait_cqe(&ring, &cqe);
+
+        if (ret == -EINTR) {
+            continue;
+        } else if (ret < 0) {
+            logger.error("Error when waiting for cancelled operations: %s.", strerror(-ret));
+            return;
+        }
+
+        auto operation = static_cast<UringOperation *>(io_uring_cqe_get_data(cqe));
+        io_uring_cqe_seen(&ring, cqe);
+
+        // completions of the cancel requests themselves carry no operation
+        if (operation != nullptr and operation->pending) {
+            operation->pending = false;
+            pendingCount--;
+        }
+    }
+}
+
+void camera::UringDatagramTransport::start(DatagramHandler datagramHandler,
+                                           BatchFinishedHandler batchFinishedHandler) {
+    this->datagramHandler = datagramHandler;
+    this->batchFinishedHandler = batchFinishedHandler;
+
+    for (unsigned int i = 0; i < URING_RECEIVE_OPERATIONS; ++i) {
+        armReceive(operations[i]);
+    }
+    submit();
+
+    waitForCompletions();
+}
+
+void camera::UringDatagramTransport::waitForCompletions() {
+    ringDescriptor->async_wait(
+            asio::posix::stream_descriptor::wait_read,
+            [this](boost::system::error_code ec) {
+                if (ec == asio::error::operation_aborted) {
+                    return;
+                } else if (ec) {
+                    throw NetworkException(
+                            (format("error at waiting for io_uring completions: %s") % ec.message()).str());
+                }
+
+                // epoll_wait() of the reactor
+                statistics.syscalls++;
+
+                processCompletions();
+
+                batchFinishedHandler();
+
+                submit();
+
+                waitForCompletions();
+            });
+}
+
+void camera::UringDatagramTransport::poll() {
+    submit();
+    processCompletions();
+}
+
+io_uring_sqe *camera::UringDatagramTransport::getSubmissionEntry() {
+    auto sqe = io_uring_get_sqe(&ring);
+
+    if (sqe == nullptr) {
+        submit();
+        sqe = io_uring_get_sqe(&ring);
+    }
+
+    if (sqe == nullptr) {
+        throw NetworkException("io_uring submission queue is full");
+    }
+
+    return sqe;
+}
+
+void camera::UringDatagramTransport::armReceive(UringOperation &operation) {
+    operation.iov[0].iov_base = operation.receiveBuffer.get();
+    operation.iov[0].iov_len = RECEIVED_DATA_MAX_LENGTH;
+    operation.msg.msg_iovlen = 1;
+    operation.msg.msg_namelen = sizeof(operation.address);
+
+    auto sqe = getSubmissionEntry();
+    io_uring_prep_recvmsg(sqe, URING_SOCKET_FILE_INDEX, &operation.msg, 0);
+    sqe->flags |= IOSQE_FIXED_FILE;
+    io_uring_sqe_set_data(sqe, &operation);
+    operation.pending = true;
+}
+
+void camera::UringDatagramTransport::submit() {
+    if (io_uring_sq_ready(&ring) == 0) {
+        return;
+    }
+
+    statistics.syscalls++;
+    int ret = io_uring_submit(&ring);
+
+    if (ret < 0) {
+        logger.error("Error when submitting to io_uring: %s.", strerror(-ret));
+    }
+}
+
+void camera::UringDatagramTransport::processCompletions() {
+    // completion queue is shared with the kernel, reading it doesn't need a system call
+    io_uring_cqe *cqe;
+    while (io_uring_peek_cqe(&ring, &cqe) == 0) {
+        processCompletion(cqe);
+    }
+}
+
+void camera::UringDatagramTransport::processCompletion(io_uring_cqe *cqe) {
+    auto operation = static_cast<UringOperation *>(io_uring_cqe_get_data(cqe));
+    int result = cqe->res;
+    io_uring_cqe_seen(&ring, cqe);
+
+    operation->pending = false;
+
+    if (operation->type == UringOperation::Type::SEND) {
+        if (result < 0) {
+            logger.error("Error when sending packet: %s.", strerror(-result));
+        } else {
+            statistics.datagramsSent++;
+            logger.info("Sent packet (%d B).", result);
+        }
+
+        operation->frame.reset();
+        freeSendOperations.push_back(operation);
+        return;
+    }
+
+    if (result == -ECANCELED) {
+        return;
+    } else if (result < 0) {
+        logger.error("Error when receiving request: %s.", strerror(-result));
+    } else {
+        statistics.datagramsReceived++;
+
+        boost::asio::ip::udp::endpoint sender;
+        std::memcpy(sender.data(), &operation->address, operation->msg.msg_namelen);
+        sender.resize(operation->msg.msg_namelen);
+
+        datagramHandler(operation->receiveBuffer.get(), result, sender);
+    }
+
+    armReceive(*operation);
+}
+
+void camera::UringDatagramTransport::waitForCompletion() {
+    submit();
+
+    io_uring_cqe *cqe;
+    statistics.syscalls++;
+    int ret = io_uring_wait_cqe(&ring, &cqe);
+
+    if (ret < 0) {
+        throw NetworkException((format("error at waiting for io_uring completion: %s") % strerror(-ret)).str());
+    }
+
+    processCompletions();
+}
+
+FrameBufferPtr camera::UringDatagramTransport::acquireFrameBuffer() {
+    auto frame = frameBufferPool->acquire();
+
+    if (frame == nullptr) {
+        logger.warn("All frame buffers are held by the queued sends, waiting for completion.");
+        waitForCompletion();
+        frame = frameBufferPool->acquire();
+    }
+
+    if (frame == nullptr) {
+        throw NetworkException("no free frame buffer");
+    }
+
+    return frame;
+}
+
+void camera::UringDatagramTransport::sendFrame(const boost::asio::ip::udp::endpoint &destination,
+                                               FrameBufferPtr frame,
+                                               unsigned int headerLength,
+                                               unsigned int jpegLength) {
+    unsigned int packetLength = headerLength + jpegLength;
+
+    if (packetLength > UDP_MAX_PAYLOAD_SIZE) {
+        logger.warn("Payload size %d B, limiting to %d B.", packetLength, UDP_MAX_PAYLOAD_SIZE);
+        jpegLength = UDP_MAX_PAYLOAD_SIZE - headerLength;
+    }
+
+    if (freeSendOperations.empty()) {
+        waitForCompletion();
+    }
+
+    if (freeSendOperations.empty()) {
+        throw NetworkException("no free io_uring send operation");
+    }
+
+    auto operation = freeSendOperations.back();
+    freeSendOperations.pop_back();
+
+    operation->frame = frame;
+
+    operation->iov[0].iov_base = frame->data;
+    operation->iov[0].iov_len = headerLength;
+    operation->iov[1].iov_base = frame->data + HEADER_RESERVED_SIZE;
+    operation->iov[1].iov_len = jpegLength;
+    operation->msg.msg_iovlen = 2;
+
+    std::memcpy(&operation->address, destination.data(), destination.size());
+    operation->msg.msg_namelen = destination.size();
+
+    auto sqe = getSubmissionEntry();
+    io_uring_prep_sendmsg(sqe, URING_SOCKET_FILE_INDEX, &operation->msg, 0);
+    sqe->flags |= IOSQE_FIXED_FILE;
+    io_uring_sqe_set_data(sqe, operation);
+    operation->pending = true;
+
+    // submitted together with the other queued operations at poll() or at the end of the batch
+}
+
+#endif
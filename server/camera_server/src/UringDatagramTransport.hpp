@@ -0,0 +1,116 @@
+#pragma once
+
+#ifdef SZARK_HAVE_LIBURING
+
+#include "DatagramTransport.hpp"
+
+#include <log4cpp/Category.hh>
+#include <liburing.h>
+
+#include <sys/socket.h>
+
+#include <vector>
+#include <memory>
+
+namespace camera {
+
+    /**
+     * Single recvmsg() or sendmsg() operation submitted to the ring. The slot owns all the memory
+     * the kernel accesses until the completion comes, so it can't be reused before that.
+     */
+    struct UringOperation {
+        enum class Type {
+            RECEIVE,
+            SEND
+        };
+
+        Type type;
+        msghdr msg;
+        iovec iov[2];
+        sockaddr_storage address;
+
+        std::unique_ptr<char[]> receiveBuffer;
+        FrameBufferPtr frame;
+
+        /**
+         * Submitted and not completed yet.
+         */
+        bool pending = false;
+    };
+
+    /**
+     * Transport built on io_uring. Receive operations are kept armed all the time and the sends
+     * are queued, so the whole batch of them goes to the kernel with a single io_uring_enter().
+     * The ring descriptor is watched by asio, therefore the transport runs in the usual io_context thread.
+     */
+    class UringDatagramTransport : public IDatagramTransport {
+    public:
+        /**
+         * @throws NetworkException if the kernel doesn't support io_uring.
+         */
+        UringDatagramTransport(boost::asio::ip::udp::socket &socket, boost::asio::io_context &ioContext);
+
+        ~UringDatagramTransport();
+
+        void start(DatagramHandler datagramHandler, BatchFinishedHandler batchFinishedHandler) override;
+
+        void poll() override;
+
+        FrameBufferPtr acquireFrameBuffer() override;
+
+        void sendFrame(const boost::asio::ip::udp::endpoint &destination,
+                       FrameBufferPtr frame,
+                       unsigned int headerLength,
+                       unsigned int jpegLength) override;
+
+        TransportStatistics getStatistics() override {
+            TransportStatistics result = statistics;
+            result.frameBuffers = frameBufferPool->getNumberOfBuffers();
+            result.freeFrameBuffers = frameBufferPool->getNumberOfFreeBuffers();
+            return result;
+        }
+
+        std::string getName() override {
+            return "io_uring";
+        }
+
+    private:
+        log4cpp::Category &logger;
+
+        boost::asio::ip::udp::socket &socket;
+
+        io_uring ring;
+        std::unique_ptr<boost::asio::posix::stream_descriptor> ringDescriptor;
+
+        std::vector<UringOperation> operations;
+        std::vector<UringOperation *> freeSendOperations;
+
+        DatagramHandler datagramHandler;
+        BatchFinishedHandler batchFinishedHandler;
+
+        std::unique_ptr<FrameBufferPool> frameBufferPool;
+
+        TransportStatistics statistics;
+
+        void waitForCompletions();
+
+        io_uring_sqe *getSubmissionEntry();
+
+        void armReceive(UringOperation &operation);
+
+        void submit();
+
+        void processCompletions();
+
+        /**
+         * Cancels the operations in flight and waits for their completions.
+         */
+        void cancelPendingOperations();
+
+        void processCompletion(io_uring_cqe *cqe);
+
+        void waitForCompletion();
+    };
+}
+
+#endif
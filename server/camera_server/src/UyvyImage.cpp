@@ -0,0 +1,132 @@
+#include "UyvyImage.hpp"
+
+#include <array>
+#include <algorithm>
+
+using namespace std;
+using namespace camera;
+
+namespace camera {
+    struct UyvySample {
+        unsigned char y;
+        unsigned char u;
+        unsigned char v;
+    };
+
+    static UyvySample bgrToYuv(int b, int g, int r) {
+        auto clamp = [](int value) {
+            return static_cast<unsigned char>(std::min(255, std::max(0, value)));
+        };
+
+        // BT.601, Y in 16-235, chroma in 16-240, fixed point with 8 fractional bits
+        UyvySample sample;
+        sample.y = clamp(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        sample.u = clamp(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+        sample.v = clamp(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        return sample;
+    }
+
+    static array<unsigned char, 256> createRangeTable(int low, int high) {
+        array<unsigned char, 256> table;
+        for (int i = 0; i < 256; ++i) {
+            int value = ((i - low) * 255 + (high - low) / 2) / (high - low);
+            table[i] = static_cast<unsigned char>(std::min(255, std::max(0, value)));
+        }
+        return table;
+    }
+
+    static const array<unsigned char, 256> LUMA_RANGE_TABLE = createRangeTable(16, 235);
+    static const array<unsigned char, 256> CHROMA_RANGE_TABLE = createRangeTable(16, 240);
+}
+
+cv::Rect camera::alignRegionToUyvy(cv::Rect roi) {
+    if (roi.area() == 0) {
+        return roi;
+    }
+
+    int right = roi.x + roi.width;
+    roi.x &= ~1;
+    roi.width = ((right + 1) & ~1) - roi.x;
+    return roi;
+}
+
+void camera::convertBgrToUyvy(const cv::Mat &bgr, cv::Mat &uyvy) {
+    CV_Assert(bgr.type() == CV_8UC3 and bgr.cols % 2 == 0);
+
+    uyvy.create(bgr.rows, bgr.cols, CV_8UC2);
+
+    for (int y = 0; y < bgr.rows; ++y) {
+        const unsigned char *src = bgr.ptr(y);
+        unsigned char *dst = uyvy.ptr(y);
+
+        for (int x = 0; x < bgr.cols; x += 2, src += 6, dst += 4) {
+            auto first = bgrToYuv(src[0], src[1], src[2]);
+            auto second = bgrToYuv(src[3], src[4], src[5]);
+
+            dst[0] = (first.u + second.u + 1) / 2;
+            dst[1] = first.y;
+            dst[2] = (first.v + second.v + 1) / 2;
+            dst[3] = second.y;
+        }
+    }
+}
+
+void camera::convertAlphaToUyvy(const cv::Mat &alpha, cv::Mat &uyvyAlpha) {
+    CV_Assert(alpha.type() == CV_8UC3 and alpha.cols % 2 == 0);
+
+    uyvyAlpha.create(alpha.rows, alpha.cols, CV_8UC2);
+
+    for (int y = 0; y < alpha.rows; ++y) {
+        const unsigned char *src = alpha.ptr(y);
+        unsigned char *dst = uyvyAlpha.ptr(y);
+
+        for (int x = 0; x < alpha.cols; x += 2, src += 6, dst += 4) {
+            unsigned char chroma = (src[0] + src[3] + 1) / 2;
+            dst[0] = chroma;
+            dst[1] = src[0];
+            dst[2] = chroma;
+            dst[3] = src[3];
+        }
+    }
+}
+
+void camera::fillUyvy(cv::Mat uyvy, cv::Rect rect, cv::Scalar bgrColor) {
+    rect = alignRegionToUyvy(rect) & cv::Rect(0, 0, uyvy.cols, uyvy.rows);
+
+    if (rect.area() == 0) {
+        return;
+    }
+
+    auto sample = bgrToYuv(bgrColor[0], bgrColor[1], bgrColor[2]);
+    const unsigned char pair[4] = {sample.u, sample.y, sample.v, sample.y};
+
+    for (int y = rect.y; y < rect.y + rect.height; ++y) {
+        unsigned char *dst = uyvy.ptr(y) + rect.x * 2;
+
+        for (int x = 0; x < rect.width; x += 2, dst += 4) {
+            std::copy(pair, pair + 4, dst);
+        }
+    }
+}
+
+void camera::splitUyvyToPlanes(const cv::Mat &uyvy, cv::Mat &yPlane, cv::Mat &uPlane, cv::Mat &vPlane) {
+    CV_Assert(uyvy.type() == CV_8UC2 and uyvy.cols % 2 == 0);
+
+    yPlane.create(uyvy.rows, uyvy.cols, CV_8UC1);
+    uPlane.create(uyvy.rows, uyvy.cols / 2, CV_8UC1);
+    vPlane.create(uyvy.rows, uyvy.cols / 2, CV_8UC1);
+
+    for (int y = 0; y < uyvy.rows; ++y) {
+        const unsigned char *src = uyvy.ptr(y);
+        unsigned char *yDst = yPlane.ptr(y);
+        unsigned char *uDst = uPlane.ptr(y);
+        unsigned char *vDst = vPlane.ptr(y);
+
+        for (int x = 0; x < uyvy.cols; x += 2, src += 4) {
+            *uDst++ = CHROMA_RANGE_TABLE[src[0]];
+            *yDst++ = LUMA_RANGE_TABLE[src[1]];
+            *vDst++ = CHROMA_RANGE_TABLE[src[2]];
+            *yDst++ = LUMA_RANGE_TABLE[src[3]];
+        }
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+namespace camera {
+
+    /*
+     * UYVY images are kept in CV_8UC2 matrices: every pixel holds the chroma sample (U for even columns,
+     * V for odd ones) and its luma. The views of such images have to start and end at even columns.
+     */
+
+    /**
+     * Extends the region to even column boundaries, so the view of UYVY image keeps whole chroma pairs.
+     */
+    cv::Rect alignRegionToUyvy(cv::Rect roi);
+
+    /**
+     * Converts BGR image to UYVY with the limited-range BT.601 coefficients, as produced by the cameras.
+     * The width of the image has to be even.
+     */
+    void convertBgrToUyvy(const cv::Mat &bgr, cv::Mat &uyvy);
+
+    /**
+     * Converts the alpha mask replicated in three channels to per-byte alpha for UYVY blending.
+     * Chroma gets the mean alpha of both pixels sharing it.
+     */
+    void convertAlphaToUyvy(const cv::Mat &alpha, cv::Mat &uyvyAlpha);
+
+    void fillUyvy(cv::Mat uyvy, cv::Rect rect, cv::Scalar bgrColor);
+
+    /**
+     * Splits UYVY image into 4:2:2 planes and expands them from limited range to the full range used by JPEG.
+     */
+    void splitUyvyToPlanes(const cv::Mat &uyvy, cv::Mat &yPlane, cv::Mat &uPlane, cv::Mat &vPlane);
+}
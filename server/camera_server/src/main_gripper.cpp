@@ -38,6 +38,7 @@ int main(int argc, char *argv[]) {
         use("imgGrabberLeft").as("leftCameraGrabber").of("imgCombiner");
         use("imgGrabberRight").as("rightCameraGrabber").of("imgCombiner");
         use("hudPainter").as("hudPainter").of("imgCombiner");
+        use("ifaceProvider").as("interfaceProvider").of("hudPainter");
         use("imgCombiner").as("imageSource").of("srv");
         use("jpegEncoder").as("jpegEncoder").of("srv");
     };
@@ -1,6 +1,7 @@
 #include "CameraImageGrabber.hpp"
 
 #include "utils.hpp"
+#include "FrameBus.hpp"
 
 #include <boost/test/unit_test.hpp>
 #include <wallaroo/catalog.h>
@@ -8,6 +9,10 @@
 #include <boost/algorithm/string/replace.hpp>
 
 #include <tuple>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
 
 using namespace std;
 using namespace camera;
@@ -21,6 +26,9 @@ BOOST_AUTO_TEST_CASE(CameraImageGrabberTest_Run) {
     config->putInt("ImageGrabber.test_width", 720);
     config->putInt("ImageGrabber.test_height", 480);
     config->putInt("ImageGrabber.test_input", 0);
+    config->putInt("ImageGrabber.test_frame_bus_slots", 2);
+    config->putInt("ImageGrabber.test_buffers", 4);
+    config->putBool("ImageGrabber.test_latest_only", true);
 
     BOOST_CHECK_EQUAL(config->getInt("ImageGrabber.test_device"), 0);
 
@@ -41,7 +49,7 @@ BOOST_AUTO_TEST_CASE(CameraImageGrabberTest_Run) {
         cv::Mat frame;
 
         for (int j = 0; j < 5; ++j) {
-            tie(frameNo, fps, frame) = imageGrabber->getFrame(false);
+            tie(frameNo, fps, frame, std::ignore) = imageGrabber->getFrame(false);
             BOOST_TEST_MESSAGE("Frame wait no. " << frameNo << ", fps: " << fps);
         }
 
@@ -53,4 +61,76 @@ BOOST_AUTO_TEST_CASE(CameraImageGrabberTest_Run) {
     }
 
     BOOST_CHECK_EQUAL(1, 1);
-}
\ No newline at end of file
+}
+BOOST_AUTO_TEST_CASE(CameraImageGrabberTest_FrameBusWithHud) {
+    constexpr uint8_t HUD_MARK = 0xEE;
+
+    wallaroo::Catalog catalog;
+
+    catalog.Create("conf", "Configuration");
+    shared_ptr<common::config::Configuration> config = catalog["conf"];
+    config->putInt("ImageGrabber.test_device", 0);
+    config->putInt("ImageGrabber.test_width", 720);
+    config->putInt("ImageGrabber.test_height", 480);
+    config->putInt("ImageGrabber.test_input", 0);
+    config->putInt("ImageGrabber.test_frame_bus_slots", 2);
+    config->putInt("ImageGrabber.test_buffers", 4);
+    config->putBool("ImageGrabber.test_latest_only", true);
+
+    catalog.Create("imgGrabber", "Video4LinuxImageGrabber", string("test"));
+
+    wallaroo_within(catalog) {
+        wallaroo::use("conf").as("config").of("imgGrabber");
+    };
+
+    catalog.CheckWiring();
+    catalog.Init();
+
+    shared_ptr<IImageGrabber> imageGrabber = catalog["imgGrabber"];
+
+    // draws the "HUD" on a copy, as HeadImageSource does, by marking the first row of each frame
+    atomic<bool> finish(false);
+    atomic<int> markedGrabberFrames(0);
+    thread hudConsumer([&]() {
+        while (not finish) {
+            long frameNo;
+            double fps;
+            cv::Mat frame;
+            tie(frameNo, fps, frame, std::ignore) = imageGrabber->getUyvyFrame(true);
+
+            if (frame.ptr(0)[0] == HUD_MARK and frame.ptr(0)[frame.cols * 2 - 1] == HUD_MARK) {
+                markedGrabberFrames++;
+            }
+
+            cv::Mat hud = frame.clone();
+            std::memset(hud.ptr(0), HUD_MARK, hud.cols * 2);
+        }
+    });
+
+    common::framebus::FrameBusReader reader("SZARK_frames_test");
+
+    int checkedFrames = 0;
+
+    for (int i = 0; i < 50; i++) {
+        uint32_t published = reader.getPublishedFramesCount();
+        BOOST_REQUIRE(reader.waitForFrame(published, 1000));
+
+        common::framebus::FrameView view;
+        BOOST_REQUIRE(reader.getLatestFrame(view));
+
+        bool marked = std::all_of(view.data, view.data + view.info.rowLength, [](uint8_t b) {
+            return b == HUD_MARK;
+        });
+
+        if (reader.isStillValid(view)) {
+            BOOST_CHECK_MESSAGE(not marked, "frame " << view.info.frameNo << " on the bus contains the HUD");
+            checkedFrames++;
+        }
+    }
+
+    finish = true;
+    hudConsumer.join();
+
+    BOOST_CHECK(checkedFrames > 0);
+    BOOST_CHECK_EQUAL(markedGrabberFrames, 0);
+}
@@ -0,0 +1,53 @@
+#include "GripperHudPainter.hpp"
+
+#include <boost/test/unit_test.hpp>
+#include <wallaroo/catalog.h>
+
+using namespace std;
+using namespace camera;
+using namespace common::bridge;
+
+BOOST_AUTO_TEST_CASE(GripperHudPainterTest_TelemetryRerender) {
+    wallaroo::Catalog catalog;
+    catalog.Create("conf", "Configuration");
+    catalog.Create("hudPainter", "GripperHudPainter");
+    catalog.Create("ifaceProvider", "InterfaceProvider", true);
+
+    wallaroo_within(catalog) {
+        wallaroo::use("conf").as("config").of("hudPainter");
+        wallaroo::use("ifaceProvider").as("interfaceProvider").of("hudPainter");
+    }
+
+    catalog.CheckWiring();
+    catalog.Init();
+
+    shared_ptr<GripperHudPainter> painter = catalog["hudPainter"];
+    shared_ptr<InterfaceProvider> interfaceProvider = catalog["ifaceProvider"];
+
+    auto draw = [&](cv::Size size) {
+        cv::Mat image(size, CV_8UC3, cv::Scalar::all(0));
+        painter->drawContent(image, make_pair(1L, 2L));
+    };
+
+    // the frame numbers change every frame, the telemetry is rendered only once
+    draw(cv::Size(640, 480));
+    draw(cv::Size(640, 480));
+    draw(cv::Size(640, 480));
+    BOOST_CHECK_EQUAL(painter->getNumOfTelemetryRenders(), 1);
+
+    {
+        auto *iface = interfaceProvider->getInterface();
+        SharedScopedMutex lk(iface->mutex);
+        iface->arm.calibrate();
+    }
+
+    draw(cv::Size(640, 480));
+    BOOST_CHECK_EQUAL(painter->getNumOfTelemetryRenders(), 2);
+
+    draw(cv::Size(640, 480));
+    BOOST_CHECK_EQUAL(painter->getNumOfTelemetryRenders(), 2);
+
+    // the layer doesn't fit another image size
+    draw(cv::Size(320, 240));
+    BOOST_CHECK_EQUAL(painter->getNumOfTelemetryRenders(), 3);
+}
@@ -13,10 +13,12 @@ BOOST_AUTO_TEST_CASE(GripperImageSourceTest_Run) {
     catalog.Create("imgGrabberRight", "ImageGrabber", string("right"));
     catalog.Create("imgCombiner", "GripperImageSource");
     catalog.Create("hudPainter", "GripperHudPainter");
+    catalog.Create("ifaceProvider", "InterfaceProvider", false);
 
     wallaroo::use(catalog["imgGrabberLeft"]).as("leftCameraGrabber").of(catalog["imgCombiner"]);
     wallaroo::use(catalog["imgGrabberRight"]).as("rightCameraGrabber").of(catalog["imgCombiner"]);
     wallaroo::use(catalog["hudPainter"]).as("hudPainter").of(catalog["imgCombiner"]);
+    wallaroo::use(catalog["ifaceProvider"]).as("interfaceProvider").of(catalog["hudPainter"]);
 
     catalog.CheckWiring();
 
@@ -0,0 +1,139 @@
+#include "HudOverlay.hpp"
+#include "UyvyImage.hpp"
+
+#include <boost/test/unit_test.hpp>
+#include <opencv2/opencv.hpp>
+
+#include <cmath>
+
+using namespace std;
+using namespace camera;
+
+/**
+ * dst * (255 - alpha) / 255 + src * alpha / 255 rounded to the nearest integer.
+ */
+static void blendReference(cv::Mat dst, const cv::Mat &src, const cv::Mat &alpha) {
+    int rowLength = dst.cols * dst.elemSize();
+
+    for (int y = 0; y < dst.rows; ++y) {
+        unsigned char *d = dst.ptr(y);
+        const unsigned char *s = src.ptr(y);
+        const unsigned char *a = alpha.ptr(y);
+
+        for (int i = 0; i < rowLength; ++i) {
+            d[i] = std::lround((d[i] * (255 - a[i]) + s[i] * a[i]) / 255.0);
+        }
+    }
+}
+
+static bool isEqual(const cv::Mat &first, const cv::Mat &second) {
+    return cv::norm(first, second, cv::NORM_INF) == 0;
+}
+
+static bool isFilledWith(const cv::Mat &image, const cv::Scalar &value) {
+    return isEqual(image, cv::Mat(image.size(), image.type(), value));
+}
+
+BOOST_AUTO_TEST_CASE(HudOverlayTest_BlendImages) {
+    // 37 BGR pixels give the rows of 111 B, the vectorized loop leaves the tail of 15 B for the scalar one
+    cv::Mat dst(23, 37, CV_8UC3);
+    cv::Mat src(dst.size(), CV_8UC3);
+    cv::Mat alpha(dst.size(), CV_8UC3);
+
+    cv::randu(dst, cv::Scalar::all(0), cv::Scalar::all(256));
+    cv::randu(src, cv::Scalar::all(0), cv::Scalar::all(256));
+    cv::randu(alpha, cv::Scalar::all(0), cv::Scalar::all(256));
+
+    // the extreme values of alpha
+    alpha.row(0).setTo(cv::Scalar::all(0));
+    alpha.row(1).setTo(cv::Scalar::all(255));
+
+    cv::Mat expected = dst.clone();
+    blendReference(expected, src, alpha);
+
+    blendImages(dst, src, alpha);
+
+    BOOST_CHECK(isEqual(dst, expected));
+
+    // view which doesn't start at the row beginning, 13 px wide
+    cv::Rect rect(3, 5, 13, 7);
+    cv::randu(dst, cv::Scalar::all(0), cv::Scalar::all(256));
+    expected = dst.clone();
+    blendReference(expected(rect), src(rect), alpha(rect));
+
+    blendImages(dst(rect), src(rect), alpha(rect));
+
+    BOOST_CHECK(isEqual(dst, expected));
+}
+
+BOOST_AUTO_TEST_CASE(HudOverlayTest_HudLayerDirtyRect) {
+    const cv::Scalar color(10, 200, 30);
+
+    HudLayer layer;
+    layer.reset(cv::Size(100, 60));
+    BOOST_CHECK(layer.isEmpty());
+
+    // opaque, 22 px wide dirty rectangle, only that part of the frame is blended
+    cv::Rect rect(6, 7, 22, 9);
+    layer.drawRectangle(rect, color, cv::FILLED);
+    BOOST_CHECK(not layer.isEmpty());
+
+    cv::Mat bgr(60, 100, CV_8UC3);
+    cv::randu(bgr, cv::Scalar::all(0), cv::Scalar::all(256));
+
+    cv::Mat expected = bgr.clone();
+    expected(rect).setTo(color);
+
+    layer.blendInto(bgr);
+
+    BOOST_CHECK(isEqual(bgr, expected));
+
+    // the same layer on UYVY image
+    cv::Mat uyvy(60, 100, CV_8UC2);
+    cv::randu(uyvy, cv::Scalar::all(0), cv::Scalar::all(256));
+
+    cv::Mat expectedUyvy = uyvy.clone();
+    cv::Mat uyvyColor;
+    convertBgrToUyvy(cv::Mat(rect.size(), CV_8UC3, color), uyvyColor);
+    uyvyColor.copyTo(expectedUyvy(rect));
+
+    layer.blendInto(uyvy);
+
+    BOOST_CHECK(isEqual(uyvy, expectedUyvy));
+}
+
+BOOST_AUTO_TEST_CASE(HudOverlayTest_GlyphAtlas) {
+    const cv::Scalar green(0, 255, 0);
+
+    GlyphAtlas atlas("0123456789", 0.5, 1, green);
+
+    // the glyph rasterized by cv::putText on black gives the same pixels as blending it onto black
+    cv::Mat drawn(40, 60, CV_8UC3, cv::Scalar::all(0));
+    atlas.drawText(drawn, "7", cv::Point(10, 30));
+
+    cv::Mat expected(40, 60, CV_8UC3, cv::Scalar::all(0));
+    cv::putText(expected, "7", cv::Point(10, 30), cv::FONT_HERSHEY_SIMPLEX, 0.5, green, 1, cv::LINE_AA);
+
+    BOOST_CHECK(not isFilledWith(expected, cv::Scalar::all(0)));
+    BOOST_CHECK(cv::norm(drawn, expected, cv::NORM_INF) <= 1);
+
+    // characters missing in the atlas are skipped
+    cv::Mat untouched(40, 60, CV_8UC3, cv::Scalar::all(0));
+    atlas.drawText(untouched, "x", cv::Point(10, 30));
+    BOOST_CHECK(isFilledWith(untouched, cv::Scalar::all(0)));
+
+    // the text crossing the edges is clipped
+    cv::Mat clipped(40, 60, CV_8UC3, cv::Scalar::all(0));
+    atlas.drawText(clipped, "0123456789", cv::Point(-5, 5));
+    atlas.drawText(clipped, "0123456789", cv::Point(40, 45));
+    BOOST_CHECK(not isFilledWith(clipped, cv::Scalar::all(0)));
+
+    // on UYVY image the glyph is moved to the even column, the neighbouring origins give the same result
+    cv::Mat uyvyFirst(40, 60, CV_8UC2, cv::Scalar::all(16));
+    cv::Mat uyvySecond = uyvyFirst.clone();
+    atlas.drawText(uyvyFirst, "7", cv::Point(11, 30));
+    atlas.drawText(uyvySecond, "7", cv::Point(12, 30));
+
+    BOOST_CHECK(not isFilledWith(uyvyFirst, cv::Scalar::all(16)));
+    BOOST_CHECK(isEqual(uyvyFirst, uyvySecond));
+}
@@ -1,4 +1,5 @@
 #include "JpegEncoder.hpp"
+#include "UyvyImage.hpp"
 
 #include "utils.hpp"
 
@@ -7,6 +8,8 @@
 
 #include <boost/algorithm/string/replace.hpp>
 
+#include <array>
+#include <vector>
 #include <fstream>
 #include <chrono>
 
@@ -62,3 +65,38 @@ BOOST_AUTO_TEST_CASE(JpegEncoderTest_Performance) {
 
     BOOST_CHECK_EQUAL(1, 1);
 }
+
+BOOST_AUTO_TEST_CASE(JpegEncoderTest_Uyvy) {
+    wallaroo::Catalog catalog;
+    catalog.Create("openCvJpegEncoder", "OpenCvJpegEncoder");
+    catalog.Create("turboJpegEncoder", "TurboJpegEncoder");
+
+    catalog.CheckWiring();
+
+    vector<unsigned char> outputBuffer(BUFFER_SIZE);
+
+    cv::Mat bgrImage = cv::imread(TEST_IMAGE);
+    cv::Mat uyvyImage;
+    convertBgrToUyvy(bgrImage(cv::Rect(0, 0, bgrImage.cols & ~1, bgrImage.rows)), uyvyImage);
+
+    array<pair<string, shared_ptr<IJpegEncoder>>, 2> encoders = {
+            make_pair("OpenCV", catalog["openCvJpegEncoder"]),
+            make_pair("TurboJPEG", catalog["turboJpegEncoder"])
+    };
+
+    for (auto &enc : encoders) {
+        unsigned int size;
+
+        int ms = common::utils::measureTime<chrono::milliseconds>([&]() {
+            for (int i = 0; i < 100; ++i) {
+                size = enc.second->encodeUyvyImage(uyvyImage, outputBuffer.data(), BUFFER_SIZE, DEFAULT_JPEG_QUALITY);
+            }
+        });
+
+        BOOST_TEST_MESSAGE(enc.first << ": encoded UYVY JPEG size: " << size << " B, overall time: " << ms << " ms.");
+
+        BOOST_REQUIRE(size > 2);
+        BOOST_CHECK_EQUAL(0xff, outputBuffer[0]);
+        BOOST_CHECK_EQUAL(0xd8, outputBuffer[1]);
+    }
+}
@@ -0,0 +1,108 @@
+#include "MjpegRecorder.hpp"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+using namespace std;
+using namespace camera;
+
+BOOST_AUTO_TEST_CASE(MjpegRecorderTest_Record) {
+    auto fileName = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("%%%%%%.mjpeg")).string();
+
+    const int NUMBER_OF_FRAMES = 200;
+    const unsigned int JPEG_LENGTH = 30000;
+
+    {
+        MjpegRecorder recorder(fileName);
+
+        BOOST_CHECK(not recorder.record(reinterpret_cast<const unsigned char *>("notajpeg"), 8, 0, 0));
+
+        vector<unsigned char> jpeg(JPEG_LENGTH);
+        jpeg[0] = 0xff;
+        jpeg[1] = 0xd8;
+
+        for (int i = 0; i < NUMBER_OF_FRAMES; ++i) {
+            std::fill(jpeg.begin() + 2, jpeg.end(), static_cast<unsigned char>(i));
+            recorder.record(jpeg.data(), jpeg.size(), i, 1000000 + i);
+        }
+
+        BOOST_CHECK_EQUAL(recorder.getRecordedFramesCount() + recorder.getDroppedFramesCount(), NUMBER_OF_FRAMES);
+    }
+
+    ifstream indexFile(fileName + ".idx", ios::binary);
+    vector<char> indexData((istreambuf_iterator<char>(indexFile)), istreambuf_iterator<char>());
+    auto *index = reinterpret_cast<RecordedFrameIndexEntry *>(indexData.data());
+    unsigned int numberOfEntries = indexData.size() / sizeof(RecordedFrameIndexEntry);
+
+    BOOST_REQUIRE(numberOfEntries > 0);
+
+    ifstream recording(fileName, ios::binary);
+    vector<unsigned char> data((istreambuf_iterator<char>(recording)), istreambuf_iterator<char>());
+
+    auto &last = index[numberOfEntries - 1];
+    BOOST_CHECK_EQUAL(data.size(), last.offset + last.length);
+
+    for (unsigned int i = 0; i < numberOfEntries; ++i) {
+        auto &entry = index[i];
+        BOOST_REQUIRE(entry.offset + entry.length <= data.size());
+
+        unsigned char *frame = data.data() + entry.offset;
+
+        BOOST_CHECK_EQUAL(frame[0], 0xff);
+        BOOST_CHECK_EQUAL(frame[1], 0xd8);
+        BOOST_CHECK_EQUAL(frame[3], 0xe9);
+        BOOST_CHECK_EQUAL(frame[10], 'K');
+        BOOST_CHECK_EQUAL(frame[entry.length - 1], static_cast<unsigned char>(entry.frameNo));
+        BOOST_CHECK_EQUAL(entry.timestampUs, 1000000 + entry.frameNo);
+    }
+
+    boost::filesystem::remove(fileName);
+    boost::filesystem::remove(fileName + ".idx");
+}
+
+BOOST_AUTO_TEST_CASE(MjpegRecorderTest_IndexOfSmallFrames) {
+    auto fileName = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("%%%%%%.mjpeg")).string();
+
+    // more frames than the index ring holds, all of them fit in a single buffer
+    const int NUMBER_OF_FRAMES = 10000;
+    const unsigned int JPEG_LENGTH = 64;
+
+    unsigned long recordedFramesCount;
+
+    {
+        MjpegRecorder recorder(fileName);
+
+        vector<unsigned char> jpeg(JPEG_LENGTH, 0);
+        jpeg[0] = 0xff;
+        jpeg[1] = 0xd8;
+
+        for (int i = 0; i < NUMBER_OF_FRAMES; ++i) {
+            recorder.record(jpeg.data(), jpeg.size(), i, i);
+        }
+
+        recordedFramesCount = recorder.getRecordedFramesCount();
+        BOOST_CHECK_EQUAL(recordedFramesCount + recorder.getDroppedFramesCount(), NUMBER_OF_FRAMES);
+    }
+
+    ifstream indexFile(fileName + ".idx", ios::binary);
+    vector<char> indexData((istreambuf_iterator<char>(indexFile)), istreambuf_iterator<char>());
+    auto *index = reinterpret_cast<RecordedFrameIndexEntry *>(indexData.data());
+
+    BOOST_REQUIRE_EQUAL(indexData.size(), recordedFramesCount * sizeof(RecordedFrameIndexEntry));
+
+    uint64_t offset = 0;
+    for (unsigned int i = 0; i < recordedFramesCount; ++i) {
+        BOOST_REQUIRE_EQUAL(index[i].offset, offset);
+        BOOST_CHECK(i == 0 or index[i].frameNo > index[i - 1].frameNo);
+        offset += index[i].length;
+    }
+
+    BOOST_CHECK_EQUAL(boost::filesystem::file_size(fileName), offset);
+
+    boost::filesystem::remove(fileName);
+    boost::filesystem::remove(fileName + ".idx");
+}
@@ -4,16 +4,28 @@
 #include <wallaroo/catalog.h>
 #include <opencv2/opencv.hpp>
 
+#include <sys/resource.h>
+
+#ifdef SZARK_HAVE_LIBURING
+#include <liburing.h>
+#endif
+
 #include <thread>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <condition_variable>
 
 using namespace std;
 using namespace camera;
 
 class DummyImageSource : public camera::IImageSource, public wallaroo::Part {
 public:
-    cv::Mat getImage(std::string &videoInput, bool drawHud) override {
+    cv::Mat getImage(std::string &videoInput, bool drawHud, cv::Rect &roi) override {
         this_thread::sleep_for(chrono::milliseconds(100));
-        return cv::imread("test.jpg", cv::IMREAD_COLOR);
+        return cropToRegionOfInterest(cv::imread("test.jpg", cv::IMREAD_COLOR), roi);
     }
 };
 
@@ -34,3 +46,508 @@ BOOST_AUTO_TEST_CASE(NetworkServerTest_Run) {
 
     BOOST_CHECK_EQUAL(1, 1);
 }
+
+class SyntheticImageSource : public camera::IImageSource, public wallaroo::Part {
+public:
+    SyntheticImageSource() : image(288, 352, CV_8UC3) {
+        cv::randu(image, cv::Scalar::all(0), cv::Scalar::all(255));
+    }
+
+    cv::Mat getImage(std::string &videoInput, bool drawHud, cv::Rect &roi) override {
+        return cropToRegionOfInterest(image, roi);
+    }
+
+private:
+    cv::Mat image;
+};
+
+WALLAROO_REGISTER(SyntheticImageSource);
+
+/**
+ * Creates the server with the given image source and the default configuration, which the tests can override
+ * before the catalog is initialized.
+ */
+static void createServer(wallaroo::Catalog &catalog, int port, const string &backend = "asio",
+                         const char *imageSource = "SyntheticImageSource") {
+    catalog.Create("conf", "Configuration");
+    catalog.Create("imageSource", imageSource);
+    catalog.Create("jpegEncoder", "TurboJpegEncoder");
+    catalog.Create("ioServiceProvider", "IoServiceProvider");
+    catalog.Create("srv", "NetworkServer");
+
+    wallaroo_within(catalog) {
+        wallaroo::use("conf").as("config").of("srv");
+        wallaroo::use("imageSource").as("imageSource").of("srv");
+        wallaroo::use("jpegEncoder").as("jpegEncoder").of("srv");
+        wallaroo::use("ioServiceProvider").as("ioServiceProvider").of("srv");
+    };
+
+    auto config = std::shared_ptr<common::config::Configuration>(catalog["conf"]);
+    config->putInt("NetworkServer.port", port);
+    config->putBool("NetworkServer.enable_ipv6", false);
+    config->putInt("NetworkServer.zerocopy_threshold", 0);
+    config->putInt("NetworkServer.static_scene_threshold", 0);
+    config->putString("NetworkServer.backend", backend);
+    config->putString("NetworkServer.recording_directory", "");
+}
+
+static double getThreadCpuTimeMs() {
+    rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    return usage.ru_utime.tv_sec * 1e3 + usage.ru_utime.tv_usec / 1e3
+           + usage.ru_stime.tv_sec * 1e3 + usage.ru_stime.tv_usec / 1e3;
+}
+
+/**
+ * Returns the backend NetworkServer is expected to use when the given one is configured.
+ */
+static string getExpectedBackend(const string &backend) {
+#ifdef SZARK_HAVE_LIBURING
+    io_uring ring;
+    if (backend == "io_uring" and io_uring_queue_init(1, &ring, 0) == 0) {
+        io_uring_queue_exit(&ring);
+        return backend;
+    }
+#endif
+    return "asio";
+}
+
+/**
+ * Serves a fixed number of frames to several clients and reports the system calls and CPU time
+ * of the server thread per frame.
+ */
+static void runBackendLoadTest(const string &backend, int port) {
+    using boost::asio::ip::udp;
+
+    constexpr int NUMBER_OF_CLIENTS = 4;
+    constexpr int FRAMES_PER_CLIENT = 250;
+
+    wallaroo::Catalog catalog;
+    createServer(catalog, port, backend);
+
+    catalog.CheckWiring();
+    catalog.Init();
+
+    auto server = std::shared_ptr<camera::INetworkServer>(catalog["srv"]);
+    auto &ioContext = std::shared_ptr<common::IoServiceProvider>(catalog["ioServiceProvider"])->getIoContext();
+
+    double cpuTimeStart = 0, cpuTimeEnd = 0;
+    boost::asio::post(ioContext, [&] { cpuTimeStart = getThreadCpuTimeMs(); });
+
+    thread serverThread([&] { ioContext.run(); });
+
+    atomic<int> framesReceived(0);
+
+    vector<thread> clients;
+    for (int c = 0; c < NUMBER_OF_CLIENTS; ++c) {
+        clients.emplace_back([&] {
+            boost::asio::io_context clientContext;
+            udp::socket socket(clientContext, udp::endpoint(udp::v4(), 0));
+            socket.non_blocking(false);
+
+            timeval timeout = {1, 0};
+            setsockopt(socket.native_handle(), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+            udp::endpoint serverEndpoint(boost::asio::ip::address_v4::loopback(), port);
+            unique_ptr<char[]> buffer(new char[UDP_MAX_PAYLOAD_SIZE]);
+
+            for (int serial = 1; serial <= FRAMES_PER_CLIENT; ++serial) {
+                string request = "{\"serial\":" + to_string(serial) + ",\"quality\":60}";
+                socket.send_to(boost::asio::buffer(request), serverEndpoint);
+
+                boost::system::error_code err;
+                socket.receive(boost::asio::buffer(buffer.get(), UDP_MAX_PAYLOAD_SIZE), 0, err);
+
+                if (not err) {
+                    framesReceived++;
+                }
+            }
+        });
+    }
+
+    for (auto &c : clients) {
+        c.join();
+    }
+
+    boost::asio::post(ioContext, [&] {
+        cpuTimeEnd = getThreadCpuTimeMs();
+        ioContext.stop();
+    });
+    serverThread.join();
+
+    auto stats = server->getTransportStatistics();
+    string usedBackend = server->getTransportName();
+
+    BOOST_CHECK_EQUAL(usedBackend, getExpectedBackend(backend));
+
+    // each client waits for the response, so no request is superseded and the loopback doesn't lose any
+    BOOST_REQUIRE(stats.datagramsSent > 0);
+    BOOST_CHECK_EQUAL(stats.datagramsReceived, NUMBER_OF_CLIENTS * FRAMES_PER_CLIENT);
+    BOOST_CHECK_EQUAL(stats.datagramsSent, framesReceived.load());
+    BOOST_CHECK_EQUAL(framesReceived.load(), NUMBER_OF_CLIENTS * FRAMES_PER_CLIENT);
+
+    BOOST_TEST_MESSAGE(usedBackend << " backend: " << stats.datagramsSent << " frames sent, "
+                       << static_cast<double>(stats.syscalls) / stats.datagramsSent << " syscalls/frame, "
+                       << (cpuTimeEnd - cpuTimeStart) / stats.datagramsSent << " ms CPU/frame.");
+}
+
+BOOST_AUTO_TEST_CASE(NetworkServerTest_BackendLoad) {
+    runBackendLoadTest("asio", 10250);
+    runBackendLoadTest("io_uring", 10251);
+}
+
+BOOST_AUTO_TEST_CASE(NetworkServerTest_RegionOfInterest) {
+    using boost::asio::ip::udp;
+
+    constexpr int PORT = 10252;
+
+    wallaroo::Catalog catalog;
+    createServer(catalog, PORT);
+
+    catalog.CheckWiring();
+    catalog.Init();
+
+    auto &ioContext = std::shared_ptr<common::IoServiceProvider>(catalog["ioServiceProvider"])->getIoContext();
+    thread serverThread([&] { ioContext.run(); });
+
+    boost::asio::io_context clientContext;
+    udp::socket socket(clientContext, udp::endpoint(udp::v4(), 0));
+
+    timeval timeout = {1, 0};
+    setsockopt(socket.native_handle(), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    udp::endpoint serverEndpoint(boost::asio::ip::address_v4::loopback(), PORT);
+    unique_ptr<char[]> buffer(new char[UDP_MAX_PAYLOAD_SIZE]);
+
+    // returns the header without spaces and the decoded frame
+    auto requestFrame = [&](const string &roi, string &header, cv::Mat &frame) {
+        string request = R"({"serial":1,"quality":90)" + (roi.empty() ? "" : R"(,"roi":)" + roi) + "}";
+        socket.send_to(boost::asio::buffer(request), serverEndpoint);
+
+        boost::system::error_code err;
+        size_t length = socket.receive(boost::asio::buffer(buffer.get(), UDP_MAX_PAYLOAD_SIZE), 0, err);
+        BOOST_REQUIRE(not err);
+
+        header = buffer.get();
+        size_t jpegOffset = header.size() + 1;
+        header.erase(std::remove(header.begin(), header.end(), ' '), header.end());
+
+        vector<unsigned char> jpeg(buffer.get() + jpegOffset, buffer.get() + length);
+        frame = cv::imdecode(jpeg, cv::IMREAD_COLOR);
+    };
+
+    string header;
+    cv::Mat frame;
+
+    // the whole frame, no echo
+    requestFrame("", header, frame);
+    BOOST_CHECK(header.find(R"("roi")") == string::npos);
+    BOOST_CHECK_EQUAL(frame.cols, 352);
+    BOOST_CHECK_EQUAL(frame.rows, 288);
+
+    requestFrame(R"({"x":16,"y":8,"w":64,"h":32})", header, frame);
+    BOOST_CHECK(header.find(R"("roi":{"x":16,"y":8,"w":64,"h":32})") != string::npos);
+    BOOST_CHECK_EQUAL(frame.cols, 64);
+    BOOST_CHECK_EQUAL(frame.rows, 32);
+
+    // clipped to the frame
+    requestFrame(R"({"x":300,"y":250,"w":100,"h":100})", header, frame);
+    BOOST_CHECK(header.find(R"("roi":{"x":300,"y":250,"w":52,"h":38})") != string::npos);
+    BOOST_CHECK_EQUAL(frame.cols, 52);
+    BOOST_CHECK_EQUAL(frame.rows, 38);
+
+    // outside of the frame, the whole frame is sent and echoed
+    requestFrame(R"({"x":1000,"y":1000,"w":10,"h":10})", header, frame);
+    BOOST_CHECK(header.find(R"("roi":{"x":0,"y":0,"w":352,"h":288})") != string::npos);
+    BOOST_CHECK_EQUAL(frame.cols, 352);
+    BOOST_CHECK_EQUAL(frame.rows, 288);
+
+    // negative size has positive area, but it's not a region
+    requestFrame(R"({"x":10,"y":10,"w":-20,"h":-20})", header, frame);
+    BOOST_CHECK(header.find(R"("roi")") == string::npos);
+    BOOST_CHECK_EQUAL(frame.cols, 352);
+    BOOST_CHECK_EQUAL(frame.rows, 288);
+
+    boost::asio::post(ioContext, [&] { ioContext.stop(); });
+    serverThread.join();
+}
+
+/**
+ * Holds the first frame until it's released, so the requests which come in the meantime wait in the socket.
+ */
+class GatedImageSource : public camera::IImageSource, public wallaroo::Part {
+public:
+    GatedImageSource() : image(64, 64, CV_8UC3, cv::Scalar::all(128)) {
+    }
+
+    cv::Mat getImage(std::string &videoInput, bool drawHud, cv::Rect &roi) override {
+        unique_lock<mutex> lk(gateMutex);
+        entered = true;
+        gateCv.notify_all();
+        gateCv.wait(lk, [&] { return released; });
+
+        return cropToRegionOfInterest(image, roi);
+    }
+
+    void waitForEntry() {
+        unique_lock<mutex> lk(gateMutex);
+        gateCv.wait(lk, [&] { return entered; });
+    }
+
+    void release() {
+        lock_guard<mutex> lk(gateMutex);
+        released = true;
+        gateCv.notify_all();
+    }
+
+private:
+    cv::Mat image;
+
+    mutex gateMutex;
+    condition_variable gateCv;
+    bool entered = false;
+    bool released = false;
+};
+
+WALLAROO_REGISTER(GatedImageSource);
+
+BOOST_AUTO_TEST_CASE(NetworkServerTest_CollapseRequests) {
+    using boost::asio::ip::udp;
+
+    constexpr int PORT = 10253;
+
+    wallaroo::Catalog catalog;
+    createServer(catalog, PORT, "asio", "GatedImageSource");
+
+    catalog.CheckWiring();
+    catalog.Init();
+
+    auto server = std::shared_ptr<camera::INetworkServer>(catalog["srv"]);
+    auto imageSource = std::shared_ptr<GatedImageSource>(catalog["imageSource"]);
+    auto &ioContext = std::shared_ptr<common::IoServiceProvider>(catalog["ioServiceProvider"])->getIoContext();
+
+    thread serverThread([&] { ioContext.run(); });
+
+    boost::asio::io_context clientContext;
+    udp::socket firstSocket(clientContext, udp::endpoint(udp::v4(), 0));
+    udp::socket secondSocket(clientContext, udp::endpoint(udp::v4(), 0));
+
+    // the client which sends many requests has the lower port, so it would come first in the endpoint order
+    bool firstIsLower = firstSocket.local_endpoint().port() < secondSocket.local_endpoint().port();
+    udp::socket &busyClient = firstIsLower ? firstSocket : secondSocket;
+    udp::socket &otherClient = firstIsLower ? secondSocket : firstSocket;
+
+    timeval timeout = {0, 500000};
+    setsockopt(busyClient.native_handle(), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(otherClient.native_handle(), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    udp::endpoint serverEndpoint(boost::asio::ip::address_v4::loopback(), PORT);
+
+    auto sendRequest = [&](udp::socket &socket, int serial) {
+        string request = "{\"serial\":" + to_string(serial) + "}";
+        socket.send_to(boost::asio::buffer(request), serverEndpoint);
+    };
+
+    sendRequest(busyClient, 1);
+    imageSource->waitForEntry();
+
+    // the other client comes first, the newest request of the busy one supersedes its pending ones
+    // and the older one coming after it is dropped
+    sendRequest(otherClient, 1);
+    this_thread::sleep_for(chrono::milliseconds(10));
+
+    for (int serial : {2, 3, 5, 4}) {
+        sendRequest(busyClient, serial);
+    }
+    this_thread::sleep_for(chrono::milliseconds(50));
+
+    imageSource->release();
+
+    unique_ptr<char[]> buffer(new char[UDP_MAX_PAYLOAD_SIZE]);
+
+    auto receiveHeaders = [&](udp::socket &socket) {
+        vector<string> headers;
+
+        while (true) {
+            boost::system::error_code err;
+            socket.receive(boost::asio::buffer(buffer.get(), UDP_MAX_PAYLOAD_SIZE), 0, err);
+
+            if (err) {
+                break;
+            }
+
+            string header = buffer.get();
+            header.erase(std::remove(header.begin(), header.end(), ' '), header.end());
+            headers.push_back(header);
+        }
+
+        return headers;
+    };
+
+    auto busyHeaders = receiveHeaders(busyClient);
+    auto otherHeaders = receiveHeaders(otherClient);
+
+    boost::asio::post(ioContext, [&] { ioContext.stop(); });
+    serverThread.join();
+
+    BOOST_REQUIRE_EQUAL(busyHeaders.size(), 2);
+    BOOST_CHECK(busyHeaders[0].find(R"("serial":1,)") != string::npos);
+    BOOST_CHECK(busyHeaders[1].find(R"("serial":5,)") != string::npos);
+    BOOST_CHECK_EQUAL(server->getDroppedRequestsCount(), 3);
+
+    // the clients are served in the order of arrival
+    BOOST_REQUIRE_EQUAL(otherHeaders.size(), 1);
+    BOOST_CHECK(otherHeaders[0].find(R"("serial":1,)") != string::npos);
+    BOOST_CHECK(otherHeaders[0].find(R"("frame":2,)") != string::npos);
+    BOOST_CHECK(busyHeaders[1].find(R"("frame":3,)") != string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(NetworkServerTest_ZeroCopy) {
+    using boost::asio::ip::udp;
+
+    constexpr int PORT = 10254;
+    constexpr int NUMBER_OF_CLIENTS = 4;
+    constexpr int FRAMES_PER_CLIENT = 50;
+
+    wallaroo::Catalog catalog;
+    createServer(catalog, PORT);
+
+    // the random 64x64 region gives JPEG of several kB, each frame is sent with MSG_ZEROCOPY
+    std::shared_ptr<common::config::Configuration>(catalog["conf"])->putInt("NetworkServer.zerocopy_threshold", 1000);
+
+    catalog.CheckWiring();
+    catalog.Init();
+
+    auto server = std::shared_ptr<camera::INetworkServer>(catalog["srv"]);
+    auto &ioContext = std::shared_ptr<common::IoServiceProvider>(catalog["ioServiceProvider"])->getIoContext();
+    thread serverThread([&] { ioContext.run(); });
+
+    // the scene and the parameters don't change, so the buffer reused before the kernel sent it shows up
+    // as the JPEG different from the others
+    mutex jpegsMutex;
+    vector<vector<unsigned char>> jpegs;
+
+    vector<thread> clients;
+    for (int c = 0; c < NUMBER_OF_CLIENTS; ++c) {
+        clients.emplace_back([&] {
+            boost::asio::io_context clientContext;
+            udp::socket socket(clientContext, udp::endpoint(udp::v4(), 0));
+
+            timeval timeout = {1, 0};
+            setsockopt(socket.native_handle(), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+            udp::endpoint serverEndpoint(boost::asio::ip::address_v4::loopback(), PORT);
+            unique_ptr<char[]> buffer(new char[UDP_MAX_PAYLOAD_SIZE]);
+
+            for (int serial = 1; serial <= FRAMES_PER_CLIENT; ++serial) {
+                string request = "{\"serial\":" + to_string(serial)
+                                 + R"(,"quality":90,"roi":{"x":32,"y":32,"w":64,"h":64}})";
+                socket.send_to(boost::asio::buffer(request), serverEndpoint);
+
+                boost::system::error_code err;
+                size_t length = socket.receive(boost::asio::buffer(buffer.get(), UDP_MAX_PAYLOAD_SIZE), 0, err);
+
+                if (err) {
+                    continue;
+                }
+
+                size_t jpegOffset = std::strlen(buffer.get()) + 1;
+
+                lock_guard<mutex> lk(jpegsMutex);
+                jpegs.emplace_back(buffer.get() + jpegOffset, buffer.get() + length);
+            }
+        });
+    }
+
+    for (auto &c : clients) {
+        c.join();
+    }
+
+    boost::asio::post(ioContext, [&] { ioContext.stop(); });
+    serverThread.join();
+
+    auto stats = server->getTransportStatistics();
+
+    BOOST_REQUIRE_EQUAL(jpegs.size(), NUMBER_OF_CLIENTS * FRAMES_PER_CLIENT);
+    BOOST_CHECK_EQUAL(stats.zeroCopyDatagramsSent, stats.datagramsSent);
+
+    cv::Mat frame = cv::imdecode(jpegs.front(), cv::IMREAD_COLOR);
+    BOOST_CHECK_EQUAL(frame.cols, 64);
+    BOOST_CHECK_EQUAL(frame.rows, 64);
+
+    BOOST_CHECK(std::all_of(jpegs.begin(), jpegs.end(), [&](const vector<unsigned char> &jpeg) {
+        return jpeg == jpegs.front();
+    }));
+
+    // the clients received all frames, so the kernel has released all buffers
+    BOOST_CHECK_GT(stats.frameBuffers, 1);
+    BOOST_CHECK_EQUAL(stats.freeFrameBuffers, stats.frameBuffers);
+}
+
+BOOST_AUTO_TEST_CASE(NetworkServerTest_StaticScene) {
+    using boost::asio::ip::udp;
+
+    constexpr int PORT = 10255;
+
+    wallaroo::Catalog catalog;
+    createServer(catalog, PORT);
+
+    std::shared_ptr<common::config::Configuration>(catalog["conf"])->putInt("NetworkServer.static_scene_threshold", 2);
+
+    catalog.CheckWiring();
+    catalog.Init();
+
+    auto server = std::shared_ptr<camera::INetworkServer>(catalog["srv"]);
+    auto &ioContext = std::shared_ptr<common::IoServiceProvider>(catalog["ioServiceProvider"])->getIoContext();
+    thread serverThread([&] { ioContext.run(); });
+
+    boost::asio::io_context clientContext;
+    udp::socket socket(clientContext, udp::endpoint(udp::v4(), 0));
+
+    timeval timeout = {1, 0};
+    setsockopt(socket.native_handle(), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    udp::endpoint serverEndpoint(boost::asio::ip::address_v4::loopback(), PORT);
+    unique_ptr<char[]> buffer(new char[UDP_MAX_PAYLOAD_SIZE]);
+
+    // returns the header without spaces and the JPEG
+    auto requestFrame = [&](int serial, bool drawHud, string &header, vector<unsigned char> &jpeg) {
+        string request = "{\"serial\":" + to_string(serial) + ",\"quality\":60,\"drawHud\":"
+                         + (drawHud ? "true" : "false") + "}";
+        socket.send_to(boost::asio::buffer(request), serverEndpoint);
+
+        boost::system::error_code err;
+        size_t length = socket.receive(boost::asio::buffer(buffer.get(), UDP_MAX_PAYLOAD_SIZE), 0, err);
+        BOOST_REQUIRE(not err);
+
+        header = buffer.get();
+        size_t jpegOffset = header.size() + 1;
+        header.erase(std::remove(header.begin(), header.end(), ' '), header.end());
+
+        jpeg.assign(buffer.get() + jpegOffset, buffer.get() + length);
+    };
+
+    string header;
+    vector<unsigned char> firstJpeg, jpeg;
+
+    requestFrame(1, false, header, firstJpeg);
+    BOOST_CHECK(header.find(R"("frame":1,)") != string::npos);
+
+    // the scene doesn't change, the client gets the previous JPEG with the new frame number
+    requestFrame(2, false, header, jpeg);
+    BOOST_CHECK(header.find(R"("frame":2,)") != string::npos);
+    BOOST_CHECK(jpeg == firstJpeg);
+
+    requestFrame(3, false, header, jpeg);
+    BOOST_CHECK(header.find(R"("frame":3,)") != string::npos);
+    BOOST_CHECK(jpeg == firstJpeg);
+
+    // the frames with HUD are always encoded
+    requestFrame(4, true, header, jpeg);
+    BOOST_CHECK(header.find(R"("frame":4,)") != string::npos);
+
+    boost::asio::post(ioContext, [&] { ioContext.stop(); });
+    serverThread.join();
+
+    BOOST_CHECK_EQUAL(server->getSkippedEncodesCount(), 2);
+}
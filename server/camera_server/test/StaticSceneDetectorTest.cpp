@@ -0,0 +1,28 @@
+#include "StaticSceneDetector.hpp"
+
+#include <boost/test/unit_test.hpp>
+#include <opencv2/opencv.hpp>
+
+using namespace std;
+using namespace camera;
+
+BOOST_AUTO_TEST_CASE(StaticSceneDetectorTest_Reuse) {
+    StaticSceneDetector detector(2);
+
+    cv::Mat image(288, 352, CV_8UC3, cv::Scalar(40, 80, 120));
+    unsigned char jpeg[] = {0xff, 0xd8, 0x01, 0x02, 0xff, 0xd9};
+
+    auto thumbnail = detector.createThumbnail(image);
+    BOOST_CHECK(detector.findUnchanged("default", thumbnail) == nullptr);
+
+    detector.store("default", thumbnail, jpeg, sizeof(jpeg));
+
+    auto cached = detector.findUnchanged("default", detector.createThumbnail(image));
+    BOOST_REQUIRE(cached != nullptr);
+    BOOST_CHECK_EQUAL(sizeof(jpeg), cached->size());
+
+    BOOST_CHECK(detector.findUnchanged("back", thumbnail) == nullptr);
+
+    cv::Mat changed(288, 352, CV_8UC3, cv::Scalar(200, 200, 200));
+    BOOST_CHECK(detector.findUnchanged("default", detector.createThumbnail(changed)) == nullptr);
+}
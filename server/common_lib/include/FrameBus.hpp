@@ -0,0 +1,156 @@
+#pragma once
+
+#include <boost/noncopyable.hpp>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <stdexcept>
+#include <cstdint>
+
+/*
+ * Frame bus publishes the raw camera frames in a shared memory ring, so the processes running on the robot
+ * can get them without the JPEG round trip through the network server.
+ *
+ * The segment consists of the control block followed by the slot data. Each slot is guarded by its own sequence
+ * number (seqlock): it's odd while the writer fills the slot and it's bumped to the next even value afterwards.
+ * The reader takes the latest slot, uses the data in place and checks the sequence once more to be sure
+ * that the slot wasn't overwritten in the meantime. The readers never block the writer.
+ */
+namespace common {
+    namespace framebus {
+
+        class FrameBusException : public std::runtime_error {
+        public:
+            FrameBusException(const std::string &message)
+                    : std::runtime_error(message) {
+            }
+        };
+
+        constexpr unsigned int FRAME_BUS_MAX_SLOTS = 16;
+
+        enum class PixelFormat : int32_t {
+            /**
+             * 2 bytes per pixel, U Y0 V Y1 macropixels.
+             */
+            UYVY = 1,
+            BGR24 = 2
+        };
+
+        struct FrameInfo {
+            /**
+             * Frame number as counted by the publisher.
+             */
+            int64_t frameNo;
+            /**
+             * CLOCK_MONOTONIC time of publishing.
+             */
+            int64_t timestampUs;
+
+            uint32_t width;
+            uint32_t height;
+            /**
+             * Length of each row in bytes. The rows are stored without padding.
+             */
+            uint32_t rowLength;
+            PixelFormat format;
+            int32_t input;
+        };
+
+        /**
+         * Frame placed directly in the shared memory. The data is valid only as long as
+         * FrameBusReader::isStillValid() returns true for it.
+         */
+        struct FrameView {
+            FrameInfo info;
+            const uint8_t *data = nullptr;
+
+            unsigned int slot;
+            uint32_t slotSequence;
+        };
+
+        struct FrameBusSlot {
+            std::atomic<uint32_t> sequence;
+            FrameInfo info;
+        };
+
+        struct FrameBusControlBlock {
+            uint32_t magic;
+            uint32_t numberOfSlots;
+            uint32_t slotCapacity;
+
+            /**
+             * Index of the most recently completed slot.
+             */
+            std::atomic<uint32_t> latestSlot;
+
+            /**
+             * Incremented after each published frame. Used as the futex the readers sleep on.
+             */
+            std::atomic<uint32_t> publishedFrames;
+
+            FrameBusSlot slots[FRAME_BUS_MAX_SLOTS];
+        };
+
+        static_assert(ATOMIC_INT_LOCK_FREE == 2, "frame bus requires lock-free 32-bit atomics");
+
+        struct _FrameBusSegment;
+
+        /**
+         * Creates the segment, replacing the previous one with the same name.
+         */
+        class FrameBusWriter : boost::noncopyable {
+        public:
+            /**
+             * @param slotCapacity maximal size of the frame in bytes.
+             */
+            FrameBusWriter(const std::string &name, unsigned int numberOfSlots, std::size_t slotCapacity);
+
+            ~FrameBusWriter();
+
+            /**
+             * Copies the frame into the next slot and wakes up the waiting readers.
+             * @param sourceStep distance between the rows in the source data.
+             * @throws FrameBusException if the frame doesn't fit in the slot.
+             */
+            void publish(const FrameInfo &info, const uint8_t *data, std::size_t sourceStep);
+
+        private:
+            std::unique_ptr<_FrameBusSegment> segment;
+            unsigned int nextSlot = 0;
+        };
+
+        class FrameBusReader : boost::noncopyable {
+        public:
+            /**
+             * @throws FrameBusException if the segment doesn't exist or isn't a frame bus.
+             */
+            FrameBusReader(const std::string &name);
+
+            ~FrameBusReader();
+
+            /**
+             * Points the view at the latest frame, no data is copied.
+             * @return false if nothing was published yet.
+             */
+            bool getLatestFrame(FrameView &view);
+
+            /**
+             * Has to be called after the frame data is used. If it returns false, the writer has overwritten the slot
+             * and the results computed from the data must be discarded.
+             */
+            bool isStillValid(const FrameView &view);
+
+            uint32_t getPublishedFramesCount();
+
+            /**
+             * Sleeps until the published frames counter differs from the given value.
+             * @return false on timeout.
+             */
+            bool waitForFrame(uint32_t publishedFramesCount, int timeoutMs);
+
+        private:
+            std::unique_ptr<_FrameBusSegment> segment;
+        };
+    }
+}
@@ -13,6 +13,7 @@
 #include <string>
 #include <map>
 #include <memory>
+#include <cstdint>
 
 namespace common {
     namespace bridge {
@@ -105,6 +106,22 @@ namespace common {
              */
             void insertRequest(std::string key, DataHolder value);
 
+            /**
+            * Set by updateFields() when a value read from the device differs from the stored one.
+            */
+            bool fieldsChanged = false;
+
+            /**
+            * Stores the value read from the device and notes whether it has changed.
+            */
+            template<typename T, typename V>
+            void updateField(T &field, V value) {
+                if (field != static_cast<T>(value)) {
+                    field = static_cast<T>(value);
+                    fieldsChanged = true;
+                }
+            }
+
         public:
             virtual ~IExternalDevice() = default;
 
@@ -182,9 +199,27 @@ namespace common {
             */
             bool isButtonPressed(Button button);
 
+            /**
+            * Returns the counter increased every time the values returned by the getters have changed.
+            * The data derived from the state can be reused as long as the version stays the same.
+            */
+            uint64_t getStateVersion() {
+                return stateVersion;
+            }
+
+            /**
+            * Called when the state is changed by the setters, i.e. new requests are sent to the device.
+            */
+            void increaseStateVersion() {
+                stateVersion++;
+            }
+
         private:
             bool objectActive;
 
+            uint64_t stateVersion = 1;
+
+
             /**
             * If the kill switch is requested by the user or detected by hardware, this function should be called.
             * It basically resets interface getter structures to match the actual state.
@@ -0,0 +1,242 @@
+#include "FrameBus.hpp"
+
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/format.hpp>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <chrono>
+#include <thread>
+#include <climits>
+#include <cstring>
+#include <ctime>
+
+using namespace boost::interprocess;
+
+namespace common {
+    namespace framebus {
+        constexpr uint32_t FRAME_BUS_MAGIC = 0x535a4642; // SZFB
+
+        constexpr std::size_t FRAME_BUS_PAGE_SIZE = 4096;
+
+        /**
+         * Number of attempts to get the consistent slot before giving up. The slot is overwritten only after
+         * the writer goes around the whole ring, so more than one retry is very unlikely.
+         */
+        constexpr int READ_ATTEMPTS = 8;
+
+        static std::size_t alignToPage(std::size_t size) {
+            return (size + FRAME_BUS_PAGE_SIZE - 1) / FRAME_BUS_PAGE_SIZE * FRAME_BUS_PAGE_SIZE;
+        }
+
+        static std::size_t getControlBlockAreaSize() {
+            return alignToPage(sizeof(FrameBusControlBlock));
+        }
+
+        struct _FrameBusSegment {
+            std::string name;
+            shared_memory_object sharedMemory;
+            mapped_region region;
+
+            FrameBusControlBlock *control = nullptr;
+
+            uint8_t *getSlotData(unsigned int slot) {
+                auto *base = static_cast<uint8_t *>(region.get_address());
+                return base + getControlBlockAreaSize() + slot * alignToPage(control->slotCapacity);
+            }
+        };
+
+#ifdef __linux__
+
+        static int futex(std::atomic<uint32_t> *address, int operation, uint32_t value, const timespec *timeout) {
+            // the segment is shared between processes, so the private futex flag can't be used
+            return syscall(SYS_futex, reinterpret_cast<uint32_t *>(address), operation, value, timeout, nullptr, 0);
+        }
+
+#endif
+    }
+}
+
+using namespace common::framebus;
+
+common::framebus::FrameBusWriter::FrameBusWriter(const std::string &name,
+                                                 unsigned int numberOfSlots,
+                                                 std::size_t slotCapacity)
+        : segment(new _FrameBusSegment()) {
+
+    if (numberOfSlots < 2 or numberOfSlots > FRAME_BUS_MAX_SLOTS) {
+        throw FrameBusException((boost::format("number of slots has to be between 2 and %d, got %d")
+                                 % FRAME_BUS_MAX_SLOTS % numberOfSlots).str());
+    }
+
+    segment->name = name;
+
+    try {
+        shared_memory_object::remove(name.c_str());
+
+        segment->sharedMemory = shared_memory_object(create_only, name.c_str(), read_write);
+        segment->sharedMemory.truncate(getControlBlockAreaSize() + numberOfSlots * alignToPage(slotCapacity));
+        segment->region = mapped_region(segment->sharedMemory, read_write);
+    } catch (interprocess_exception &e) {
+        throw FrameBusException((boost::format("cannot create frame bus segment '%s': %s") % name % e.what()).str());
+    }
+
+    // freshly truncated segment is zero-filled, so all slots start with even sequence
+    auto *control = new(segment->region.get_address()) FrameBusControlBlock();
+    control->numberOfSlots = numberOfSlots;
+    control->slotCapacity = slotCapacity;
+    control->latestSlot.store(0);
+    control->publishedFrames.store(0);
+    for (auto &slot : control->slots) {
+        slot.sequence.store(0);
+    }
+
+    std::atomic_thread_fence(std::memory_order_release);
+    control->magic = FRAME_BUS_MAGIC;
+
+    segment->control = control;
+}
+
+common::framebus::FrameBusWriter::~FrameBusWriter() {
+    // readers keep their mappings, the name is only unlinked
+    shared_memory_object::remove(segment->name.c_str());
+}
+
+void common::framebus::FrameBusWriter::publish(const FrameInfo &info, const uint8_t *data, std::size_t sourceStep) {
+    auto *control = segment->control;
+
+    const std::size_t frameSize = std::size_t(info.rowLength) * info.height;
+    if (frameSize > control->slotCapacity) {
+        throw FrameBusException((boost::format("frame of %d B doesn't fit in the slot of %d B")
+                                 % frameSize % control->slotCapacity).str());
+    }
+
+    auto &slot = control->slots[nextSlot];
+    uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.info = info;
+
+    uint8_t *slotData = segment->getSlotData(nextSlot);
+    if (sourceStep == info.rowLength) {
+        std::memcpy(slotData, data, frameSize);
+    } else {
+        for (uint32_t row = 0; row < info.height; ++row) {
+            std::memcpy(slotData + row * info.rowLength, data + row * sourceStep, info.rowLength);
+        }
+    }
+
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+
+    control->latestSlot.store(nextSlot, std::memory_order_release);
+    control->publishedFrames.fetch_add(1, std::memory_order_release);
+
+#ifdef __linux__
+    futex(&control->publishedFrames, FUTEX_WAKE, INT_MAX, nullptr);
+#endif
+
+    nextSlot = (nextSlot + 1) % control->numberOfSlots;
+}
+
+common::framebus::FrameBusReader::FrameBusReader(const std::string &name)
+        : segment(new _FrameBusSegment()) {
+
+    segment->name = name;
+
+    try {
+        segment->sharedMemory = shared_memory_object(open_only, name.c_str(), read_only);
+        segment->region = mapped_region(segment->sharedMemory, read_only);
+    } catch (interprocess_exception &e) {
+        throw FrameBusException((boost::format("cannot open frame bus segment '%s': %s") % name % e.what()).str());
+    }
+
+    auto *control = static_cast<FrameBusControlBlock *>(segment->region.get_address());
+
+    if (segment->region.get_size() < getControlBlockAreaSize() or control->magic != FRAME_BUS_MAGIC) {
+        throw FrameBusException((boost::format("segment '%s' isn't a frame bus") % name).str());
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    if (segment->region.get_size() <
+        getControlBlockAreaSize() + control->numberOfSlots * alignToPage(control->slotCapacity)) {
+        throw FrameBusException((boost::format("frame bus segment '%s' is truncated") % name).str());
+    }
+
+    segment->control = control;
+}
+
+common::framebus::FrameBusReader::~FrameBusReader() {
+}
+
+bool common::framebus::FrameBusReader::getLatestFrame(FrameView &view) {
+    auto *control = segment->control;
+
+    if (control->publishedFrames.load(std::memory_order_acquire) == 0) {
+        return false;
+    }
+
+    for (int attempt = 0; attempt < READ_ATTEMPTS; ++attempt) {
+        unsigned int slotNo = control->latestSlot.load(std::memory_order_acquire) % control->numberOfSlots;
+        auto &slot = control->slots[slotNo];
+
+        uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence % 2 != 0) {
+            continue;
+        }
+
+        view.info = slot.info;
+        view.data = segment->getSlotData(slotNo);
+        view.slot = slotNo;
+        view.slotSequence = sequence;
+
+        if (isStillValid(view)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool common::framebus::FrameBusReader::isStillValid(const FrameView &view) {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return segment->control->slots[view.slot].sequence.load(std::memory_order_relaxed) == view.slotSequence;
+}
+
+uint32_t common::framebus::FrameBusReader::getPublishedFramesCount() {
+    return segment->control->publishedFrames.load(std::memory_order_acquire);
+}
+
+bool common::framebus::FrameBusReader::waitForFrame(uint32_t publishedFramesCount, int timeoutMs) {
+    auto &publishedFrames = segment->control->publishedFrames;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
+    while (publishedFrames.load(std::memory_order_acquire) == publishedFramesCount) {
+        auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                deadline - std::chrono::steady_clock::now());
+
+        if (remaining.count() <= 0) {
+            return false;
+        }
+
+#ifdef __linux__
+        timespec timeout;
+        timeout.tv_sec = remaining.count() / 1000000000;
+        timeout.tv_nsec = remaining.count() % 1000000000;
+
+        // returns immediately with EAGAIN if the counter has already changed
+        futex(&publishedFrames, FUTEX_WAIT, publishedFramesCount, &timeout);
+#else
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+#endif
+    }
+
+    return true;
+}
@@ -354,6 +354,27 @@ bool bridge::Interface::ExpanderClass::Device::isEnabled() {
 void bridge::Interface::updateDataStructures(std::vector<USBCommands::Request> getterRequests,
                                              std::vector<uint8_t> deviceResponse) {
 
+    for (auto listener : extDevListeners) {
+        listener->fieldsChanged = false;
+    }
+
+    // the voltage and current are averaged, so they can change even if the response is the same
+    double previousVoltage = getVoltage();
+    double previousCurrent = getCurrent();
+
+    // the getters rotate, so the response differs every time, only the changes of the decoded values count
+    auto increaseVersionIfChanged = [&]() {
+        bool changed = getVoltage() != previousVoltage or getCurrent() != previousCurrent;
+
+        for (auto listener : extDevListeners) {
+            changed = changed or listener->fieldsChanged;
+        }
+
+        if (changed) {
+            stateVersion++;
+        }
+    };
+
     unsigned int actualPosition = 0;
 
     for (auto gReq : getterRequests) {
@@ -369,6 +390,8 @@ void bridge::Interface::updateDataStructures(std::vector<USBCommands::Request> g
         }
 
         if (bytesTaken == 0) {
+            // the partially updated state gets the new version too
+            increaseVersionIfChanged();
             throw runtime_error(string("Request ") + to_string(int(gReq)) + " hasn't been handled by any listener");
         }
     }
@@ -378,10 +401,13 @@ void bridge::Interface::updateDataStructures(std::vector<USBCommands::Request> g
                                       std::find(deviceResponse.begin() + actualPosition, deviceResponse.end(),
                                                 USBCommands::MESSAGE_END));
 
+        increaseVersionIfChanged();
         throw runtime_error(
                 string("MESSAGE_END not found in the response at position: ") + to_string(actualPosition) + ", but: "
                 + to_string(foundPos));
     }
+
+    increaseVersionIfChanged();
 }
 
 unsigned int bridge::Interface::ExpanderClass::updateFields(USBCommands::Request request, uint8_t *data) {
@@ -389,7 +415,7 @@ unsigned int bridge::Interface::ExpanderClass::updateFields(USBCommands::Request
         return 0;
     }
 
-    expanderByte = data[0];
+    updateField(expanderByte, data[0]);
 
     logger.info("Updating state expander byte.");
 
@@ -408,18 +434,18 @@ unsigned int bridge::Interface::ArmClass::updateFields(USBCommands::Request requ
             requests->erase("arm_addon");
             logger.notice("Calibration finished.");
         }
-        calibrationStatus = ArmCalibrationStatus::DONE;
+        updateField(calibrationStatus, ArmCalibrationStatus::DONE);
     }
 
     switch (state->mode) {
         case arm::DIR:
-            mode = ArmDriverMode::DIRECTIONAL;
+            updateField(mode, ArmDriverMode::DIRECTIONAL);
             break;
         case arm::POS:
-            mode = ArmDriverMode::POSITIONAL;
+            updateField(mode, ArmDriverMode::POSITIONAL);
             break;
         case arm::CAL:
-            mode = ArmDriverMode::CALIBRATING;
+            updateField(mode, ArmDriverMode::CALIBRATING);
             break;
     };
 
@@ -460,7 +486,7 @@ unsigned int bridge::Interface::MotorClass::SingleMotor::updateFields(USBCommand
 //		break;
 //	};
 
-    power = state->speed;
+    updateField(power, state->speed);
 
     logger.info("Updating state motor %s power: %d.", devToString(motorNo).c_str(), static_cast<int>(power));
 
@@ -494,18 +520,18 @@ unsigned int bridge::Interface::ArmClass::SingleJoint::updateFields(USBCommands:
 
     switch (state->direction) {
         case arm::FORWARD:
-            direction = Direction::FORWARD;
+            updateField(direction, Direction::FORWARD);
             break;
         case arm::BACKWARD:
-            direction = Direction::BACKWARD;
+            updateField(direction, Direction::BACKWARD);
             break;
         default:
-            direction = Direction::STOP;
+            updateField(direction, Direction::STOP);
             break;
     };
 
-    speed = state->speed;
-    position = state->position;
+    updateField(speed, state->speed);
+    updateField(position, state->position);
 
     logger.info("Updating state joint %s: direction: %s, position: %d.",
                 devToString(jointNo).c_str(), directionToString(direction).c_str(), static_cast<int>(position));
@@ -521,17 +547,17 @@ unsigned int bridge::Interface::updateFields(USBCommands::Request request, uint8
     auto state = reinterpret_cast<USBCommands::bridge::State *>(data);
 
     if (state->killSwitch == USBCommands::bridge::ACTIVE) {
-        killSwitchActive = true;
-        killSwitchCausedByHardware = state->killSwitchCausedByHardware;
+        updateField(killSwitchActive, true);
+        updateField(killSwitchCausedByHardware, state->killSwitchCausedByHardware);
         updateStructsWhenKillSwitchActivated();
     } else {
-        killSwitchCausedByHardware = false;
-        killSwitchActive = false;
+        updateField(killSwitchCausedByHardware, false);
+        updateField(killSwitchActive, false);
     }
 
-    buttons[Button::UP] = state->buttonUp;
-    buttons[Button::DOWN] = state->buttonDown;
-    buttons[Button::ENTER] = state->buttonEnter;
+    updateField(buttons[Button::UP], state->buttonUp);
+    updateField(buttons[Button::DOWN], state->buttonDown);
+    updateField(buttons[Button::ENTER], state->buttonEnter);
 
     unsigned int curr = state->rawCurrent;
     unsigned int volt = state->rawVoltage;
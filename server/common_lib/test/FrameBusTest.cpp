@@ -0,0 +1,104 @@
+#include "FrameBus.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace common::framebus;
+
+static const char *const FRAME_BUS_TEST_NAME = "SZARK_FrameBusTest";
+
+BOOST_AUTO_TEST_CASE(FrameBusTest_PublishAndRead) {
+    const uint32_t width = 64;
+    const uint32_t height = 8;
+    const uint32_t rowLength = width * 2;
+
+    FrameBusWriter writer(FRAME_BUS_TEST_NAME, 3, rowLength * height);
+    FrameBusReader reader(FRAME_BUS_TEST_NAME);
+
+    FrameView view;
+    BOOST_CHECK(not reader.getLatestFrame(view));
+
+    // source rows are padded, the bus stores them packed
+    const size_t sourceStep = rowLength + 16;
+    vector<uint8_t> source(sourceStep * height);
+
+    for (int frameNo = 1; frameNo <= 5; ++frameNo) {
+        for (uint32_t row = 0; row < height; ++row) {
+            std::fill_n(source.begin() + row * sourceStep, rowLength, uint8_t(frameNo * 10 + row));
+        }
+
+        FrameInfo info = {};
+        info.frameNo = frameNo;
+        info.width = width;
+        info.height = height;
+        info.rowLength = rowLength;
+        info.format = PixelFormat::UYVY;
+
+        writer.publish(info, source.data(), sourceStep);
+    }
+
+    BOOST_CHECK_EQUAL(reader.getPublishedFramesCount(), 5);
+
+    BOOST_REQUIRE(reader.getLatestFrame(view));
+    BOOST_CHECK_EQUAL(view.info.frameNo, 5);
+    BOOST_CHECK_EQUAL(view.info.width, width);
+    BOOST_CHECK(view.info.format == PixelFormat::UYVY);
+
+    for (uint32_t row = 0; row < height; ++row) {
+        BOOST_CHECK_EQUAL(view.data[row * rowLength], 50 + row);
+        BOOST_CHECK_EQUAL(view.data[row * rowLength + rowLength - 1], 50 + row);
+    }
+
+    BOOST_CHECK(reader.isStillValid(view));
+
+    // the ring has 3 slots, so the third frame from now lands in the slot the view points at
+    FrameInfo info = view.info;
+    for (int i = 0; i < 3; ++i) {
+        writer.publish(info, source.data(), sourceStep);
+    }
+
+    BOOST_CHECK(not reader.isStillValid(view));
+
+    info.height = height * 2;
+    BOOST_CHECK_THROW(writer.publish(info, source.data(), sourceStep), FrameBusException);
+}
+
+BOOST_AUTO_TEST_CASE(FrameBusTest_WaitForFrame) {
+    const uint32_t frameSize = 256;
+
+    FrameBusWriter writer(FRAME_BUS_TEST_NAME, 2, frameSize);
+    FrameBusReader reader(FRAME_BUS_TEST_NAME);
+
+    uint32_t count = reader.getPublishedFramesCount();
+    BOOST_CHECK(not reader.waitForFrame(count, 20));
+
+    vector<uint8_t> data(frameSize, 0xAB);
+
+    std::thread publisher([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+
+        FrameInfo info = {};
+        info.frameNo = 1;
+        info.width = frameSize;
+        info.height = 1;
+        info.rowLength = frameSize;
+        info.format = PixelFormat::BGR24;
+
+        writer.publish(info, data.data(), frameSize);
+    });
+
+    BOOST_CHECK(reader.waitForFrame(count, 2000));
+    publisher.join();
+
+    FrameView view;
+    BOOST_REQUIRE(reader.getLatestFrame(view));
+    BOOST_CHECK_EQUAL(view.info.frameNo, 1);
+    BOOST_CHECK_EQUAL(view.data[frameSize - 1], 0xAB);
+}
+
+BOOST_AUTO_TEST_CASE(FrameBusTest_MissingSegment) {
+    BOOST_CHECK_THROW(FrameBusReader reader("SZARK_FrameBusTest_nonexistent"), FrameBusException);
+}
@@ -0,0 +1,429 @@
+#include "BinaryProtocol.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+using namespace processing;
+using namespace common::bridge;
+
+namespace processing {
+
+    /**
+     * Bits of the mask of the present fields in the request.
+     */
+    enum BinaryRequestField : uint32_t {
+        FIELD_MAX_AGE = 1 << 0,
+        FIELD_KILL_SWITCH = 1 << 1,
+        FIELD_LCD = 1 << 2,
+        FIELD_LEFT_MOTOR = 1 << 3,
+        FIELD_RIGHT_MOTOR = 1 << 5,
+        FIELD_SHOULDER = 1 << 7,
+        FIELD_ELBOW = 1 << 10,
+        FIELD_GRIPPER = 1 << 13,
+        FIELD_CALIBRATE_ARM = 1 << 16,
+        FIELD_LIGHT_LEFT = 1 << 17,
+        FIELD_LIGHT_RIGHT = 1 << 18,
+        FIELD_LIGHT_CAMERA = 1 << 19
+    };
+
+    /*
+     * Offsets of the bits of the device fields from the first bit of the device.
+     */
+    constexpr int DEVICE_SPEED = 0;
+    constexpr int DEVICE_DIRECTION = 1;
+    constexpr int DEVICE_POSITION = 2;
+
+    constexpr uint8_t REQUEST_FLAG_SKIP_RESPONSE = 1;
+
+    constexpr uint8_t RESPONSE_FLAG_BRIDGE = 1;
+    constexpr uint8_t RESPONSE_FLAG_WIFI = 2;
+
+    class ByteWriter {
+    public:
+        ByteWriter(uint8_t *buffer, std::size_t capacity)
+                : begin(buffer), pos(buffer), end(buffer + capacity) {
+        }
+
+        void put8(uint8_t value) {
+            reserve(1);
+            *pos++ = value;
+        }
+
+        void put16(uint16_t value) {
+            reserve(2);
+            *pos++ = value & 0xff;
+            *pos++ = value >> 8;
+        }
+
+        void put32(uint32_t value) {
+            put16(value & 0xffff);
+            put16(value >> 16);
+        }
+
+        void putBytes(const void *data, std::size_t length) {
+            reserve(length);
+            std::memcpy(pos, data, length);
+            pos += length;
+        }
+
+        std::size_t getLength() const {
+            return pos - begin;
+        }
+
+    private:
+        uint8_t *begin;
+        uint8_t *pos;
+        uint8_t *end;
+
+        void reserve(std::size_t length) {
+            if (static_cast<std::size_t>(end - pos) < length) {
+                throw BinaryProtocolException("buffer too small for the message");
+            }
+        }
+    };
+
+    class ByteReader {
+    public:
+        ByteReader(const uint8_t *data, std::size_t length)
+                : pos(data), end(data + length) {
+        }
+
+        uint8_t get8() {
+            require(1);
+            return *pos++;
+        }
+
+        uint16_t get16() {
+            uint16_t low = get8();
+            return low | (uint16_t(get8()) << 8);
+        }
+
+        uint32_t get32() {
+            uint32_t low = get16();
+            return low | (uint32_t(get16()) << 16);
+        }
+
+        const uint8_t *getBytes(std::size_t length) {
+            require(length);
+            const uint8_t *bytes = pos;
+            pos += length;
+            return bytes;
+        }
+
+    private:
+        const uint8_t *pos;
+        const uint8_t *end;
+
+        void require(std::size_t length) {
+            if (static_cast<std::size_t>(end - pos) < length) {
+                throw BinaryProtocolException("message is truncated");
+            }
+        }
+    };
+
+    static uint16_t toUint16(long value) {
+        if (value < 0 or value > 0xffff) {
+            throw BinaryProtocolException("value " + to_string(value) + " doesn't fit in the field");
+        }
+        return static_cast<uint16_t>(value);
+    }
+
+    static uint16_t toFixedPoint(double value, double factor) {
+        return static_cast<uint16_t>(std::min(std::max(std::round(value * factor), 0.0), 65535.0));
+    }
+
+    static Direction toDirection(uint8_t value) {
+        if (value > static_cast<uint8_t>(Direction::BACKWARD)) {
+            throw BinaryProtocolException("invalid direction: " + to_string(value));
+        }
+        return static_cast<Direction>(value);
+    }
+
+    static void readHeader(ByteReader &reader) {
+        if (reader.get8() != BINARY_PROTOCOL_MAGIC) {
+            throw BinaryProtocolException("message is not binary");
+        }
+
+        uint8_t version = reader.get8();
+        if (version != BINARY_PROTOCOL_VERSION) {
+            throw BinaryProtocolException("unsupported protocol version: " + to_string(version));
+        }
+    }
+}
+
+std::size_t processing::encodeBinaryRequest(const Request &request, uint8_t *buffer, std::size_t capacity) {
+    const Command &c = request.command;
+    uint32_t mask = 0;
+
+    auto presentIf = [&](bool present, uint32_t bit) {
+        if (present) {
+            mask |= bit;
+        }
+    };
+
+    auto presentMotor = [&](const MotorCommand &m, uint32_t first) {
+        presentIf(m.speed.present, first << DEVICE_SPEED);
+        presentIf(m.direction.present, first << DEVICE_DIRECTION);
+    };
+
+    auto presentJoint = [&](const JointCommand &j, uint32_t first) {
+        presentIf(j.speed.present, first << DEVICE_SPEED);
+        presentIf(j.direction.present, first << DEVICE_DIRECTION);
+        presentIf(j.position.present, first << DEVICE_POSITION);
+    };
+
+    presentIf(request.maxAgeMs > 0, FIELD_MAX_AGE);
+    presentIf(c.killSwitch.present, FIELD_KILL_SWITCH);
+    presentIf(c.lcdTextPresent, FIELD_LCD);
+    presentMotor(c.leftMotor, FIELD_LEFT_MOTOR);
+    presentMotor(c.rightMotor, FIELD_RIGHT_MOTOR);
+    presentJoint(c.shoulder, FIELD_SHOULDER);
+    presentJoint(c.elbow, FIELD_ELBOW);
+    presentJoint(c.gripper, FIELD_GRIPPER);
+    presentIf(c.calibrateArm, FIELD_CALIBRATE_ARM);
+    presentIf(c.lightLeft.present, FIELD_LIGHT_LEFT);
+    presentIf(c.lightRight.present, FIELD_LIGHT_RIGHT);
+    presentIf(c.lightCamera.present, FIELD_LIGHT_CAMERA);
+
+    if (request.session.size() > 0xff) {
+        throw BinaryProtocolException("session token is too long");
+    }
+
+    ByteWriter writer(buffer, capacity);
+
+    writer.put8(BINARY_PROTOCOL_MAGIC);
+    writer.put8(BINARY_PROTOCOL_VERSION);
+    writer.put8(request.skipResponse ? REQUEST_FLAG_SKIP_RESPONSE : 0);
+    writer.put8(request.session.size());
+    writer.put32(request.serial);
+    writer.put32(mask);
+    writer.putBytes(request.session.data(), request.session.size());
+
+    if (mask & FIELD_MAX_AGE) {
+        writer.put16(toUint16(request.maxAgeMs));
+    }
+
+    if (mask & FIELD_KILL_SWITCH) {
+        writer.put8(c.killSwitch.value);
+    }
+
+    if (mask & FIELD_LCD) {
+        uint8_t length = strnlen(c.lcdText, COMMAND_LCD_TEXT_MAX_LENGTH);
+        writer.put8(length);
+        writer.putBytes(c.lcdText, length);
+    }
+
+    auto putMotor = [&](const MotorCommand &m) {
+        if (m.speed.present) {
+            writer.put16(toUint16(m.speed.value));
+        }
+        if (m.direction.present) {
+            writer.put8(static_cast<uint8_t>(m.direction.value));
+        }
+    };
+
+    auto putJoint = [&](const JointCommand &j) {
+        if (j.speed.present) {
+            writer.put16(toUint16(j.speed.value));
+        }
+        if (j.direction.present) {
+            writer.put8(static_cast<uint8_t>(j.direction.value));
+        }
+        if (j.position.present) {
+            writer.put16(toUint16(j.position.value));
+        }
+    };
+
+    putMotor(c.leftMotor);
+    putMotor(c.rightMotor);
+    putJoint(c.shoulder);
+    putJoint(c.elbow);
+    putJoint(c.gripper);
+
+    for (auto &light : {c.lightLeft, c.lightRight, c.lightCamera}) {
+        if (light.present) {
+            writer.put8(light.value);
+        }
+    }
+
+    return writer.getLength();
+}
+
+void processing::decodeBinaryRequest(const uint8_t *data, std::size_t length, Request &request) {
+    ByteReader reader(data, length);
+    readHeader(reader);
+
+    Command &c = request.command;
+    c = Command();
+
+    uint8_t flags = reader.get8();
+    uint8_t sessionLength = reader.get8();
+
+    request.skipResponse = flags & REQUEST_FLAG_SKIP_RESPONSE;
+    request.serial = reader.get32();
+
+    uint32_t mask = reader.get32();
+
+    request.session.assign(reinterpret_cast<const char *>(reader.getBytes(sessionLength)),
+                           std::min<std::size_t>(sessionLength, REQUEST_SESSION_MAX_LENGTH));
+
+    if (mask & FIELD_MAX_AGE) {
+        request.maxAgeMs = reader.get16();
+    }
+
+    if (mask & FIELD_KILL_SWITCH) {
+        c.killSwitch.set(reader.get8() != 0);
+    }
+
+    if (mask & FIELD_LCD) {
+        uint8_t textLength = reader.get8();
+        const uint8_t *text = reader.getBytes(textLength);
+        std::size_t copied = std::min<std::size_t>(textLength, COMMAND_LCD_TEXT_MAX_LENGTH);
+
+        std::memcpy(c.lcdText, text, copied);
+        c.lcdText[copied] = 0;
+        c.lcdTextPresent = true;
+    }
+
+    auto getMotor = [&](MotorCommand &m, uint32_t first) {
+        if (mask & (first << DEVICE_SPEED)) {
+            m.speed.set(reader.get16());
+        }
+        if (mask & (first << DEVICE_DIRECTION)) {
+            m.direction.set(toDirection(reader.get8()));
+        }
+    };
+
+    auto getJoint = [&](JointCommand &j, uint32_t first) {
+        if (mask & (first << DEVICE_SPEED)) {
+            j.speed.set(reader.get16());
+        }
+        if (mask & (first << DEVICE_DIRECTION)) {
+            j.direction.set(toDirection(reader.get8()));
+        }
+        if (mask & (first << DEVICE_POSITION)) {
+            j.position.set(reader.get16());
+        }
+    };
+
+    getMotor(c.leftMotor, FIELD_LEFT_MOTOR);
+    getMotor(c.rightMotor, FIELD_RIGHT_MOTOR);
+    getJoint(c.shoulder, FIELD_SHOULDER);
+    getJoint(c.elbow, FIELD_ELBOW);
+    getJoint(c.gripper, FIELD_GRIPPER);
+
+    c.calibrateArm = mask & FIELD_CALIBRATE_ARM;
+
+    if (mask & FIELD_LIGHT_LEFT) {
+        c.lightLeft.set(reader.get8() != 0);
+    }
+    if (mask & FIELD_LIGHT_RIGHT) {
+        c.lightRight.set(reader.get8() != 0);
+    }
+    if (mask & FIELD_LIGHT_CAMERA) {
+        c.lightCamera.set(reader.get8() != 0);
+    }
+}
+
+std::size_t processing::encodeBinaryResponse(const BinaryResponse &response, uint8_t *buffer, std::size_t capacity) {
+    const Report &report = response.report;
+    ByteWriter writer(buffer, capacity);
+
+    writer.put8(BINARY_PROTOCOL_MAGIC);
+    writer.put8(BINARY_PROTOCOL_VERSION);
+    writer.put8((report.bridgePresent ? RESPONSE_FLAG_BRIDGE : 0) | (report.wifiPresent ? RESPONSE_FLAG_WIFI : 0));
+    writer.put8(0);
+    writer.put32(response.serial);
+    writer.put32(response.queueWaitUs);
+    writer.put32(response.executionTimeUs);
+
+    if (report.bridgePresent) {
+        const BridgeReport &b = report.bridge;
+
+        writer.put8(b.lightRight | (b.lightLeft << 1) | (b.lightCamera << 2));
+        writer.put8(b.buttonUp | (b.buttonDown << 1) | (b.buttonEnter << 2));
+        writer.put8(static_cast<uint8_t>(b.killSwitch));
+        writer.put8(static_cast<uint8_t>(b.armMode));
+        writer.put8(static_cast<uint8_t>(b.calibrationStatus));
+
+        for (auto *m : {&b.leftMotor, &b.rightMotor}) {
+            writer.put8(m->speed);
+            writer.put8(static_cast<uint8_t>(m->direction));
+        }
+
+        for (auto *j : {&b.shoulder, &b.elbow, &b.gripper}) {
+            writer.put8(j->speed);
+            writer.put16(j->position);
+            writer.put8(static_cast<uint8_t>(j->direction));
+        }
+
+        writer.put16(toFixedPoint(b.voltage, 100));
+        writer.put16(toFixedPoint(b.current, 100));
+    }
+
+    if (report.wifiPresent) {
+        writer.put16(static_cast<uint16_t>(static_cast<int16_t>(std::round(report.wifi.signalStrength * 10))));
+        writer.put16(toFixedPoint(report.wifi.txBitrate, 10));
+        writer.put16(toFixedPoint(report.wifi.rxBitrate, 10));
+    }
+
+    return writer.getLength();
+}
+
+void processing::decodeBinaryResponse(const uint8_t *data, std::size_t length, BinaryResponse &response) {
+    ByteReader reader(data, length);
+    readHeader(reader);
+
+    Report &report = response.report;
+    report = Report();
+
+    uint8_t flags = reader.get8();
+    reader.get8();
+
+    response.serial = reader.get32();
+    response.queueWaitUs = reader.get32();
+    response.executionTimeUs = reader.get32();
+
+    report.bridgePresent = flags & RESPONSE_FLAG_BRIDGE;
+    report.wifiPresent = flags & RESPONSE_FLAG_WIFI;
+
+    if (report.bridgePresent) {
+        BridgeReport &b = report.bridge;
+
+        uint8_t lights = reader.get8();
+        b.lightRight = lights & 1;
+        b.lightLeft = lights & 2;
+        b.lightCamera = lights & 4;
+
+        uint8_t buttons = reader.get8();
+        b.buttonUp = buttons & 1;
+        b.buttonDown = buttons & 2;
+        b.buttonEnter = buttons & 4;
+
+        b.killSwitch = static_cast<KillSwitchStatus>(reader.get8());
+        b.armMode = static_cast<ArmDriverMode>(reader.get8());
+        b.calibrationStatus = static_cast<ArmCalibrationStatus>(reader.get8());
+
+        for (auto *m : {&b.leftMotor, &b.rightMotor}) {
+            m->speed = reader.get8();
+            m->direction = toDirection(reader.get8());
+        }
+
+        for (auto *j : {&b.shoulder, &b.elbow, &b.gripper}) {
+            j->speed = reader.get8();
+            j->position = reader.get16();
+            j->direction = toDirection(reader.get8());
+        }
+
+        b.voltage = reader.get16() / 100.0;
+        b.current = reader.get16() / 100.0;
+    }
+
+    if (report.wifiPresent) {
+        report.wifi.signalStrength = static_cast<int16_t>(reader.get16()) / 10.0;
+        report.wifi.txBitrate = reader.get16() / 10.0;
+        report.wifi.rxBitrate = reader.get16() / 10.0;
+    }
+}
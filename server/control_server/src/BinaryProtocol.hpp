@@ -0,0 +1,85 @@
+#pragma once
+
+#include "IRequestProcessor.hpp"
+#include "Report.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+namespace processing {
+
+    /**
+     * First byte of the binary messages. JSON documents start with '{' or whitespace, so the protocols
+     * can't be confused.
+     */
+    constexpr uint8_t BINARY_PROTOCOL_MAGIC = 0xa5;
+
+    constexpr uint8_t BINARY_PROTOCOL_VERSION = 1;
+
+    /**
+     * Header, session token and all command fields.
+     */
+    constexpr std::size_t BINARY_REQUEST_MAX_LENGTH = 128;
+
+    constexpr std::size_t BINARY_RESPONSE_MAX_LENGTH = 64;
+
+    class BinaryProtocolException : public std::runtime_error {
+    public:
+        BinaryProtocolException(const std::string &message)
+                : std::runtime_error(message) {
+        }
+    };
+
+    /**
+     * Response as decoded by the client.
+     */
+    struct BinaryResponse {
+        long serial = 0;
+        /**
+         * Time between receiving the request and starting its execution.
+         */
+        uint32_t queueWaitUs = 0;
+        uint32_t executionTimeUs = 0;
+        Report report;
+    };
+
+    inline bool isBinaryMessage(const char *data, std::size_t length) {
+        return length > 0 and static_cast<uint8_t>(data[0]) == BINARY_PROTOCOL_MAGIC;
+    }
+
+    /*
+     * Request, all numbers little-endian:
+     *   magic, version, flags (bit 0: skip response), session token length,
+     *   serial (u32), mask of the present fields (u32), session token,
+     *   present fields in the order of the bits in BinaryRequestField.
+     *
+     * Response:
+     *   magic, version, flags (bit 0: bridge report, bit 1: Wi-Fi report), reserved,
+     *   serial (u32), queue wait in us (u32), execution time in us (u32),
+     *   bridge report: lights (r, l, cam bits), buttons (up, down, enter bits), kill switch status,
+     *                  arm mode, calibration status, motors (left, right) as speed (u8) and direction (u8),
+     *                  joints (shoulder, elbow, gripper) as speed (u8), position (u16) and direction (u8),
+     *                  voltage in 10 mV (u16), current in 10 mA (u16)
+     *   Wi-Fi report: signal strength in 0.1 dBm (i16), TX and RX bitrate in 0.1 Mbit/s (u16)
+     */
+
+    /**
+     * Encodes serial, skipResponse, maxAgeMs (if not 0), session and the present command fields.
+     * This is the reference encoder for the clients.
+     * @return length of the message
+     * @throws BinaryProtocolException if the buffer is too small
+     */
+    std::size_t encodeBinaryRequest(const Request &request, uint8_t *buffer, std::size_t capacity);
+
+    /**
+     * Sets serial, skipResponse, session, maxAgeMs (only if present) and the command of the request.
+     * @throws BinaryProtocolException if the message is malformed or has unsupported version
+     */
+    void decodeBinaryRequest(const uint8_t *data, std::size_t length, Request &request);
+
+    std::size_t encodeBinaryResponse(const BinaryResponse &response, uint8_t *buffer, std::size_t capacity);
+
+    void decodeBinaryResponse(const uint8_t *data, std::size_t length, BinaryResponse &response);
+}
@@ -6,103 +6,240 @@
 #include "utils.hpp"
 
 #include <boost/format.hpp>
-#include <minijson_reader.hpp>
+
+#include <pthread.h>
+#include <sched.h>
 
 #include <chrono>
 #include <functional>
+#include <cstring>
 
 using namespace std;
 using namespace bridge;
 using namespace common::bridge;
 
-using std::chrono::high_resolution_clock;
+using std::chrono::steady_clock;
+
+constexpr int STATISTICS_REPORT_INTERVAL_SECONDS = 10;
 
 /**
-* If the process() function in the given timeout, the maintainance thread starts operation.
-* It prevents the device from going to stopped state, queries for battery etc.
-*/
-constexpr chrono::milliseconds TIMEOUT(25);
-constexpr chrono::milliseconds MAINTENANCE_TASK_INTERVAL(25);
-constexpr bool MAINTENANCE_TASK_ENABLED = true;
+ * Number of the synchronizations sent to the device before the oldest response is waited for.
+ */
+constexpr unsigned int SYNC_PIPELINE_DEPTH = 2;
 
 WALLAROO_REGISTER(BridgeProcessor);
 
 bridge::BridgeProcessor::BridgeProcessor()
         : logger(log4cpp::Category::getInstance("BridgeProcessor")),
+          config("config", RegistrationToken()),
           usbComm("communicator", RegistrationToken()),
-          interfaceManager("interfaceManager", RegistrationToken()),
-          lastProcessFunctionExecution(high_resolution_clock::now()) {
+          interfaceManager("interfaceManager", RegistrationToken()) {
 }
 
 void bridge::BridgeProcessor::Init() {
-    if (MAINTENANCE_TASK_ENABLED) {
-        maintenanceThread.reset(new thread(&BridgeProcessor::maintenanceThreadFunction, this));
-        common::utils::setThreadName(logger, maintenanceThread.get(), "bMaintenance");
+    int syncRateHz = config->getInt("BridgeProcessor.sync_rate_hz");
+
+    if (syncRateHz < 1 or syncRateHz > 1000) {
+        throw std::runtime_error("synchronization rate has to be between 1 and 1000 Hz");
     }
 
+    syncPeriod = chrono::duration_cast<steady_clock::duration>(chrono::duration<double>(1.0 / syncRateHz));
+    syncThreadPriority = config->getInt("BridgeProcessor.sync_thread_priority");
+
+    syncThread.reset(new thread(&BridgeProcessor::syncThreadFunction, this));
+    common::utils::setThreadName(logger, syncThread.get(), "bSync");
+
+    killSwitchThread.reset(new thread(&BridgeProcessor::killSwitchThreadFunction, this));
+    common::utils::setThreadName(logger, killSwitchThread.get(), "bKillSwitch");
+
+    logger.notice("Synchronizing with the device at %d Hz.", syncRateHz);
+
     logger.notice("Instance created.");
 }
 
 bridge::BridgeProcessor::~BridgeProcessor() {
-    finishCycleThread = true;
+    {
+        lock_guard<mutex> lk(killSwitchMutex);
+        finishCycleThread = true;
+    }
+    killSwitchCv.notify_all();
 
-    logger.notice("Waiting for maintenance task to stop.");
+    logger.notice("Waiting for synchronization threads to stop.");
 
-    if (maintenanceThread.get() != nullptr) {
-        maintenanceThread->join();
+    if (syncThread.get() != nullptr) {
+        syncThread->join();
+    }
+
+    if (killSwitchThread.get() != nullptr) {
+        killSwitchThread->join();
     }
 
     logger.notice("Instance destroyed.");
 }
 
-void bridge::BridgeProcessor::process(processing::Request &request, minijson::object_writer &response) {
+void bridge::BridgeProcessor::process(processing::Request &request, processing::Report &report) {
     SharedScopedMutex lk(iface().mutex);
 
-    firstMaintenanceTask = true;
-
     logger.info("Processing request.");
 
-    parseRequest(request.reqJson);
+    // shipped to the device by the next tick of the synchronization thread, but some of the reported values
+    // are changed by the setters at once
+    if (applyCommand(request.command)) {
+        iface().increaseStateVersion();
+    }
+
+    // the report is created again only if the state has changed since the previous request
+    uint64_t stateVersion = iface().getStateVersion();
+    if (stateVersion != lastReportStateVersion) {
+        createBridgeReport(iface(), lastReport);
+        lastReportStateVersion = stateVersion;
+    }
 
-    interfaceManager->syncWithDevice([&](vector<uint8_t> &r) {
-        usbComm->sendData(r);
-        return usbComm->receiveData();
-    });
+    report.bridge = lastReport;
+    report.bridgeStateVersion = stateVersion;
+    report.bridgePresent = true;
+}
 
-    createReport(response);
+void bridge::BridgeProcessor::activateKillSwitch() {
+    {
+        lock_guard<mutex> lk(killSwitchMutex);
+        if (not killSwitchRequested) {
+            killSwitchRequested = true;
+            killSwitchRequestTime = steady_clock::now();
+        }
+    }
+    killSwitchCv.notify_one();
+}
 
-    lastProcessFunctionExecution = high_resolution_clock::now();
+processing::LatencyHistogram bridge::BridgeProcessor::getKillSwitchLatencyHistogram() {
+    lock_guard<mutex> lk(killSwitchMutex);
+    return killSwitchLatencyHistogram;
 }
 
-void bridge::BridgeProcessor::maintenanceThreadFunction() {
+void bridge::BridgeProcessor::killSwitchThreadFunction() {
+    setRealTimePriority();
+
     while (true) {
-        this_thread::sleep_for(MAINTENANCE_TASK_INTERVAL);
+        unique_lock<mutex> lk(killSwitchMutex);
+        killSwitchCv.wait(lk, [&]() {
+            return finishCycleThread or killSwitchRequested;
+        });
 
         if (finishCycleThread) {
-            break;
+            return;
         }
 
-        if ((not usbComm.WiringOk())
-            or (not interfaceManager.WiringOk())
-            or ((high_resolution_clock::now() - lastProcessFunctionExecution) < TIMEOUT)) {
-            this_thread::yield();
-            continue;
+        auto requestTime = killSwitchRequestTime;
+        killSwitchRequested = false;
+        lk.unlock();
+
+        sendKillSwitchPacket();
+
+        long latencyMicroseconds = chrono::duration_cast<chrono::microseconds>(
+                steady_clock::now() - requestTime).count();
+
+        lk.lock();
+        killSwitchLatencyHistogram.add(latencyMicroseconds);
+        lk.unlock();
+
+        logger.warn("Kill switch sent to the device %ld us after the request.", latencyMicroseconds);
+    }
+}
+
+/**
+ * The interface learns about the kill switch from the state read by the next synchronization.
+ */
+void bridge::BridgeProcessor::sendKillSwitchPacket() {
+    vector<uint8_t> packet = {USBCommands::BRIDGE_SET_KILLSWITCH,
+                              USBCommands::bridge::ACTIVE,
+                              USBCommands::MESSAGE_END};
+
+    try {
+        // the device answers each packet, the response is empty for the setters
+        usbComm->exchange(packet).get();
+    } catch (CommException &e) {
+        logger.error("Error when sending kill switch to the device: %s.", e.what());
+    }
+}
+
+void bridge::BridgeProcessor::syncThreadFunction() {
+    setRealTimePriority();
+
+    auto nextTick = steady_clock::now();
+    auto lastReportTime = nextTick;
+
+    while (not finishCycleThread) {
+        // TODO dodać - jeżeli przez 2s nie ma sygnału, to zatrzymaj wszystko
+        long syncTimeMicroseconds = common::utils::measureTime<chrono::microseconds>([&]() {
+            syncWithDevice();
+        });
+        syncTimeHistogram.add(syncTimeMicroseconds);
+
+        nextTick += syncPeriod;
+        auto now = steady_clock::now();
+
+        // the missed ticks are skipped, the device gets the current state anyway
+        if (now > nextTick) {
+            syncOverrunsCount++;
+            logger.info("Synchronization took %ld us, longer than the period.", syncTimeMicroseconds);
+            nextTick = now;
         }
 
-        SharedScopedMutex lk(iface().mutex);
+        if (now - lastReportTime >= chrono::seconds(STATISTICS_REPORT_INTERVAL_SECONDS)) {
+            logger.notice("Synchronized %lu times: median < %ld us, 99th percentile < %ld us, max %ld us. "
+                                  "%lu overruns, %lu errors.",
+                          static_cast<unsigned long>(syncTimeHistogram.getCount()),
+                          static_cast<long>(syncTimeHistogram.getPercentile(0.5)),
+                          static_cast<long>(syncTimeHistogram.getPercentile(0.99)),
+                          static_cast<long>(syncTimeHistogram.getMax()),
+                          syncOverrunsCount, syncErrorsCount);
+
+            syncTimeHistogram.clear();
+            lastReportTime = now;
+        }
+
+        this_thread::sleep_until(nextTick);
+    }
+}
+
+void bridge::BridgeProcessor::setRealTimePriority() {
+    if (syncThreadPriority <= 0) {
+        return;
+    }
+
+    sched_param param;
+    std::memset(&param, 0, sizeof(param));
+    param.sched_priority = syncThreadPriority;
+
+    int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
 
-        if (firstMaintenanceTask) {
-            logger.notice("No requests, starting performing maintenance task.");
-            firstMaintenanceTask = false;
+    if (result != 0) {
+        logger.warn("Cannot set real-time priority %d of the thread: %s.", syncThreadPriority, strerror(result));
+    } else {
+        logger.notice("Thread runs with real-time priority %d.", syncThreadPriority);
+    }
+}
+
+void bridge::BridgeProcessor::syncWithDevice() {
+    try {
+        {
+            SharedScopedMutex lk(iface().mutex);
+            interfaceManager->submitSync([&](vector<uint8_t> &r) {
+                return usbComm->exchange(r);
+            });
         }
 
-        logger.info("Performing maintenance task.");
-        // TODO dodać - jeżeli przez 2s nie ma sygnału, to zatrzymaj wszystko
+        // the response to the previous tick usually arrived in the meantime
+        while (interfaceManager->getNumOfPendingSyncs() >= SYNC_PIPELINE_DEPTH) {
+            interfaceManager->waitForSync();
 
-        interfaceManager->syncWithDevice([&](vector<uint8_t> &r) {
-            usbComm->sendData(r);
-            return usbComm->receiveData();
-        });
+            SharedScopedMutex lk(iface().mutex);
+            interfaceManager->completeSync();
+        }
+    } catch (runtime_error &e) {
+        // also the malformed responses
+        syncErrorsCount++;
+        logger.error("Error when synchronizing with the device: %s.", e.what());
     }
 }
 
@@ -111,165 +248,119 @@ using bridge::Motor;
 using bridge::Joint;
 using bridge::Button;
 
-void bridge::BridgeProcessor::parseRequest(std::string &request) {
-    using namespace std::placeholders;
-    using namespace minijson;
+/**
+ * @return true if any of the setters was called
+ */
+bool bridge::BridgeProcessor::applyCommand(const processing::Command &command) {
+    bool applied = false;
+
+    if (command.lcdTextPresent) {
+        iface().setLCDText(command.lcdText);
+        applied = true;
+    }
+
+    if (command.killSwitch.present) {
+        iface().setKillSwitch(command.killSwitch.value);
+        applied = true;
+    }
 
-    const_buffer_context ctx(request.c_str(), request.size());
+    auto applyMotor = [&](Motor m, const processing::MotorCommand &c) {
+        applied = applied or c.speed.present or c.direction.present;
 
-    auto parse_motor = [&](Motor m, const char *k, minijson::value v) {
         try {
-            dispatch(k)
-            << "s" >> [&] { iface().motor[m].setSpeed(v.as_long()); }
-            << "d" >> [&] { iface().motor[m].setDirection(stringToDirection(v.as_string())); }
-            << minijson::any >> [&] { minijson::ignore(ctx); };
+            if (c.speed.present) {
+                iface().motor[m].setSpeed(c.speed.value);
+            }
+            if (c.direction.present) {
+                iface().motor[m].setDirection(c.direction.value);
+            }
         } catch (runtime_error &e) {
             logger.error("Cannot set value for motor " + devToString(m) + ": " + e.what() + ".");
         }
     };
 
-    auto parse_arm = [&](Joint j, const char *k, minijson::value v) {
+    applyMotor(Motor::LEFT, command.leftMotor);
+    applyMotor(Motor::RIGHT, command.rightMotor);
+
+    auto applyJoint = [&](Joint j, const processing::JointCommand &c) {
+        applied = applied or c.speed.present or c.direction.present or c.position.present;
+
         try {
-            bool directionSet = false;
-            dispatch(k)
-            << "s" >> [&] { iface().arm[j].setSpeed(v.as_long()); }
-            << "d" >> [&] {
-                iface().arm[j].setDirection(stringToDirection(v.as_string()));
-                directionSet = true;
+            if (c.speed.present) {
+                iface().arm[j].setSpeed(c.speed.value);
             }
-            << "p" >> [&] {
-                if (!directionSet) {
-                    iface().arm[j].setPosition(v.as_long());
-                }
+            // the direction switches the driver to directional mode, so the position is ignored then
+            if (c.direction.present) {
+                iface().arm[j].setDirection(c.direction.value);
+            } else if (c.position.present) {
+                iface().arm[j].setPosition(c.position.value);
             }
-            << minijson::any >> [&] { minijson::ignore(ctx); };
         } catch (runtime_error &e) {
             logger.error("Cannot set value for joint " + devToString(j) + ": " + e.what() + ".");
         }
     };
 
-    parse_object(ctx, [&](const char *k, value v) {
-        dispatch(k)
-        << "lcd" >> [&] { iface().setLCDText(v.as_string()); }
-        << "ks_en" >> [&] { iface().setKillSwitch(v.as_bool()); }
-        << "m" >> [&] {
-            parse_object(ctx, [&](const char *k, value v) {
-                dispatch(k)
-                << "l" >> [&] { parse_object(ctx, bind(parse_motor, Motor::LEFT, _1, _2)); }
-                << "r" >> [&] { parse_object(ctx, bind(parse_motor, Motor::RIGHT, _1, _2)); }
-                << minijson::any >> [&] { minijson::ignore(ctx); };
-            });
-        }
-        << "a" >> [&] {
-            parse_object(ctx, [&](const char *k, value v) {
-                dispatch(k)
-                << "s" >> [&] { parse_object(ctx, bind(parse_arm, Joint::SHOULDER, _1, _2)); }
-                << "e" >> [&] { parse_object(ctx, bind(parse_arm, Joint::ELBOW, _1, _2)); }
-                << "g" >> [&] { parse_object(ctx, bind(parse_arm, Joint::GRIPPER, _1, _2)); }
-                << "b_cal" >> [&] {
-                    if (v.as_bool()) {
-                        iface().arm.calibrate();
-                    }
-                }
-                << minijson::any >> [&] { minijson::ignore(ctx); };
-            });
-        }
-        << "e" >> [&] {
-            parse_object(ctx, [&](const char *k, value v) {
-                dispatch(k)
-                << "r" >> [&] { iface().expander[ExpanderDevice::LIGHT_RIGHT].setEnabled(v.as_bool()); }
-                << "l" >> [&] { iface().expander[ExpanderDevice::LIGHT_LEFT].setEnabled(v.as_bool()); }
-                << "cam" >> [&] { iface().expander[ExpanderDevice::LIGHT_CAMERA].setEnabled(v.as_bool()); }
-                << minijson::any >> [&] { minijson::ignore(ctx); };
-            });
-        }
-
-        << minijson::any >> [&] { minijson::ignore(ctx); };
-    });
-}
-
-void bridge::BridgeProcessor::createReport(minijson::object_writer &r) {
-
-    {
-        auto light = r.nested_object("e");
-        auto fillExpander = [&](const char *name, ExpanderDevice d) {
-            light.write(name, iface().expander[d].isEnabled());
-        };
-
-        fillExpander("r", ExpanderDevice::LIGHT_RIGHT);
-        fillExpander("l", ExpanderDevice::LIGHT_LEFT);
-        fillExpander("cam", ExpanderDevice::LIGHT_CAMERA);
+    applyJoint(Joint::SHOULDER, command.shoulder);
+    applyJoint(Joint::ELBOW, command.elbow);
+    applyJoint(Joint::GRIPPER, command.gripper);
 
-        light.close();
+    if (command.calibrateArm) {
+        iface().arm.calibrate();
+        applied = true;
     }
 
-    {
-        auto motor = r.nested_object("m");
-
-        auto fillMotor = [&](const char *name, Motor m) {
-            auto specificMotor = motor.nested_object(name);
-            specificMotor.write("s", iface().motor[m].getSpeed());
-            specificMotor.write("d", directionToString(iface().motor[m].getDirection()));
-            specificMotor.close();
-        };
-
-        fillMotor("l", Motor::LEFT);
-        fillMotor("r", Motor::RIGHT);
+    auto applyExpander = [&](ExpanderDevice d, const processing::CommandField<bool> &enabled) {
+        if (enabled.present) {
+            iface().expander[d].setEnabled(enabled.value);
+            applied = true;
+        }
+    };
 
-        motor.close();
-    }
+    applyExpander(ExpanderDevice::LIGHT_RIGHT, command.lightRight);
+    applyExpander(ExpanderDevice::LIGHT_LEFT, command.lightLeft);
+    applyExpander(ExpanderDevice::LIGHT_CAMERA, command.lightCamera);
 
-    {
-        auto arm = r.nested_object("a");
+    return applied;
+}
 
-        auto fillArm = [&](const char *name, Joint j) {
-            auto joint = arm.nested_object(name);
-            joint.write("s", iface().arm[j].getSpeed());
-            joint.write("p", iface().arm[j].getPosition());
-            joint.write("d", directionToString(iface().arm[j].getDirection()));
-            joint.close();
-        };
+void bridge::createBridgeReport(Interface &iface, processing::BridgeReport &r) {
+    r.lightRight = iface.expander[ExpanderDevice::LIGHT_RIGHT].isEnabled();
+    r.lightLeft = iface.expander[ExpanderDevice::LIGHT_LEFT].isEnabled();
+    r.lightCamera = iface.expander[ExpanderDevice::LIGHT_CAMERA].isEnabled();
 
-        fillArm("s", Joint::SHOULDER);
-        fillArm("e", Joint::ELBOW);
-        fillArm("g", Joint::GRIPPER);
+    auto fillMotor = [&](processing::MotorReport &report, Motor m) {
+        report.speed = iface.motor[m].getSpeed();
+        report.direction = iface.motor[m].getDirection();
+    };
 
-        arm.write("cal_st", armCalibrationStatusToString(iface().arm.getCalibrationStatus()));
-        arm.write("mode", armDriverModeToString(iface().arm.getMode()));
+    fillMotor(r.leftMotor, Motor::LEFT);
+    fillMotor(r.rightMotor, Motor::RIGHT);
 
-        arm.close();
-    }
+    auto fillArm = [&](processing::JointReport &report, Joint j) {
+        report.speed = iface.arm[j].getSpeed();
+        report.position = iface.arm[j].getPosition();
+        report.direction = iface.arm[j].getDirection();
+    };
 
-    {
-        auto button = r.nested_array("btn");
+    fillArm(r.shoulder, Joint::SHOULDER);
+    fillArm(r.elbow, Joint::ELBOW);
+    fillArm(r.gripper, Joint::GRIPPER);
 
-        auto fillButtons = [&](string name, Button d) {
-            if (iface().isButtonPressed(d)) {
-                button.write(name);
-            }
-        };
+    r.calibrationStatus = iface.arm.getCalibrationStatus();
+    r.armMode = iface.arm.getMode();
 
-        fillButtons("u", Button::UP);
-        fillButtons("d", Button::DOWN);
-        fillButtons("e", Button::ENTER);
+    r.buttonUp = iface.isButtonPressed(Button::UP);
+    r.buttonDown = iface.isButtonPressed(Button::DOWN);
+    r.buttonEnter = iface.isButtonPressed(Button::ENTER);
 
-        button.close();
-    }
+    r.voltage = iface.getVoltage();
+    r.current = iface.getCurrent();
 
-    {
-        auto batt = r.nested_object("b");
-        batt.write("u", iface().getVoltage());
-        batt.write("i", iface().getCurrent());
-        batt.close();
-    }
-
-    if (iface().isKillSwitchActive()) {
-        if (iface().isKillSwitchCausedByHardware()) {
-            r.write("ks_stat", "hardware");
-        } else {
-            r.write("ks_stat", "software");
-        }
+    if (iface.isKillSwitchActive()) {
+        r.killSwitch = iface.isKillSwitchCausedByHardware()
+                       ? processing::KillSwitchStatus::HARDWARE
+                       : processing::KillSwitchStatus::SOFTWARE;
     } else {
-        r.write("ks_stat", "inactive");
+        r.killSwitch = processing::KillSwitchStatus::INACTIVE;
     }
 }
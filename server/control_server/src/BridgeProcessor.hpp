@@ -3,52 +3,109 @@
 #include "IRequestProcessor.hpp"
 #include "USBCommunicator.hpp"
 #include "InterfaceManager.hpp"
+#include "LatencyHistogram.hpp"
+#include "Configuration.hpp"
 
 #include <log4cpp/Category.hh>
 #include <wallaroo/part.h>
-#include <minijson_writer.hpp>
 
 #include <memory>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
 #include <chrono>
 #include <functional>
+#include <cstdint>
 
 namespace bridge {
     using namespace common::bridge;
 
-    class BridgeProcessor : public processing::IRequestProcessor, public wallaroo::Part {
+    /**
+     * Fills the report with the current state of the interface. The interface has to be locked.
+     */
+    void createBridgeReport(Interface &iface, processing::BridgeReport &r);
+
+    /**
+     * The requests only change the desired state in the interface. The device is synchronized
+     * by the separate thread at the fixed rate, so the USB traffic doesn't depend on the arrival
+     * of the requests and the command is shipped at most one period after it was applied.
+     *
+     * The synchronization is pipelined: the packet of the current tick is sent before the response
+     * to the previous one is applied, so the thread doesn't wait for the full USB round trip.
+     *
+     * The kill switch has its own thread which queues the minimal packet right behind the exchanges
+     * in flight, without waiting for the interface and the next tick.
+     */
+    class BridgeProcessor : public processing::IRequestProcessor,
+                            public processing::IEmergencyStop,
+                            public wallaroo::Part {
     public:
         BridgeProcessor();
 
         ~BridgeProcessor();
 
-        void process(processing::Request &request, minijson::object_writer &response) override;
+        void process(processing::Request &request, processing::Report &report) override;
+
+        void activateKillSwitch() override;
+
+        /**
+         * @return histogram of the time between activateKillSwitch() and the end of sending the packet
+         */
+        processing::LatencyHistogram getKillSwitchLatencyHistogram();
 
     private:
         log4cpp::Category &logger;
 
+        wallaroo::Collaborator<common::config::Configuration> config;
         wallaroo::Collaborator<ICommunicator> usbComm;
         wallaroo::Collaborator<IInterfaceManager> interfaceManager;
 
-        std::unique_ptr<std::thread> maintenanceThread;
+        std::unique_ptr<std::thread> syncThread;
+        std::unique_ptr<std::thread> killSwitchThread;
+
+        std::mutex killSwitchMutex;
+        std::condition_variable killSwitchCv;
+        bool killSwitchRequested = false;
+        std::chrono::steady_clock::time_point killSwitchRequestTime;
+        processing::LatencyHistogram killSwitchLatencyHistogram;
+
+        std::chrono::steady_clock::duration syncPeriod;
+
+        /**
+         * Priority of the synchronization and kill switch threads in SCHED_FIFO class,
+         * 0 for the default scheduling.
+         */
+        int syncThreadPriority = 0;
+
+        /**
+         * Used only by the synchronization thread.
+         */
+        processing::LatencyHistogram syncTimeHistogram;
+        unsigned long syncOverrunsCount = 0;
+        unsigned long syncErrorsCount = 0;
 
-        std::chrono::time_point<std::chrono::high_resolution_clock> lastProcessFunctionExecution;
+        processing::BridgeReport lastReport;
+        uint64_t lastReportStateVersion = 0;
 
         volatile bool finishCycleThread = false;
-        volatile bool firstMaintenanceTask = true;
 
         void Init() override;
 
-        void maintenanceThreadFunction();
+        void syncThreadFunction();
+
+        void setRealTimePriority();
+
+        void syncWithDevice();
+
+        void killSwitchThreadFunction();
+
+        void sendKillSwitchPacket();
 
         Interface &iface() {
             return interfaceManager->iface();
         }
 
-        void createReport(minijson::object_writer &r);
-
-        void parseRequest(std::string &request);
+        bool applyCommand(const processing::Command &command);
     };
 
 }
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Interface.hpp"
+
+namespace processing {
+
+    /**
+     * 32 characters and the new line, more isn't sent to the display.
+     */
+    constexpr unsigned int COMMAND_LCD_TEXT_MAX_LENGTH = 33;
+
+    /**
+     * Value which may be missing in the request.
+     */
+    template<typename T>
+    struct CommandField {
+        bool present = false;
+        T value = T();
+
+        void set(T v) {
+            value = v;
+            present = true;
+        }
+    };
+
+    struct MotorCommand {
+        CommandField<long> speed;
+        CommandField<common::bridge::Direction> direction;
+    };
+
+    struct JointCommand {
+        CommandField<long> speed;
+        CommandField<common::bridge::Direction> direction;
+        CommandField<long> position;
+    };
+
+    /**
+     * Device settings decoded from the request. Only the present fields are applied,
+     * the others keep their previous values. The struct has fixed size, decoding doesn't allocate.
+     */
+    struct Command {
+        CommandField<bool> killSwitch;
+
+        bool lcdTextPresent = false;
+        char lcdText[COMMAND_LCD_TEXT_MAX_LENGTH + 1] = {0};
+
+        MotorCommand leftMotor;
+        MotorCommand rightMotor;
+
+        JointCommand shoulder;
+        JointCommand elbow;
+        JointCommand gripper;
+        bool calibrateArm = false;
+
+        CommandField<bool> lightLeft;
+        CommandField<bool> lightRight;
+        CommandField<bool> lightCamera;
+    };
+}
@@ -0,0 +1,243 @@
+#include "CommandDecoder.hpp"
+#include "BinaryProtocol.hpp"
+
+#include <strings.h>
+
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+
+using namespace std;
+using namespace processing;
+using common::bridge::Direction;
+
+namespace processing {
+
+    /**
+     * FNV-1a, usable in the case labels.
+     */
+    constexpr uint32_t hashKey(const char *key, uint32_t hash = 2166136261u) {
+        return *key == 0 ? hash : hashKey(key + 1, (hash ^ static_cast<uint8_t>(*key)) * 16777619u);
+    }
+
+    /**
+     * All keys known on any level of the request. The names are indexed by the values.
+     */
+    enum class Key {
+        UNKNOWN,
+        SERIAL, SKIP_RESPONSE, TSS, SESSION, MAX_AGE, ACK,
+        LCD, KS_EN, M, A, E,
+        L, R, S, D, P, G, B_CAL, CAM
+    };
+
+    static const char *KEY_NAMES[] = {
+            "",
+            "serial", "skip_response", "tss", "session", "max_age", "ack",
+            "lcd", "ks_en", "m", "a", "e",
+            "l", "r", "s", "d", "p", "g", "b_cal", "cam"
+    };
+
+    /**
+     * The switch doesn't compile if two keys have the same hash, so the hash is perfect for the known keys.
+     * The unknown keys are sorted out by the comparison with the name of the matched one.
+     */
+    static Key identifyKey(const char *name) {
+        Key key;
+
+        switch (hashKey(name)) {
+            case hashKey("serial"):        key = Key::SERIAL;        break;
+            case hashKey("skip_response"): key = Key::SKIP_RESPONSE; break;
+            case hashKey("tss"):           key = Key::TSS;           break;
+            case hashKey("session"):       key = Key::SESSION;       break;
+            case hashKey("max_age"):       key = Key::MAX_AGE;       break;
+            case hashKey("ack"):           key = Key::ACK;           break;
+            case hashKey("lcd"):           key = Key::LCD;           break;
+            case hashKey("ks_en"):         key = Key::KS_EN;         break;
+            case hashKey("m"):             key = Key::M;             break;
+            case hashKey("a"):             key = Key::A;             break;
+            case hashKey("e"):             key = Key::E;             break;
+            case hashKey("l"):             key = Key::L;             break;
+            case hashKey("r"):             key = Key::R;             break;
+            case hashKey("s"):             key = Key::S;             break;
+            case hashKey("d"):             key = Key::D;             break;
+            case hashKey("p"):             key = Key::P;             break;
+            case hashKey("g"):             key = Key::G;             break;
+            case hashKey("b_cal"):         key = Key::B_CAL;         break;
+            case hashKey("cam"):           key = Key::CAM;           break;
+            default:
+                return Key::UNKNOWN;
+        }
+
+        return std::strcmp(name, KEY_NAMES[static_cast<int>(key)]) == 0 ? key : Key::UNKNOWN;
+    }
+
+    /**
+     * Same as common::bridge::stringToDirection(), without creating the strings.
+     */
+    static Direction decodeDirection(const char *text) {
+        if (strcasecmp(text, "stop") == 0) {
+            return Direction::STOP;
+        } else if (strcasecmp(text, "forward") == 0) {
+            return Direction::FORWARD;
+        } else if (strcasecmp(text, "backward") == 0) {
+            return Direction::BACKWARD;
+        }
+
+        throw std::runtime_error(string("invalid direction: ") + text);
+    }
+}
+
+processing::CommandDecoder::CommandDecoder()
+        : logger(log4cpp::Category::getInstance("CommandDecoder")) {
+}
+
+void processing::CommandDecoder::decode(char *data, std::size_t length, Request &request) {
+    if (isBinaryMessage(data, length)) {
+        request.protocol = Protocol::BINARY;
+        decodeBinaryRequest(reinterpret_cast<const uint8_t *>(data), length, request);
+        return;
+    }
+
+    request.protocol = Protocol::JSON;
+
+    Command &command = request.command;
+    command = Command();
+
+    minijson::buffer_context ctx(data, length);
+    minijson::parse_object(ctx, [&](const char *k, minijson::value v) {
+        switch (identifyKey(k)) {
+            case Key::SERIAL:
+                request.serial = v.as_long();
+                break;
+            case Key::SKIP_RESPONSE:
+                request.skipResponse = v.as_bool();
+                break;
+            case Key::TSS:
+                request.sendTimestamp.assign(v.as_string(), strnlen(v.as_string(), REQUEST_TIMESTAMP_MAX_LENGTH));
+                break;
+            case Key::SESSION:
+                request.session.assign(v.as_string(), strnlen(v.as_string(), REQUEST_SESSION_MAX_LENGTH));
+                break;
+            case Key::MAX_AGE:
+                request.maxAgeMs = v.as_long();
+                break;
+            case Key::ACK:
+                request.ackedReportVersion = v.as_long();
+                break;
+            case Key::LCD:
+                std::strncpy(command.lcdText, v.as_string(), COMMAND_LCD_TEXT_MAX_LENGTH);
+                command.lcdText[COMMAND_LCD_TEXT_MAX_LENGTH] = 0;
+                command.lcdTextPresent = true;
+                break;
+            case Key::KS_EN:
+                command.killSwitch.set(v.as_bool());
+                break;
+            case Key::M:
+                decodeMotors(ctx, command);
+                break;
+            case Key::A:
+                decodeArm(ctx, command);
+                break;
+            case Key::E:
+                decodeLights(ctx, command);
+                break;
+            default:
+                minijson::ignore(ctx);
+        }
+    });
+}
+
+void processing::CommandDecoder::decodeMotors(minijson::buffer_context &ctx, Command &command) {
+    minijson::parse_object(ctx, [&](const char *k, minijson::value v) {
+        switch (identifyKey(k)) {
+            case Key::L:
+                decodeMotor(ctx, command.leftMotor, "left");
+                break;
+            case Key::R:
+                decodeMotor(ctx, command.rightMotor, "right");
+                break;
+            default:
+                minijson::ignore(ctx);
+        }
+    });
+}
+
+void processing::CommandDecoder::decodeMotor(minijson::buffer_context &ctx, MotorCommand &motor, const char *name) {
+    minijson::parse_object(ctx, [&](const char *k, minijson::value v) {
+        try {
+            switch (identifyKey(k)) {
+                case Key::S:
+                    motor.speed.set(v.as_long());
+                    break;
+                case Key::D:
+                    motor.direction.set(decodeDirection(v.as_string()));
+                    break;
+                default:
+                    minijson::ignore(ctx);
+            }
+        } catch (runtime_error &e) {
+            logger.error("Cannot set value for motor %s: %s.", name, e.what());
+        }
+    });
+}
+
+void processing::CommandDecoder::decodeArm(minijson::buffer_context &ctx, Command &command) {
+    minijson::parse_object(ctx, [&](const char *k, minijson::value v) {
+        switch (identifyKey(k)) {
+            case Key::S:
+                decodeJoint(ctx, command.shoulder, "shoulder");
+                break;
+            case Key::E:
+                decodeJoint(ctx, command.elbow, "elbow");
+                break;
+            case Key::G:
+                decodeJoint(ctx, command.gripper, "gripper");
+                break;
+            case Key::B_CAL:
+                command.calibrateArm = v.as_bool();
+                break;
+            default:
+                minijson::ignore(ctx);
+        }
+    });
+}
+
+void processing::CommandDecoder::decodeJoint(minijson::buffer_context &ctx, JointCommand &joint, const char *name) {
+    minijson::parse_object(ctx, [&](const char *k, minijson::value v) {
+        try {
+            switch (identifyKey(k)) {
+                case Key::S:
+                    joint.speed.set(v.as_long());
+                    break;
+                case Key::D:
+                    joint.direction.set(decodeDirection(v.as_string()));
+                    break;
+                case Key::P:
+                    joint.position.set(v.as_long());
+                    break;
+                default:
+                    minijson::ignore(ctx);
+            }
+        } catch (runtime_error &e) {
+            logger.error("Cannot set value for joint %s: %s.", name, e.what());
+        }
+    });
+}
+
+void processing::CommandDecoder::decodeLights(minijson::buffer_context &ctx, Command &command) {
+    minijson::parse_object(ctx, [&](const char *k, minijson::value v) {
+        switch (identifyKey(k)) {
+            case Key::R:
+                command.lightRight.set(v.as_bool());
+                break;
+            case Key::L:
+                command.lightLeft.set(v.as_bool());
+                break;
+            case Key::CAM:
+                command.lightCamera.set(v.as_bool());
+                break;
+            default:
+                minijson::ignore(ctx);
+        }
+    });
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "IRequestProcessor.hpp"
+
+#include <log4cpp/Category.hh>
+#include <boost/noncopyable.hpp>
+#include <minijson_reader.hpp>
+
+#include <cstddef>
+
+namespace processing {
+
+    /**
+     * Parses the request once, filling both the header fields used by the queuer (serial, timestamps etc.)
+     * and the command for the processors. Both JSON and binary requests are accepted, they're told apart
+     * by the first byte. The keys are identified by the hash computed at compile time,
+     * so each key costs one hash and one string comparison regardless of the number of known keys.
+     */
+    class CommandDecoder : boost::noncopyable {
+    public:
+        CommandDecoder();
+
+        /**
+         * Invalid values of the single fields are logged and skipped, the rest of the request is decoded.
+         * @param data text of the request, it's parsed in place, so it's modified
+         * @throws minijson::parse_error if the request isn't valid JSON document
+         * @throws BinaryProtocolException if the binary request is malformed
+         */
+        void decode(char *data, std::size_t length, Request &request);
+
+    private:
+        log4cpp::Category &logger;
+
+        void decodeMotors(minijson::buffer_context &ctx, Command &command);
+
+        void decodeMotor(minijson::buffer_context &ctx, MotorCommand &motor, const char *name);
+
+        void decodeArm(minijson::buffer_context &ctx, Command &command);
+
+        void decodeJoint(minijson::buffer_context &ctx, JointCommand &joint, const char *name);
+
+        void decodeLights(minijson::buffer_context &ctx, Command &command);
+    };
+}
@@ -0,0 +1,352 @@
+#include "DeviceEmulator.hpp"
+#include "usb-settings.hpp"
+#include "utils.hpp"
+
+#include <thread>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+using namespace std;
+using namespace bridge;
+
+using std::chrono::steady_clock;
+using std::chrono::microseconds;
+
+/**
+ * Size of usb::Buffer in the firmware.
+ */
+constexpr unsigned int OUTPUT_BUFFER_SIZE = 128;
+
+constexpr double EMULATED_VOLTAGE = 12.6;
+constexpr double EMULATED_CURRENT = 0.5;
+
+WALLAROO_REGISTER(DeviceEmulator);
+
+bridge::DeviceEmulator::DeviceEmulator()
+        : logger(log4cpp::Category::getInstance("DeviceEmulator")),
+          config("config", RegistrationToken()),
+          randomGenerator(std::random_device()()) {
+    response.reserve(USB_SETTINGS_DEVICE_TO_HOST_DATAPACKET_SIZE);
+    outputBuffer.resize(OUTPUT_BUFFER_SIZE);
+
+    resetDevice();
+
+    deliveryThread = std::thread(&DeviceEmulator::deliveryThreadFunction, this);
+}
+
+void bridge::DeviceEmulator::Init() {
+    int latencyUs = config->getInt("DeviceEmulator.latency_us");
+    int jitterUs = config->getInt("DeviceEmulator.jitter_us");
+
+    if (latencyUs < 0 or jitterUs < 0) {
+        throw std::runtime_error("emulated latency and jitter cannot be negative");
+    }
+
+    latency = microseconds(latencyUs);
+    jitter = microseconds(jitterUs);
+
+    logger.notice("Emulating bridge device with latency %d us and jitter %d us.", latencyUs, jitterUs);
+
+    logger.notice("Instance created.");
+}
+
+bridge::DeviceEmulator::~DeviceEmulator() {
+    {
+        std::lock_guard<std::mutex> lk(deliveryMutex);
+        finishDelivery = true;
+    }
+    deliveryCv.notify_all();
+    deliveryThread.join();
+
+    logger.notice("Instance destroyed.");
+}
+
+void bridge::DeviceEmulator::sendData(vector<uint8_t> &data) {
+    pendingResponse = exchange(data);
+}
+
+vector<uint8_t> &bridge::DeviceEmulator::receiveData() {
+    response = pendingResponse.get();
+
+    return response;
+}
+
+future<vector<uint8_t>> bridge::DeviceEmulator::exchange(vector<uint8_t> &data) {
+    std::lock_guard<std::mutex> lk(deliveryMutex);
+
+    auto delay = latency;
+
+    if (jitter.count() > 0) {
+        uniform_int_distribution<long> distribution(0, jitter.count());
+        delay += microseconds(distribution(randomGenerator));
+    }
+
+    // the responses come in the order of the packets
+    lastResponseTime = std::max(steady_clock::now() + delay, lastResponseTime);
+
+    pendingResponses.push_back({lastResponseTime, processPacket(data), promise<vector<uint8_t>>()});
+
+    auto future = pendingResponses.back().promise.get_future();
+    deliveryCv.notify_one();
+    return future;
+}
+
+void bridge::DeviceEmulator::deliveryThreadFunction() {
+    std::unique_lock<std::mutex> lk(deliveryMutex);
+
+    while (true) {
+        deliveryCv.wait(lk, [&]() { return finishDelivery or not pendingResponses.empty(); });
+
+        if (finishDelivery) {
+            return;
+        }
+
+        // the later packets never have the earlier response time, so only the first one is waited for
+        auto time = pendingResponses.front().time;
+        if (deliveryCv.wait_until(lk, time, [&]() { return finishDelivery; })) {
+            return;
+        }
+
+        auto pending = std::move(pendingResponses.front());
+        pendingResponses.pop_front();
+
+        lk.unlock();
+        pending.promise.set_value(std::move(pending.data));
+        lk.lock();
+    }
+}
+
+vector<uint8_t> &bridge::DeviceEmulator::processPacket(const vector<uint8_t> &packet) {
+    std::lock_guard<std::mutex> lk(stateMutex);
+
+    packetsCount++;
+
+    // the communicator pads the packet with zeros, which aren't commands
+    vector<uint8_t> in(packet);
+    in.resize(USB_SETTINGS_HOST_TO_DEVICE_DATAPACKET_SIZE, 0);
+
+    std::fill(outputBuffer.begin(), outputBuffer.end(), USBCommands::MESSAGE_END);
+    outputLength = 0;
+
+    unsigned int pos = 0;
+
+    // the firmware reads the arguments past the end of the packet, here the processing stops
+    auto hasArguments = [&](unsigned int length) {
+        if (pos + length > in.size()) {
+            logger.warn("Command %u at position %u has truncated arguments.", in[pos - 1], pos - 1);
+            pos = in.size();
+            return false;
+        }
+        return true;
+    };
+
+    while (pos < in.size()) {
+        auto command = static_cast<USBCommands::Request>(in[pos++]);
+
+        switch (command) {
+            case USBCommands::BRIDGE_GET_STATE: {
+                USBCommands::bridge::State state;
+                std::memset(&state, 0, sizeof(state));
+                state.rawVoltage = lround(EMULATED_VOLTAGE / USBCommands::bridge::VOLTAGE_FACTOR);
+                state.rawCurrent = lround(EMULATED_CURRENT / USBCommands::bridge::CURRENT_FACTOR);
+                state.killSwitch = killSwitchActive ? USBCommands::bridge::ACTIVE : USBCommands::bridge::INACTIVE;
+                state.killSwitchCausedByHardware = false;
+                push(&state, sizeof(state));
+            }
+                break;
+            case USBCommands::BRIDGE_SET_KILLSWITCH:
+                if (hasArguments(1)) {
+                    setKillSwitch(in[pos] != USBCommands::bridge::INACTIVE);
+                    pos++;
+                }
+                break;
+            case USBCommands::EXPANDER_GET:
+                push(&expanderValue, 1);
+                break;
+            case USBCommands::EXPANDER_SET:
+                if (hasArguments(1)) {
+                    expanderValue = in[pos];
+                    pos++;
+                }
+                break;
+            case USBCommands::ARM_DRIVER_GET_GENERAL_STATE:
+                push(&armState, sizeof(armState));
+                break;
+            case USBCommands::ARM_DRIVER_GET:
+                if (hasArguments(1)) {
+                    USBCommands::arm::JointState joint;
+                    std::memset(&joint, 0, sizeof(joint));
+                    joint.motor = static_cast<::arm::Motor>(in[pos]);
+
+                    if (joint.motor < joints.size()) {
+                        joint = joints[joint.motor];
+                    }
+
+                    joint.setPosition = false;
+                    push(&joint, sizeof(joint));
+                    pos++;
+                }
+                break;
+            case USBCommands::MOTOR_DRIVER_GET:
+                if (hasArguments(1)) {
+                    USBCommands::motor::SpecificMotorState motor;
+                    std::memset(&motor, 0, sizeof(motor));
+                    motor.motor = static_cast<::motor::Motor>(in[pos]);
+
+                    if (motor.motor < motors.size()) {
+                        motor = motors[motor.motor];
+                    }
+
+                    push(&motor, sizeof(motor));
+                    pos++;
+                }
+                break;
+            case USBCommands::ARM_DRIVER_SET:
+                if (not hasArguments(1)) {
+                    break;
+                }
+
+                if (in[pos] == USBCommands::arm::BRAKE) {
+                    if (not killSwitchActive) {
+                        for (auto &j : joints) {
+                            j.speed = 0;
+                            j.direction = ::arm::STOP;
+                        }
+                    }
+                    pos++;
+                } else if (in[pos] == USBCommands::arm::CALIBRATE) {
+                    if (not killSwitchActive) {
+                        for (auto &j : joints) {
+                            j.position = 0;
+                        }
+                        armState.isCalibrated = true;
+                        armState.mode = ::arm::DIR;
+                    }
+                    pos++;
+                } else if (hasArguments(sizeof(USBCommands::arm::JointState))) {
+                    USBCommands::arm::JointState joint;
+                    std::memcpy(&joint, &in[pos], sizeof(joint));
+                    setJoint(joint);
+                    pos += sizeof(USBCommands::arm::JointState);
+                }
+                break;
+            case USBCommands::MOTOR_DRIVER_SET:
+                if (hasArguments(sizeof(USBCommands::motor::SpecificMotorState))) {
+                    USBCommands::motor::SpecificMotorState motor;
+                    std::memcpy(&motor, &in[pos], sizeof(motor));
+
+                    if (not killSwitchActive and motor.motor < motors.size()) {
+                        motors[motor.motor] = motor;
+                    }
+                    pos += sizeof(USBCommands::motor::SpecificMotorState);
+                }
+                break;
+            case USBCommands::BRIDGE_LCD_SET:
+                if (hasArguments(1) and hasArguments(1 + in[pos])) {
+                    uint8_t length = in[pos];
+                    lcdText.assign(reinterpret_cast<const char *>(&in[pos + 1]), length);
+                    pos += length + 1;
+                }
+                break;
+            case USBCommands::MESSAGE_END:
+                pos = in.size();
+                break;
+            case USBCommands::BRIDGE_RESET_DEVICE:
+                // the real device restarts and doesn't answer, the emulated one answers at once
+                logger.warn("Device reset requested.");
+                resetDevice();
+                pos = in.size();
+                break;
+            default:
+                // ignored by the firmware as well
+                break;
+        }
+    }
+
+    response.assign(outputBuffer.begin(), outputBuffer.begin() + USB_SETTINGS_DEVICE_TO_HOST_DATAPACKET_SIZE);
+
+    if (logger.getPriority() >= log4cpp::Priority::DEBUG) {
+        logger.debug(string("Response: ") + common::utils::toString<uint8_t>(response));
+    }
+
+    return response;
+}
+
+void bridge::DeviceEmulator::resetDevice() {
+    expanderValue = 0;
+    lcdText.clear();
+
+    armState.isCalibrated = false;
+    armState.mode = ::arm::DIR;
+
+    for (uint8_t j = 0; j < joints.size(); j++) {
+        joints[j].motor = static_cast<::arm::Motor>(j);
+        joints[j].position = 0;
+        joints[j].setPosition = false;
+    }
+
+    for (uint8_t m = 0; m < motors.size(); m++) {
+        motors[m].motor = static_cast<::motor::Motor>(m);
+    }
+
+    resetDrivers();
+
+    // the firmware activates the kill switch at start
+    killSwitchActive = true;
+}
+
+void bridge::DeviceEmulator::resetDrivers() {
+    for (auto &m : motors) {
+        m.speed = 0;
+        m.direction = ::motor::STOP;
+    }
+
+    for (auto &j : joints) {
+        j.speed = 0;
+        j.direction = ::arm::STOP;
+    }
+
+    armState.mode = ::arm::DIR;
+}
+
+void bridge::DeviceEmulator::setKillSwitch(bool active) {
+    if (active and not killSwitchActive) {
+        logger.info("Kill switch activated.");
+        resetDrivers();
+        lcdText.clear();
+    } else if (not active and killSwitchActive) {
+        logger.info("Kill switch deactivated.");
+    }
+
+    killSwitchActive = active;
+}
+
+void bridge::DeviceEmulator::setJoint(const USBCommands::arm::JointState &joint) {
+    if (killSwitchActive or joint.motor >= joints.size()) {
+        return;
+    }
+
+    auto &j = joints[joint.motor];
+    j.speed = joint.speed;
+
+    if (joint.setPosition) {
+        // reached at once
+        j.position = joint.position;
+        j.direction = ::arm::STOP;
+        armState.mode = ::arm::POS;
+    } else {
+        j.direction = joint.direction;
+        armState.mode = ::arm::DIR;
+    }
+}
+
+void bridge::DeviceEmulator::push(const void *data, unsigned int length) {
+    if (outputLength + length > OUTPUT_BUFFER_SIZE) {
+        logger.warn("Response doesn't fit in the output buffer.");
+        return;
+    }
+
+    std::memcpy(&outputBuffer[outputLength], data, length);
+    outputLength += length;
+}
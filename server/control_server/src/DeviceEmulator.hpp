@@ -0,0 +1,154 @@
+#pragma once
+
+#include "USBCommunicator.hpp"
+#include "Configuration.hpp"
+
+#include <log4cpp/Category.hh>
+#include <wallaroo/registered.h>
+
+#include <array>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <future>
+#include <cstdint>
+
+namespace bridge {
+
+    /**
+     * Emulates the bridge device, so the control path can be tested and benchmarked without the hardware.
+     * The packets are decoded the same way as by usb::executeCommandsFromUSB() in the firmware and the responses
+     * are laid out from the USBCommands structs, padded with MESSAGE_END.
+     *
+     * The drivers are ideal: the set values are read back at once and the calibration finishes immediately.
+     * As in the hardware, they are held in reset while the kill switch is active and the device starts with
+     * the kill switch active.
+     */
+    class DeviceEmulator : public ICommunicator, public wallaroo::Part {
+    public:
+        DeviceEmulator();
+
+        ~DeviceEmulator();
+
+        void sendData(std::vector<uint8_t> &data) override;
+
+        /**
+         * Returns the response to the last packet after the configured latency and the random jitter,
+         * both counted from sendData().
+         */
+        std::vector<uint8_t> &receiveData() override;
+
+        /**
+         * Executes the commands from the packet at once and returns immediately. The future response
+         * is completed by the delivery thread after the latency and the jitter, but not before the response
+         * to the previous packet, so the exchanges are pipelined as with the real device.
+         */
+        std::future<std::vector<uint8_t>> exchange(std::vector<uint8_t> &data) override;
+
+        /**
+         * Executes the commands from the packet without any delay.
+         * @return response of the device, USB_SETTINGS_DEVICE_TO_HOST_DATAPACKET_SIZE bytes long
+         */
+        std::vector<uint8_t> &processPacket(const std::vector<uint8_t> &packet);
+
+        // the getters can be called while another thread synchronizes the device
+        bool isKillSwitchActive() {
+            std::lock_guard<std::mutex> lk(stateMutex);
+            return killSwitchActive;
+        }
+
+        std::string getLCDText() {
+            std::lock_guard<std::mutex> lk(stateMutex);
+            return lcdText;
+        }
+
+        uint8_t getExpanderValue() {
+            std::lock_guard<std::mutex> lk(stateMutex);
+            return expanderValue;
+        }
+
+        USBCommands::motor::SpecificMotorState getMotorState(::motor::Motor m) {
+            std::lock_guard<std::mutex> lk(stateMutex);
+            return motors.at(m);
+        }
+
+        USBCommands::arm::JointState getJointState(::arm::Motor j) {
+            std::lock_guard<std::mutex> lk(stateMutex);
+            return joints.at(j);
+        }
+
+        unsigned long getNumOfPackets() {
+            std::lock_guard<std::mutex> lk(stateMutex);
+            return packetsCount;
+        }
+
+    private:
+        log4cpp::Category &logger;
+
+        wallaroo::Collaborator<common::config::Configuration> config;
+
+        std::chrono::microseconds latency;
+        std::chrono::microseconds jitter;
+
+        std::mt19937 randomGenerator;
+
+        std::vector<uint8_t> response;
+        std::future<std::vector<uint8_t>> pendingResponse;
+
+        struct PendingResponse {
+            std::chrono::steady_clock::time_point time;
+            std::vector<uint8_t> data;
+            std::promise<std::vector<uint8_t>> promise;
+        };
+
+        /**
+         * Guards the responses waiting for the delivery and the random generator.
+         */
+        std::mutex deliveryMutex;
+        std::condition_variable deliveryCv;
+        std::deque<PendingResponse> pendingResponses;
+        std::chrono::steady_clock::time_point lastResponseTime;
+        bool finishDelivery = false;
+
+        std::thread deliveryThread;
+
+        /**
+         * The firmware buffer is longer than the packet, the overflowing part isn't sent.
+         */
+        std::vector<uint8_t> outputBuffer;
+        unsigned int outputLength = 0;
+
+        /**
+         * Guards the state of the device and the counter.
+         */
+        std::mutex stateMutex;
+
+        unsigned long packetsCount = 0;
+
+        bool killSwitchActive;
+        uint8_t expanderValue;
+        std::string lcdText;
+        std::array<USBCommands::motor::SpecificMotorState, 2> motors;
+        std::array<USBCommands::arm::JointState, 3> joints;
+        USBCommands::arm::GeneralState armState;
+
+        void Init() override;
+
+        void deliveryThreadFunction();
+
+        void resetDevice();
+
+        void resetDrivers();
+
+        void setKillSwitch(bool active);
+
+        void setJoint(const USBCommands::arm::JointState &joint);
+
+        void push(const void *data, unsigned int length);
+    };
+}
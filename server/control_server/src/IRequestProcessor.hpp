@@ -1,32 +1,85 @@
 #pragma once
 
-#include <minijson_writer.hpp>
+#include "Command.hpp"
+#include "Report.hpp"
 
 #include <boost/asio.hpp>
 
 #include <memory>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
 
 namespace processing {
 
+    /**
+     * Longer client timestamps and session tokens are truncated when the request is decoded,
+     * so the response header has bounded length.
+     */
+    constexpr std::size_t REQUEST_TIMESTAMP_MAX_LENGTH = 32;
+
+    constexpr std::size_t REQUEST_SESSION_MAX_LENGTH = 32;
+
+    enum class Protocol {
+        JSON, BINARY
+    };
+
     struct Request {
         long internalId = -1;
         long serial = -1;
         bool skipResponse = false;
-        boost::asio::ip::address ipAddress;
-        std::string reqJson;
+        /**
+         * The response is encoded in the same protocol as the request.
+         */
+        Protocol protocol = Protocol::JSON;
+        boost::asio::ip::udp::endpoint client;
+        /**
+         * Token which lets one client have more sessions, empty if not given in the request.
+         */
+        std::string session;
         std::string sendTimestamp;
         std::string receiveTimestamp;
+        /**
+         * When the request was added to the queue.
+         */
+        std::chrono::steady_clock::time_point receiveTime;
+        /**
+         * The request isn't executed if it waits in the queue longer, 0 for no limit.
+         */
+        long maxAgeMs = 0;
+        /**
+         * Version of the last report received by the client. The response contains only the fields
+         * changed since this version. 0 if the client wants the full report.
+         */
+        uint64_t ackedReportVersion = 0;
+        /**
+         * Decoded once by the queuer, the processors don't parse the request text.
+         */
+        Command command;
     };
 
     class IRequestProcessor {
     public:
         /*
-         * Takes the JSON document tree and parses the request. Returns the response.
+         * Takes the decoded request and executes its command. Fills its part of the report.
          * The function is blocking till the values are gathered.
          */
-        virtual void process(Request &req, minijson::object_writer &response) = 0;
+        virtual void process(Request &req, Report &report) = 0;
 
         virtual ~IRequestProcessor() = default;
     };
 
+    /**
+     * Stops the robot without waiting for the requests in the queue and the synchronization in progress.
+     */
+    class IEmergencyStop {
+    public:
+        /**
+         * Called from the network thread when the kill switch request is received, so it must not block.
+         */
+        virtual void activateKillSwitch() = 0;
+
+        virtual ~IEmergencyStop() = default;
+    };
+
 }
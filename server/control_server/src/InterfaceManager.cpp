@@ -77,39 +77,78 @@ pair<vector<uint8_t>, vector<USBCommands::Request>> bridge::InterfaceManager::ge
 }
 
 void bridge::InterfaceManager::syncWithDevice(BridgeSyncFunction syncFunction) {
+    vector<uint8_t> request;
+    auto getters = createRequest(request);
 
-    vector<uint8_t> concatenated;
+    auto response = syncFunction(request);
+
+    applyResponse(getters, response);
+}
+
+void bridge::InterfaceManager::submitSync(BridgeExchangeFunction exchangeFunction) {
+    vector<uint8_t> request;
+    auto getters = createRequest(request);
+
+    pendingSyncs.push_back({exchangeFunction(request), std::move(getters)});
+}
+
+void bridge::InterfaceManager::waitForSync() {
+    if (not pendingSyncs.empty()) {
+        pendingSyncs.front().response.wait();
+    }
+}
+
+void bridge::InterfaceManager::completeSync() {
+    if (pendingSyncs.empty()) {
+        return;
+    }
+
+    PendingSync sync = std::move(pendingSyncs.front());
+    pendingSyncs.pop_front();
+
+    auto response = sync.response.get();
+
+    applyResponse(sync.getters, response);
+}
+
+vector<USBCommands::Request> bridge::InterfaceManager::createRequest(vector<uint8_t> &request) {
     std::priority_queue<DataHolder, vector<DataHolder>, DataHolderComparer> sortedRequests;
 
     auto diff = generateDifferentialRequests(interface->isKillSwitchActive());
 
+    if (not diff.empty()) {
+        interface->increaseStateVersion();
+    }
+
     for (auto &r : diff) {
         sortedRequests.push(r.second);
     }
 
     while (not sortedRequests.empty()) {
-        sortedRequests.top().appendTo(concatenated);
+        sortedRequests.top().appendTo(request);
         sortedRequests.pop();
     }
 
     auto getterReqs = generateGetRequests(interface->isKillSwitchActive());
-    concatenated.insert(concatenated.end(), getterReqs.first.begin(), getterReqs.first.end());
+    request.insert(request.end(), getterReqs.first.begin(), getterReqs.first.end());
 
-    concatenated.push_back(USBCommands::MESSAGE_END);
+    request.push_back(USBCommands::MESSAGE_END);
 
-    logger.info("Sending request to the device (%d bytes).", concatenated.size());
+    logger.info("Sending request to the device (%d bytes).", request.size());
     if (logger.getPriority() >= log4cpp::Priority::DEBUG) {
-        logger.debug("Request: %s.", common::utils::toString<uint8_t>(concatenated).c_str());
+        logger.debug("Request: %s.", common::utils::toString<uint8_t>(request).c_str());
     }
 
-    auto response = syncFunction(concatenated);
+    return getterReqs.second;
+}
 
+void bridge::InterfaceManager::applyResponse(vector<USBCommands::Request> &getters, vector<uint8_t> &response) {
     logger.info("Got response from device (%d bytes).", response.size());
     if (logger.getPriority() >= log4cpp::Priority::DEBUG) {
         logger.debug("Response: %s.", common::utils::toString<uint8_t>(response).c_str());
     }
 
-    interface->updateDataStructures(getterReqs.second, response);
+    interface->updateDataStructures(getters, response);
 }
 
 RequestMap bridge::InterfaceManager::generateDifferentialRequests(bool killSwitchActive) {
@@ -10,17 +10,42 @@
 #include <log4cpp/Category.hh>
 
 #include <functional>
+#include <future>
+#include <deque>
 
 namespace bridge {
 
     typedef std::function<std::vector<uint8_t>(std::vector<uint8_t> &)> BridgeSyncFunction;
 
+    typedef std::function<std::future<std::vector<uint8_t>>(std::vector<uint8_t> &)> BridgeExchangeFunction;
+
     class IInterfaceManager : boost::noncopyable {
     public:
         virtual ~IInterfaceManager() = default;
 
         virtual void syncWithDevice(BridgeSyncFunction syncFunction) = 0;
 
+        /**
+         * Sends the changed values and the getters without waiting for the response, which is applied
+         * to the interface by completeSync(). The interface has to be locked.
+         */
+        virtual void submitSync(BridgeExchangeFunction exchangeFunction) = 0;
+
+        /**
+         * Waits for the response to the oldest submitted synchronization. Doesn't touch the interface,
+         * so it's called without the lock.
+         */
+        virtual void waitForSync() = 0;
+
+        /**
+         * Updates the interface with the response to the oldest submitted synchronization, which is then
+         * forgotten even if it failed. The interface has to be locked.
+         * @throws CommException if the exchange with the device failed
+         */
+        virtual void completeSync() = 0;
+
+        virtual unsigned int getNumOfPendingSyncs() = 0;
+
         virtual common::bridge::Interface &iface() = 0;
     };
 
@@ -32,6 +57,16 @@ namespace bridge {
 
         void syncWithDevice(BridgeSyncFunction syncFunction) override;
 
+        void submitSync(BridgeExchangeFunction exchangeFunction) override;
+
+        void waitForSync() override;
+
+        void completeSync() override;
+
+        unsigned int getNumOfPendingSyncs() override {
+            return pendingSyncs.size();
+        }
+
         common::bridge::Interface &iface() override;
 
     private:
@@ -47,6 +82,20 @@ namespace bridge {
 
         common::bridge::RequestMap previousRequests;
 
+        struct PendingSync {
+            std::future<std::vector<uint8_t>> response;
+            std::vector<USBCommands::Request> getters;
+        };
+
+        /**
+         * Submitted synchronizations in the order of sending. Used only by the synchronizing thread.
+         */
+        std::deque<PendingSync> pendingSyncs;
+
+        std::vector<USBCommands::Request> createRequest(std::vector<uint8_t> &request);
+
+        void applyResponse(std::vector<USBCommands::Request> &getters, std::vector<uint8_t> &response);
+
         virtual void Init() override;
 
         common::bridge::RequestMap generateDifferentialRequests(bool killSwitchActive);
@@ -0,0 +1,52 @@
+#include "LatencyHistogram.hpp"
+
+using namespace processing;
+
+constexpr unsigned int LatencyHistogram::NUMBER_OF_BUCKETS;
+
+void processing::LatencyHistogram::add(int64_t microseconds) {
+    if (microseconds < 0) {
+        microseconds = 0;
+    }
+
+    unsigned int bucket = 0;
+    while (bucket < NUMBER_OF_BUCKETS - 1 and microseconds >= getBucketUpperBound(bucket)) {
+        bucket++;
+    }
+
+    buckets[bucket]++;
+    count++;
+
+    if (microseconds > max) {
+        max = microseconds;
+    }
+}
+
+void processing::LatencyHistogram::clear() {
+    buckets.fill(0);
+    count = 0;
+    max = 0;
+}
+
+int64_t processing::LatencyHistogram::getBucketUpperBound(unsigned int bucket) {
+    return bucket < NUMBER_OF_BUCKETS - 1 ? (int64_t(1) << bucket) : -1;
+}
+
+int64_t processing::LatencyHistogram::getPercentile(double fraction) const {
+    if (count == 0) {
+        return 0;
+    }
+
+    uint64_t threshold = static_cast<uint64_t>(fraction * count);
+    uint64_t accumulated = 0;
+
+    for (unsigned int i = 0; i < NUMBER_OF_BUCKETS - 1; ++i) {
+        accumulated += buckets[i];
+
+        if (accumulated > threshold) {
+            return getBucketUpperBound(i);
+        }
+    }
+
+    return max;
+}
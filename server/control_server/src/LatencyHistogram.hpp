@@ -0,0 +1,49 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace processing {
+
+    /**
+     * Histogram of durations in microseconds. The buckets grow by powers of 2: bucket i counts
+     * the values below 2^i us, the last one counts everything longer. Adding a value doesn't allocate.
+     * Not thread-safe.
+     */
+    class LatencyHistogram {
+    public:
+        static constexpr unsigned int NUMBER_OF_BUCKETS = 22;
+
+        void add(int64_t microseconds);
+
+        void clear();
+
+        uint64_t getCount() const {
+            return count;
+        }
+
+        uint64_t getBucketCount(unsigned int bucket) const {
+            return buckets[bucket];
+        }
+
+        /**
+         * @return exclusive upper bound of the bucket in microseconds, -1 for the last bucket
+         */
+        static int64_t getBucketUpperBound(unsigned int bucket);
+
+        int64_t getMax() const {
+            return max;
+        }
+
+        /**
+         * @param fraction between 0 and 1, e.g. 0.99
+         * @return upper bound of the bucket which contains the percentile, max for the last bucket
+         */
+        int64_t getPercentile(double fraction) const;
+
+    private:
+        std::array<uint64_t, NUMBER_OF_BUCKETS> buckets{};
+        uint64_t count = 0;
+        int64_t max = 0;
+    };
+}
@@ -2,9 +2,32 @@
 
 #include <boost/format.hpp>
 
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <poll.h>
+
+#include <cstring>
+#include <cerrno>
 
 constexpr int MAX_PACKET_SIZE = 1200;
 
+/**
+ * Maximal number of datagrams taken by a single recvmmsg() call.
+ */
+constexpr unsigned int RECEIVE_BATCH_SIZE = 32;
+
+/**
+ * Limits the number of recvmmsg() calls at one wake-up, so a flood doesn't starve other handlers on the io_context.
+ */
+constexpr int MAX_RECEIVE_CALLS_PER_WAKEUP = 4;
+
+constexpr int STATISTICS_REPORT_INTERVAL_SECONDS = 10;
+
+/**
+ * How long the executor thread waits for the room in the socket send buffer before the response is dropped.
+ */
+constexpr int SEND_WAIT_TIMEOUT_MS = 10;
+
 using namespace std;
 using namespace boost;
 using namespace boost::asio;
@@ -13,11 +36,40 @@ using boost::asio::ip::udp;
 
 WALLAROO_REGISTER(NetServer);
 
+/**
+ * The socket is non-blocking for the io_context, so the full send buffer is waited for here.
+ * @return number of bytes sent, -1 with errno set on error
+ */
+static ssize_t sendDatagram(int fd, const std::string &data, const udp::endpoint &endpoint) {
+    while (true) {
+        ssize_t sent = ::sendto(fd, data.data(), data.length(), 0, endpoint.data(), endpoint.size());
+
+        if (sent >= 0) {
+            return sent;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno != EAGAIN and errno != EWOULDBLOCK) {
+            return -1;
+        }
+
+        pollfd pfd = {fd, POLLOUT, 0};
+        int ready = poll(&pfd, 1, SEND_WAIT_TIMEOUT_MS);
+
+        if (ready == 0) {
+            errno = EAGAIN;
+            return -1;
+        } else if (ready < 0 and errno != EINTR) {
+            return -1;
+        }
+    }
+}
+
 processing::NetServer::NetServer()
         : logger(log4cpp::Category::getInstance("NetServer")),
           config("config", RegistrationToken()),
           reqQueuer("requestQueuer", RegistrationToken()),
           ioServiceProvider("ioServiceProvider", RegistrationToken()),
+          routingTable(ROUTING_TABLE_CAPACITY),
           udpPort(0) { }
 
 processing::NetServer::NetServer(unsigned int port)
@@ -25,10 +77,26 @@ processing::NetServer::NetServer(unsigned int port)
           config("config", RegistrationToken()),
           reqQueuer("requestQueuer", RegistrationToken()),
           ioServiceProvider("ioServiceProvider", RegistrationToken()),
+          routingTable(ROUTING_TABLE_CAPACITY),
           udpPort(port) { }
 
 void processing::NetServer::Init() {
-    buff.reset(new char[MAX_PACKET_SIZE]);
+    receiveBuffers.reset(new char[RECEIVE_BATCH_SIZE * MAX_PACKET_SIZE]);
+    receiveMessages.resize(RECEIVE_BATCH_SIZE);
+    receiveIovecs.resize(RECEIVE_BATCH_SIZE);
+    receiveAddresses.resize(RECEIVE_BATCH_SIZE);
+
+    for (unsigned int i = 0; i < RECEIVE_BATCH_SIZE; ++i) {
+        receiveIovecs[i].iov_base = receiveBuffers.get() + i * MAX_PACKET_SIZE;
+        receiveIovecs[i].iov_len = MAX_PACKET_SIZE;
+
+        auto &hdr = receiveMessages[i].msg_hdr;
+        std::memset(&hdr, 0, sizeof(hdr));
+        hdr.msg_iov = &receiveIovecs[i];
+        hdr.msg_iovlen = 1;
+        hdr.msg_name = &receiveAddresses[i];
+    }
+
     udpSocket.reset(new ip::udp::socket(ioServiceProvider->getIoContext()));
 
     if (udpPort == 0) {
@@ -52,6 +120,14 @@ void processing::NetServer::Init() {
         throw NetException("error at binding socket: " + err.message());
     }
 
+    udpSocket->non_blocking(true);
+
+    namespace ph = std::placeholders;
+    reqQueuer->setResponseSender(bind(&NetServer::sendResponse, this, ph::_1, ph::_2, ph::_3));
+    reqQueuer->setRejectedRequestRemover(bind(&NetServer::removeRejectedRequest, this, ph::_1));
+
+    lastReportTime = std::chrono::steady_clock::now();
+
     doReceive();
 
     logger.notice("Started UDP listener on port %u%s.", udpPort, ipv6enabled ? " (IPv6 enabled)" : "");
@@ -60,52 +136,134 @@ void processing::NetServer::Init() {
 }
 
 void processing::NetServer::doReceive() {
-    udpSocket->async_receive_from(
-            asio::buffer(buff.get(), MAX_PACKET_SIZE),
-            recvSenderEndpoint,
-            [this](system::error_code ec, size_t bytes_recvd) {
-                if (!ec && bytes_recvd > 0) {
-                    logger.info("Received %d bytes from %s.",
-                                bytes_recvd, recvSenderEndpoint.address().to_string().c_str());
+    udpSocket->async_wait(
+            udp::socket::wait_read,
+            [this](system::error_code ec) {
+                if (ec == asio::error::operation_aborted) {
+                    return;
+                } else if (ec) {
+                    logger.error("Error when waiting for packets: %s.", ec.message().c_str());
+                } else {
+                    receiveBatches();
+                }
+                doReceive();
+            });
+}
 
-                    auto msg = string(buff.get(), 0, bytes_recvd);
-                    logger.debug(string("Received data: ") + msg);
+void processing::NetServer::receiveBatches() {
+    // epoll_wait() of the reactor
+    statistics.syscalls++;
+
+    for (int call = 0; call < MAX_RECEIVE_CALLS_PER_WAKEUP; ++call) {
+        for (auto &msg : receiveMessages) {
+            msg.msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+            msg.msg_hdr.msg_flags = 0;
+        }
+
+        statistics.syscalls++;
+        int received = recvmmsg(udpSocket->native_handle(), receiveMessages.data(), RECEIVE_BATCH_SIZE,
+                                MSG_DONTWAIT, nullptr);
+
+        if (received < 0) {
+            if (errno != EAGAIN and errno != EWOULDBLOCK and errno != EINTR) {
+                logger.error("Error when receiving packets: %s.", strerror(errno));
+            }
+            break;
+        }
+
+        if (call == 0) {
+            statistics.batches++;
+        }
+
+        for (int i = 0; i < received; ++i) {
+            auto &msg = receiveMessages[i];
+
+            udp::endpoint sender;
+            std::memcpy(sender.data(), msg.msg_hdr.msg_name, msg.msg_hdr.msg_namelen);
+            sender.resize(msg.msg_hdr.msg_namelen);
+
+            if (msg.msg_hdr.msg_flags & MSG_TRUNC) {
+                logger.error("Packet from %s longer than %d bytes, dropping it.",
+                             sender.address().to_string().c_str(), MAX_PACKET_SIZE);
+                continue;
+            }
+
+            statistics.datagramsReceived++;
+            processDatagram(static_cast<char *>(receiveIovecs[i].iov_base), msg.msg_len, sender);
+        }
+
+        if (received < static_cast<int>(RECEIVE_BATCH_SIZE)) {
+            break;
+        }
+    }
 
-                    long id = reqQueuer->addRequest(msg, recvSenderEndpoint.address());
+    reportStatistics();
+}
 
-                    if (id != INVALID_MESSAGE) {
-                        logger.debug("Adding key %ld to senders map.", id);
+void processing::NetServer::processDatagram(char *data, std::size_t length, const udp::endpoint &sender) {
+    // formatting the address allocates, so it's skipped on the hot path unless it's logged
+    if (logger.isInfoEnabled()) {
+        logger.info("Received %zu bytes from %s.", length, sender.address().to_string().c_str());
+    }
 
-                        sendersMap[id] = recvSenderEndpoint;
+    if (logger.isDebugEnabled()) {
+        logger.debug(string("Received data: ") + string(data, length));
+    }
 
-                        logger.debug("Senders map contains now %d keys.", sendersMap.size());
-                    }
+    // the endpoint has to be stored before the request is visible to the executor thread
+    long id = routingTable.reserve(sender);
 
-                    namespace ph = std::placeholders;
-                    reqQueuer->setResponseSender(
-                            bind(&NetServer::sendResponse, this, ph::_1, ph::_2, ph::_3));
-                    reqQueuer->setRejectedRequestRemover(
-                            bind(&NetServer::removeFromRequestMap, this, ph::_1));
-                } else {
-                    logger.error("Error when receiving packet (%u bytes): %s.", bytes_recvd,
-                                 ec.message().c_str());
-                }
-                doReceive();
-            });
+    if (id < 0) {
+        logger.warn("All %u response routes are in use, dropping request from %s.",
+                    routingTable.getCapacity(), sender.address().to_string().c_str());
+
+        // the emergency stop doesn't need the response
+        reqQueuer->addRequest(data, length, sender, NO_RESPONSE_ROUTE);
+        return;
+    }
+
+    if (reqQueuer->addRequest(data, length, sender, id) == INVALID_MESSAGE) {
+        routingTable.release(id);
+    }
+}
+
+void processing::NetServer::reportStatistics() {
+    auto now = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - lastReportTime).count();
+
+    if (elapsed < STATISTICS_REPORT_INTERVAL_SECONDS * 1000) {
+        return;
+    }
+
+    // the handler runs in the io_context thread, so its CPU time is the cost of the network handling
+    rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    double cpuTimeMs = usage.ru_utime.tv_sec * 1e3 + usage.ru_utime.tv_usec / 1e3
+                       + usage.ru_stime.tv_sec * 1e3 + usage.ru_stime.tv_usec / 1e3;
+
+    unsigned long datagrams = statistics.datagramsReceived - lastReportedStatistics.datagramsReceived;
+    unsigned long batches = statistics.batches - lastReportedStatistics.batches;
+
+    logger.notice("Received %.0f packets/s, %.1f packets per wake-up, network thread CPU load %.1f%%.",
+                  datagrams * 1000.0 / elapsed,
+                  batches > 0 ? static_cast<double>(datagrams) / batches : 0.0,
+                  (cpuTimeMs - lastReportCpuTimeMs) * 100.0 / elapsed);
+
+    lastReportedStatistics = statistics;
+    lastReportTime = now;
+    lastReportCpuTimeMs = cpuTimeMs;
 }
 
 void processing::NetServer::sendResponse(long id, std::string response, bool transmit) {
-    const auto senderEndpoint = sendersMap.find(id);
+    // called from the executor thread
+    udp::endpoint endpoint;
 
-    //TODO tu się wyrżnęło  senders map doesn't contain key: 22351.
-    //TODO wywala się, jak zalewa się pakietami z instrukcją - wywalić wait w doInBackground controlUpdater w cliencie
-    if (senderEndpoint == sendersMap.end()) {
-        throw NetException((format("senders map doesn't contain key: %ld.") % id).str());
+    if (not routingTable.release(id, endpoint)) {
+        logger.error("No route for the response to request %ld.", id);
+        return;
     }
 
     if (transmit == true) {
-        udp::endpoint endpoint = senderEndpoint->second;
-
         unsigned int responseLength = response.length();
 
         logger.info("Sending response (length %d) to %s.",
@@ -113,29 +271,21 @@ void processing::NetServer::sendResponse(long id, std::string response, bool tra
 
         logger.debug(string("Sending data: ") + response);
 
-        udpSocket->async_send_to(asio::buffer(response), endpoint,
-                                 [responseLength](system::error_code ec, size_t bytes_sent) {
-                                     if (ec) {
-                                         throw NetException("error when sending response: " + ec.message());
-                                     }
-                                     if (bytes_sent != responseLength) {
-                                         throw NetException(
-                                                 (format("wrong amount of data sent: %u instead of %u") % bytes_sent %
-                                                  responseLength).str());
-                                     }
-                                 });
-    }
+        // the asio socket object is used by the io_context thread, only its descriptor is used here
+        ssize_t bytesSent = sendDatagram(udpSocket->native_handle(), response, endpoint);
 
-    removeFromRequestMap(id);
+        if (bytesSent < 0) {
+            logger.error("Error when sending response: %s.", strerror(errno));
+        } else if (static_cast<size_t>(bytesSent) != responseLength) {
+            logger.error("Wrong amount of data sent: %u instead of %u.",
+                         static_cast<unsigned int>(bytesSent), responseLength);
+        }
+    }
 }
 
-void processing::NetServer::removeFromRequestMap(long id) {
-    post(ioServiceProvider->getIoContext(),
-        [id, this]() {
-        logger.debug("Removing key %ld from senders map.", id);
-        sendersMap.erase(id);
-        logger.debug("Senders map contains now %d keys.", sendersMap.size());
-    });
+void processing::NetServer::removeRejectedRequest(long id) {
+    logger.debug("Removing route of rejected request %ld.", id);
+    routingTable.release(id);
 }
 
 processing::NetServer::~NetServer() {
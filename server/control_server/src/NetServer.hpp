@@ -3,18 +3,29 @@
 #include "RequestQueuer.hpp"
 #include "Configuration.hpp"
 #include "IoServiceProvider.hpp"
+#include "ResponseRoutingTable.hpp"
 
 #include <log4cpp/Category.hh>
 #include <wallaroo/registered.h>
 #include <boost/asio.hpp>
 
+#include <sys/socket.h>
+
 #include <string>
 #include <memory>
-#include <unordered_map>
+#include <vector>
+#include <chrono>
 #include <stdexcept>
 
 namespace processing {
 
+    /**
+     * Every session of RequestQueuer can fill its queue, the pooled requests cover the executed one
+     * and the ones being replaced.
+     */
+    constexpr unsigned int ROUTING_TABLE_CAPACITY = MAX_NUMBER_OF_SESSIONS * REQUEST_QUEUE_MAX_SIZE
+                                                    + REQUEST_POOL_SIZE;
+
     class NetException : public std::runtime_error {
     public:
         NetException(const std::string &message)
@@ -22,10 +33,21 @@ namespace processing {
         }
     };
 
+    struct ReceiveStatistics {
+        unsigned long datagramsReceived = 0;
+        /**
+         * Number of wake-ups of the event loop which brought at least one datagram.
+         */
+        unsigned long batches = 0;
+        unsigned long syscalls = 0;
+    };
+
     class INetServer {
     public:
         virtual void sendResponse(long id, std::string response, bool transmit) = 0;
 
+        virtual ReceiveStatistics getReceiveStatistics() = 0;
+
         virtual ~INetServer() = default;
     };
 
@@ -37,6 +59,10 @@ namespace processing {
 
         virtual void sendResponse(long id, std::string response, bool transmit);
 
+        virtual ReceiveStatistics getReceiveStatistics() {
+            return statistics;
+        }
+
         virtual ~NetServer();
 
     private:
@@ -47,19 +73,40 @@ namespace processing {
         wallaroo::Collaborator<common::IoServiceProvider> ioServiceProvider;
 
         std::unique_ptr<boost::asio::ip::udp::socket> udpSocket;
-        boost::asio::ip::udp::endpoint recvSenderEndpoint;
 
-        std::unordered_map<long, boost::asio::ip::udp::endpoint> sendersMap;
+        /**
+         * Endpoints of the clients waiting for the response, indexed by the request internal id.
+         * Written by the network thread, released by the executor thread.
+         */
+        ResponseRoutingTable routingTable;
 
         unsigned int udpPort;
 
-        std::unique_ptr<char> buff;
+        /**
+         * Receive ring: one slot of MAX_PACKET_SIZE per datagram of the recvmmsg() batch.
+         * Everything is allocated once, in Init().
+         */
+        std::unique_ptr<char[]> receiveBuffers;
+        std::vector<mmsghdr> receiveMessages;
+        std::vector<iovec> receiveIovecs;
+        std::vector<sockaddr_storage> receiveAddresses;
+
+        ReceiveStatistics statistics;
+        ReceiveStatistics lastReportedStatistics;
+        std::chrono::steady_clock::time_point lastReportTime;
+        double lastReportCpuTimeMs = 0;
 
         void Init();
 
         void doReceive();
 
-        void removeFromRequestMap(long id);
+        void receiveBatches();
+
+        void processDatagram(char *data, std::size_t length, const boost::asio::ip::udp::endpoint &sender);
+
+        void reportStatistics();
+
+        void removeRejectedRequest(long id);
     };
 
 } /* namespace processing */
@@ -15,30 +15,26 @@ os::OSInformationProcessor::~OSInformationProcessor() {
     logger.notice("Instance destroyed.");
 }
 
-void OSInformationProcessor::process(processing::Request &req, minijson::object_writer &response) {
+void OSInformationProcessor::process(processing::Request &req, processing::Report &report) {
 
     logger.info("Processing request.");
 
+    report.wifiPresent = true;
+
     try {
-        auto linkParams = wifiInfo->getWifiLinkParams(req.ipAddress);
+        auto linkParams = wifiInfo->getWifiLinkParams(req.client.address());
 
-        auto wifiWriter = response.nested_object("w");
-        wifiWriter.write("s", linkParams.getSignalStrength());
-        wifiWriter.write("txb", linkParams.getTxBitrate());
-        wifiWriter.write("rxb", linkParams.getRxBitrate());
-        wifiWriter.close();
+        report.wifi.signalStrength = linkParams.getSignalStrength();
+        report.wifi.txBitrate = linkParams.getTxBitrate();
+        report.wifi.rxBitrate = linkParams.getRxBitrate();
 
         logger.info("Wi-Fi params for %s: %2.0f dBm",
-                    req.ipAddress.to_string().c_str(), linkParams.getSignalStrength());
+                    req.client.address().to_string().c_str(), linkParams.getSignalStrength());
         //TODO add isEnabled to WifiInfo
     } catch (WifiException &e) {
         logger.info("Error reading Wi-Fi information: %s.", e.what());
 
-        auto wifiWriter = response.nested_object("w");
-        wifiWriter.write("txb", 0);
-        wifiWriter.write("rxb", 0);
-        wifiWriter.write("s", 0);
-        wifiWriter.close();
+        report.wifi = processing::WifiReport();
     }
 }
 
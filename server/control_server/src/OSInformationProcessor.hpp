@@ -4,8 +4,6 @@
 #include "IRequestProcessor.hpp"
 #include "WifiInfo.hpp"
 
-#include <minijson_writer.hpp>
-
 namespace os {
     class OSInformationProcessor : public processing::IRequestProcessor, public wallaroo::Part {
     public:
@@ -13,7 +11,7 @@ namespace os {
 
         ~OSInformationProcessor();
 
-        virtual void process(processing::Request &req, minijson::object_writer &response);
+        virtual void process(processing::Request &req, processing::Report &report);
 
     private:
         log4cpp::Category &logger;
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Interface.hpp"
+
+#include <cstdint>
+
+namespace processing {
+
+    enum class KillSwitchStatus : uint8_t {
+        INACTIVE, SOFTWARE, HARDWARE
+    };
+
+    struct MotorReport {
+        unsigned int speed = 0;
+        common::bridge::Direction direction = common::bridge::Direction::STOP;
+    };
+
+    struct JointReport {
+        unsigned int speed = 0;
+        unsigned int position = 0;
+        common::bridge::Direction direction = common::bridge::Direction::STOP;
+    };
+
+    struct BridgeReport {
+        bool lightRight = false;
+        bool lightLeft = false;
+        bool lightCamera = false;
+
+        MotorReport leftMotor;
+        MotorReport rightMotor;
+
+        JointReport shoulder;
+        JointReport elbow;
+        JointReport gripper;
+        common::bridge::ArmCalibrationStatus calibrationStatus = common::bridge::ArmCalibrationStatus::NONE;
+        common::bridge::ArmDriverMode armMode = common::bridge::ArmDriverMode::DIRECTIONAL;
+
+        bool buttonUp = false;
+        bool buttonDown = false;
+        bool buttonEnter = false;
+
+        double voltage = 0;
+        double current = 0;
+
+        KillSwitchStatus killSwitch = KillSwitchStatus::INACTIVE;
+    };
+
+    struct WifiReport {
+        double signalStrength = 0;
+        double txBitrate = 0;
+        double rxBitrate = 0;
+    };
+
+    /**
+     * State gathered by the processors, each one fills its part and sets the flag. The report is encoded
+     * in the protocol of the request by the queuer.
+     */
+    struct Report {
+        bool bridgePresent = false;
+        BridgeReport bridge;
+        /**
+         * Interface state version the bridge report was created from, 0 if not known.
+         */
+        uint64_t bridgeStateVersion = 0;
+
+        bool wifiPresent = false;
+        WifiReport wifi;
+    };
+}
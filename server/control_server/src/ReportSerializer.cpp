@@ -0,0 +1,397 @@
+#include "ReportSerializer.hpp"
+#include "convert.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+using namespace processing;
+using namespace common::bridge;
+
+namespace processing {
+
+    constexpr unsigned int REPORT_BOOL_WIDTH = 5;
+
+    /**
+     * The speeds and positions are 8 or 16-bit values.
+     */
+    constexpr unsigned int REPORT_UNSIGNED_WIDTH = 5;
+    constexpr unsigned int REPORT_UNSIGNED_MAX = 99999;
+
+    constexpr unsigned int REPORT_FIXED_POINT_WIDTH = 9;
+    constexpr double REPORT_FIXED_POINT_MAX = 99999.99;
+
+    /**
+     * ["u","d","e"]
+     */
+    constexpr unsigned int REPORT_BUTTONS_WIDTH = 13;
+
+    static const string &killSwitchStatusToString(KillSwitchStatus status) {
+        static const string text[] = {
+                "inactive",
+                "software",
+                "hardware"
+        };
+
+        return text[static_cast<int>(status)];
+    }
+
+    static unsigned int maxQuotedLength(std::initializer_list<const string *> texts) {
+        unsigned int length = 0;
+        for (auto t : texts) {
+            length = std::max<unsigned int>(length, t->size());
+        }
+        return length + 2;
+    }
+
+    static void writeLeftAligned(char *dest, unsigned int width, const char *text, unsigned int length) {
+        std::memcpy(dest, text, length);
+        std::memset(dest + length, ' ', width - length);
+    }
+
+    static void writeRightAligned(char *dest, unsigned int width, const char *text, unsigned int length) {
+        std::memset(dest, ' ', width - length);
+        std::memcpy(dest + width - length, text, length);
+    }
+
+    static void writeQuoted(char *dest, unsigned int width, const string &text) {
+        dest[0] = '"';
+        std::memcpy(dest + 1, text.data(), text.size());
+        dest[text.size() + 1] = '"';
+        std::memset(dest + text.size() + 2, ' ', width - text.size() - 2);
+    }
+
+    static void writeUnsigned(char *dest, unsigned int width, unsigned int value) {
+        value = std::min(value, REPORT_UNSIGNED_MAX);
+
+        char digits[REPORT_UNSIGNED_WIDTH];
+        unsigned int length = 0;
+
+        do {
+            digits[REPORT_UNSIGNED_WIDTH - 1 - length] = '0' + value % 10;
+            value /= 10;
+            length++;
+        } while (value > 0);
+
+        writeRightAligned(dest, width, digits + REPORT_UNSIGNED_WIDTH - length, length);
+    }
+
+    static void writeFixedPoint(char *dest, unsigned int width, double value) {
+        if (not std::isfinite(value)) {
+            value = 0;
+        }
+
+        value = std::max(std::min(value, REPORT_FIXED_POINT_MAX), -REPORT_FIXED_POINT_MAX);
+
+        char text[32];
+        int length = std::snprintf(text, sizeof(text), "%.2f", value);
+
+        writeRightAligned(dest, width, text, length);
+    }
+}
+
+processing::ReportSerializer::ReportSerializer() {
+    for (unsigned int i = 0; i < templates.size(); ++i) {
+        buildTemplate(templates[i], i & 1, i & 2);
+
+        if (templates[i].text.size() > REPORT_MAX_LENGTH) {
+            throw std::logic_error("report longer than REPORT_MAX_LENGTH");
+        }
+    }
+}
+
+std::size_t processing::ReportSerializer::serialize(const Report &report, char *buffer, std::size_t capacity) {
+    Template &t = templates[getLayout(report)];
+
+    if (t.text.size() > capacity) {
+        throw std::length_error("buffer too small for the report");
+    }
+
+    bool bridgeChanged = report.bridgeStateVersion == 0 or report.bridgeStateVersion != t.bridgeStateVersion;
+
+    for (auto &slot : t.slots) {
+        if (bridgeChanged or not slot.bridgePart) {
+            patchSlot(t.text.data(), slot, report);
+        }
+    }
+
+    t.bridgeStateVersion = report.bridgeStateVersion;
+
+    std::memcpy(buffer, t.text.data(), t.text.size());
+
+    return t.text.size();
+}
+
+std::size_t processing::ReportSerializer::writeDelta(unsigned int layout, const char *text, const char *baseText,
+                                                    char *buffer, std::size_t capacity) {
+    const Template &t = templates[layout];
+
+    // the delta is the full report without the padding at most
+    if (t.text.size() > capacity) {
+        throw std::length_error("buffer too small for the report");
+    }
+
+    char *dest = buffer;
+    const Slot *previous = nullptr;
+    unsigned int openObjects = 0;
+
+    for (auto &slot : t.slots) {
+        if (std::memcmp(text + slot.offset, baseText + slot.offset, slot.width) == 0) {
+            continue;
+        }
+
+        // the objects shared with the previous value stay open, the rest are closed
+        unsigned int shared = 0;
+
+        if (previous != nullptr) {
+            while (shared < openObjects and shared + 1 < slot.depth
+                   and std::strcmp(previous->path[shared], slot.path[shared]) == 0) {
+                shared++;
+            }
+
+            for (unsigned int i = shared; i < openObjects; ++i) {
+                *dest++ = '}';
+            }
+
+            *dest++ = ',';
+        }
+
+        for (unsigned int i = shared; i < slot.depth; ++i) {
+            if (i > shared) {
+                *dest++ = '{';
+            }
+
+            unsigned int keyLength = std::strlen(slot.path[i]);
+            *dest++ = '"';
+            std::memcpy(dest, slot.path[i], keyLength);
+            dest += keyLength;
+            *dest++ = '"';
+            *dest++ = ':';
+        }
+
+        const char *value = text + slot.offset;
+        unsigned int valueLength = slot.width;
+
+        while (valueLength > 0 and value[0] == ' ') {
+            value++;
+            valueLength--;
+        }
+
+        while (valueLength > 0 and value[valueLength - 1] == ' ') {
+            valueLength--;
+        }
+
+        std::memcpy(dest, value, valueLength);
+        dest += valueLength;
+
+        previous = &slot;
+        openObjects = slot.depth - 1;
+    }
+
+    for (unsigned int i = 0; i < openObjects; ++i) {
+        *dest++ = '}';
+    }
+
+    return dest - buffer;
+}
+
+void processing::ReportSerializer::buildTemplate(Template &t, bool bridgePresent, bool wifiPresent) {
+    if (bridgePresent) {
+        appendBridgeReport(t);
+    }
+
+    if (bridgePresent and wifiPresent) {
+        appendText(t, ",");
+    }
+
+    if (wifiPresent) {
+        appendWifiReport(t);
+    }
+}
+
+void processing::ReportSerializer::appendBridgeReport(Template &t) {
+    const BridgeReport &b = prototype.bridge;
+
+    auto slot = [&](SlotType type, const void *field, std::initializer_list<const char *> path) {
+        appendSlot(t, type, field, true, path);
+    };
+
+    appendText(t, R"("e":{"r":)");
+    slot(SlotType::BOOL, &b.lightRight, {"e", "r"});
+    appendText(t, R"(,"l":)");
+    slot(SlotType::BOOL, &b.lightLeft, {"e", "l"});
+    appendText(t, R"(,"cam":)");
+    slot(SlotType::BOOL, &b.lightCamera, {"e", "cam"});
+
+    auto motor = [&](const char *name, const MotorReport &m) {
+        appendText(t, name);
+        appendText(t, R"(":{"s":)");
+        slot(SlotType::UNSIGNED, &m.speed, {"m", name, "s"});
+        appendText(t, R"(,"d":)");
+        slot(SlotType::DIRECTION, &m.direction, {"m", name, "d"});
+        appendText(t, "}");
+    };
+
+    appendText(t, R"(},"m":{")");
+    motor("l", b.leftMotor);
+    appendText(t, R"(,")");
+    motor("r", b.rightMotor);
+
+    auto joint = [&](const char *name, const JointReport &j) {
+        appendText(t, name);
+        appendText(t, R"(":{"s":)");
+        slot(SlotType::UNSIGNED, &j.speed, {"a", name, "s"});
+        appendText(t, R"(,"p":)");
+        slot(SlotType::UNSIGNED, &j.position, {"a", name, "p"});
+        appendText(t, R"(,"d":)");
+        slot(SlotType::DIRECTION, &j.direction, {"a", name, "d"});
+        appendText(t, "}");
+    };
+
+    appendText(t, R"(},"a":{")");
+    joint("s", b.shoulder);
+    appendText(t, R"(,")");
+    joint("e", b.elbow);
+    appendText(t, R"(,")");
+    joint("g", b.gripper);
+    appendText(t, R"(,"cal_st":)");
+    slot(SlotType::CALIBRATION_STATUS, &b.calibrationStatus, {"a", "cal_st"});
+    appendText(t, R"(,"mode":)");
+    slot(SlotType::ARM_MODE, &b.armMode, {"a", "mode"});
+
+    appendText(t, R"(},"btn":)");
+    slot(SlotType::BUTTONS, &b, {"btn"});
+
+    appendText(t, R"(,"b":{"u":)");
+    slot(SlotType::FIXED_POINT, &b.voltage, {"b", "u"});
+    appendText(t, R"(,"i":)");
+    slot(SlotType::FIXED_POINT, &b.current, {"b", "i"});
+
+    appendText(t, R"(},"ks_stat":)");
+    slot(SlotType::KILL_SWITCH, &b.killSwitch, {"ks_stat"});
+}
+
+void processing::ReportSerializer::appendWifiReport(Template &t) {
+    const WifiReport &w = prototype.wifi;
+
+    appendText(t, R"("w":{"s":)");
+    appendSlot(t, SlotType::FIXED_POINT, &w.signalStrength, false, {"w", "s"});
+    appendText(t, R"(,"txb":)");
+    appendSlot(t, SlotType::FIXED_POINT, &w.txBitrate, false, {"w", "txb"});
+    appendText(t, R"(,"rxb":)");
+    appendSlot(t, SlotType::FIXED_POINT, &w.rxBitrate, false, {"w", "rxb"});
+    appendText(t, "}");
+}
+
+void processing::ReportSerializer::appendText(Template &t, const char *text) {
+    t.text.insert(t.text.end(), text, text + std::strlen(text));
+}
+
+void processing::ReportSerializer::appendSlot(Template &t, SlotType type, const void *field, bool bridgePart,
+                                              std::initializer_list<const char *> path) {
+    unsigned int width = 0;
+
+    switch (type) {
+        case SlotType::BOOL:
+            width = REPORT_BOOL_WIDTH;
+            break;
+        case SlotType::UNSIGNED:
+            width = REPORT_UNSIGNED_WIDTH;
+            break;
+        case SlotType::FIXED_POINT:
+            width = REPORT_FIXED_POINT_WIDTH;
+            break;
+        case SlotType::DIRECTION:
+            width = maxQuotedLength({&directionToString(Direction::STOP),
+                                     &directionToString(Direction::FORWARD),
+                                     &directionToString(Direction::BACKWARD)});
+            break;
+        case SlotType::CALIBRATION_STATUS:
+            width = maxQuotedLength({&armCalibrationStatusToString(ArmCalibrationStatus::NONE),
+                                     &armCalibrationStatusToString(ArmCalibrationStatus::IN_PROGRESS),
+                                     &armCalibrationStatusToString(ArmCalibrationStatus::DONE)});
+            break;
+        case SlotType::ARM_MODE:
+            width = maxQuotedLength({&armDriverModeToString(ArmDriverMode::DIRECTIONAL),
+                                     &armDriverModeToString(ArmDriverMode::POSITIONAL),
+                                     &armDriverModeToString(ArmDriverMode::CALIBRATING)});
+            break;
+        case SlotType::BUTTONS:
+            width = REPORT_BUTTONS_WIDTH;
+            break;
+        case SlotType::KILL_SWITCH:
+            width = maxQuotedLength({&killSwitchStatusToString(KillSwitchStatus::INACTIVE),
+                                     &killSwitchStatusToString(KillSwitchStatus::SOFTWARE),
+                                     &killSwitchStatusToString(KillSwitchStatus::HARDWARE)});
+            break;
+    }
+
+    std::size_t fieldOffset = reinterpret_cast<const char *>(field) - reinterpret_cast<const char *>(&prototype);
+
+    Slot slot = {type, static_cast<unsigned int>(t.text.size()), width, fieldOffset, bridgePart};
+    slot.depth = std::min<unsigned int>(path.size(), REPORT_PATH_MAX_DEPTH);
+    std::copy(path.begin(), path.begin() + slot.depth, slot.path.begin());
+
+    t.slots.push_back(slot);
+    t.text.insert(t.text.end(), width, ' ');
+}
+
+void processing::ReportSerializer::patchSlot(char *text, const Slot &slot, const Report &report) {
+    char *dest = text + slot.offset;
+    const char *field = reinterpret_cast<const char *>(&report) + slot.fieldOffset;
+
+    switch (slot.type) {
+        case SlotType::BOOL:
+            if (*reinterpret_cast<const bool *>(field)) {
+                writeLeftAligned(dest, slot.width, "true", 4);
+            } else {
+                writeLeftAligned(dest, slot.width, "false", 5);
+            }
+            break;
+        case SlotType::UNSIGNED:
+            writeUnsigned(dest, slot.width, *reinterpret_cast<const unsigned int *>(field));
+            break;
+        case SlotType::FIXED_POINT:
+            writeFixedPoint(dest, slot.width, *reinterpret_cast<const double *>(field));
+            break;
+        case SlotType::DIRECTION:
+            writeQuoted(dest, slot.width, directionToString(*reinterpret_cast<const Direction *>(field)));
+            break;
+        case SlotType::CALIBRATION_STATUS:
+            writeQuoted(dest, slot.width,
+                        armCalibrationStatusToString(*reinterpret_cast<const ArmCalibrationStatus *>(field)));
+            break;
+        case SlotType::ARM_MODE:
+            writeQuoted(dest, slot.width, armDriverModeToString(*reinterpret_cast<const ArmDriverMode *>(field)));
+            break;
+        case SlotType::BUTTONS: {
+            auto &bridge = *reinterpret_cast<const BridgeReport *>(field);
+            char buttons[REPORT_BUTTONS_WIDTH];
+            unsigned int length = 0;
+
+            buttons[length++] = '[';
+            for (auto b : {make_pair(bridge.buttonUp, 'u'),
+                           make_pair(bridge.buttonDown, 'd'),
+                           make_pair(bridge.buttonEnter, 'e')}) {
+                if (b.first) {
+                    if (length > 1) {
+                        buttons[length++] = ',';
+                    }
+                    buttons[length++] = '"';
+                    buttons[length++] = b.second;
+                    buttons[length++] = '"';
+                }
+            }
+            buttons[length++] = ']';
+
+            writeLeftAligned(dest, slot.width, buttons, length);
+            break;
+        }
+        case SlotType::KILL_SWITCH:
+            writeQuoted(dest, slot.width, killSwitchStatusToString(*reinterpret_cast<const KillSwitchStatus *>(field)));
+            break;
+    }
+}
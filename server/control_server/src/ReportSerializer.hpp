@@ -0,0 +1,120 @@
+#pragma once
+
+#include "Report.hpp"
+
+#include <boost/noncopyable.hpp>
+
+#include <array>
+#include <initializer_list>
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+namespace processing {
+
+    /**
+     * The longest text of the report, with both parts present.
+     */
+    constexpr std::size_t REPORT_MAX_LENGTH = 512;
+
+    /**
+     * The deepest value in the report is nested in two objects, e.g. "m":{"l":{"s":...}}.
+     */
+    constexpr unsigned int REPORT_PATH_MAX_DEPTH = 3;
+
+    /**
+     * Writes the report as JSON fields. The text of the report is generated once for each combination
+     * of the present parts, with fixed-width slots for the values, padded with spaces. Serializing
+     * the report only patches the values into their slots. The bridge part isn't patched at all
+     * if the state version of the report is the same as the previous one.
+     *
+     * The delta of two serialized reports is found by comparing the text of the slots, only the changed
+     * values are written, nested in the same objects as in the full report.
+     *
+     * Serializing doesn't allocate. Not thread-safe.
+     */
+    class ReportSerializer : boost::noncopyable {
+    public:
+        ReportSerializer();
+
+        /**
+         * Writes the fields of the present parts of the report, separated by commas, without the braces.
+         * @return length of the text, 0 if no part is present
+         * @throws std::length_error if the buffer is too small
+         */
+        std::size_t serialize(const Report &report, char *buffer, std::size_t capacity);
+
+        /**
+         * Writes only the values which differ between two serialized reports. Both have to be serialized
+         * from the reports with the same layout.
+         * @param layout layout of both reports
+         * @param text the current report, serialized
+         * @param baseText the report known to the client, serialized
+         * @return length of the text, 0 if nothing changed
+         * @throws std::length_error if the buffer is too small
+         */
+        std::size_t writeDelta(unsigned int layout, const char *text, const char *baseText,
+                               char *buffer, std::size_t capacity);
+
+        /**
+         * The reports with the same parts present have the same layout, i.e. the same keys and the lengths.
+         */
+        static unsigned int getLayout(const Report &report) {
+            return (report.bridgePresent ? 1 : 0) | (report.wifiPresent ? 2 : 0);
+        }
+
+    private:
+        enum class SlotType {
+            BOOL, UNSIGNED, FIXED_POINT, DIRECTION, CALIBRATION_STATUS, ARM_MODE, BUTTONS, KILL_SWITCH
+        };
+
+        struct Slot {
+            SlotType type;
+            unsigned int offset;
+            unsigned int width;
+            /**
+             * Offset of the value in the Report struct.
+             */
+            std::size_t fieldOffset;
+            bool bridgePart;
+            /**
+             * Keys of the objects the value is nested in and the key of the value itself.
+             */
+            std::array<const char *, REPORT_PATH_MAX_DEPTH> path;
+            unsigned int depth;
+        };
+
+        struct Template {
+            std::vector<char> text;
+            std::vector<Slot> slots;
+            /**
+             * State version of the bridge report patched into the text, 0 if not known.
+             */
+            uint64_t bridgeStateVersion = 0;
+        };
+
+        /**
+         * Indexed by the combination of the present parts.
+         */
+        std::array<Template, 4> templates;
+
+        /**
+         * Only the addresses of its fields are used to compute the offsets.
+         */
+        Report prototype;
+
+        void buildTemplate(Template &t, bool bridgePresent, bool wifiPresent);
+
+        void appendBridgeReport(Template &t);
+
+        void appendWifiReport(Template &t);
+
+        void appendText(Template &t, const char *text);
+
+        void appendSlot(Template &t, SlotType type, const void *field, bool bridgePart,
+                        std::initializer_list<const char *> path);
+
+        void patchSlot(char *text, const Slot &slot, const Report &report);
+    };
+}
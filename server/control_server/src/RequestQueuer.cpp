@@ -1,4 +1,5 @@
 #include "RequestQueuer.hpp"
+#include "BinaryProtocol.hpp"
 #include "utils.hpp"
 
 #include <minijson_writer.hpp>
@@ -7,32 +8,75 @@
 #include <boost/interprocess/streams/bufferstream.hpp>
 
 #include <iomanip>
+#include <atomic>
 
 using namespace std;
 using namespace boost;
 using namespace processing;
 
-/**
-* Defines the maximum requests queue size.
-*/
-constexpr int REQUEST_QUEUE_MAX_SIZE = 100;
-
 /**
 * If true, new requests will be skipped. If false, new requests will replace older ones.
 */
 constexpr bool REQUEST_QUEUE_OVERFLOW_BEHAVIOR = false;
 
-constexpr int REQUEST_MAX_LENGTH = 1024;
-constexpr int RESPONSE_MAX_LENGTH = 512;
+constexpr int RESPONSE_MAX_LENGTH = 1024;
+
+/**
+ * Sessions without pending requests are forgotten after this time.
+ */
+constexpr int SESSION_IDLE_TIMEOUT_SECONDS = 60;
+
+constexpr int STATISTICS_REPORT_INTERVAL_SECONDS = 10;
 
 WALLAROO_REGISTER(RequestQueuer);
 
 processing::RequestQueuer::RequestQueuer()
         : logger(log4cpp::Category::getInstance("RequestQueuer")),
-          requestProcessors("requestProcessors", RegistrationToken()) {
+          config("config", RegistrationToken()),
+          requestProcessors("requestProcessors", RegistrationToken()),
+          emergencyStop("emergencyStop", RegistrationToken()) {
+
+    for (int i = 0; i < REQUEST_POOL_SIZE; ++i) {
+        std::shared_ptr<Request> request(new Request());
+        request->sendTimestamp.reserve(REQUEST_TIMESTAMP_MAX_LENGTH);
+        request->receiveTimestamp.reserve(REQUEST_TIMESTAMP_MAX_LENGTH);
+        request->session.reserve(REQUEST_SESSION_MAX_LENGTH);
+        requestPool.push_back(request);
+    }
 }
 
 void processing::RequestQueuer::Init() {
+    string policyName = config->getString("RequestQueuer.policy");
+
+    if (policyName == "latest_wins") {
+        policy = QueuePolicy::LATEST_WINS;
+    } else if (policyName == "priority_queue") {
+        policy = QueuePolicy::PRIORITY_QUEUE;
+    } else {
+        throw std::runtime_error("invalid request queue policy: " + policyName);
+    }
+
+    logger.notice("Using %s request queue policy.", policyName.c_str());
+
+    controllerSession = config->getString("RequestQueuer.controller_session");
+    controllerWeight = config->getInt("RequestQueuer.controller_weight");
+
+    if (controllerWeight < 1) {
+        throw std::runtime_error("controller weight has to be at least 1");
+    }
+
+    defaultMaxAgeMs = config->getInt("RequestQueuer.default_max_age_ms");
+
+    int keyframeInterval = config->getInt("RequestQueuer.delta_keyframe_interval");
+
+    if (keyframeInterval < 0) {
+        throw std::runtime_error("delta keyframe interval cannot be negative");
+    }
+
+    deltaKeyframeInterval = keyframeInterval;
+
+    lastReportTime = chrono::steady_clock::now();
+
     requestProcessorExecutorThread.reset(new thread(&RequestQueuer::requestProcessorExecutorThreadFunction, this));
     common::utils::setThreadName(logger, requestProcessorExecutorThread.get(), "reqProcExec");
     logger.notice("Instance created.");
@@ -52,31 +96,36 @@ processing::RequestQueuer::~RequestQueuer() {
     logger.notice("Instance destroyed.");
 }
 
-long processing::RequestQueuer::addRequest(string requestString, boost::asio::ip::address address) {
+long processing::RequestQueuer::addRequest(char *requestData,
+                                          std::size_t length,
+                                          const boost::asio::ip::udp::endpoint &client,
+                                          long internalId) {
     unique_lock<mutex> lk(requestsMutex);
 
-    logger.debug("Received request with the size of %d bytes.", requestString.length());
+    logger.debug("Received request with the size of %d bytes.", length);
 
-    if (requests.size() == REQUEST_QUEUE_MAX_SIZE and REQUEST_QUEUE_OVERFLOW_BEHAVIOR) {
-        logger.warn("Requests queue is full (%d). Skipping request.", REQUEST_QUEUE_MAX_SIZE);
-        return INVALID_MESSAGE;
-    }
-
-    std::shared_ptr<Request> request(new Request());
+    auto request = acquireRequest();
+    request->receiveTime = chrono::steady_clock::now();
+    request->maxAgeMs = defaultMaxAgeMs;
 
     try {
-        minijson::const_buffer_context ctx(requestString.c_str(), requestString.size());
-        minijson::parse_object(ctx, [&](const char *k, minijson::value v) {
-            minijson::dispatch(k)
-            << "serial" >> [&] { request->serial = v.as_long(); }
-            << "skip_response" >> [&] { request->skipResponse = v.as_bool(); }
-            << "tss" >> [&] { request->sendTimestamp = v.as_string(); }
-
-            << minijson::any >> [&] { minijson::ignore(ctx); };
-        });
+        decoder.decode(requestData, length, *request);
     } catch (minijson::parse_error &e) {
         logger.error("Received request is not valid JSON document: %s.", e.what());
         return INVALID_MESSAGE;
+    } catch (BinaryProtocolException &e) {
+        logger.error("Received binary request is invalid: %s.", e.what());
+        return INVALID_MESSAGE;
+    }
+
+    // the robot is stopped even if the request itself turns out to be invalid or too old
+    if (request->command.killSwitch.present and request->command.killSwitch.value) {
+        stopImmediately();
+    }
+
+    if (internalId == NO_RESPONSE_ROUTE) {
+        logger.warn("No route for the response to request from %s. Skipping.", client.address().to_string().c_str());
+        return INVALID_MESSAGE;
     }
 
     if (request->serial < 0) {
@@ -84,57 +133,403 @@ long processing::RequestQueuer::addRequest(string requestString, boost::asio::ip
         return INVALID_MESSAGE;
     }
 
-    if (request->serial != 0 and request->serial <= lastSerial) {
+    Session *session = findSession({client, request->session});
+
+    if (session == nullptr) {
+        logger.warn("Too many sessions (%d). Skipping request from %s.", MAX_NUMBER_OF_SESSIONS,
+                    client.address().to_string().c_str());
+        return INVALID_MESSAGE;
+    }
+
+    if (request->serial != 0 and request->serial <= session->lastSerial) {
         logger.warn("Request has too old serial (%d). Skipping.", request->serial);
         return INVALID_MESSAGE;
     }
 
-    request->receiveTimestamp = common::utils::getTimestamp();
+    request->receiveTimestamp.assign(common::utils::getTimestamp());
 
-    if (requests.size() == REQUEST_QUEUE_MAX_SIZE) {
-        logger.warn("Requests queue is full (%d). removing the oldest one.", REQUEST_QUEUE_MAX_SIZE);
+    if (request->serial == 0) {
+        logger.notice("Request has the serial = 0, resetting counter and clearing queue of the session.");
+        clearSession(*session);
+    }
+
+    request->internalId = internalId == AUTOMATIC_INTERNAL_ID ? nextId() : internalId;
+    request->client = client;
+
+    session->lastActivity = request->receiveTime;
 
-        auto toppedRequest = requests.top();
+    bool added = policy == QueuePolicy::LATEST_WINS
+                 ? putToMailbox(*session, request)
+                 : pushToQueue(*session, request);
+
+    if (not added) {
+        return INVALID_MESSAGE;
+    }
+
+    cv.notify_one();
+
+    return request->internalId;
+}
+
+/**
+ * @return the session or nullptr if there are too many sessions to create the new one.
+ */
+Session *processing::RequestQueuer::findSession(const SessionKey &key) {
+    auto it = sessions.find(key);
+
+    if (it != sessions.end()) {
+        return &it->second;
+    }
 
-        requests.pop();
+    removeIdleSessions();
 
-        if (rejectedRequestRemover == nullptr) {
-            logger.error("Cannot remove rejected request. No RejectedRequestRemover set.");
+    if (sessions.size() >= MAX_NUMBER_OF_SESSIONS) {
+        return nullptr;
+    }
+
+    Session &session = sessions[key];
+
+    if (not controllerSession.empty() and key.token == controllerSession) {
+        session.weight = controllerWeight;
+    }
+
+    logger.notice("New session '%s' of %s:%d with weight %d. Number of sessions: %d.", key.token.c_str(),
+                  key.client.address().to_string().c_str(), key.client.port(), session.weight, sessions.size());
+
+    return &session;
+}
+
+void processing::RequestQueuer::removeIdleSessions() {
+    auto now = chrono::steady_clock::now();
+
+    for (auto it = sessions.begin(); it != sessions.end();) {
+        if (it->second.getNumOfPending() == 0
+            and now - it->second.lastActivity > chrono::seconds(SESSION_IDLE_TIMEOUT_SECONDS)) {
+
+            logger.notice("Session '%s' of %s:%d expired.", it->first.token.c_str(),
+                          it->first.client.address().to_string().c_str(), it->first.client.port());
+            it = sessions.erase(it);
         } else {
-            rejectedRequestRemover(toppedRequest->internalId);
+            ++it;
         }
     }
+}
 
-    if (request->serial == 0) {
-        logger.notice("Request has the serial = 0, resetting counter and clearing queue.");
-        for (unsigned int i = 0; i < requests.size(); ++i) {
-            requests.pop();
+void processing::RequestQueuer::clearSession(Session &session) {
+    rejectPendingRequests(session);
+    session.lastSerial = 0;
+}
+
+/**
+ * @return number of the rejected requests
+ */
+unsigned int processing::RequestQueuer::rejectPendingRequests(Session &session) {
+    unsigned int pending = session.getNumOfPending();
+    pendingRequestsCount -= pending;
+
+    while (not session.requests.empty()) {
+        rejectRequest(session.requests.top());
+        session.requests.pop();
+    }
+
+    if (session.mailbox) {
+        rejectRequest(session.mailbox);
+        session.mailbox.reset();
+    }
+
+    session.currentWeight = 0;
+
+    return pending;
+}
+
+/**
+ * Sends the kill switch to the device at once and drops the pending requests of all sessions,
+ * so no drive command queued before the kill switch is executed after it. Must be called with the lock held.
+ */
+void processing::RequestQueuer::stopImmediately() {
+    std::shared_ptr<IEmergencyStop> stop = emergencyStop;
+
+    if (stop) {
+        stop->activateKillSwitch();
+    }
+
+    unsigned int preempted = 0;
+
+    for (auto &s : sessions) {
+        preempted += rejectPendingRequests(s.second);
+    }
+
+    preemptedRequestsCount += preempted;
+
+    logger.warn("Kill switch request received, %u pending requests dropped.", preempted);
+}
+
+/**
+ * @return false if the queue of the session is full and new requests are skipped.
+ */
+bool processing::RequestQueuer::pushToQueue(Session &session, const std::shared_ptr<Request> &request) {
+    if (session.requests.size() == REQUEST_QUEUE_MAX_SIZE) {
+        if (REQUEST_QUEUE_OVERFLOW_BEHAVIOR) {
+            logger.warn("Requests queue is full (%d). Skipping request.", REQUEST_QUEUE_MAX_SIZE);
+            return false;
         }
-        lastSerial = 0;
+
+        logger.warn("Requests queue is full (%d). removing the oldest one.", REQUEST_QUEUE_MAX_SIZE);
+
+        rejectRequest(session.requests.top());
+        session.requests.pop();
+        pendingRequestsCount--;
     }
 
-    request->internalId = nextId();
-    request->ipAddress = address;
-    request->reqJson = requestString;
+    session.requests.push(request);
+    pendingRequestsCount++;
 
-    requests.push(request);
+    logger.info("Pushed request with the serial %d. Queue size: %d.", request->serial, session.requests.size());
 
-    logger.info("Pushed request with the serial %d. Queue size: %d.", request->serial, requests.size());
+    return true;
+}
 
-    cv.notify_one();
+/**
+ * @return false if the client has already sent newer request which is still waiting.
+ */
+bool processing::RequestQueuer::putToMailbox(Session &session, const std::shared_ptr<Request> &request) {
+    auto &slot = session.mailbox;
+
+    if (slot) {
+        if (request->serial != 0 and slot->serial > request->serial) {
+            logger.warn("Request with serial %d came after the newer one (%d). Skipping.",
+                        request->serial, slot->serial);
+            return false;
+        }
 
-    return request->internalId;
+        supersededRequestsCount++;
+        logger.info("Request with serial %d superseded by %d before execution. %lu requests superseded so far.",
+                    slot->serial, request->serial, supersededRequestsCount);
+
+        rejectRequest(slot);
+    } else {
+        pendingRequestsCount++;
+    }
+
+    slot = request;
+
+    logger.info("Put request with the serial %d to the mailbox of %s.", request->serial,
+                request->client.address().to_string().c_str());
+
+    return true;
+}
+
+bool processing::RequestQueuer::hasPendingRequests() {
+    return pendingRequestsCount > 0;
+}
+
+/**
+ * Must be called with the lock held and only if hasPendingRequests() returns true.
+ * @param session set to the session of the returned request, valid only while the lock is held
+ */
+std::shared_ptr<Request> processing::RequestQueuer::takeNextRequest(Session *&session) {
+    // smooth weighted round robin: the session with the highest current weight is served and its
+    // current weight is lowered by the sum of the weights, so the turns are interleaved
+    Session *selected = nullptr;
+    int totalWeight = 0;
+
+    for (auto &s : sessions) {
+        Session &candidate = s.second;
+
+        if (candidate.getNumOfPending() == 0) {
+            continue;
+        }
+
+        candidate.currentWeight += candidate.weight;
+        totalWeight += candidate.weight;
+
+        if (selected == nullptr or candidate.currentWeight > selected->currentWeight) {
+            selected = &candidate;
+        }
+    }
+
+    selected->currentWeight -= totalWeight;
+
+    std::shared_ptr<Request> request;
+
+    if (selected->mailbox) {
+        request.swap(selected->mailbox);
+    } else {
+        request = selected->requests.top();
+        selected->requests.pop();
+    }
+
+    pendingRequestsCount--;
+
+    if (selected->getNumOfPending() == 0) {
+        selected->currentWeight = 0;
+    }
+
+    session = selected;
+    return request;
 }
 
 int processing::RequestQueuer::getNumOfMessages() {
     unique_lock<mutex> lk(requestsMutex);
-    return requests.size();
+    return pendingRequestsCount;
+}
+
+int processing::RequestQueuer::getNumOfSessions() {
+    unique_lock<mutex> lk(requestsMutex);
+    return sessions.size();
+}
+
+LatencyHistogram processing::RequestQueuer::getQueueWaitHistogram() {
+    unique_lock<mutex> lk(requestsMutex);
+    return queueWaitHistogram;
+}
+
+unsigned long processing::RequestQueuer::getExpiredRequestsCount() {
+    unique_lock<mutex> lk(requestsMutex);
+    return expiredRequestsCount;
+}
+
+/**
+ * Must be called with the lock held.
+ */
+void processing::RequestQueuer::reportStatistics(std::chrono::steady_clock::time_point now) {
+    if (now - lastReportTime < chrono::seconds(STATISTICS_REPORT_INTERVAL_SECONDS)) {
+        return;
+    }
+
+    lastReportTime = now;
+
+    logger.notice("Queue wait of %lu requests: median < %ld us, 99th percentile < %ld us, max %ld us. "
+                          "%lu requests expired.",
+                  static_cast<unsigned long>(queueWaitHistogram.getCount()),
+                  static_cast<long>(queueWaitHistogram.getPercentile(0.5)),
+                  static_cast<long>(queueWaitHistogram.getPercentile(0.99)),
+                  static_cast<long>(queueWaitHistogram.getMax()),
+                  expiredRequestsCount);
+}
+
+/**
+ * Called only by the executor thread.
+ */
+ReportHistory &processing::RequestQueuer::findReportHistory(const SessionKey &key) {
+    auto now = chrono::steady_clock::now();
+    auto it = reportHistories.find(key);
+
+    if (it == reportHistories.end()) {
+        for (auto h = reportHistories.begin(); h != reportHistories.end();) {
+            if (now - h->second.lastUse > chrono::seconds(SESSION_IDLE_TIMEOUT_SECONDS)) {
+                h = reportHistories.erase(h);
+            } else {
+                ++h;
+            }
+        }
+
+        it = reportHistories.insert(make_pair(key, ReportHistory())).first;
+    }
+
+    it->second.lastUse = now;
+    return it->second;
+}
+
+/**
+ * Serializes the report for the session of the request. If the client has acknowledged the report
+ * which is still in the history, only the fields changed since it are written. Called only by the executor thread.
+ * @param version set to the version of the serialized report, 0 if no part of the report is present
+ * @param baseVersion set to the version the delta is based on, 0 if the report is full
+ * @return length of the report fields
+ */
+std::size_t processing::RequestQueuer::serializeReport(const Request &request, const Report &report,
+                                                       char *buffer, std::size_t capacity,
+                                                       uint64_t &version, uint64_t &baseVersion) {
+    version = 0;
+    baseVersion = 0;
+
+    if (not report.bridgePresent and not report.wifiPresent) {
+        return 0;
+    }
+
+    ReportHistory &history = findReportHistory({request.client, request.session});
+
+    auto &entry = history.entries[history.nextEntry];
+    history.nextEntry = (history.nextEntry + 1) % history.entries.size();
+
+    std::size_t length = reportSerializer.serialize(report, entry.text.data(), entry.text.size());
+    entry.version = ++lastReportVersion;
+    entry.layout = ReportSerializer::getLayout(report);
+
+    version = entry.version;
+
+    const ReportHistory::Entry *base = nullptr;
+
+    if (request.ackedReportVersion != 0 and history.deltasSinceKeyframe + 1 < deltaKeyframeInterval) {
+        for (auto &e : history.entries) {
+            if (e.version == request.ackedReportVersion and e.layout == entry.layout) {
+                base = &e;
+            }
+        }
+    }
+
+    if (base == nullptr) {
+        history.deltasSinceKeyframe = 0;
+
+        if (length > capacity) {
+            throw std::length_error("buffer too small for the report");
+        }
+
+        std::memcpy(buffer, entry.text.data(), length);
+        return length;
+    }
+
+    history.deltasSinceKeyframe++;
+    baseVersion = base->version;
+
+    return reportSerializer.writeDelta(entry.layout, entry.text.data(), base->text.data(), buffer, capacity);
+}
+
+unsigned long processing::RequestQueuer::getPreemptedRequestsCount() {
+    unique_lock<mutex> lk(requestsMutex);
+    return preemptedRequestsCount;
 }
 
 int processing::RequestQueuer::getNumOfProcessors() {
     return requestProcessors.size();
 }
 
+std::shared_ptr<Request> processing::RequestQueuer::acquireRequest() {
+    for (unsigned int i = 0; i < requestPool.size(); ++i) {
+        auto &request = requestPool[nextPoolIndex];
+        nextPoolIndex = (nextPoolIndex + 1) % requestPool.size();
+
+        if (request.use_count() == 1) {
+            // pairs with the release of the last reference by the executor thread
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            request->internalId = -1;
+            request->serial = -1;
+            request->skipResponse = false;
+            request->sendTimestamp.clear();
+            request->receiveTimestamp.clear();
+            request->session.clear();
+            request->ackedReportVersion = 0;
+            return request;
+        }
+    }
+
+    logger.warn("All %d pooled requests are in use, allocating new one.", requestPool.size());
+    return std::shared_ptr<Request>(new Request());
+}
+
+/**
+ * Every request which isn't answered has to be reported, so the network server can forget its client.
+ */
+void processing::RequestQueuer::rejectRequest(const std::shared_ptr<Request> &request) {
+    if (rejectedRequestRemover == nullptr) {
+        logger.error("Cannot remove rejected request. No RejectedRequestRemover set.");
+    } else {
+        rejectedRequestRemover(request->internalId);
+    }
+}
+
 long processing::RequestQueuer::nextId() {
     static long id = 1;
     id++;
@@ -145,9 +540,9 @@ void processing::RequestQueuer::requestProcessorExecutorThreadFunction() {
     while (true) {
         unique_lock<mutex> lk(requestsMutex);
 
-        if (requests.empty()) {
+        if (not hasPendingRequests()) {
             cv.wait(lk, [&]() {
-                return finishCycleThread or (not requests.empty());
+                return finishCycleThread or hasPendingRequests();
             });
         }
 
@@ -155,54 +550,130 @@ void processing::RequestQueuer::requestProcessorExecutorThreadFunction() {
             return;
         }
 
-        auto request = requests.top();
-        requests.pop();
+        Session *session;
+        auto request = takeNextRequest(session);
+
+        bool tooOld = request->serial < session->lastSerial;
+        if (not tooOld) {
+            session->lastSerial = request->serial;
+        }
+
+        auto now = chrono::steady_clock::now();
+        long waitMicroseconds = chrono::duration_cast<chrono::microseconds>(now - request->receiveTime).count();
+        queueWaitHistogram.add(waitMicroseconds);
+
+        bool expired = request->maxAgeMs > 0 and waitMicroseconds > request->maxAgeMs * 1000;
+        if (expired) {
+            expiredRequestsCount++;
+        }
+
+        reportStatistics(now);
 
         lk.unlock();
 
-        if (request->serial < lastSerial) {
+        if (tooOld) {
             logger.warn("Request has too old serial (%d). Skipping (from executor).", request->serial);
+            rejectRequest(request);
             continue;
-        } else {
-            lastSerial = request->serial;
         }
 
-        logger.info("Executing request with serial %d from %s.", request->serial,
-                    request->ipAddress.to_string().c_str());
+        // stale drive commands are more dangerous than no commands, so they don't get to the USB
+        if (expired) {
+            logger.warn("Request with serial %d waited %ld us, longer than its maximal age of %ld ms. Skipping.",
+                        request->serial, waitMicroseconds, request->maxAgeMs);
+            rejectRequest(request);
+            continue;
+        }
 
-        char responseBuffer[RESPONSE_MAX_LENGTH];
-        std::memset(responseBuffer, 0, RESPONSE_MAX_LENGTH);
-        boost::interprocess::bufferstream responseStream(responseBuffer, RESPONSE_MAX_LENGTH);
+        logger.info("Executing request with serial %d from %s.", request->serial,
+                    request->client.address().to_string().c_str());
 
-        minijson::object_writer response(responseStream);
+        string processingBeginTimestamp;
+        if (request->protocol == Protocol::JSON) {
+            processingBeginTimestamp = common::utils::getTimestamp();
+        }
 
-        response.write("serial", request->serial);
-        response.write("tss", request->sendTimestamp);
-        response.write("tsr", request->receiveTimestamp);
-        response.write("tspb", common::utils::getTimestamp());
+        Report report;
 
         auto execTimeMicroseconds = common::utils::measureTime<chrono::microseconds>([&]() {
             for (auto proc : requestProcessors) {
-                std::shared_ptr<IRequestProcessor>(proc)->process(*request, response);
+                std::shared_ptr<IRequestProcessor>(proc)->process(*request, report);
             }
         });
 
-        response.write("tspe", common::utils::getTimestamp());
+        logger.info("Request %d executed in %d us.", request->serial, execTimeMicroseconds);
 
-        response.close();
+        char responseBuffer[RESPONSE_MAX_LENGTH];
+        std::size_t responseLength;
 
-        logger.info("Request %d executed in %d us.", request->serial, execTimeMicroseconds);
+        if (request->protocol == Protocol::BINARY) {
+            BinaryResponse binaryResponse;
+            binaryResponse.serial = request->serial;
+            binaryResponse.queueWaitUs = waitMicroseconds;
+            binaryResponse.executionTimeUs = execTimeMicroseconds;
+            binaryResponse.report = report;
+
+            responseLength = encodeBinaryResponse(binaryResponse, reinterpret_cast<uint8_t *>(responseBuffer),
+                                                  RESPONSE_MAX_LENGTH);
+        } else {
+            char reportBuffer[REPORT_MAX_LENGTH];
+            uint64_t reportVersion;
+            uint64_t baseVersion;
+            std::size_t reportLength = serializeReport(*request, report, reportBuffer, sizeof(reportBuffer),
+                                                       reportVersion, baseVersion);
+
+            // the last byte is left for the terminating NUL
+            std::memset(responseBuffer, 0, RESPONSE_MAX_LENGTH);
+            boost::interprocess::bufferstream responseStream(responseBuffer, RESPONSE_MAX_LENGTH - 1);
+
+            minijson::object_writer response(responseStream);
+
+            response.write("serial", request->serial);
+            response.write("tss", request->sendTimestamp);
+            response.write("tsr", request->receiveTimestamp);
+            response.write("tspb", processingBeginTimestamp);
+            response.write("tspe", common::utils::getTimestamp());
+
+            if (reportVersion != 0) {
+                response.write("rv", static_cast<long>(reportVersion));
+            }
+
+            if (baseVersion != 0) {
+                response.write("rb", static_cast<long>(baseVersion));
+            }
+
+            response.close();
+
+            responseLength = strlen(responseBuffer);
+
+            if (not responseStream or responseLength + reportLength + 1 > RESPONSE_MAX_LENGTH) {
+                logger.error("Response to request %d doesn't fit in %d bytes. Skipping.", request->serial,
+                             RESPONSE_MAX_LENGTH);
+                rejectRequest(request);
+                continue;
+            }
+
+            // the report is appended in place of the closing brace
+            if (reportLength > 0) {
+                std::memcpy(responseBuffer + responseLength, reportBuffer, reportLength);
+                responseBuffer[responseLength - 1] = ',';
+                responseBuffer[responseLength + reportLength] = '}';
+                responseLength += reportLength + 1;
+            }
+        }
 
         if (request->skipResponse) {
             logger.debug("Skipping response sending.");
+        } else if (request->protocol == Protocol::JSON) {
+            logger.debug("Response in JSON (%d B): %s", responseLength, responseBuffer);
         } else {
-            logger.debug("Response in JSON (%d B): %s", strlen(responseBuffer), responseBuffer);
+            logger.debug("Binary response (%d B).", responseLength);
         }
 
         if (responseSender == nullptr) {
             logger.error("Cannot send response. No ResponseSender set.");
         } else {
-            responseSender(request->internalId, responseBuffer, not request->skipResponse);
+            responseSender(request->internalId, string(responseBuffer, responseLength), not request->skipResponse);
         }
     }
 }
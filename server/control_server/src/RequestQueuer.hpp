@@ -1,19 +1,27 @@
 #pragma once
 
 #include "IRequestProcessor.hpp"
+#include "Configuration.hpp"
+#include "LatencyHistogram.hpp"
+#include "CommandDecoder.hpp"
+#include "ReportSerializer.hpp"
 
 #include <log4cpp/Category.hh>
 #include <wallaroo/registered.h>
-#include <boost/asio/ip/address.hpp>
+#include <boost/asio/ip/udp.hpp>
 
 #include <string>
 #include <list>
+#include <map>
 #include <vector>
 #include <functional>
 #include <queue>
 #include <mutex>
 #include <thread>
 #include <condition_variable>
+#include <chrono>
+#include <array>
+#include <cstdint>
 
 namespace processing {
 
@@ -22,15 +30,52 @@ namespace processing {
 
     constexpr long INVALID_MESSAGE = -1;
 
+    /**
+    * Defines the maximum requests queue size of one session.
+    */
+    constexpr int REQUEST_QUEUE_MAX_SIZE = 100;
+
+    /**
+     * Requests in the queue, the executed one and the ones waiting for removal.
+     */
+    constexpr int REQUEST_POOL_SIZE = REQUEST_QUEUE_MAX_SIZE + 8;
+
+    /**
+     * Requests from new sessions are rejected when there are so many sessions with pending requests.
+     */
+    constexpr unsigned int MAX_NUMBER_OF_SESSIONS = 16;
+
+    /**
+     * Lets the queuer assign the internal id of the request itself.
+     */
+    constexpr long AUTOMATIC_INTERNAL_ID = 0;
+
+    /**
+     * The network server has no free route for the response. The request is only checked for the kill switch,
+     * it isn't queued.
+     */
+    constexpr long NO_RESPONSE_ROUTE = -2;
+
     class IRequestQueuer {
     public:
         /**
         * Adds the request to the queue.
-        * @param request text of the request in JSON format
-        * @param address IP address of the client
-        * @return true if the request was added to the queue
+        * @param request text of the request in JSON format. The buffer is parsed in place, so it's modified.
+        * @param length length of the request
+        * @param client address and port of the client, together with the session token from the request
+        *               it identifies the session
+        * @param internalId id passed to ResponseSender and RejectedRequestRemover, AUTOMATIC_INTERNAL_ID
+        *                   if the queuer should assign it or NO_RESPONSE_ROUTE if the request cannot be answered
+        * @return internal id of the request or INVALID_MESSAGE if it wasn't added to the queue
         */
-        virtual long addRequest(std::string request, boost::asio::ip::address address) = 0;
+        virtual long addRequest(char *request,
+                                std::size_t length,
+                                const boost::asio::ip::udp::endpoint &client,
+                                long internalId) = 0;
+
+        long addRequest(std::string request, boost::asio::ip::udp::endpoint client) {
+            return addRequest(&request[0], request.size(), client, AUTOMATIC_INTERNAL_ID);
+        }
 
         virtual int getNumOfMessages() = 0;
 
@@ -51,6 +96,21 @@ namespace processing {
         }
     };
 
+    typedef std::priority_queue<std::shared_ptr<Request>,
+            std::vector<std::shared_ptr<Request>>,
+            RequestValueComparer> RequestPriorityQueue;
+
+    enum class QueuePolicy {
+        /**
+         * Requests are executed in the order of their serials.
+         */
+        PRIORITY_QUEUE,
+        /**
+         * Only the newest request of each client waits for execution, it replaces the older one.
+         */
+        LATEST_WINS
+    };
+
 //    class RequestValueComparer {
 //    public:
 //        bool operator()(const Request &r1, const Request &r2) const {
@@ -59,16 +119,99 @@ namespace processing {
 //        }
 //    };
 
+    struct SessionKey {
+        boost::asio::ip::udp::endpoint client;
+        std::string token;
+
+        bool operator<(const SessionKey &other) const {
+            return client < other.client or (client == other.client and token < other.token);
+        }
+    };
+
+    /**
+     * Requests of one client. Each session has its own serial counter, so the clients don't
+     * reject each other's requests.
+     */
+    struct Session {
+        long lastSerial = 0;
+
+        /**
+         * Weighted round robin: the session gets this many turns for one turn of the session with weight 1.
+         */
+        int weight = 1;
+        int currentWeight = 0;
+
+        RequestPriorityQueue requests;
+
+        /**
+         * Used in LATEST_WINS mode instead of the priority queue.
+         */
+        std::shared_ptr<Request> mailbox;
+
+        std::chrono::steady_clock::time_point lastActivity;
+
+        unsigned int getNumOfPending() const {
+            return mailbox ? 1 : requests.size();
+        }
+    };
+
+    /**
+     * Reports recently sent to one session, so the client which acknowledges one of them gets only
+     * the changed fields. Used only by the executor thread.
+     */
+    struct ReportHistory {
+        struct Entry {
+            /**
+             * 0 if the entry is empty.
+             */
+            uint64_t version = 0;
+            unsigned int layout = 0;
+            std::array<char, REPORT_MAX_LENGTH> text;
+        };
+
+        /**
+         * At 25 ms per request this covers the round trip of 400 ms.
+         */
+        std::array<Entry, 16> entries;
+        unsigned int nextEntry = 0;
+
+        unsigned int deltasSinceKeyframe = 0;
+
+        std::chrono::steady_clock::time_point lastUse;
+    };
+
     class RequestQueuer : public wallaroo::Part, public IRequestQueuer {
     public:
         RequestQueuer();
 
         ~RequestQueuer();
 
-        virtual long addRequest(std::string requestString, boost::asio::ip::address address);
+        using IRequestQueuer::addRequest;
+
+        virtual long addRequest(char *requestData,
+                                std::size_t length,
+                                const boost::asio::ip::udp::endpoint &client,
+                                long internalId);
 
         virtual int getNumOfMessages();
 
+        int getNumOfSessions();
+
+        /**
+         * @return histogram of the time between receiving the requests and starting their execution
+         */
+        LatencyHistogram getQueueWaitHistogram();
+
+        /**
+         * @return number of requests skipped because they waited longer than their maximal age
+         */
+        unsigned long getExpiredRequestsCount();
+
+        /**
+         * @return number of requests dropped because the kill switch request came after them
+         */
+        unsigned long getPreemptedRequestsCount();
+
         virtual int getNumOfProcessors();
 
         void setResponseSender(ResponseSender s) {
@@ -82,11 +225,51 @@ namespace processing {
     private:
         log4cpp::Category &logger;
 
+        wallaroo::Collaborator<common::config::Configuration> config;
         wallaroo::Collaborator<IRequestProcessor, wallaroo::collection> requestProcessors;
+        wallaroo::Collaborator<IEmergencyStop, wallaroo::optional> emergencyStop;
+
+        QueuePolicy policy = QueuePolicy::PRIORITY_QUEUE;
+
+        CommandDecoder decoder;
+        ReportSerializer reportSerializer;
+
+        /**
+         * Sessions with this token get controllerWeight turns of the executor.
+         */
+        std::string controllerSession;
+        int controllerWeight = 1;
+
+        /**
+         * Maximal age of the requests which don't specify it, 0 for no limit.
+         */
+        long defaultMaxAgeMs = 0;
+
+        /**
+         * Every n-th report sent to the session is full even if the client acknowledges the previous one.
+         * 0 disables the delta reports.
+         */
+        unsigned int deltaKeyframeInterval = 0;
 
         std::mutex requestsMutex;
-        std::priority_queue<std::shared_ptr<Request>, std::vector<std::shared_ptr<Request>>, RequestValueComparer> requests;
-        volatile long lastSerial = 0;
+        std::map<SessionKey, Session> sessions;
+        unsigned int pendingRequestsCount = 0;
+        unsigned long supersededRequestsCount = 0;
+        unsigned long preemptedRequestsCount = 0;
+
+        LatencyHistogram queueWaitHistogram;
+        unsigned long expiredRequestsCount = 0;
+        std::chrono::steady_clock::time_point lastReportTime;
+
+        /**
+         * Requests are reused to avoid allocations for each received packet. The request is free
+         * if it's referenced only by the pool.
+         */
+        std::vector<std::shared_ptr<Request>> requestPool;
+
+        std::map<SessionKey, ReportHistory> reportHistories;
+        uint64_t lastReportVersion = 0;
+        unsigned int nextPoolIndex = 0;
 
         std::unique_ptr<std::thread> requestProcessorExecutorThread;
         std::condition_variable cv;
@@ -100,6 +283,35 @@ namespace processing {
         void requestProcessorExecutorThreadFunction();
 
         long nextId();
+
+        std::shared_ptr<Request> acquireRequest();
+
+        void rejectRequest(const std::shared_ptr<Request> &request);
+
+        Session *findSession(const SessionKey &key);
+
+        void removeIdleSessions();
+
+        void clearSession(Session &session);
+
+        unsigned int rejectPendingRequests(Session &session);
+
+        void stopImmediately();
+
+        bool pushToQueue(Session &session, const std::shared_ptr<Request> &request);
+
+        bool putToMailbox(Session &session, const std::shared_ptr<Request> &request);
+
+        bool hasPendingRequests();
+
+        std::shared_ptr<Request> takeNextRequest(Session *&session);
+
+        void reportStatistics(std::chrono::steady_clock::time_point now);
+
+        ReportHistory &findReportHistory(const SessionKey &key);
+
+        std::size_t serializeReport(const Request &request, const Report &report, char *buffer, std::size_t capacity,
+                                    uint64_t &version, uint64_t &baseVersion);
     };
 
 }
\ No newline at end of file
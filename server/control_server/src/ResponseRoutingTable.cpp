@@ -0,0 +1,84 @@
+#include "ResponseRoutingTable.hpp"
+
+using namespace std;
+using namespace processing;
+
+constexpr uint64_t SLOT_RESERVED = 1;
+
+processing::ResponseRoutingTable::ResponseRoutingTable(unsigned int capacity)
+        : capacity(1) {
+
+    while (this->capacity < capacity) {
+        this->capacity <<= 1;
+    }
+
+    slots.reset(new Slot[this->capacity]);
+
+    for (unsigned int i = 0; i < this->capacity; ++i) {
+        slots[i].state.store(0);
+    }
+}
+
+long processing::ResponseRoutingTable::reserve(const boost::asio::ip::udp::endpoint &endpoint) {
+    for (unsigned int i = 0; i < capacity; ++i) {
+        unsigned int index = nextSlot;
+        nextSlot = (nextSlot + 1) & (capacity - 1);
+
+        auto &slot = slots[index];
+        uint64_t state = slot.state.load(std::memory_order_acquire);
+
+        if (state & SLOT_RESERVED) {
+            continue;
+        }
+
+        // nobody else writes to the free slot, the endpoint is published by the state store
+        uint64_t generation = (state >> 1) + 1;
+        slot.endpoint = endpoint;
+        slot.state.store((generation << 1) | SLOT_RESERVED, std::memory_order_release);
+
+        return static_cast<long>(generation * capacity + index);
+    }
+
+    return -1;
+}
+
+bool processing::ResponseRoutingTable::release(long id, boost::asio::ip::udp::endpoint &endpoint) {
+    if (id < static_cast<long>(capacity)) {
+        return false;
+    }
+
+    auto &slot = slots[id & (capacity - 1)];
+    uint64_t reservedState = ((static_cast<uint64_t>(id) / capacity) << 1) | SLOT_RESERVED;
+
+    if (slot.state.load(std::memory_order_acquire) != reservedState) {
+        return false;
+    }
+
+    // the copy is valid only if the slot is still ours, which is checked by the exchange below
+    boost::asio::ip::udp::endpoint copy = slot.endpoint;
+
+    if (not slot.state.compare_exchange_strong(reservedState, reservedState & ~SLOT_RESERVED,
+                                               std::memory_order_acq_rel)) {
+        return false;
+    }
+
+    endpoint = copy;
+    return true;
+}
+
+bool processing::ResponseRoutingTable::release(long id) {
+    boost::asio::ip::udp::endpoint endpoint;
+    return release(id, endpoint);
+}
+
+unsigned int processing::ResponseRoutingTable::getNumberOfReserved() {
+    unsigned int reserved = 0;
+
+    for (unsigned int i = 0; i < capacity; ++i) {
+        if (slots[i].state.load(std::memory_order_relaxed) & SLOT_RESERVED) {
+            reserved++;
+        }
+    }
+
+    return reserved;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+namespace processing {
+
+    /**
+     * Remembers the endpoints of the clients whose requests wait for the response. The slot is reserved
+     * by the network thread when the request arrives and it's released by the executor thread when
+     * the response is sent or the request is rejected.
+     *
+     * Each slot has the generation counter which is part of the request id, so the id of the released
+     * request never matches the slot reused for another request. No locks are used.
+     */
+    class ResponseRoutingTable : boost::noncopyable {
+    public:
+        /**
+         * @param capacity maximal number of the requests waiting for response. Rounded up to the power of 2.
+         */
+        ResponseRoutingTable(unsigned int capacity);
+
+        ~ResponseRoutingTable() = default;
+
+        /**
+         * Stores the endpoint in a free slot. Can be called only from one thread.
+         * @return id of the request, positive, or -1 if the table is full.
+         */
+        long reserve(const boost::asio::ip::udp::endpoint &endpoint);
+
+        /**
+         * Releases the slot and returns the endpoint stored in it. Any thread.
+         * @return false if the id wasn't reserved or it was already released.
+         */
+        bool release(long id, boost::asio::ip::udp::endpoint &endpoint);
+
+        bool release(long id);
+
+        unsigned int getCapacity() {
+            return capacity;
+        }
+
+        unsigned int getNumberOfReserved();
+
+    private:
+        struct Slot {
+            /**
+             * Generation shifted left by one, the lowest bit is set when the slot is reserved.
+             */
+            std::atomic<uint64_t> state;
+            boost::asio::ip::udp::endpoint endpoint;
+        };
+
+        unsigned int capacity;
+        std::unique_ptr<Slot[]> slots;
+
+        /**
+         * Where the search for the free slot starts, used only by the reserving thread.
+         */
+        unsigned int nextSlot = 0;
+    };
+}
@@ -0,0 +1,346 @@
+#include "TelemetryPublisher.hpp"
+#include "BridgeProcessor.hpp"
+#include "utils.hpp"
+
+#include <minijson_writer.hpp>
+#include <minijson_reader.hpp>
+
+#include <boost/interprocess/streams/bufferstream.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/format.hpp>
+
+#include <algorithm>
+#include <random>
+#include <cstring>
+
+using namespace std;
+using namespace boost;
+using namespace boost::asio;
+using namespace processing;
+using boost::asio::ip::udp;
+
+/**
+ * The subscription message is short, longer datagrams are truncated and rejected as invalid JSON.
+ */
+constexpr int TELEMETRY_RECEIVE_BUFFER_SIZE = 256;
+
+constexpr int TELEMETRY_MESSAGE_MAX_LENGTH = 1024;
+
+constexpr unsigned int TELEMETRY_MAX_SUBSCRIBERS = 16;
+
+/**
+ * The client has to renew the subscription within this time.
+ */
+constexpr int SUBSCRIPTION_TIMEOUT_SECONDS = 30;
+
+constexpr double SUBSCRIPTION_MIN_RATE_HZ = 0.1;
+
+constexpr int NONCE_MAX_LENGTH = 32;
+
+processing::TelemetrySubscriptions::TelemetrySubscriptions(unsigned int maxSubscribers,
+                                                           double maxRateHz,
+                                                           std::chrono::seconds timeout)
+        : maxSubscribers(maxSubscribers),
+          maxRateHz(maxRateHz),
+          timeout(timeout) {
+    subscribers.reserve(maxSubscribers);
+}
+
+bool processing::TelemetrySubscriptions::subscribe(const udp::endpoint &endpoint, double rateHz, TimePoint now) {
+    auto it = std::find_if(subscribers.begin(), subscribers.end(), [&](const Subscriber &s) {
+        return s.endpoint == endpoint;
+    });
+
+    if (rateHz <= 0) {
+        if (it != subscribers.end()) {
+            subscribers.erase(it);
+        }
+        return true;
+    }
+
+    rateHz = std::max(std::min(rateHz, maxRateHz), SUBSCRIPTION_MIN_RATE_HZ);
+    auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(1.0 / rateHz));
+
+    if (it == subscribers.end()) {
+        if (subscribers.size() >= maxSubscribers) {
+            return false;
+        }
+
+        subscribers.push_back({endpoint, period, now, now + timeout});
+    } else {
+        // the new rate applies from the next push
+        it->nextPush = std::min(it->nextPush, now + period);
+        it->period = period;
+        it->expiry = now + timeout;
+    }
+
+    return true;
+}
+
+void processing::TelemetrySubscriptions::forEachDue(TimePoint now,
+                                                    std::function<void(const udp::endpoint &)> function) {
+    subscribers.erase(std::remove_if(subscribers.begin(), subscribers.end(), [&](const Subscriber &s) {
+        return now >= s.expiry;
+    }), subscribers.end());
+
+    for (auto &s : subscribers) {
+        if (now < s.nextPush) {
+            continue;
+        }
+
+        function(s.endpoint);
+
+        s.nextPush += s.period;
+
+        // the pushes delayed by the busy thread aren't caught up in a burst
+        if (s.nextPush <= now) {
+            s.nextPush = now + s.period;
+        }
+    }
+}
+
+TelemetrySubscriptions::TimePoint processing::TelemetrySubscriptions::getNextPushTime() const {
+    TimePoint next = TimePoint::max();
+
+    for (auto &s : subscribers) {
+        next = std::min(next, s.nextPush);
+    }
+
+    return next;
+}
+
+WALLAROO_REGISTER(TelemetryPublisher);
+
+processing::TelemetryPublisher::TelemetryPublisher()
+        : logger(log4cpp::Category::getInstance("TelemetryPublisher")),
+          config("config", RegistrationToken()),
+          interfaceManager("interfaceManager", RegistrationToken()),
+          ioServiceProvider("ioServiceProvider", RegistrationToken()) {
+}
+
+void processing::TelemetryPublisher::Init() {
+    unsigned int port = config->getInt("TelemetryPublisher.port");
+    int maxRateHz = config->getInt("TelemetryPublisher.max_rate_hz");
+
+    if (maxRateHz < 1) {
+        throw std::runtime_error("maximal telemetry rate has to be at least 1 Hz");
+    }
+
+    subscriptions.reset(new TelemetrySubscriptions(TELEMETRY_MAX_SUBSCRIBERS, maxRateHz,
+                                                   std::chrono::seconds(SUBSCRIPTION_TIMEOUT_SECONDS)));
+
+    receiveBuffer.reset(new char[TELEMETRY_RECEIVE_BUFFER_SIZE]);
+
+    std::random_device randomDevice;
+    nonceKey = (static_cast<uint64_t>(randomDevice()) << 32) | randomDevice();
+
+    snapshot.bridgePresent = true;
+
+    auto &ioContext = ioServiceProvider->getIoContext();
+    udpSocket.reset(new udp::socket(ioContext));
+    pushTimer.reset(new steady_timer(ioContext));
+
+    system::error_code err;
+    bool ipv6enabled = config->getBool("NetServer.enable_ipv6");
+
+    if (ipv6enabled) {
+        udpSocket->open(udp::v6());
+        udpSocket->bind(udp::endpoint(udp::v6(), port), err);
+    } else {
+        udpSocket->open(udp::v4());
+        udpSocket->bind(udp::endpoint(udp::v4(), port), err);
+    }
+
+    if (err) {
+        throw std::runtime_error("error at binding telemetry socket: " + err.message());
+    }
+
+    udpSocket->non_blocking(true);
+
+    doReceive();
+
+    logger.notice("Accepting telemetry subscriptions on port %u, up to %d Hz.", port, maxRateHz);
+
+    logger.notice("Instance created.");
+}
+
+processing::TelemetryPublisher::~TelemetryPublisher() {
+    logger.notice("Instance destroyed.");
+}
+
+void processing::TelemetryPublisher::doReceive() {
+    udpSocket->async_receive_from(
+            asio::buffer(receiveBuffer.get(), TELEMETRY_RECEIVE_BUFFER_SIZE),
+            sender,
+            [this](system::error_code ec, std::size_t bytesReceived) {
+                if (ec == asio::error::operation_aborted) {
+                    return;
+                } else if (ec) {
+                    logger.error("Error when receiving subscription: %s.", ec.message().c_str());
+                } else {
+                    handleSubscription(receiveBuffer.get(), bytesReceived, sender);
+                }
+                doReceive();
+            });
+}
+
+void processing::TelemetryPublisher::handleSubscription(char *data, std::size_t length, const udp::endpoint &endpoint) {
+    double rateHz = -1;
+    string nonce;
+
+    try {
+        minijson::buffer_context ctx(data, length);
+        minijson::parse_object(ctx, [&](const char *k, minijson::value v) {
+            if (std::strcmp(k, "subscribe") == 0) {
+                rateHz = v.as_double();
+            } else if (std::strcmp(k, "nonce") == 0) {
+                nonce.assign(v.as_string(), strnlen(v.as_string(), NONCE_MAX_LENGTH));
+            } else {
+                minijson::ignore(ctx);
+            }
+        });
+    } catch (minijson::parse_error &e) {
+        logger.error("Subscription from %s is not valid JSON document: %s.",
+                     endpoint.address().to_string().c_str(), e.what());
+        return;
+    }
+
+    if (rateHz < 0) {
+        logger.error("Message from %s doesn't contain the subscription rate.", endpoint.address().to_string().c_str());
+        return;
+    }
+
+    // the sender address may be spoofed, nothing is pushed to the endpoint which didn't prove it receives
+    if (nonce != createNonce(endpoint)) {
+        logger.info("Subscription from %s:%d without valid nonce. Sending the nonce.",
+                    endpoint.address().to_string().c_str(), endpoint.port());
+        sendNonce(endpoint);
+        return;
+    }
+
+    if (not subscriptions->subscribe(endpoint, rateHz, std::chrono::steady_clock::now())) {
+        logger.warn("Too many telemetry subscribers (%u). Rejecting %s.", TELEMETRY_MAX_SUBSCRIBERS,
+                    endpoint.address().to_string().c_str());
+        return;
+    }
+
+    logger.info("%s %s:%d with rate %.1f Hz. Number of subscribers: %u.",
+                rateHz > 0 ? "Subscribed" : "Unsubscribed", endpoint.address().to_string().c_str(),
+                endpoint.port(), rateHz, subscriptions->size());
+
+    schedulePush();
+}
+
+string processing::TelemetryPublisher::createNonce(const udp::endpoint &endpoint) {
+    std::size_t hash = nonceKey;
+    boost::hash_combine(hash, endpoint.address().to_string());
+    boost::hash_combine(hash, endpoint.port());
+    boost::hash_combine(hash, nonceKey);
+
+    return (format("%016x") % static_cast<uint64_t>(hash)).str();
+}
+
+void processing::TelemetryPublisher::sendNonce(const udp::endpoint &endpoint) {
+    string message = "{\"nonce\":\"" + createNonce(endpoint) + "\"}";
+
+    system::error_code ec;
+    udpSocket->send_to(asio::buffer(message), endpoint, 0, ec);
+
+    if (ec) {
+        logger.warn("Cannot send nonce to %s: %s.", endpoint.address().to_string().c_str(), ec.message().c_str());
+    }
+}
+
+void processing::TelemetryPublisher::schedulePush() {
+    auto nextPush = subscriptions->getNextPushTime();
+
+    if (nextPush == TelemetrySubscriptions::TimePoint::max()) {
+        pushTimer->cancel();
+        return;
+    }
+
+    // cancels the wait for the previous time
+    pushTimer->expires_at(nextPush);
+    pushTimer->async_wait([this](system::error_code ec) {
+        if (ec == asio::error::operation_aborted) {
+            return;
+        }
+        push();
+        schedulePush();
+    });
+}
+
+void processing::TelemetryPublisher::push() {
+    updateSnapshot();
+
+    char message[TELEMETRY_MESSAGE_MAX_LENGTH];
+    std::size_t messageLength = 0;
+
+    // the default report would tell the kill switch is inactive
+    bool snapshotTaken = snapshotStateVersion != 0;
+
+    if (not snapshotTaken) {
+        logger.debug("No snapshot of the interface taken yet, skipping the push.");
+    }
+
+    subscriptions->forEachDue(std::chrono::steady_clock::now(), [&](const udp::endpoint &endpoint) {
+        if (not snapshotTaken) {
+            return;
+        }
+
+        // the message is the same for all subscribers due at once
+        if (messageLength == 0) {
+            messageLength = writeMessage(message, sizeof(message));
+        }
+
+        system::error_code ec;
+        udpSocket->send_to(asio::buffer(message, messageLength), endpoint, 0, ec);
+
+        if (ec) {
+            logger.warn("Cannot push telemetry to %s: %s.", endpoint.address().to_string().c_str(),
+                        ec.message().c_str());
+        }
+    });
+}
+
+void processing::TelemetryPublisher::updateSnapshot() {
+    auto &iface = interfaceManager->iface();
+
+    common::bridge::SharedScopedMutex lk(iface.mutex, boost::interprocess::try_to_lock);
+
+    if (not lk) {
+        logger.debug("Interface is being synchronized, pushing the previous snapshot.");
+        return;
+    }
+
+    uint64_t stateVersion = iface.getStateVersion();
+
+    if (stateVersion != snapshotStateVersion) {
+        bridge::createBridgeReport(iface, snapshot.bridge);
+        snapshot.bridgeStateVersion = stateVersion;
+        snapshotStateVersion = stateVersion;
+    }
+}
+
+std::size_t processing::TelemetryPublisher::writeMessage(char *buffer, std::size_t capacity) {
+    std::memset(buffer, 0, capacity);
+    boost::interprocess::bufferstream messageStream(buffer, capacity);
+
+    minijson::object_writer message(messageStream);
+
+    message.write("seq", static_cast<long>(++sequence));
+    message.write("ts", common::utils::getTimestamp());
+    message.write("sv", static_cast<long>(snapshotStateVersion));
+
+    message.close();
+
+    std::size_t length = std::strlen(buffer);
+
+    // the report is appended in place of the closing brace
+    std::size_t reportLength = serializer.serialize(snapshot, buffer + length, capacity - length - 1);
+    buffer[length - 1] = ',';
+    buffer[length + reportLength] = '}';
+
+    return length + reportLength + 1;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "InterfaceManager.hpp"
+#include "ReportSerializer.hpp"
+#include "Configuration.hpp"
+#include "IoServiceProvider.hpp"
+
+#include <log4cpp/Category.hh>
+#include <wallaroo/registered.h>
+#include <boost/asio.hpp>
+
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <cstdint>
+
+namespace processing {
+
+    /**
+     * Endpoints subscribed to the telemetry with the rate of the pushes. The subscriptions expire
+     * if they aren't renewed, so the clients which disappeared without unsubscribing are forgotten.
+     */
+    class TelemetrySubscriptions {
+    public:
+        typedef std::chrono::steady_clock::time_point TimePoint;
+
+        TelemetrySubscriptions(unsigned int maxSubscribers, double maxRateHz, std::chrono::seconds timeout);
+
+        /**
+         * Adds the subscription or renews the existing one with the new rate. The rate is limited to the maximal one.
+         * @param rateHz 0 removes the subscription
+         * @return false if there are too many subscribers to add the new one
+         */
+        bool subscribe(const boost::asio::ip::udp::endpoint &endpoint, double rateHz, TimePoint now);
+
+        /**
+         * Calls the function for each subscriber whose push is due and schedules its next push.
+         * The expired subscriptions are removed.
+         */
+        void forEachDue(TimePoint now, std::function<void(const boost::asio::ip::udp::endpoint &)> function);
+
+        /**
+         * @return time of the earliest push, TimePoint::max() if there are no subscribers
+         */
+        TimePoint getNextPushTime() const;
+
+        unsigned int size() const {
+            return subscribers.size();
+        }
+
+    private:
+        struct Subscriber {
+            boost::asio::ip::udp::endpoint endpoint;
+            std::chrono::steady_clock::duration period;
+            TimePoint nextPush;
+            TimePoint expiry;
+        };
+
+        unsigned int maxSubscribers;
+        double maxRateHz;
+        std::chrono::seconds timeout;
+
+        std::vector<Subscriber> subscribers;
+    };
+
+    /**
+     * Pushes the snapshots of the bridge state to the subscribed clients. The clients subscribe by sending
+     * {"subscribe":<rate in Hz>,"nonce":"<nonce>"} to the telemetry port and have to renew the subscription
+     * periodically. The message without the valid nonce is answered by {"nonce":"<nonce>"} only, so the client
+     * has to receive the datagrams sent to its endpoint before anything is pushed there. The nonce is derived
+     * from the endpoint and the key generated at the start, no state is kept for the unconfirmed endpoints.
+     *
+     * The snapshot is taken from the Interface as left by the last synchronization with the device,
+     * the device isn't queried. If the Interface is locked by the synchronization in progress, the previous
+     * snapshot is sent, so the network thread never waits for the USB. Nothing is pushed until the first
+     * snapshot is taken. The state version of the Interface starts at 1, so that snapshot may be taken before
+     * the first synchronization and show the initial state of the Interface.
+     */
+    class TelemetryPublisher : public wallaroo::Part {
+    public:
+        TelemetryPublisher();
+
+        ~TelemetryPublisher();
+
+        unsigned int getNumOfSubscribers() {
+            return subscriptions->size();
+        }
+
+        unsigned long getNumOfPushes() {
+            return sequence;
+        }
+
+    private:
+        log4cpp::Category &logger;
+
+        wallaroo::Collaborator<common::config::Configuration> config;
+        wallaroo::Collaborator<bridge::IInterfaceManager> interfaceManager;
+        wallaroo::Collaborator<common::IoServiceProvider> ioServiceProvider;
+
+        std::unique_ptr<boost::asio::ip::udp::socket> udpSocket;
+        std::unique_ptr<boost::asio::steady_timer> pushTimer;
+
+        std::unique_ptr<TelemetrySubscriptions> subscriptions;
+
+        std::unique_ptr<char[]> receiveBuffer;
+        boost::asio::ip::udp::endpoint sender;
+
+        ReportSerializer serializer;
+
+        Report snapshot;
+        uint64_t snapshotStateVersion = 0;
+
+        unsigned long sequence = 0;
+
+        uint64_t nonceKey = 0;
+
+        void Init() override;
+
+        void doReceive();
+
+        void handleSubscription(char *data, std::size_t length, const boost::asio::ip::udp::endpoint &endpoint);
+
+        std::string createNonce(const boost::asio::ip::udp::endpoint &endpoint);
+
+        void sendNonce(const boost::asio::ip::udp::endpoint &endpoint);
+
+        void schedulePush();
+
+        void push();
+
+        void updateSnapshot();
+
+        std::size_t writeMessage(char *buffer, std::size_t capacity);
+    };
+}
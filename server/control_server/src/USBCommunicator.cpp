@@ -4,9 +4,12 @@
 
 #include <boost/format.hpp>
 
+#include <sys/time.h>
+
 #include <iostream>
 #include <functional>
 #include <chrono>
+#include <exception>
 
 using namespace std;
 using namespace bridge;
@@ -15,6 +18,30 @@ using boost::format;
 const int BUFFER_SIZE = USB_SETTINGS_HOST_TO_DEVICE_DATAPACKET_SIZE;
 const int MESSAGE_TIMEOUT = 2000; // ms
 
+/**
+ * Two for the pipelined synchronization and one for the kill switch sent meanwhile.
+ */
+const int MAX_EXCHANGES_IN_FLIGHT = 3;
+
+/**
+ * How often the event thread checks whether it should finish.
+ */
+const int EVENT_HANDLING_TIMEOUT = 100; // ms
+
+std::future<std::vector<uint8_t>> bridge::ICommunicator::exchange(std::vector<uint8_t> &data) {
+    std::promise<std::vector<uint8_t>> promise;
+
+    try {
+        lock_guard<mutex> lk(exchangeMutex);
+        sendData(data);
+        promise.set_value(receiveData());
+    } catch (CommException &e) {
+        promise.set_exception(std::current_exception());
+    }
+
+    return promise.get_future();
+}
+
 WALLAROO_REGISTER(USBCommunicator);
 
 bridge::USBCommunicator::USBCommunicator()
@@ -101,11 +128,71 @@ bridge::USBCommunicator::USBCommunicator()
         libusb_close(devHandle);
         throw CommException((format("error at claiming interface (%s)") % libusb_error_name(status)).str());
     } else {
-        logger.notice("Interface claimed. Device ready to go. Instance created.");
+        logger.notice("Interface claimed.");
+    }
+
+    for (int i = 0; i < MAX_EXCHANGES_IN_FLIGHT; i++) {
+        unique_ptr<Exchange> e(new Exchange());
+        e->communicator = this;
+        e->outTransfer = libusb_alloc_transfer(0);
+        e->inTransfer = libusb_alloc_transfer(0);
+        e->outBuffer.resize(BUFFER_SIZE, 0);
+        e->inBuffer.resize(USB_SETTINGS_DEVICE_TO_HOST_DATAPACKET_SIZE, 0);
+
+        freeExchanges.push_back(e.get());
+        exchanges.push_back(std::move(e));
     }
+
+    for (auto &e : exchanges) {
+        if (e->outTransfer == nullptr or e->inTransfer == nullptr) {
+            for (auto &toFree : exchanges) {
+                libusb_free_transfer(toFree->outTransfer);
+                libusb_free_transfer(toFree->inTransfer);
+            }
+            libusb_release_interface(devHandle, 0);
+            libusb_close(devHandle);
+            throw CommException("cannot allocate USB transfers");
+        }
+    }
+
+    eventThread.reset(new thread(&USBCommunicator::eventThreadFunction, this));
+    common::utils::setThreadName(logger, eventThread.get(), "usbEvents");
+
+    logger.notice("Device ready to go. Instance created.");
 }
 
 bridge::USBCommunicator::~USBCommunicator() {
+    {
+        unique_lock<mutex> lk(exchangesMutex);
+
+        // the callbacks of the cancelled transfers are still called by the event thread
+        for (auto &e : exchanges) {
+            if (e->pendingTransfers > 0) {
+                libusb_cancel_transfer(e->outTransfer);
+                libusb_cancel_transfer(e->inTransfer);
+            }
+        }
+
+        bool allFinished = exchangeFinished.wait_for(lk, chrono::milliseconds(MESSAGE_TIMEOUT), [&]() {
+            return freeExchanges.size() == exchanges.size();
+        });
+
+        if (not allFinished) {
+            logger.error("Not all USB transfers were cancelled.");
+        }
+    }
+
+    finishEventThread = true;
+
+    if (eventThread.get() != nullptr) {
+        eventThread->join();
+    }
+
+    for (auto &e : exchanges) {
+        libusb_free_transfer(e->outTransfer);
+        libusb_free_transfer(e->inTransfer);
+    }
+
     libusb_release_interface(devHandle, 0);
     libusb_close(devHandle);
     libusb_exit(nullptr);
@@ -114,62 +201,129 @@ bridge::USBCommunicator::~USBCommunicator() {
 }
 
 void bridge::USBCommunicator::sendData(vector<uint8_t> &data) {
-    data.resize(BUFFER_SIZE, 0);
+    pendingResponse = exchange(data);
+}
 
-    int transferred, status;
+vector<uint8_t> &bridge::USBCommunicator::receiveData() {
+    if (not pendingResponse.valid()) {
+        throw CommException("no data was sent to the device");
+    }
 
-    auto microseconds = common::utils::measureTime<chrono::microseconds>([&]() {
-        status = libusb_bulk_transfer(devHandle, (USB_SETTINGS_HOST_TO_DEVICE_ENDPOINT_NO | LIBUSB_ENDPOINT_OUT),
-                                      &data[0], USB_SETTINGS_HOST_TO_DEVICE_DATAPACKET_SIZE, &transferred,
-                                      MESSAGE_TIMEOUT);
-    });
+    response = pendingResponse.get();
 
-    logger.info(string("Sending data in ") + to_string(microseconds) + " us.");
+    return response;
+}
+
+std::future<std::vector<uint8_t>> bridge::USBCommunicator::exchange(std::vector<uint8_t> &data) {
+    data.resize(BUFFER_SIZE, 0);
 
     if (logger.getPriority() >= log4cpp::Priority::DEBUG) {
         logger.debug(string("Sending data: ") + common::utils::toString<uint8_t>(data));
     }
 
-    if (transferred != USB_SETTINGS_HOST_TO_DEVICE_DATAPACKET_SIZE) {
-        throw CommException(
-                (format("sent %d bytes to the device instead of %d") % transferred
-                 % USB_SETTINGS_HOST_TO_DEVICE_DATAPACKET_SIZE).str());
+    unique_lock<mutex> lk(exchangesMutex);
+
+    // each exchange ends at the latest with the transfer timeout
+    exchangeFinished.wait(lk, [&]() {
+        return not freeExchanges.empty();
+    });
+
+    Exchange &e = *freeExchanges.front();
+    freeExchanges.pop_front();
+
+    std::copy(data.begin(), data.end(), e.outBuffer.begin());
+    e.promise = std::promise<std::vector<uint8_t>>();
+    e.failed = false;
+    e.submitTime = chrono::steady_clock::now();
+
+    auto future = e.promise.get_future();
+
+    libusb_fill_bulk_transfer(e.outTransfer, devHandle,
+                              (USB_SETTINGS_HOST_TO_DEVICE_ENDPOINT_NO | LIBUSB_ENDPOINT_OUT),
+                              &e.outBuffer[0], USB_SETTINGS_HOST_TO_DEVICE_DATAPACKET_SIZE,
+                              &USBCommunicator::transferCallback, &e, MESSAGE_TIMEOUT);
+
+    libusb_fill_bulk_transfer(e.inTransfer, devHandle,
+                              (USB_SETTINGS_DEVICE_TO_HOST_ENDPOINT_NO | LIBUSB_ENDPOINT_IN),
+                              &e.inBuffer[0], USB_SETTINGS_DEVICE_TO_HOST_DATAPACKET_SIZE,
+                              &USBCommunicator::transferCallback, &e, MESSAGE_TIMEOUT);
+
+    // the callbacks wait for the lock, so the transfers are submitted in pairs and the order is kept
+    int status = libusb_submit_transfer(e.outTransfer);
+    if (status < 0) {
+        failExchange(e, (format("error at sending data to the device (%s)") % libusb_error_name(status)).str());
+        freeExchanges.push_back(&e);
+        return future;
     }
 
+    e.pendingTransfers = 1;
+
+    status = libusb_submit_transfer(e.inTransfer);
     if (status < 0) {
-        throw CommException((format("error at sending data to the device (%s)") % libusb_error_name(status)).str());
+        failExchange(e, (format("error at receiving data from the device (%s)") % libusb_error_name(status)).str());
+        libusb_cancel_transfer(e.outTransfer);
+        return future;
     }
-}
 
-vector<uint8_t> &bridge::USBCommunicator::receiveData() {
-    uint8_t data[BUFFER_SIZE];
+    e.pendingTransfers = 2;
 
-    int transferred, status;
+    return future;
+}
 
-    auto microseconds = common::utils::measureTime<chrono::microseconds>([&]() {
-        status = libusb_bulk_transfer(devHandle, (USB_SETTINGS_DEVICE_TO_HOST_ENDPOINT_NO | LIBUSB_ENDPOINT_IN),
-                                      data,
-                                      USB_SETTINGS_DEVICE_TO_HOST_DATAPACKET_SIZE, &transferred, MESSAGE_TIMEOUT);
-    });
+void bridge::USBCommunicator::eventThreadFunction() {
+    while (not finishEventThread) {
+        timeval timeout;
+        timeout.tv_sec = 0;
+        timeout.tv_usec = EVENT_HANDLING_TIMEOUT * 1000;
 
-    logger.info(string("Received data in ") + to_string(microseconds) + " us.");
+        int status = libusb_handle_events_timeout_completed(nullptr, &timeout, nullptr);
 
-    if (transferred != USB_SETTINGS_DEVICE_TO_HOST_DATAPACKET_SIZE) {
-        throw CommException(
-                (format("received %d bytes from the device instead of %d") % transferred
-                 % USB_SETTINGS_DEVICE_TO_HOST_DATAPACKET_SIZE).str());
+        if (status < 0 and status != LIBUSB_ERROR_INTERRUPTED) {
+            logger.error("Error when handling USB events (%s).", libusb_error_name(status));
+        }
     }
+}
 
-    if (status < 0) {
-        throw CommException((format("error at receiving data from the device (%s)") % libusb_error_name(status)).str());
-    }
+void bridge::USBCommunicator::transferCallback(libusb_transfer *transfer) {
+    auto e = static_cast<Exchange *>(transfer->user_data);
+    e->communicator->onTransferFinished(*e, transfer);
+}
 
-    response.assign(data, data + transferred);
+void bridge::USBCommunicator::onTransferFinished(Exchange &e, libusb_transfer *transfer) {
+    lock_guard<mutex> lk(exchangesMutex);
+
+    bool isOut = (transfer == e.outTransfer);
+
+    if (not e.failed) {
+        if (transfer->status != LIBUSB_TRANSFER_COMPLETED) {
+            failExchange(e, (format("error at %s data (transfer status %d)")
+                              % (isOut ? "sending" : "receiving") % transfer->status).str());
+        } else if (transfer->actual_length != transfer->length) {
+            failExchange(e, (format("%s %d bytes instead of %d")
+                              % (isOut ? "sent" : "received") % transfer->actual_length % transfer->length).str());
+        } else if (not isOut) {
+            if (logger.isInfoEnabled()) {
+                long microseconds = chrono::duration_cast<chrono::microseconds>(
+                        chrono::steady_clock::now() - e.submitTime).count();
+                logger.info("Exchanged data in %ld us.", microseconds);
+            }
 
-    if (logger.getPriority() >= log4cpp::Priority::DEBUG) {
-        logger.debug(string("Received data: ") + common::utils::toString<uint8_t>(response));
+            e.promise.set_value(e.inBuffer);
+        }
+
+        // the response to the packet which didn't arrive won't come
+        if (e.failed and isOut) {
+            libusb_cancel_transfer(e.inTransfer);
+        }
     }
 
-    return response;
+    if (--e.pendingTransfers == 0) {
+        freeExchanges.push_back(&e);
+        exchangeFinished.notify_all();
+    }
 }
 
+void bridge::USBCommunicator::failExchange(Exchange &e, const std::string &message) {
+    e.failed = true;
+    e.promise.set_exception(std::make_exception_ptr(CommException(message)));
+}
@@ -14,7 +14,14 @@ extern "C" {
 #include <string>
 #include <cstdint>
 #include <vector>
+#include <deque>
+#include <memory>
 #include <functional>
+#include <future>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 
 namespace bridge {
 /**
@@ -35,6 +42,18 @@ namespace bridge {
         virtual void sendData(std::vector<uint8_t> &data) = 0;
 
         virtual std::vector<uint8_t> &receiveData() = 0;
+
+        /**
+         * Sends the packet and returns the future response to it. The next exchange can be started
+         * before the previous response arrives; the responses come in the order of the packets.
+         * Errors are reported by the future as CommException.
+         *
+         * The default implementation is synchronous: sendData() and receiveData() under the lock.
+         */
+        virtual std::future<std::vector<uint8_t>> exchange(std::vector<uint8_t> &data);
+
+    private:
+        std::mutex exchangeMutex;
     };
 
     class USBCommunicator : public ICommunicator, public wallaroo::Part {
@@ -47,11 +66,50 @@ namespace bridge {
 
         std::vector<uint8_t> &receiveData() override;
 
+        /**
+         * Submits the OUT transfer with the packet together with the IN transfer for its response and returns
+         * immediately. Blocks only if the maximal number of the exchanges is already in flight.
+         */
+        std::future<std::vector<uint8_t>> exchange(std::vector<uint8_t> &data) override;
+
     private:
+        /**
+         * Preallocated pair of the transfers. Both are submitted at once, so the next OUT transfer
+         * is queued while the IN transfer of the previous exchange is still pending.
+         */
+        struct Exchange {
+            USBCommunicator *communicator;
+            libusb_transfer *outTransfer;
+            libusb_transfer *inTransfer;
+            std::vector<uint8_t> outBuffer;
+            std::vector<uint8_t> inBuffer;
+            std::promise<std::vector<uint8_t>> promise;
+            std::chrono::steady_clock::time_point submitTime;
+            int pendingTransfers = 0;
+            bool failed = false;
+        };
+
         std::vector<uint8_t> response;
+        std::future<std::vector<uint8_t>> pendingResponse;
 
         log4cpp::Category &logger;
         libusb_device_handle *devHandle;
+
+        std::vector<std::unique_ptr<Exchange>> exchanges;
+        std::deque<Exchange *> freeExchanges;
+        std::mutex exchangesMutex;
+        std::condition_variable exchangeFinished;
+
+        std::unique_ptr<std::thread> eventThread;
+        volatile bool finishEventThread = false;
+
+        void eventThreadFunction();
+
+        static void transferCallback(libusb_transfer *transfer);
+
+        void onTransferFinished(Exchange &e, libusb_transfer *transfer);
+
+        void failExchange(Exchange &e, const std::string &message);
     };
 
 } /* namespace USB */
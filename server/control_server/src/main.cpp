@@ -2,6 +2,7 @@
 
 #include "NetServer.hpp"
 #include "IoServiceProvider.hpp"
+#include "Configuration.hpp"
 #include "initialization.hpp"
 
 #include <backward.hpp>
@@ -18,7 +19,10 @@ int main(int argc, char *argv[]) {
 
     Catalog c;
     c.Create("conf", "Configuration", configFiles);
-    c.Create("comm", "USBCommunicator");
+
+    bool deviceEmulated = std::shared_ptr<common::config::Configuration>(c["conf"])->getBool("DeviceEmulator.enabled");
+    c.Create("comm", deviceEmulated ? "DeviceEmulator" : "USBCommunicator");
+
     c.Create("ifaceProvider", "InterfaceProvider", true);
     c.Create("ifaceMgr", "InterfaceManager");
     c.Create("wifiInfo", "WifiInfo");
@@ -27,22 +31,33 @@ int main(int argc, char *argv[]) {
     c.Create("reqQueuer", "RequestQueuer");
     c.Create("bridgeProc", "BridgeProcessor");
     c.Create("osProc", "OSInformationProcessor");
+    c.Create("telemetry", "TelemetryPublisher");
 
     wallaroo_within(c) {
         use("conf").as("config").of("wifiInfo");
         use("conf").as("config").of("netServer");
         use("conf").as("config").of("osProc");
         use("conf").as("config").of("ifaceMgr");
+        use("conf").as("config").of("reqQueuer");
+        use("conf").as("config").of("telemetry");
+        use("conf").as("config").of("bridgeProc");
         use("ioServiceProvider").as("ioServiceProvider").of("netServer");
+        use("ioServiceProvider").as("ioServiceProvider").of("telemetry");
         use("ifaceProvider").as("interfaceProvider").of("ifaceMgr");
         use("ifaceMgr").as("interfaceManager").of("bridgeProc");
+        use("ifaceMgr").as("interfaceManager").of("telemetry");
         use("wifiInfo").as("wifiInfo").of("osProc");
         use("comm").as("communicator").of("bridgeProc");
         use("reqQueuer").as("requestQueuer").of("netServer");
         use("bridgeProc").as("requestProcessors").of("reqQueuer");
+        use("bridgeProc").as("emergencyStop").of("reqQueuer");
         use("osProc").as("requestProcessors").of("reqQueuer");
     }
 
+    if (deviceEmulated) {
+        use(c["conf"]).as("config").of(c["comm"]);
+    }
+
     c.CheckWiring();
     c.Init();
 
@@ -0,0 +1,106 @@
+#include "BinaryProtocol.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+#include <cstring>
+
+using namespace processing;
+using common::bridge::Direction;
+using common::bridge::ArmDriverMode;
+
+BOOST_AUTO_TEST_CASE(BinaryProtocolTest_Request) {
+    Request request;
+    request.serial = 123456;
+    request.skipResponse = true;
+    request.session = "operator";
+    request.maxAgeMs = 150;
+    request.command.killSwitch.set(false);
+    request.command.leftMotor.speed.set(10);
+    request.command.leftMotor.direction.set(Direction::FORWARD);
+    request.command.gripper.position.set(300);
+    request.command.calibrateArm = true;
+    request.command.lightCamera.set(true);
+    std::strcpy(request.command.lcdText, "hello");
+    request.command.lcdTextPresent = true;
+
+    uint8_t buffer[BINARY_REQUEST_MAX_LENGTH];
+    std::size_t length = encodeBinaryRequest(request, buffer, sizeof(buffer));
+
+    BOOST_CHECK(isBinaryMessage(reinterpret_cast<char *>(buffer), length));
+    BOOST_CHECK(length < 40);
+
+    Request decoded;
+    decodeBinaryRequest(buffer, length, decoded);
+
+    BOOST_CHECK_EQUAL(decoded.serial, 123456);
+    BOOST_CHECK(decoded.skipResponse);
+    BOOST_CHECK_EQUAL(decoded.session, "operator");
+    BOOST_CHECK_EQUAL(decoded.maxAgeMs, 150);
+
+    auto &c = decoded.command;
+    BOOST_CHECK(c.killSwitch.present and not c.killSwitch.value);
+    BOOST_CHECK_EQUAL(c.leftMotor.speed.value, 10);
+    BOOST_CHECK(c.leftMotor.direction.value == Direction::FORWARD);
+    BOOST_CHECK(not c.rightMotor.speed.present);
+    BOOST_CHECK(c.gripper.position.present);
+    BOOST_CHECK_EQUAL(c.gripper.position.value, 300);
+    BOOST_CHECK(not c.gripper.speed.present);
+    BOOST_CHECK(c.calibrateArm);
+    BOOST_CHECK(c.lightCamera.present and c.lightCamera.value);
+    BOOST_CHECK(not c.lightLeft.present);
+    BOOST_CHECK(c.lcdTextPresent);
+    BOOST_CHECK_EQUAL(std::strcmp(c.lcdText, "hello"), 0);
+
+    BOOST_CHECK_THROW(decodeBinaryRequest(buffer, length - 1, decoded), BinaryProtocolException);
+
+    buffer[1] = BINARY_PROTOCOL_VERSION + 1;
+    BOOST_CHECK_THROW(decodeBinaryRequest(buffer, length, decoded), BinaryProtocolException);
+
+    BOOST_CHECK_THROW(encodeBinaryRequest(request, buffer, 10), BinaryProtocolException);
+}
+
+BOOST_AUTO_TEST_CASE(BinaryProtocolTest_Response) {
+    BinaryResponse response;
+    response.serial = 77;
+    response.queueWaitUs = 1500;
+    response.executionTimeUs = 4200;
+    response.report.bridgePresent = true;
+    response.report.bridge.lightLeft = true;
+    response.report.bridge.buttonEnter = true;
+    response.report.bridge.killSwitch = KillSwitchStatus::HARDWARE;
+    response.report.bridge.armMode = ArmDriverMode::POSITIONAL;
+    response.report.bridge.rightMotor.speed = 11;
+    response.report.bridge.rightMotor.direction = Direction::BACKWARD;
+    response.report.bridge.elbow.position = 512;
+    response.report.bridge.voltage = 12.3;
+    response.report.bridge.current = 1.5;
+    response.report.wifiPresent = true;
+    response.report.wifi.signalStrength = -55;
+    response.report.wifi.txBitrate = 65;
+
+    uint8_t buffer[BINARY_RESPONSE_MAX_LENGTH];
+    std::size_t length = encodeBinaryResponse(response, buffer, sizeof(buffer));
+
+    BinaryResponse decoded;
+    decodeBinaryResponse(buffer, length, decoded);
+
+    BOOST_CHECK_EQUAL(decoded.serial, 77);
+    BOOST_CHECK_EQUAL(decoded.queueWaitUs, 1500);
+    BOOST_CHECK_EQUAL(decoded.executionTimeUs, 4200);
+
+    auto &b = decoded.report.bridge;
+    BOOST_CHECK(decoded.report.bridgePresent);
+    BOOST_CHECK(b.lightLeft and not b.lightRight);
+    BOOST_CHECK(b.buttonEnter and not b.buttonUp);
+    BOOST_CHECK(b.killSwitch == KillSwitchStatus::HARDWARE);
+    BOOST_CHECK(b.armMode == ArmDriverMode::POSITIONAL);
+    BOOST_CHECK_EQUAL(b.rightMotor.speed, 11);
+    BOOST_CHECK(b.rightMotor.direction == Direction::BACKWARD);
+    BOOST_CHECK_EQUAL(b.elbow.position, 512);
+    BOOST_CHECK_CLOSE(b.voltage, 12.3, 0.1);
+    BOOST_CHECK_CLOSE(b.current, 1.5, 0.1);
+
+    BOOST_CHECK(decoded.report.wifiPresent);
+    BOOST_CHECK_CLOSE(decoded.report.wifi.signalStrength, -55, 0.1);
+    BOOST_CHECK_CLOSE(decoded.report.wifi.txBitrate, 65, 0.1);
+}
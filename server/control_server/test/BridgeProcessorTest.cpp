@@ -1,11 +1,23 @@
 #include "BridgeProcessor.hpp"
+#include "ReportSerializer.hpp"
+#include "RequestQueuer.hpp"
+#include "DeviceEmulator.hpp"
+#include "NetServer.hpp"
 
 #include <boost/test/unit_test.hpp>
 #include <wallaroo/catalog.h>
-#include <minijson_writer.hpp>
+
+#include <sys/socket.h>
 
 #include <thread>
 #include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <deque>
+#include <future>
+#include <algorithm>
+#include <string>
 
 using namespace std;
 using namespace std::chrono;
@@ -14,31 +26,432 @@ static void execTest(const shared_ptr<bridge::BridgeProcessor> &proc) {
     this_thread::sleep_for(milliseconds(500));
 
     processing::Request req;
-    req.ipAddress = boost::asio::ip::address();
+    req.client = boost::asio::ip::udp::endpoint();
+
+    processing::Report report;
+    proc->process(req, report);
 
-    std::stringstream respStream;
-    minijson::object_writer resp(respStream);
-    proc->process(req, resp);
-    BOOST_TEST_MESSAGE(respStream.str());
+    processing::ReportSerializer serializer;
+    char text[512];
+    BOOST_TEST_MESSAGE(std::string(text, serializer.serialize(report, text, sizeof(text))));
     for (int i = 0; i < 30; i++) {
-        proc->process(req, resp);
+        proc->process(req, report);
         this_thread::sleep_for(milliseconds(40));
     }
     BOOST_CHECK_EQUAL(1, 1);
 }
 
+/**
+ * Creates the bridge part of the control server as in main.cpp, with the emulated device.
+ */
+static void createBridgeWithEmulatedDevice(wallaroo::Catalog &catalog) {
+    catalog.Create("conf", "Configuration");
+    catalog.Create("comm", "DeviceEmulator");
+    catalog.Create("ifaceProvider", "InterfaceProvider", true);
+    catalog.Create("ifaceMgr", "InterfaceManager");
+    catalog.Create("bp", "BridgeProcessor");
+
+    wallaroo_within(catalog) {
+        wallaroo::use("conf").as("config").of("comm");
+        wallaroo::use("conf").as("config").of("ifaceMgr");
+        wallaroo::use("conf").as("config").of("bp");
+        wallaroo::use("ifaceProvider").as("interfaceProvider").of("ifaceMgr");
+        wallaroo::use("ifaceMgr").as("interfaceManager").of("bp");
+        wallaroo::use("comm").as("communicator").of("bp");
+    }
+
+    std::shared_ptr<common::config::Configuration> config = catalog["conf"];
+    config->putInt("DeviceEmulator.latency_us", 1000);
+    config->putInt("DeviceEmulator.jitter_us", 200);
+    config->putInt("BridgeProcessor.sync_rate_hz", 100);
+    config->putInt("BridgeProcessor.sync_thread_priority", 0);
+}
+
 BOOST_AUTO_TEST_CASE(BridgeProcessorTest_Run) {
     wallaroo::Catalog catalog;
+    createBridgeWithEmulatedDevice(catalog);
 
-    catalog.Create("comm", "USBCommunicator");
-    catalog.Create("bp", "BridgeProcessor");
+    catalog.CheckWiring();
+    catalog.Init();
+
+    shared_ptr<bridge::BridgeProcessor> proc = catalog["bp"];
+
+    execTest(proc);
+}
+
+BOOST_AUTO_TEST_CASE(BridgeProcessorTest_ReportReflectsCommand) {
+    using processing::KillSwitchStatus;
 
-    wallaroo::use(catalog["comm"]).as("communicator").of(catalog["bp"]);
+    wallaroo::Catalog catalog;
+    createBridgeWithEmulatedDevice(catalog);
 
     catalog.CheckWiring();
+    catalog.Init();
 
     shared_ptr<bridge::BridgeProcessor> proc = catalog["bp"];
 
-    execTest(proc);
+    processing::Report report;
+
+    // the kill switch is deactivated only when the device confirms it
+    processing::Request release;
+    release.command.killSwitch.set(false);
+    proc->process(release, report);
+
+    processing::Request empty;
+
+    for (int i = 0; i < 100 and report.bridge.killSwitch != KillSwitchStatus::INACTIVE; i++) {
+        this_thread::sleep_for(milliseconds(10));
+        proc->process(empty, report);
+    }
+
+    BOOST_REQUIRE(report.bridge.killSwitch == KillSwitchStatus::INACTIVE);
+    BOOST_REQUIRE(not report.bridge.lightLeft);
+
+    // the setters change the reported values before the next synchronization
+    processing::Request lightOn;
+    lightOn.command.lightLeft.set(true);
+    proc->process(lightOn, report);
+
+    BOOST_CHECK(report.bridge.lightLeft);
+
+    processing::Request stop;
+    stop.command.killSwitch.set(true);
+    proc->process(stop, report);
+
+    BOOST_CHECK(report.bridge.killSwitch == KillSwitchStatus::SOFTWARE);
+}
+
+/**
+ * Drives the whole control path over UDP: NetServer, RequestQueuer, BridgeProcessor and the emulated device.
+ * Reports the round trip times of the requests.
+ */
+BOOST_AUTO_TEST_CASE(BridgeProcessorTest_Headless) {
+    using boost::asio::ip::udp;
+
+    constexpr int PORT = 10261;
+    constexpr int NUMBER_OF_REQUESTS = 500;
+
+    wallaroo::Catalog catalog;
+    createBridgeWithEmulatedDevice(catalog);
+
+    catalog.Create("ioServiceProvider", "IoServiceProvider");
+    catalog.Create("netServer", "NetServer");
+    catalog.Create("rq", "RequestQueuer");
+
+    wallaroo_within(catalog) {
+        wallaroo::use("conf").as("config").of("netServer");
+        wallaroo::use("conf").as("config").of("rq");
+        wallaroo::use("ioServiceProvider").as("ioServiceProvider").of("netServer");
+        wallaroo::use("rq").as("requestQueuer").of("netServer");
+        wallaroo::use("bp").as("requestProcessors").of("rq");
+        wallaroo::use("bp").as("emergencyStop").of("rq");
+    }
+
+    std::shared_ptr<common::config::Configuration> config = catalog["conf"];
+    config->putInt("NetServer.port", PORT);
+    config->putBool("NetServer.enable_ipv6", false);
+    config->putString("RequestQueuer.policy", "latest_wins");
+    config->putString("RequestQueuer.controller_session", "");
+    config->putInt("RequestQueuer.controller_weight", 1);
+    config->putInt("RequestQueuer.default_max_age_ms", 0);
+    config->putInt("RequestQueuer.delta_keyframe_interval", 0);
+
+    catalog.CheckWiring();
+    catalog.Init();
+
+    std::shared_ptr<bridge::DeviceEmulator> device = catalog["comm"];
+    auto &ioContext = std::shared_ptr<common::IoServiceProvider>(catalog["ioServiceProvider"])->getIoContext();
+
+    thread serverThread([&] { ioContext.run(); });
+
+    boost::asio::io_context clientContext;
+    udp::socket socket(clientContext, udp::endpoint(udp::v4(), 0));
+
+    timeval timeout = {1, 0};
+    setsockopt(socket.native_handle(), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    udp::endpoint serverEndpoint(boost::asio::ip::address_v4::loopback(), PORT);
+    char response[2048];
+
+    vector<long> roundTripsMicroseconds;
+    int lastSpeed = 0;
+
+    for (int serial = 1; serial <= NUMBER_OF_REQUESTS; ++serial) {
+        lastSpeed = serial % (common::bridge::MOTOR_DRIVER_MAX_SPEED + 1);
+        string request = R"({"serial":)" + to_string(serial) + R"(,"ks_en":false,"m":{"l":{"s":)"
+                         + to_string(lastSpeed) + R"(,"d":"forward"}}})";
+
+        auto sendTime = steady_clock::now();
+        socket.send_to(boost::asio::buffer(request), serverEndpoint);
+
+        boost::system::error_code err;
+        size_t length = socket.receive(boost::asio::buffer(response), 0, err);
+
+        if (err) {
+            continue;
+        }
+
+        roundTripsMicroseconds.push_back(duration_cast<microseconds>(steady_clock::now() - sendTime).count());
+
+        BOOST_CHECK(string(response, length).find(R"("serial":)" + to_string(serial)) != string::npos);
+    }
+
+    // the desired state reaches the device at the next synchronizations
+    this_thread::sleep_for(milliseconds(100));
+
+    boost::asio::post(ioContext, [&] { ioContext.stop(); });
+    serverThread.join();
+
+    BOOST_CHECK_EQUAL(roundTripsMicroseconds.size(), NUMBER_OF_REQUESTS);
+    BOOST_CHECK(not device->isKillSwitchActive());
+    BOOST_CHECK_EQUAL(device->getMotorState(motor::MOTOR1).speed, lastSpeed);
+    BOOST_CHECK_EQUAL(device->getMotorState(motor::MOTOR1).direction, motor::FORWARD);
+
+    BOOST_REQUIRE(not roundTripsMicroseconds.empty());
+    std::sort(roundTripsMicroseconds.begin(), roundTripsMicroseconds.end());
+
+    BOOST_TEST_MESSAGE("Round trip of " << roundTripsMicroseconds.size() << " requests: median "
+                       << roundTripsMicroseconds[roundTripsMicroseconds.size() / 2] << " us, 99th percentile "
+                       << roundTripsMicroseconds[roundTripsMicroseconds.size() * 99 / 100] << " us, max "
+                       << roundTripsMicroseconds.back() << " us.");
 }
 
+
+/**
+ * Device which takes the fixed time to answer each packet and remembers the packets with the time of their arrival.
+ * Like the real one, it accepts the next packet before the previous one is answered and executes them in order,
+ * so the exchanges are pipelined.
+ */
+class SimulatedDeviceMock : public bridge::ICommunicator, public wallaroo::Part {
+public:
+    static constexpr milliseconds EXCHANGE_DURATION{8};
+
+    SimulatedDeviceMock()
+            : deviceThread(&SimulatedDeviceMock::deviceThreadFunction, this) {
+    }
+
+    ~SimulatedDeviceMock() {
+        {
+            lock_guard<mutex> lk(queueMutex);
+            finish = true;
+        }
+        queueCv.notify_all();
+        deviceThread.join();
+    }
+
+    void sendData(std::vector<uint8_t> &data) override {
+        pendingResponse = exchange(data);
+    }
+
+    std::vector<uint8_t> &receiveData() override {
+        response = pendingResponse.get();
+        return response;
+    }
+
+    std::future<std::vector<uint8_t>> exchange(std::vector<uint8_t> &data) override {
+        lock_guard<mutex> lk(queueMutex);
+
+        queue.emplace_back(data, promise<vector<uint8_t>>());
+        maxExchangesInFlight = std::max<unsigned int>(maxExchangesInFlight, queue.size() + (busy ? 1 : 0));
+
+        auto future = queue.back().second.get_future();
+        queueCv.notify_one();
+        return future;
+    }
+
+    unsigned int getMaxExchangesInFlight() {
+        lock_guard<mutex> lk(queueMutex);
+        return maxExchangesInFlight;
+    }
+
+    /**
+     * @return time of arrival of the first kill switch packet after the given time
+     */
+    bool findKillSwitchPacket(steady_clock::time_point after, steady_clock::time_point &arrival) {
+        lock_guard<mutex> lk(packetsMutex);
+
+        for (auto &p : packets) {
+            if (p.first >= after and p.second.size() >= 3 and p.second[0] == USBCommands::BRIDGE_SET_KILLSWITCH) {
+                BOOST_CHECK_EQUAL(p.second[1], USBCommands::bridge::ACTIVE);
+                BOOST_CHECK_EQUAL(p.second[2], USBCommands::MESSAGE_END);
+                arrival = p.first;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+private:
+    mutex packetsMutex;
+    vector<pair<steady_clock::time_point, vector<uint8_t>>> packets;
+
+    mutex queueMutex;
+    condition_variable queueCv;
+    deque<pair<vector<uint8_t>, promise<vector<uint8_t>>>> queue;
+    bool busy = false;
+    bool finish = false;
+    unsigned int maxExchangesInFlight = 0;
+
+    future<vector<uint8_t>> pendingResponse;
+    vector<uint8_t> response;
+
+    thread deviceThread;
+
+    void deviceThreadFunction() {
+        while (true) {
+            unique_lock<mutex> lk(queueMutex);
+            queueCv.wait(lk, [&]() { return finish or not queue.empty(); });
+
+            if (queue.empty()) {
+                return;
+            }
+
+            auto exchange = std::move(queue.front());
+            queue.pop_front();
+            busy = true;
+            lk.unlock();
+
+            // the packet arrives when the device is ready to execute it
+            {
+                lock_guard<mutex> packetsLk(packetsMutex);
+                packets.push_back(make_pair(steady_clock::now(), exchange.first));
+            }
+
+            this_thread::sleep_for(EXCHANGE_DURATION);
+            exchange.second.set_value(vector<uint8_t>(64, USBCommands::MESSAGE_END));
+
+            lk.lock();
+            busy = false;
+        }
+    }
+};
+
+constexpr milliseconds SimulatedDeviceMock::EXCHANGE_DURATION;
+
+WALLAROO_REGISTER(SimulatedDeviceMock);
+
+/**
+ * Keeps the synchronization thread busy with the device without parsing the responses.
+ */
+class InterfaceManagerMock : public bridge::IInterfaceManager, public wallaroo::Part {
+public:
+    InterfaceManagerMock()
+            : interfaceProvider("interfaceProvider", RegistrationToken()) {
+    }
+
+    void syncWithDevice(bridge::BridgeSyncFunction syncFunction) override {
+        std::vector<uint8_t> packet = {USBCommands::BRIDGE_GET_STATE, USBCommands::MESSAGE_END};
+        syncFunction(packet);
+    }
+
+    void submitSync(bridge::BridgeExchangeFunction exchangeFunction) override {
+        std::vector<uint8_t> packet = {USBCommands::BRIDGE_GET_STATE, USBCommands::MESSAGE_END};
+        pendingResponses.push_back(exchangeFunction(packet));
+    }
+
+    void waitForSync() override {
+        pendingResponses.front().wait();
+    }
+
+    void completeSync() override {
+        auto response = std::move(pendingResponses.front());
+        pendingResponses.pop_front();
+        response.get();
+    }
+
+    unsigned int getNumOfPendingSyncs() override {
+        return pendingResponses.size();
+    }
+
+    common::bridge::Interface &iface() override {
+        return *interfaceProvider->getInterface();
+    }
+
+private:
+    wallaroo::Collaborator<common::bridge::InterfaceProvider> interfaceProvider;
+    deque<future<vector<uint8_t>>> pendingResponses;
+};
+
+WALLAROO_REGISTER(InterfaceManagerMock);
+
+BOOST_AUTO_TEST_CASE(BridgeProcessorTest_KillSwitchLatency) {
+    constexpr int NUMBER_OF_STOPS = 20;
+
+    wallaroo::Catalog catalog;
+
+    catalog.Create("conf", "Configuration");
+    catalog.Create("ifaceProvider", "InterfaceProvider", true);
+    catalog.Create("ifaceMgr", "InterfaceManagerMock");
+    catalog.Create("device", "SimulatedDeviceMock");
+    catalog.Create("bp", "BridgeProcessor");
+    catalog.Create("rq", "RequestQueuer");
+
+    wallaroo_within(catalog) {
+        wallaroo::use("conf").as("config").of("bp");
+        wallaroo::use("conf").as("config").of("rq");
+        wallaroo::use("ifaceProvider").as("interfaceProvider").of("ifaceMgr");
+        wallaroo::use("ifaceMgr").as("interfaceManager").of("bp");
+        wallaroo::use("device").as("communicator").of("bp");
+        wallaroo::use("bp").as("requestProcessors").of("rq");
+        wallaroo::use("bp").as("emergencyStop").of("rq");
+    }
+
+    std::shared_ptr<common::config::Configuration> config = catalog["conf"];
+    config->putInt("BridgeProcessor.sync_rate_hz", 100);
+    config->putInt("BridgeProcessor.sync_thread_priority", 0);
+    config->putString("RequestQueuer.policy", "priority_queue");
+    config->putString("RequestQueuer.controller_session", "");
+    config->putInt("RequestQueuer.controller_weight", 1);
+    config->putInt("RequestQueuer.default_max_age_ms", 0);
+    config->putInt("RequestQueuer.delta_keyframe_interval", 0);
+
+    catalog.CheckWiring();
+    catalog.Init();
+
+    std::shared_ptr<processing::RequestQueuer> rq = catalog["rq"];
+    std::shared_ptr<SimulatedDeviceMock> device = catalog["device"];
+    std::shared_ptr<bridge::BridgeProcessor> proc = catalog["bp"];
+
+    rq->setResponseSender([](long id, std::string response, bool transmit) {
+    });
+    rq->setRejectedRequestRemover([](long id) {
+    });
+
+    // the synchronization keeps the device busy for 8 ms of each 10 ms, so the kill switch usually comes
+    // during the exchange and has to wait for its end and for the pipelined one, but not for the next tick
+    vector<long> latenciesMicroseconds;
+
+    for (int i = 1; i <= NUMBER_OF_STOPS; ++i) {
+        this_thread::sleep_for(milliseconds(20 + i % 7));
+
+        auto requestTime = steady_clock::now();
+        std::string request = R"({"serial":)" + std::to_string(i) + R"(,"ks_en":true})";
+        BOOST_REQUIRE(rq->addRequest(request, boost::asio::ip::udp::endpoint()) != processing::INVALID_MESSAGE);
+
+        steady_clock::time_point arrival;
+        auto deadline = requestTime + seconds(1);
+        while (not device->findKillSwitchPacket(requestTime, arrival) and steady_clock::now() < deadline) {
+            this_thread::sleep_for(microseconds(100));
+        }
+
+        BOOST_REQUIRE(arrival >= requestTime);
+
+        latenciesMicroseconds.push_back(duration_cast<microseconds>(arrival - requestTime).count());
+    }
+
+    std::sort(latenciesMicroseconds.begin(), latenciesMicroseconds.end());
+    long percentileMicroseconds = latenciesMicroseconds[latenciesMicroseconds.size() * 9 / 10];
+
+    BOOST_TEST_MESSAGE("Kill switch latency: 90th percentile " << percentileMicroseconds << " us, max "
+                       << latenciesMicroseconds.back() << " us.");
+
+    // the threads run with the default scheduling, so single stops may be delayed by the machine load;
+    // waiting for the next tick would add whole periods
+    BOOST_CHECK(percentileMicroseconds < duration_cast<microseconds>(
+            2 * SimulatedDeviceMock::EXCHANGE_DURATION + milliseconds(10)).count());
+    BOOST_CHECK_EQUAL(proc->getKillSwitchLatencyHistogram().getCount(), NUMBER_OF_STOPS);
+
+    // the synchronizations are pipelined
+    BOOST_CHECK(device->getMaxExchangesInFlight() >= 2);
+}
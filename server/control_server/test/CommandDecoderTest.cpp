@@ -0,0 +1,79 @@
+#include "CommandDecoder.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <cstring>
+
+using namespace std;
+using namespace processing;
+using common::bridge::Direction;
+
+static void decode(CommandDecoder &decoder, string text, Request &request) {
+    decoder.decode(&text[0], text.size(), request);
+}
+
+BOOST_AUTO_TEST_CASE(CommandDecoderTest_Decode) {
+    CommandDecoder decoder;
+    Request request;
+
+    decode(decoder, R"({
+        "serial" : 123,
+        "tss" : "12:34:56.789",
+        "session" : "operator",
+        "max_age" : 150,
+        "unknown" : { "s" : 1, "list" : [1, 2, 3] },
+        "ks_en" : false,
+        "lcd" : "hello",
+        "m" : {
+            "l" : { "s" : 12, "d" : "forward" },
+            "r" : { "s" : 34, "d" : "BACKWARD" }
+        },
+        "a" : {
+            "s" : { "s" : 100, "p" : 45 },
+            "g" : { "d" : "sideways" },
+            "b_cal" : true
+        },
+        "e" : { "cam" : true, "l" : false }
+    })", request);
+
+    BOOST_CHECK_EQUAL(request.serial, 123);
+    BOOST_CHECK_EQUAL(request.sendTimestamp, "12:34:56.789");
+    BOOST_CHECK_EQUAL(request.session, "operator");
+    BOOST_CHECK_EQUAL(request.maxAgeMs, 150);
+    BOOST_CHECK(not request.skipResponse);
+
+    auto &c = request.command;
+
+    BOOST_CHECK(c.killSwitch.present and not c.killSwitch.value);
+    BOOST_CHECK(c.lcdTextPresent);
+    BOOST_CHECK_EQUAL(std::strcmp(c.lcdText, "hello"), 0);
+
+    BOOST_CHECK(c.leftMotor.speed.present);
+    BOOST_CHECK_EQUAL(c.leftMotor.speed.value, 12);
+    BOOST_CHECK(c.leftMotor.direction.value == Direction::FORWARD);
+    BOOST_CHECK_EQUAL(c.rightMotor.speed.value, 34);
+    BOOST_CHECK(c.rightMotor.direction.value == Direction::BACKWARD);
+
+    BOOST_CHECK_EQUAL(c.shoulder.speed.value, 100);
+    BOOST_CHECK(c.shoulder.position.present);
+    BOOST_CHECK_EQUAL(c.shoulder.position.value, 45);
+    BOOST_CHECK(not c.shoulder.direction.present);
+    BOOST_CHECK(not c.elbow.speed.present);
+    BOOST_CHECK(not c.gripper.direction.present);
+    BOOST_CHECK(c.calibrateArm);
+
+    BOOST_CHECK(c.lightCamera.present and c.lightCamera.value);
+    BOOST_CHECK(c.lightLeft.present and not c.lightLeft.value);
+    BOOST_CHECK(not c.lightRight.present);
+
+    // the command is cleared before decoding the next request
+    decode(decoder, R"({"serial" : 124, "lcd" : "this text is longer than the display can show"})", request);
+
+    BOOST_CHECK_EQUAL(request.serial, 124);
+    BOOST_CHECK(not request.command.leftMotor.speed.present);
+    BOOST_CHECK(not request.command.calibrateArm);
+    BOOST_CHECK_EQUAL(std::strlen(request.command.lcdText), COMMAND_LCD_TEXT_MAX_LENGTH);
+
+    BOOST_CHECK_THROW(decode(decoder, "not a json", request), minijson::parse_error);
+}
@@ -0,0 +1,238 @@
+#include "DeviceEmulator.hpp"
+#include "InterfaceManager.hpp"
+#include "usb-settings.hpp"
+
+#include <boost/test/unit_test.hpp>
+#include <wallaroo/catalog.h>
+
+#include <vector>
+#include <chrono>
+#include <memory>
+#include <future>
+#include <cstring>
+
+using namespace std;
+using namespace std::chrono;
+using namespace bridge;
+using namespace common::bridge;
+
+BOOST_AUTO_TEST_CASE(DeviceEmulatorTest_Packets) {
+    DeviceEmulator emulator;
+
+    // the device starts with the kill switch active
+    auto response = emulator.processPacket({USBCommands::BRIDGE_GET_STATE, USBCommands::MESSAGE_END});
+
+    BOOST_REQUIRE_EQUAL(response.size(), USB_SETTINGS_DEVICE_TO_HOST_DATAPACKET_SIZE);
+
+    USBCommands::bridge::State state;
+    std::memcpy(&state, &response[0], sizeof(state));
+    BOOST_CHECK_EQUAL(state.killSwitch, USBCommands::bridge::ACTIVE);
+    BOOST_CHECK(state.rawVoltage > 0);
+    BOOST_CHECK_EQUAL(response[sizeof(state)], USBCommands::MESSAGE_END);
+
+    // the drivers are held in reset
+    emulator.processPacket({USBCommands::MOTOR_DRIVER_SET, motor::MOTOR1, motor::FORWARD, 50,
+                            USBCommands::MESSAGE_END});
+    BOOST_CHECK_EQUAL(emulator.getMotorState(motor::MOTOR1).speed, 0);
+
+    response = emulator.processPacket({USBCommands::BRIDGE_SET_KILLSWITCH, USBCommands::bridge::INACTIVE,
+                                       USBCommands::MOTOR_DRIVER_SET, motor::MOTOR1, motor::FORWARD, 50,
+                                       USBCommands::BRIDGE_LCD_SET, 5, 'h', 'e', 'l', 'l', 'o',
+                                       USBCommands::EXPANDER_SET, 0x05,
+                                       USBCommands::ARM_DRIVER_SET, arm::ELBOW, arm::STOP, 30, true, 120,
+                                       USBCommands::MOTOR_DRIVER_GET, motor::MOTOR1,
+                                       USBCommands::EXPANDER_GET,
+                                       USBCommands::ARM_DRIVER_GET, arm::ELBOW,
+                                       USBCommands::ARM_DRIVER_GET_GENERAL_STATE,
+                                       USBCommands::MESSAGE_END});
+
+    BOOST_CHECK(not emulator.isKillSwitchActive());
+    BOOST_CHECK_EQUAL(emulator.getLCDText(), "hello");
+    BOOST_CHECK_EQUAL(emulator.getExpanderValue(), 0x05);
+
+    // only the getters produce the data, in the order of the requests
+    USBCommands::motor::SpecificMotorState motorState;
+    std::memcpy(&motorState, &response[0], sizeof(motorState));
+    BOOST_CHECK_EQUAL(motorState.motor, motor::MOTOR1);
+    BOOST_CHECK_EQUAL(motorState.direction, motor::FORWARD);
+    BOOST_CHECK_EQUAL(motorState.speed, 50);
+
+    BOOST_CHECK_EQUAL(response[3], 0x05);
+
+    USBCommands::arm::JointState joint;
+    std::memcpy(&joint, &response[4], sizeof(joint));
+    BOOST_CHECK_EQUAL(joint.motor, arm::ELBOW);
+    BOOST_CHECK_EQUAL(joint.speed, 30);
+    BOOST_CHECK_EQUAL(joint.position, 120);
+
+    USBCommands::arm::GeneralState general;
+    std::memcpy(&general, &response[9], sizeof(general));
+    BOOST_CHECK(not general.isCalibrated);
+    BOOST_CHECK_EQUAL(general.mode, arm::POS);
+
+    for (unsigned int i = 11; i < response.size(); i++) {
+        BOOST_CHECK_EQUAL(response[i], USBCommands::MESSAGE_END);
+    }
+
+    // activating the kill switch stops the drivers
+    emulator.processPacket({USBCommands::BRIDGE_SET_KILLSWITCH, USBCommands::bridge::ACTIVE,
+                            USBCommands::MESSAGE_END});
+    BOOST_CHECK(emulator.isKillSwitchActive());
+    BOOST_CHECK_EQUAL(emulator.getMotorState(motor::MOTOR1).speed, 0);
+    BOOST_CHECK_EQUAL(emulator.getJointState(arm::ELBOW).speed, 0);
+
+    // truncated arguments aren't read past the packet
+    response = emulator.processPacket({USBCommands::BRIDGE_GET_STATE, USBCommands::BRIDGE_LCD_SET, 200, 'x'});
+    BOOST_CHECK_EQUAL(response[sizeof(state)], USBCommands::MESSAGE_END);
+    BOOST_CHECK_EQUAL(emulator.getNumOfPackets(), 5);
+}
+
+BOOST_AUTO_TEST_CASE(DeviceEmulatorTest_InterfaceManager) {
+    constexpr int LATENCY_US = 2000;
+
+    wallaroo::Catalog catalog;
+    catalog.Create("conf", "Configuration");
+    catalog.Create("ifaceProvider", "InterfaceProvider", true);
+    catalog.Create("mgr", "InterfaceManager");
+    catalog.Create("device", "DeviceEmulator");
+
+    wallaroo_within(catalog) {
+        wallaroo::use("conf").as("config").of("mgr");
+        wallaroo::use("conf").as("config").of("device");
+        wallaroo::use("ifaceProvider").as("interfaceProvider").of("mgr");
+    }
+
+    std::shared_ptr<common::config::Configuration> config = catalog["conf"];
+    config->putInt("DeviceEmulator.latency_us", LATENCY_US);
+    config->putInt("DeviceEmulator.jitter_us", 500);
+
+    catalog.CheckWiring();
+    catalog.Init();
+
+    std::shared_ptr<IInterfaceManager> interfaceManager = catalog["mgr"];
+    std::shared_ptr<DeviceEmulator> device = catalog["device"];
+
+    auto &iface = interfaceManager->iface();
+
+    iface.setKillSwitch(false);
+    iface.motor[Motor::LEFT].setSpeed(10);
+    iface.setLCDText("emulated");
+
+    auto start = steady_clock::now();
+
+    for (int i = 0; i < 4; i++) {
+        interfaceManager->submitSync([&](vector<uint8_t> &packet) {
+            return device->exchange(packet);
+        });
+        interfaceManager->completeSync();
+    }
+
+    BOOST_CHECK(steady_clock::now() - start >= microseconds(4 * LATENCY_US));
+
+    BOOST_CHECK(not device->isKillSwitchActive());
+    BOOST_CHECK_EQUAL(device->getMotorState(motor::MOTOR1).speed, 10);
+    BOOST_CHECK_EQUAL(device->getLCDText(), "emulated");
+
+    BOOST_CHECK(not iface.isKillSwitchActive());
+    BOOST_CHECK(iface.getVoltage() > 0);
+}
+
+BOOST_AUTO_TEST_CASE(DeviceEmulatorTest_StateVersion) {
+    wallaroo::Catalog catalog;
+    catalog.Create("conf", "Configuration");
+    catalog.Create("ifaceProvider", "InterfaceProvider", true);
+    catalog.Create("mgr", "InterfaceManager");
+    catalog.Create("device", "DeviceEmulator");
+
+    wallaroo_within(catalog) {
+        wallaroo::use("conf").as("config").of("mgr");
+        wallaroo::use("conf").as("config").of("device");
+        wallaroo::use("ifaceProvider").as("interfaceProvider").of("mgr");
+    }
+
+    std::shared_ptr<common::config::Configuration> config = catalog["conf"];
+    config->putInt("DeviceEmulator.latency_us", 0);
+    config->putInt("DeviceEmulator.jitter_us", 0);
+
+    catalog.CheckWiring();
+    catalog.Init();
+
+    std::shared_ptr<IInterfaceManager> interfaceManager = catalog["mgr"];
+    std::shared_ptr<DeviceEmulator> device = catalog["device"];
+
+    auto &iface = interfaceManager->iface();
+
+    auto sync = [&]() {
+        interfaceManager->syncWithDevice([&](vector<uint8_t> &packet) {
+            return device->exchange(packet).get();
+        });
+    };
+
+    iface.setKillSwitch(false);
+    iface.motor[Motor::LEFT].setSpeed(10);
+
+    // all rotating getters are sent and the averaged voltage settles
+    for (int i = 0; i < 8; i++) {
+        sync();
+    }
+
+    uint64_t version = iface.getStateVersion();
+
+    // the getters differ between the syncs, but the device state doesn't
+    sync();
+    sync();
+
+    BOOST_CHECK_EQUAL(iface.getStateVersion(), version);
+
+    iface.motor[Motor::LEFT].setSpeed(20);
+    sync();
+
+    BOOST_CHECK(iface.getStateVersion() > version);
+}
+
+BOOST_AUTO_TEST_CASE(DeviceEmulatorTest_PipelinedExchanges) {
+    constexpr int LATENCY_US = 50000;
+
+    wallaroo::Catalog catalog;
+    catalog.Create("conf", "Configuration");
+    catalog.Create("device", "DeviceEmulator");
+
+    wallaroo::use(catalog["conf"]).as("config").of(catalog["device"]);
+
+    std::shared_ptr<common::config::Configuration> config = catalog["conf"];
+    config->putInt("DeviceEmulator.latency_us", LATENCY_US);
+    config->putInt("DeviceEmulator.jitter_us", 0);
+
+    catalog.CheckWiring();
+    catalog.Init();
+
+    std::shared_ptr<DeviceEmulator> device = catalog["device"];
+
+    vector<uint8_t> setKillSwitch = {USBCommands::BRIDGE_SET_KILLSWITCH, USBCommands::bridge::INACTIVE,
+                                     USBCommands::MESSAGE_END};
+    vector<uint8_t> getState = {USBCommands::BRIDGE_GET_STATE, USBCommands::MESSAGE_END};
+
+    auto start = steady_clock::now();
+
+    // the caller doesn't wait for the device, the commands are executed at once
+    auto first = device->exchange(setKillSwitch);
+    auto second = device->exchange(getState);
+
+    BOOST_CHECK(steady_clock::now() - start < microseconds(LATENCY_US));
+    BOOST_CHECK(first.wait_for(seconds(0)) == future_status::timeout);
+    BOOST_CHECK(not device->isKillSwitchActive());
+
+    BOOST_CHECK_EQUAL(first.get().size(), USB_SETTINGS_DEVICE_TO_HOST_DATAPACKET_SIZE);
+
+    auto response = second.get();
+    BOOST_REQUIRE_EQUAL(response.size(), USB_SETTINGS_DEVICE_TO_HOST_DATAPACKET_SIZE);
+
+    USBCommands::bridge::State state;
+    std::memcpy(&state, response.data(), sizeof(state));
+    BOOST_CHECK_EQUAL(state.killSwitch, USBCommands::bridge::INACTIVE);
+
+    // both latencies overlap
+    auto elapsed = steady_clock::now() - start;
+    BOOST_CHECK(elapsed >= microseconds(LATENCY_US));
+    BOOST_CHECK(elapsed < microseconds(2 * LATENCY_US));
+}
@@ -0,0 +1,32 @@
+#include "LatencyHistogram.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+using namespace processing;
+
+BOOST_AUTO_TEST_CASE(LatencyHistogramTest_Add) {
+    LatencyHistogram histogram;
+
+    BOOST_CHECK_EQUAL(histogram.getPercentile(0.5), 0);
+
+    histogram.add(0);
+    histogram.add(1);
+    histogram.add(700);
+    histogram.add(1000);
+    histogram.add(10000000);
+
+    BOOST_CHECK_EQUAL(histogram.getCount(), 5);
+    BOOST_CHECK_EQUAL(histogram.getMax(), 10000000);
+
+    BOOST_CHECK_EQUAL(histogram.getBucketCount(0), 1);
+    BOOST_CHECK_EQUAL(histogram.getBucketCount(1), 1);
+    BOOST_CHECK_EQUAL(histogram.getBucketCount(10), 2);
+    BOOST_CHECK_EQUAL(histogram.getBucketCount(LatencyHistogram::NUMBER_OF_BUCKETS - 1), 1);
+
+    BOOST_CHECK_EQUAL(histogram.getPercentile(0.5), 1024);
+    BOOST_CHECK_EQUAL(histogram.getPercentile(0.99), 10000000);
+
+    histogram.clear();
+    BOOST_CHECK_EQUAL(histogram.getCount(), 0);
+    BOOST_CHECK_EQUAL(histogram.getMax(), 0);
+}
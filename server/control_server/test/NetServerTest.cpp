@@ -1,20 +1,35 @@
 #include "NetServer.hpp"
+#include "IRequestProcessor.hpp"
 
 #include <boost/test/unit_test.hpp>
 #include <wallaroo/catalog.h>
 
+#include <sys/resource.h>
+
+#include <atomic>
 #include <memory>
 #include <thread>
+#include <functional>
 
 using namespace std;
 using namespace processing;
 
 class RequestQueuerMock : public wallaroo::Part, public processing::IRequestQueuer {
 public:
-    virtual long addRequest(std::string request, boost::asio::ip::address address) {
+    virtual long addRequest(char *request,
+                            std::size_t length,
+                            const boost::asio::ip::udp::endpoint &client,
+                            long internalId) {
+        receivedCount++;
         id++;
         //respThread.reset(new thread(&RequestQueuerMock::respThreadFunction, this));
-        return id;
+
+        // the request is answered at once, so its route is released
+        if (callback) {
+            callback(internalId, "", false);
+        }
+
+        return internalId;
     }
 
     virtual int getNumOfMessages() {
@@ -33,6 +48,8 @@ public:
 
     }
 
+    std::atomic<unsigned long> receivedCount{0};
+
     ~RequestQueuerMock() {
         if (respThread.get() != nullptr) {
             respThread->join();
@@ -72,3 +89,225 @@ BOOST_AUTO_TEST_CASE(NetServerTest_Run) {
 
     BOOST_CHECK_EQUAL(1, 1);
 }
+
+static double getThreadCpuTimeMs() {
+    rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    return usage.ru_utime.tv_sec * 1e3 + usage.ru_utime.tv_usec / 1e3
+           + usage.ru_stime.tv_sec * 1e3 + usage.ru_stime.tv_usec / 1e3;
+}
+
+/**
+ * Floods the server like tests/flood.py and reports the packets received per second and the CPU time
+ * of the server thread per packet.
+ */
+BOOST_AUTO_TEST_CASE(NetServerTest_Flood) {
+    using boost::asio::ip::udp;
+
+    constexpr int PORT = 10260;
+    constexpr int NUMBER_OF_PACKETS = 50000;
+
+    wallaroo::Catalog catalog;
+
+    catalog.Create("conf", "Configuration");
+    catalog.Create("rq", "RequestQueuerMock");
+    catalog.Create("netServer", "NetServer");
+    catalog.Create("ioServiceProvider", "IoServiceProvider");
+
+    wallaroo_within(catalog) {
+        wallaroo::use("conf").as("config").of("netServer");
+        wallaroo::use("rq").as("requestQueuer").of("netServer");
+        wallaroo::use("ioServiceProvider").as("ioServiceProvider").of("netServer");
+    };
+
+    auto config = std::shared_ptr<common::config::Configuration>(catalog["conf"]);
+    config->putInt("NetServer.port", PORT);
+    config->putBool("NetServer.enable_ipv6", false);
+
+    catalog.CheckWiring();
+    catalog.Init();
+
+    auto server = std::shared_ptr<INetServer>(catalog["netServer"]);
+    auto queuer = std::shared_ptr<RequestQueuerMock>(catalog["rq"]);
+    auto &ioContext = std::shared_ptr<common::IoServiceProvider>(catalog["ioServiceProvider"])->getIoContext();
+
+    double cpuTimeStart = 0, cpuTimeEnd = 0;
+    boost::asio::post(ioContext, [&] { cpuTimeStart = getThreadCpuTimeMs(); });
+
+    thread serverThread([&] { ioContext.run(); });
+
+    auto start = chrono::steady_clock::now();
+
+    boost::asio::io_context clientContext;
+    udp::socket socket(clientContext, udp::endpoint(udp::v4(), 0));
+    udp::endpoint serverEndpoint(boost::asio::ip::address_v4::loopback(), PORT);
+
+    for (int serial = 1; serial <= NUMBER_OF_PACKETS; ++serial) {
+        string request = R"({"killswitch":false,"serial":)" + to_string(serial) + R"(,"lcd":"hello world"})";
+        socket.send_to(boost::asio::buffer(request), serverEndpoint);
+    }
+
+    // datagrams which don't fit in the socket buffer are lost, so the test waits only for the traffic to stop
+    unsigned long lastCount = 0;
+    do {
+        lastCount = queuer->receivedCount;
+        this_thread::sleep_for(chrono::milliseconds(100));
+    } while (queuer->receivedCount != lastCount);
+
+    auto elapsedMs = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+
+    boost::asio::post(ioContext, [&] {
+        cpuTimeEnd = getThreadCpuTimeMs();
+        ioContext.stop();
+    });
+    serverThread.join();
+
+    auto stats = server->getReceiveStatistics();
+
+    BOOST_REQUIRE(stats.datagramsReceived > 0);
+    BOOST_CHECK_EQUAL(stats.datagramsReceived, queuer->receivedCount);
+
+    BOOST_TEST_MESSAGE(stats.datagramsReceived << " of " << NUMBER_OF_PACKETS << " packets received, "
+                       << stats.datagramsReceived * 1000.0 / elapsedMs << " packets/s, "
+                       << static_cast<double>(stats.datagramsReceived) / stats.batches << " packets/wake-up, "
+                       << (cpuTimeEnd - cpuTimeStart) * 1000.0 / stats.datagramsReceived << " us CPU/packet.");
+}
+
+/**
+ * Keeps the routes of all requests, so the routing table fills up. The requests without the route are passed
+ * to the real queuer.
+ */
+class RouteHoldingQueuerMock : public wallaroo::Part, public processing::IRequestQueuer {
+public:
+    RouteHoldingQueuerMock()
+            : queuer("queuer", RegistrationToken()) {
+    }
+
+    virtual long addRequest(char *request,
+                            std::size_t length,
+                            const boost::asio::ip::udp::endpoint &client,
+                            long internalId) {
+        if (internalId == NO_RESPONSE_ROUTE) {
+            unroutedCount++;
+            return std::shared_ptr<IRequestQueuer>(queuer)->addRequest(request, length, client, internalId);
+        }
+
+        heldCount++;
+        return internalId;
+    }
+
+    virtual int getNumOfMessages() {
+        return heldCount;
+    }
+
+    virtual int getNumOfProcessors() {
+        return 0;
+    }
+
+    virtual void setResponseSender(ResponseSender s) {
+    }
+
+    virtual void setRejectedRequestRemover(RejectedRequestRemover r) {
+    }
+
+    std::atomic<unsigned long> heldCount{0};
+    std::atomic<unsigned long> unroutedCount{0};
+
+private:
+    wallaroo::Collaborator<IRequestQueuer> queuer;
+};
+
+WALLAROO_REGISTER(RouteHoldingQueuerMock);
+
+class EmergencyStopCounter : public processing::IEmergencyStop, public wallaroo::Part {
+public:
+    void activateKillSwitch() override {
+        activationsCount++;
+    }
+
+    std::atomic<int> activationsCount{0};
+};
+
+WALLAROO_REGISTER(EmergencyStopCounter);
+
+BOOST_AUTO_TEST_CASE(NetServerTest_KillSwitchWithoutRoute) {
+    using boost::asio::ip::udp;
+
+    constexpr int PORT = 10262;
+
+    wallaroo::Catalog catalog;
+
+    catalog.Create("conf", "Configuration");
+    catalog.Create("holder", "RouteHoldingQueuerMock");
+    catalog.Create("rq", "RequestQueuer");
+    catalog.Create("stop", "EmergencyStopCounter");
+    catalog.Create("netServer", "NetServer");
+    catalog.Create("ioServiceProvider", "IoServiceProvider");
+
+    wallaroo_within(catalog) {
+        wallaroo::use("conf").as("config").of("netServer");
+        wallaroo::use("conf").as("config").of("rq");
+        wallaroo::use("holder").as("requestQueuer").of("netServer");
+        wallaroo::use("rq").as("queuer").of("holder");
+        wallaroo::use("stop").as("emergencyStop").of("rq");
+        wallaroo::use("ioServiceProvider").as("ioServiceProvider").of("netServer");
+    };
+
+    auto config = std::shared_ptr<common::config::Configuration>(catalog["conf"]);
+    config->putInt("NetServer.port", PORT);
+    config->putBool("NetServer.enable_ipv6", false);
+    config->putString("RequestQueuer.policy", "priority_queue");
+    config->putString("RequestQueuer.controller_session", "");
+    config->putInt("RequestQueuer.controller_weight", 1);
+    config->putInt("RequestQueuer.default_max_age_ms", 0);
+    config->putInt("RequestQueuer.delta_keyframe_interval", 0);
+
+    catalog.CheckWiring();
+    catalog.Init();
+
+    auto holder = std::shared_ptr<RouteHoldingQueuerMock>(catalog["holder"]);
+    auto stop = std::shared_ptr<EmergencyStopCounter>(catalog["stop"]);
+    auto &ioContext = std::shared_ptr<common::IoServiceProvider>(catalog["ioServiceProvider"])->getIoContext();
+
+    thread serverThread([&] { ioContext.run(); });
+
+    boost::asio::io_context clientContext;
+    udp::socket socket(clientContext, udp::endpoint(udp::v4(), 0));
+    udp::endpoint serverEndpoint(boost::asio::ip::address_v4::loopback(), PORT);
+
+    // the capacity is rounded up by the table
+    const unsigned int capacity = ResponseRoutingTable(ROUTING_TABLE_CAPACITY).getCapacity();
+
+    auto waitFor = [](std::function<bool()> condition) {
+        for (int i = 0; i < 200 and not condition(); ++i) {
+            this_thread::sleep_for(chrono::milliseconds(10));
+        }
+        return condition();
+    };
+
+    // the packets are sent in small portions, so none of them is lost in the socket buffer
+    for (unsigned int serial = 1; serial <= capacity; ++serial) {
+        string request = R"({"serial":)" + to_string(serial) + R"(,"m":{"l":{"s":50}}})";
+        socket.send_to(boost::asio::buffer(request), serverEndpoint);
+
+        if (serial % 64 == 0) {
+            BOOST_REQUIRE(waitFor([&] { return holder->heldCount == serial; }));
+        }
+    }
+
+    BOOST_REQUIRE(waitFor([&] { return holder->heldCount == capacity; }));
+
+    // the drive command without the route is dropped, the kill switch stops the robot anyway
+    socket.send_to(boost::asio::buffer(string(R"({"serial":100000,"m":{"l":{"s":50}}})")), serverEndpoint);
+    BOOST_REQUIRE(waitFor([&] { return holder->unroutedCount == 1; }));
+    BOOST_CHECK_EQUAL(stop->activationsCount, 0);
+
+    socket.send_to(boost::asio::buffer(string(R"({"serial":100001,"ks_en":true})")), serverEndpoint);
+    BOOST_REQUIRE(waitFor([&] { return holder->unroutedCount == 2; }));
+    BOOST_CHECK_EQUAL(stop->activationsCount, 1);
+
+    BOOST_CHECK_EQUAL(holder->heldCount, capacity);
+
+    boost::asio::post(ioContext, [&] { ioContext.stop(); });
+    serverThread.join();
+}
@@ -0,0 +1,102 @@
+#include "ReportSerializer.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <string>
+
+using namespace std;
+using namespace processing;
+using common::bridge::Direction;
+
+static string serializeWithoutSpaces(ReportSerializer &serializer, const Report &report) {
+    char buffer[1024];
+    string text(buffer, serializer.serialize(report, buffer, sizeof(buffer)));
+    text.erase(std::remove(text.begin(), text.end(), ' '), text.end());
+    return text;
+}
+
+BOOST_AUTO_TEST_CASE(ReportSerializerTest_Serialize) {
+    ReportSerializer serializer;
+    Report report;
+
+    BOOST_CHECK_EQUAL(serializeWithoutSpaces(serializer, report), "");
+
+    report.wifiPresent = true;
+    report.wifi.signalStrength = -55;
+    report.wifi.txBitrate = 65;
+    BOOST_CHECK_EQUAL(serializeWithoutSpaces(serializer, report), R"("w":{"s":-55.00,"txb":65.00,"rxb":0.00})");
+
+    report.bridgePresent = true;
+    report.bridgeStateVersion = 10;
+    report.bridge.lightCamera = true;
+    report.bridge.leftMotor.speed = 11;
+    report.bridge.leftMotor.direction = Direction::BACKWARD;
+    report.bridge.gripper.position = 12345;
+    report.bridge.buttonUp = true;
+    report.bridge.buttonEnter = true;
+    report.bridge.voltage = 12.3;
+    report.bridge.killSwitch = KillSwitchStatus::HARDWARE;
+
+    BOOST_CHECK_EQUAL(serializeWithoutSpaces(serializer, report),
+                      R"("e":{"r":false,"l":false,"cam":true},)"
+                      R"("m":{"l":{"s":11,"d":"backward"},"r":{"s":0,"d":"stop"}},)"
+                      R"("a":{"s":{"s":0,"p":0,"d":"stop"},"e":{"s":0,"p":0,"d":"stop"},)"
+                      R"("g":{"s":0,"p":12345,"d":"stop"},"cal_st":"none","mode":"directional"},)"
+                      R"("btn":["u","e"],"b":{"u":12.30,"i":0.00},"ks_stat":"hardware",)"
+                      R"("w":{"s":-55.00,"txb":65.00,"rxb":0.00})");
+
+    // the same state version, the bridge part isn't patched
+    report.bridge.leftMotor.speed = 5;
+    report.wifi.rxBitrate = 1;
+    string cached = serializeWithoutSpaces(serializer, report);
+    BOOST_CHECK(cached.find(R"("l":{"s":11,)") != string::npos);
+    BOOST_CHECK(cached.find(R"("rxb":1.00)") != string::npos);
+
+    report.bridgeStateVersion = 11;
+    BOOST_CHECK(serializeWithoutSpaces(serializer, report).find(R"("l":{"s":5,)") != string::npos);
+
+    char small[16];
+    BOOST_CHECK_THROW(serializer.serialize(report, small, sizeof(small)), std::length_error);
+}
+
+BOOST_AUTO_TEST_CASE(ReportSerializerTest_Delta) {
+    ReportSerializer serializer;
+    Report report;
+    report.bridgePresent = true;
+    report.wifiPresent = true;
+
+    char base[REPORT_MAX_LENGTH];
+    serializer.serialize(report, base, sizeof(base));
+
+    char text[REPORT_MAX_LENGTH];
+    serializer.serialize(report, text, sizeof(text));
+
+    char delta[REPORT_MAX_LENGTH];
+    unsigned int layout = ReportSerializer::getLayout(report);
+    BOOST_CHECK_EQUAL(serializer.writeDelta(layout, text, base, delta, sizeof(delta)), 0);
+
+    report.bridge.leftMotor.speed = 11;
+    report.bridge.leftMotor.direction = Direction::FORWARD;
+    report.bridge.rightMotor.speed = 12;
+    report.bridge.buttonDown = true;
+    report.bridge.killSwitch = KillSwitchStatus::SOFTWARE;
+    report.wifi.rxBitrate = 54;
+    serializer.serialize(report, text, sizeof(text));
+
+    BOOST_CHECK_EQUAL(string(delta, serializer.writeDelta(layout, text, base, delta, sizeof(delta))),
+                      R"("m":{"l":{"s":11,"d":"forward"},"r":{"s":12}},"btn":["d"],"ks_stat":"software",)"
+                      R"("w":{"rxb":54.00})");
+
+    report.bridge.lightRight = true;
+    report.bridge.gripper.position = 300;
+    serializer.serialize(report, base, sizeof(base));
+    report.bridge.gripper.position = 301;
+    serializer.serialize(report, text, sizeof(text));
+
+    BOOST_CHECK_EQUAL(string(delta, serializer.writeDelta(layout, text, base, delta, sizeof(delta))),
+                      R"("a":{"g":{"p":301}})");
+
+    char small[16];
+    BOOST_CHECK_THROW(serializer.writeDelta(layout, text, base, small, sizeof(small)), std::length_error);
+}
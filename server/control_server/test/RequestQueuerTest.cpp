@@ -5,27 +5,41 @@
 #include <wallaroo/catalog.h>
 
 #include <memory>
+#include <mutex>
+#include <vector>
+#include <set>
 #include <chrono>
 #include <thread>
+#include <atomic>
 
 class RequestProcessorMock : public processing::IRequestProcessor, public wallaroo::Part {
 public:
 
-    virtual void process(processing::Request &req, minijson::object_writer &response) override;
+    virtual void process(processing::Request &req, processing::Report &report) override;
 };
 
-void RequestProcessorMock::process(processing::Request &req, minijson::object_writer &response) {
+void RequestProcessorMock::process(processing::Request &req, processing::Report &report) {
 
-    auto lights = response.nested_object("lights");
-    lights.write("led", false);
-    lights.write("camera", true);
-    lights.close();
+    report.bridgePresent = true;
+    report.bridge.lightLeft = false;
+    report.bridge.lightCamera = true;
 
     std::this_thread::sleep_for(std::chrono::milliseconds(1));
 }
 
 WALLAROO_REGISTER(RequestProcessorMock);
 
+class EmergencyStopMock : public processing::IEmergencyStop, public wallaroo::Part {
+public:
+    void activateKillSwitch() override {
+        activationsCount++;
+    }
+
+    std::atomic<int> activationsCount{0};
+};
+
+WALLAROO_REGISTER(EmergencyStopMock);
+
 static std::string requestWithNoSerial =
         R"(
 {
@@ -94,10 +108,20 @@ static std::string validRequestWithHigherSerial =
      }
 })";
 
-static std::shared_ptr<processing::RequestQueuer> prepareBindings(wallaroo::Catalog &catalog) {
+static std::shared_ptr<processing::RequestQueuer> prepareBindings(wallaroo::Catalog &catalog,
+                                                                  const std::string &policy = "priority_queue") {
+    catalog.Create("conf", "Configuration");
     catalog.Create("rq", "RequestQueuer");
     catalog.Create("mock1", "RequestProcessorMock");
     wallaroo::use(catalog["mock1"]).as("requestProcessors").of(catalog["rq"]);
+    wallaroo::use(catalog["conf"]).as("config").of(catalog["rq"]);
+
+    std::shared_ptr<common::config::Configuration> config = catalog["conf"];
+    config->putString("RequestQueuer.policy", policy);
+    config->putString("RequestQueuer.controller_session", "");
+    config->putInt("RequestQueuer.controller_weight", 1);
+    config->putInt("RequestQueuer.default_max_age_ms", 0);
+    config->putInt("RequestQueuer.delta_keyframe_interval", 4);
 
     catalog.CheckWiring();
 
@@ -131,7 +155,7 @@ BOOST_AUTO_TEST_CASE(RequestQueuerTest_addRequest) {
     };
 
     for (auto t : tests) {
-        BOOST_CHECK_EQUAL(rq->addRequest(t.first, boost::asio::ip::address()), t.second);
+        BOOST_CHECK_EQUAL(rq->addRequest(t.first, boost::asio::ip::udp::endpoint()), t.second);
         std::this_thread::sleep_for(std::chrono::milliseconds(15));
     }
 
@@ -147,3 +171,273 @@ BOOST_AUTO_TEST_CASE(RequestQueuerTest_requestProcessor) {
     wallaroo::Catalog catalog;
     auto rq = prepareBindings(catalog);
 }
+
+BOOST_AUTO_TEST_CASE(RequestQueuerTest_LatestWins) {
+    constexpr int NUMBER_OF_REQUESTS = 200;
+
+    wallaroo::Catalog catalog;
+    auto rq = prepareBindings(catalog, "latest_wins");
+    catalog.Init();
+
+    std::mutex mutex;
+    std::vector<long> executed;
+    std::vector<long> rejected;
+
+    rq->setResponseSender([&](long id, std::string response, bool transmit) {
+        std::lock_guard<std::mutex> lk(mutex);
+        executed.push_back(id);
+    });
+    rq->setRejectedRequestRemover([&](long id) {
+        std::lock_guard<std::mutex> lk(mutex);
+        rejected.push_back(id);
+    });
+
+    // the processor takes 1 ms, so most of the requests are superseded while waiting
+    long lastId = processing::INVALID_MESSAGE;
+    for (int serial = 1; serial <= NUMBER_OF_REQUESTS; ++serial) {
+        std::string request = R"({"serial":)" + std::to_string(serial) + "}";
+        lastId = rq->addRequest(request, boost::asio::ip::udp::endpoint());
+        BOOST_CHECK(lastId != processing::INVALID_MESSAGE);
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::lock_guard<std::mutex> lk(mutex);
+
+    BOOST_CHECK_EQUAL(executed.size() + rejected.size(), NUMBER_OF_REQUESTS);
+    BOOST_CHECK(executed.size() < NUMBER_OF_REQUESTS / 2);
+    BOOST_REQUIRE(not executed.empty());
+    BOOST_CHECK_EQUAL(executed.back(), lastId);
+    BOOST_CHECK_EQUAL(rq->getNumOfMessages(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(RequestQueuerTest_Sessions) {
+    constexpr int REQUESTS_PER_SESSION = 30;
+
+    wallaroo::Catalog catalog;
+    auto rq = prepareBindings(catalog);
+
+    std::shared_ptr<common::config::Configuration> config = catalog["conf"];
+    config->putString("RequestQueuer.controller_session", "driver");
+    config->putInt("RequestQueuer.controller_weight", 3);
+
+    catalog.Init();
+
+    std::mutex mutex;
+    std::vector<long> executed;
+
+    rq->setResponseSender([&](long id, std::string response, bool transmit) {
+        std::lock_guard<std::mutex> lk(mutex);
+        executed.push_back(id);
+    });
+    rq->setRejectedRequestRemover([](long id) {});
+
+    boost::asio::ip::udp::endpoint driver(boost::asio::ip::address_v4::loopback(), 5000);
+    boost::asio::ip::udp::endpoint observer(boost::asio::ip::address_v4::loopback(), 5001);
+
+    auto request = [](int serial, const std::string &session) {
+        return R"({"serial":)" + std::to_string(serial) + R"(,"session":")" + session + R"("})";
+    };
+
+    // each session has its own serials
+    BOOST_CHECK(rq->addRequest(request(1000, ""), observer) != processing::INVALID_MESSAGE);
+    std::this_thread::sleep_for(std::chrono::milliseconds(15));
+    BOOST_CHECK(rq->addRequest(request(1, "driver"), driver) != processing::INVALID_MESSAGE);
+    std::this_thread::sleep_for(std::chrono::milliseconds(15));
+    BOOST_CHECK(rq->addRequest(request(999, ""), observer) == processing::INVALID_MESSAGE);
+    BOOST_CHECK(rq->addRequest(request(2, "driver"), driver) != processing::INVALID_MESSAGE);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(15));
+
+    BOOST_CHECK_EQUAL(rq->getNumOfSessions(), 2);
+
+    {
+        std::lock_guard<std::mutex> lk(mutex);
+        executed.clear();
+    }
+
+    // the observer doesn't push out the requests of the driver, which gets three turns for each observer's one
+    std::set<long> driverIds;
+    for (int i = 0; i < REQUESTS_PER_SESSION; ++i) {
+        rq->addRequest(request(2000 + i, ""), observer);
+        driverIds.insert(rq->addRequest(request(10 + i, "driver"), driver));
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    std::lock_guard<std::mutex> lk(mutex);
+
+    BOOST_REQUIRE_EQUAL(executed.size(), 2 * REQUESTS_PER_SESSION);
+
+    int driverRequestsFirst = 0;
+    for (int i = 0; i < REQUESTS_PER_SESSION; ++i) {
+        driverRequestsFirst += driverIds.count(executed[i]);
+    }
+
+    BOOST_CHECK(driverRequestsFirst >= REQUESTS_PER_SESSION * 2 / 3);
+}
+
+BOOST_AUTO_TEST_CASE(RequestQueuerTest_MaxAge) {
+    constexpr int NUMBER_OF_REQUESTS = 20;
+
+    wallaroo::Catalog catalog;
+    auto rq = prepareBindings(catalog);
+    catalog.Init();
+
+    std::mutex mutex;
+    int executedCount = 0;
+    int rejectedCount = 0;
+
+    rq->setResponseSender([&](long id, std::string response, bool transmit) {
+        std::lock_guard<std::mutex> lk(mutex);
+        executedCount++;
+    });
+    rq->setRejectedRequestRemover([&](long id) {
+        std::lock_guard<std::mutex> lk(mutex);
+        rejectedCount++;
+    });
+
+    // the processor takes 1 ms, so the requests at the end of the queue wait too long
+    for (int serial = 1; serial <= NUMBER_OF_REQUESTS; ++serial) {
+        std::string request = R"({"serial":)" + std::to_string(serial) + R"(,"max_age":3})";
+        BOOST_CHECK(rq->addRequest(request, boost::asio::ip::udp::endpoint()) != processing::INVALID_MESSAGE);
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::lock_guard<std::mutex> lk(mutex);
+
+    BOOST_CHECK_EQUAL(executedCount + rejectedCount, NUMBER_OF_REQUESTS);
+    BOOST_CHECK(executedCount > 0);
+    BOOST_CHECK(rejectedCount > 0);
+    BOOST_CHECK_EQUAL(rq->getExpiredRequestsCount(), rejectedCount);
+    BOOST_CHECK_EQUAL(rq->getQueueWaitHistogram().getCount(), NUMBER_OF_REQUESTS);
+}
+
+BOOST_AUTO_TEST_CASE(RequestQueuerTest_DeltaResponses) {
+    wallaroo::Catalog catalog;
+    auto rq = prepareBindings(catalog);
+    catalog.Init();
+
+    std::mutex mutex;
+    std::vector<std::string> responses;
+
+    rq->setResponseSender([&](long id, std::string response, bool transmit) {
+        std::lock_guard<std::mutex> lk(mutex);
+        responses.push_back(response);
+    });
+    rq->setRejectedRequestRemover([&](long id) {
+    });
+
+    auto sendAndWait = [&](const std::string &request) {
+        BOOST_REQUIRE(rq->addRequest(request, boost::asio::ip::udp::endpoint()) != processing::INVALID_MESSAGE);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+        std::lock_guard<std::mutex> lk(mutex);
+        BOOST_REQUIRE(not responses.empty());
+        return responses.back();
+    };
+
+    std::string full = sendAndWait(R"({"serial":1})");
+    BOOST_CHECK(full.find(R"("rv":1)") != std::string::npos);
+    BOOST_CHECK(full.find(R"("rb")") == std::string::npos);
+    BOOST_CHECK(full.find(R"("cam":true)") != std::string::npos);
+
+    // the mock reports the same state, so nothing changed since the acknowledged version
+    std::string delta = sendAndWait(R"({"serial":2,"ack":1})");
+    BOOST_CHECK(delta.find(R"("rv":2,"rb":1})") != std::string::npos);
+    BOOST_CHECK(delta.size() < full.size());
+
+    // unknown version
+    BOOST_CHECK(sendAndWait(R"({"serial":3,"ack":1000})").find(R"("cam":true)") != std::string::npos);
+
+    BOOST_CHECK(sendAndWait(R"({"serial":4,"ack":3})").find(R"("rb":3)") != std::string::npos);
+    BOOST_CHECK(sendAndWait(R"({"serial":5,"ack":4})").find(R"("rb":4)") != std::string::npos);
+    BOOST_CHECK(sendAndWait(R"({"serial":6,"ack":5})").find(R"("rb":5)") != std::string::npos);
+
+    // keyframe
+    BOOST_CHECK(sendAndWait(R"({"serial":7,"ack":6})").find(R"("rb")") == std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(RequestQueuerTest_LongTimestamp) {
+    wallaroo::Catalog catalog;
+    auto rq = prepareBindings(catalog);
+    catalog.Init();
+
+    std::mutex mutex;
+    std::vector<std::string> responses;
+
+    rq->setResponseSender([&](long id, std::string response, bool transmit) {
+        std::lock_guard<std::mutex> lk(mutex);
+        responses.push_back(response);
+    });
+    rq->setRejectedRequestRemover([&](long id) {
+    });
+
+    // almost the whole datagram, the response header would overflow without truncating it
+    std::string timestamp(1150, 'x');
+    std::string session(300, 's');
+
+    BOOST_REQUIRE(rq->addRequest(R"({"serial":1,"tss":")" + timestamp + R"(","session":")" + session + R"("})",
+                                 boost::asio::ip::udp::endpoint()) != processing::INVALID_MESSAGE);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    std::lock_guard<std::mutex> lk(mutex);
+    BOOST_REQUIRE_EQUAL(responses.size(), 1);
+
+    auto &response = responses.front();
+    BOOST_CHECK(response.size() <= 1024);
+    BOOST_CHECK(response.find(R"("tss":")" + std::string(processing::REQUEST_TIMESTAMP_MAX_LENGTH, 'x') + "\"")
+                != std::string::npos);
+    BOOST_CHECK_EQUAL(response.back(), '}');
+}
+
+BOOST_AUTO_TEST_CASE(RequestQueuerTest_KillSwitchPreemption) {
+    constexpr int NUMBER_OF_REQUESTS = 50;
+
+    wallaroo::Catalog catalog;
+    auto rq = prepareBindings(catalog);
+    catalog.Create("stop", "EmergencyStopMock");
+    wallaroo::use(catalog["stop"]).as("emergencyStop").of(catalog["rq"]);
+    catalog.Init();
+
+    std::shared_ptr<EmergencyStopMock> stop = catalog["stop"];
+
+    std::mutex mutex;
+    int executedCount = 0;
+    int rejectedCount = 0;
+
+    rq->setResponseSender([&](long id, std::string response, bool transmit) {
+        std::lock_guard<std::mutex> lk(mutex);
+        executedCount++;
+    });
+    rq->setRejectedRequestRemover([&](long id) {
+        std::lock_guard<std::mutex> lk(mutex);
+        rejectedCount++;
+    });
+
+    boost::asio::ip::udp::endpoint driver(boost::asio::ip::address_v4::loopback(), 5000);
+    boost::asio::ip::udp::endpoint operatorConsole(boost::asio::ip::address_v4::loopback(), 5001);
+
+    // the processor takes 1 ms, so most of the drive commands are still waiting
+    for (int serial = 1; serial <= NUMBER_OF_REQUESTS; ++serial) {
+        rq->addRequest(R"({"serial":)" + std::to_string(serial) + R"(,"m":{"l":{"s":50}}})", driver);
+    }
+
+    BOOST_CHECK(rq->addRequest(R"({"serial":1,"ks_en":true})", operatorConsole) != processing::INVALID_MESSAGE);
+
+    BOOST_CHECK_EQUAL(stop->activationsCount, 1);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::lock_guard<std::mutex> lk(mutex);
+
+    BOOST_CHECK_EQUAL(executedCount + rejectedCount, NUMBER_OF_REQUESTS + 1);
+    BOOST_CHECK(rejectedCount > NUMBER_OF_REQUESTS / 2);
+    BOOST_CHECK_EQUAL(rq->getPreemptedRequestsCount(), rejectedCount);
+    BOOST_CHECK_EQUAL(rq->getNumOfMessages(), 0);
+
+    // deactivation goes the usual way
+    BOOST_CHECK(rq->addRequest(R"({"serial":2,"ks_en":false})", operatorConsole) != processing::INVALID_MESSAGE);
+    BOOST_CHECK_EQUAL(stop->activationsCount, 1);
+}
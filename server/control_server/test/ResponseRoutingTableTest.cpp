@@ -0,0 +1,114 @@
+#include "ResponseRoutingTable.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <deque>
+
+using namespace std;
+using namespace processing;
+using boost::asio::ip::udp;
+
+BOOST_AUTO_TEST_CASE(ResponseRoutingTableTest_ReserveRelease) {
+    ResponseRoutingTable table(3);
+    BOOST_CHECK_EQUAL(table.getCapacity(), 4);
+
+    udp::endpoint first(boost::asio::ip::address_v4::loopback(), 1000);
+    udp::endpoint second(boost::asio::ip::address_v4::loopback(), 2000);
+
+    long firstId = table.reserve(first);
+    long secondId = table.reserve(second);
+
+    BOOST_CHECK(firstId > 0);
+    BOOST_CHECK(secondId > 0);
+    BOOST_CHECK(firstId != secondId);
+    BOOST_CHECK_EQUAL(table.getNumberOfReserved(), 2);
+
+    udp::endpoint endpoint;
+    BOOST_CHECK(table.release(secondId, endpoint));
+    BOOST_CHECK(endpoint == second);
+
+    // released twice or unknown
+    BOOST_CHECK(not table.release(secondId, endpoint));
+    BOOST_CHECK(not table.release(12345, endpoint));
+    BOOST_CHECK(not table.release(-1, endpoint));
+
+    BOOST_CHECK(table.release(firstId, endpoint));
+    BOOST_CHECK(endpoint == first);
+
+    // the slot is reused with new generation, the old id doesn't match it
+    for (int i = 0; i < 4; ++i) {
+        BOOST_CHECK(table.reserve(first) > 0);
+    }
+    BOOST_CHECK_EQUAL(table.reserve(first), -1);
+    BOOST_CHECK(not table.release(firstId));
+    BOOST_CHECK_EQUAL(table.getNumberOfReserved(), 4);
+}
+
+/**
+ * The network thread reserves the routes while the executor and the request rejection release them.
+ * Each route has to be released exactly once with the endpoint it was reserved with.
+ */
+BOOST_AUTO_TEST_CASE(ResponseRoutingTableTest_Concurrent) {
+    constexpr int NUMBER_OF_REQUESTS = 20000;
+
+    ResponseRoutingTable table(64);
+
+    std::mutex mutex;
+    std::deque<pair<long, unsigned short>> queues[2];
+
+    std::atomic<int> released(0);
+    std::atomic<int> mismatched(0);
+    std::atomic<bool> finished(false);
+
+    auto releaser = [&](int queueNo) {
+        while (true) {
+            pair<long, unsigned short> route;
+            {
+                std::lock_guard<std::mutex> lk(mutex);
+                if (queues[queueNo].empty()) {
+                    if (finished) {
+                        return;
+                    }
+                    continue;
+                }
+                route = queues[queueNo].front();
+                queues[queueNo].pop_front();
+            }
+
+            udp::endpoint endpoint;
+            if (table.release(route.first, endpoint)) {
+                released++;
+                if (endpoint.port() != route.second) {
+                    mismatched++;
+                }
+            }
+        }
+    };
+
+    thread executor(releaser, 0);
+    thread rejector(releaser, 1);
+
+    for (int i = 0; i < NUMBER_OF_REQUESTS; ++i) {
+        unsigned short port = i % 60000 + 1;
+
+        long id;
+        while ((id = table.reserve(udp::endpoint(boost::asio::ip::address_v4::loopback(), port))) < 0) {
+            this_thread::yield();
+        }
+
+        std::lock_guard<std::mutex> lk(mutex);
+        queues[0].push_back(make_pair(id, port));
+        queues[1].push_back(make_pair(id, port));
+    }
+
+    finished = true;
+    executor.join();
+    rejector.join();
+
+    BOOST_CHECK_EQUAL(released, NUMBER_OF_REQUESTS);
+    BOOST_CHECK_EQUAL(mismatched, 0);
+    BOOST_CHECK_EQUAL(table.getNumberOfReserved(), 0);
+}
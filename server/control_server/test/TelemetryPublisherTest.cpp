@@ -0,0 +1,269 @@
+#include "TelemetryPublisher.hpp"
+#include "DeviceEmulator.hpp"
+
+#include <boost/test/unit_test.hpp>
+#include <wallaroo/catalog.h>
+
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <cstring>
+
+using namespace std;
+using namespace std::chrono;
+using namespace processing;
+using boost::asio::ip::udp;
+
+BOOST_AUTO_TEST_CASE(TelemetryPublisherTest_Subscriptions) {
+    TelemetrySubscriptions subscriptions(2, 50, seconds(30));
+
+    udp::endpoint first(boost::asio::ip::address_v4::loopback(), 5000);
+    udp::endpoint second(boost::asio::ip::address_v4::loopback(), 5001);
+    udp::endpoint third(boost::asio::ip::address_v4::loopback(), 5002);
+
+    auto start = steady_clock::now();
+
+    BOOST_CHECK(subscriptions.getNextPushTime() == TelemetrySubscriptions::TimePoint::max());
+
+    BOOST_CHECK(subscriptions.subscribe(first, 10, start));
+    // limited to the maximal rate
+    BOOST_CHECK(subscriptions.subscribe(second, 1000, start));
+    BOOST_CHECK(not subscriptions.subscribe(third, 10, start));
+    BOOST_CHECK_EQUAL(subscriptions.size(), 2);
+
+    BOOST_CHECK(subscriptions.getNextPushTime() == start);
+
+    vector<udp::endpoint> pushed;
+    auto collect = [&](const udp::endpoint &e) {
+        pushed.push_back(e);
+    };
+
+    // 1 s: the first one is pushed 10 times, the second one 50 times
+    for (auto t = start; t < start + seconds(1); t += milliseconds(1)) {
+        subscriptions.forEachDue(t, collect);
+    }
+
+    BOOST_CHECK_EQUAL(std::count(pushed.begin(), pushed.end(), first), 10);
+    BOOST_CHECK_EQUAL(std::count(pushed.begin(), pushed.end(), second), 50);
+
+    BOOST_CHECK(subscriptions.getNextPushTime() >= start + milliseconds(980));
+
+    // unsubscribed
+    BOOST_CHECK(subscriptions.subscribe(second, 0, start + seconds(1)));
+    BOOST_CHECK_EQUAL(subscriptions.size(), 1);
+    BOOST_CHECK(subscriptions.subscribe(third, 10, start + seconds(1)));
+
+    // the third one renews its subscription, the first one expires
+    BOOST_CHECK(subscriptions.subscribe(third, 10, start + seconds(25)));
+
+    pushed.clear();
+    subscriptions.forEachDue(start + seconds(40), collect);
+
+    BOOST_CHECK_EQUAL(subscriptions.size(), 1);
+    BOOST_REQUIRE_EQUAL(pushed.size(), 1);
+    BOOST_CHECK(pushed[0] == third);
+
+    // the delayed push isn't caught up
+    pushed.clear();
+    subscriptions.forEachDue(start + seconds(40) + milliseconds(50), collect);
+    BOOST_CHECK(pushed.empty());
+}
+
+/**
+ * Creates the publisher with the interface manager it takes the snapshots from.
+ */
+static void createPublisher(wallaroo::Catalog &catalog, int port) {
+    catalog.Create("conf", "Configuration");
+    catalog.Create("ifaceProvider", "InterfaceProvider", true);
+    catalog.Create("mgr", "InterfaceManager");
+    catalog.Create("ioServiceProvider", "IoServiceProvider");
+    catalog.Create("telemetry", "TelemetryPublisher");
+
+    wallaroo_within(catalog) {
+        wallaroo::use("conf").as("config").of("mgr");
+        wallaroo::use("conf").as("config").of("telemetry");
+        wallaroo::use("ifaceProvider").as("interfaceProvider").of("mgr");
+        wallaroo::use("mgr").as("interfaceManager").of("telemetry");
+        wallaroo::use("ioServiceProvider").as("ioServiceProvider").of("telemetry");
+    }
+
+    std::shared_ptr<common::config::Configuration> config = catalog["conf"];
+    config->putInt("TelemetryPublisher.port", port);
+    config->putInt("TelemetryPublisher.max_rate_hz", 50);
+    config->putBool("NetServer.enable_ipv6", false);
+}
+
+/**
+ * Waits up to 1 s for the datagram on the non-blocking socket, returns the empty string if none came.
+ */
+static string receiveMessage(udp::socket &socket) {
+    char message[1024];
+    udp::endpoint sender;
+    auto deadline = steady_clock::now() + seconds(1);
+
+    while (steady_clock::now() < deadline) {
+        boost::system::error_code ec;
+        std::size_t length = socket.receive_from(boost::asio::buffer(message), sender, 0, ec);
+
+        if (ec != boost::asio::error::would_block) {
+            return string(message, length);
+        }
+
+        this_thread::sleep_for(milliseconds(10));
+    }
+
+    return "";
+}
+
+/**
+ * Subscribes to the publisher at the port, i.e. sends the subscription and repeats it with the received nonce.
+ */
+static void subscribe(udp::socket &socket, int port, int rateHz) {
+    udp::endpoint publisherEndpoint(boost::asio::ip::address_v4::loopback(), port);
+    string subscription = R"({"subscribe":)" + to_string(rateHz);
+
+    socket.send_to(boost::asio::buffer(subscription + "}"), publisherEndpoint);
+
+    string challenge = receiveMessage(socket);
+    auto nonceStart = challenge.find(R"("nonce":")");
+    BOOST_REQUIRE(nonceStart != string::npos);
+    nonceStart += std::strlen(R"("nonce":")");
+    string nonce = challenge.substr(nonceStart, challenge.find('"', nonceStart) - nonceStart);
+
+    socket.send_to(boost::asio::buffer(subscription + R"(,"nonce":")" + nonce + "\"}"), publisherEndpoint);
+}
+
+BOOST_AUTO_TEST_CASE(TelemetryPublisherTest_NoPushBeforeSnapshot) {
+    constexpr int PORT = 10292;
+
+    wallaroo::Catalog catalog;
+    createPublisher(catalog, PORT);
+
+    catalog.Create("device", "DeviceEmulator");
+    wallaroo::use(catalog["conf"]).as("config").of(catalog["device"]);
+
+    std::shared_ptr<common::config::Configuration> config = catalog["conf"];
+    config->putInt("DeviceEmulator.latency_us", 0);
+    config->putInt("DeviceEmulator.jitter_us", 0);
+
+    catalog.CheckWiring();
+    catalog.Init();
+
+    std::shared_ptr<bridge::IInterfaceManager> interfaceManager = catalog["mgr"];
+    std::shared_ptr<bridge::DeviceEmulator> device = catalog["device"];
+    std::shared_ptr<TelemetryPublisher> publisher = catalog["telemetry"];
+    auto &ioContext = std::shared_ptr<common::IoServiceProvider>(catalog["ioServiceProvider"])->getIoContext();
+
+    auto &iface = interfaceManager->iface();
+
+    boost::asio::io_context clientContext;
+    udp::socket client(clientContext, udp::endpoint(udp::v4(), 0));
+    client.non_blocking(true);
+
+    thread serverThread;
+
+    {
+        // the publisher can't take the snapshot, the default report would tell the kill switch is inactive
+        common::bridge::SharedScopedMutex lk(iface.mutex);
+
+        serverThread = thread([&] { ioContext.run(); });
+
+        subscribe(client, PORT, 50);
+
+        this_thread::sleep_for(milliseconds(200));
+
+        BOOST_CHECK_EQUAL(publisher->getNumOfSubscribers(), 1);
+        BOOST_CHECK_EQUAL(publisher->getNumOfPushes(), 0);
+    }
+
+    char message[1024];
+    udp::endpoint sender;
+    boost::system::error_code ec;
+    client.receive_from(boost::asio::buffer(message), sender, 0, ec);
+    BOOST_CHECK(ec == boost::asio::error::would_block);
+
+    // the emulated device starts with the kill switch active
+    interfaceManager->syncWithDevice([&](vector<uint8_t> &packet) {
+        return device->exchange(packet).get();
+    });
+
+    std::size_t length = 0;
+    auto deadline = steady_clock::now() + seconds(1);
+
+    while (length == 0 and steady_clock::now() < deadline) {
+        length = client.receive_from(boost::asio::buffer(message), sender, 0, ec);
+
+        if (ec == boost::asio::error::would_block) {
+            length = 0;
+            this_thread::sleep_for(milliseconds(10));
+        }
+    }
+
+    boost::asio::post(ioContext, [&] { ioContext.stop(); });
+    serverThread.join();
+
+    BOOST_REQUIRE(length > 0);
+
+    string pushed(message, length);
+    pushed.erase(std::remove(pushed.begin(), pushed.end(), ' '), pushed.end());
+    BOOST_CHECK(pushed.find(R"("ks_stat")") != string::npos);
+    BOOST_CHECK(pushed.find(R"("ks_stat":"inactive")") == string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(TelemetryPublisherTest_SubscriptionHandshake) {
+    constexpr int PORT = 10293;
+
+    wallaroo::Catalog catalog;
+    createPublisher(catalog, PORT);
+
+    catalog.CheckWiring();
+    catalog.Init();
+
+    std::shared_ptr<TelemetryPublisher> publisher = catalog["telemetry"];
+    auto &ioContext = std::shared_ptr<common::IoServiceProvider>(catalog["ioServiceProvider"])->getIoContext();
+
+    thread serverThread([&] { ioContext.run(); });
+
+    boost::asio::io_context clientContext;
+    udp::socket client(clientContext, udp::endpoint(udp::v4(), 0));
+    udp::socket spoofer(clientContext, udp::endpoint(udp::v4(), 0));
+    client.non_blocking(true);
+    spoofer.non_blocking(true);
+
+    udp::endpoint publisherEndpoint(boost::asio::ip::address_v4::loopback(), PORT);
+
+    // the subscription without the nonce gets only the nonce
+    client.send_to(boost::asio::buffer(string(R"({"subscribe":50})")), publisherEndpoint);
+    string challenge = receiveMessage(client);
+    BOOST_CHECK(challenge.find(R"("nonce":")") != string::npos);
+    BOOST_CHECK(challenge.find(R"("seq")") == string::npos);
+
+    // the wrong nonce gets the same one again
+    client.send_to(boost::asio::buffer(string(R"({"subscribe":50,"nonce":"0"})")), publisherEndpoint);
+    BOOST_CHECK_EQUAL(receiveMessage(client), challenge);
+
+    // the nonce is valid only for the endpoint it was sent to
+    string stolen = R"({"subscribe":50,)" + challenge.substr(1);
+    spoofer.send_to(boost::asio::buffer(stolen), publisherEndpoint);
+    string spooferChallenge = receiveMessage(spoofer);
+    BOOST_CHECK(spooferChallenge.find(R"("nonce":")") != string::npos);
+    BOOST_CHECK(spooferChallenge != challenge);
+
+    this_thread::sleep_for(milliseconds(100));
+    BOOST_CHECK_EQUAL(publisher->getNumOfSubscribers(), 0);
+
+    // the snapshot is taken without synchronization, the telemetry is pushed right after the subscription
+    client.send_to(boost::asio::buffer(R"({"subscribe":50,)" + challenge.substr(1)), publisherEndpoint);
+    string pushed = receiveMessage(client);
+    BOOST_CHECK(pushed.find(R"("seq")") != string::npos);
+
+    this_thread::sleep_for(milliseconds(100));
+    BOOST_CHECK_EQUAL(publisher->getNumOfSubscribers(), 1);
+
+    BOOST_CHECK_EQUAL(receiveMessage(spoofer), "");
+
+    boost::asio::post(ioContext, [&] { ioContext.stop(); });
+    serverThread.join();
+}
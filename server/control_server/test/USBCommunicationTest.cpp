@@ -7,6 +7,7 @@
 
 #include <cstdint>
 #include <vector>
+#include <future>
 
 BOOST_AUTO_TEST_CASE(USBCommunicationTest_Connection) {
     bridge::USBCommunicator comm;
@@ -22,3 +23,25 @@ BOOST_AUTO_TEST_CASE(USBCommunicationTest_Connection) {
         BOOST_CHECK_MESSAGE(returned.at(9) == USBCommands::MESSAGE_END, "real message length");
     }
 }
+
+BOOST_AUTO_TEST_CASE(USBCommunicationTest_PipelinedExchanges) {
+    bridge::USBCommunicator comm;
+
+    std::vector<uint8_t> getStateData = {USBCommands::BRIDGE_GET_STATE, USBCommands::MESSAGE_END};
+    std::vector<uint8_t> setterData = {USBCommands::BRIDGE_SET_KILLSWITCH, USBCommands::bridge::INACTIVE,
+                                       USBCommands::MESSAGE_END};
+
+    for (int i = 0; i < 100; i++) {
+        // the setter is queued before the response to the getter is received
+        auto getterResponse = comm.exchange(getStateData);
+        auto setterResponse = comm.exchange(setterData);
+
+        auto returned = getterResponse.get();
+
+        BOOST_CHECK(returned.size() == USB_SETTINGS_DEVICE_TO_HOST_DATAPACKET_SIZE);
+        BOOST_CHECK_MESSAGE(returned.at(9) == USBCommands::MESSAGE_END, "real message length");
+
+        // the setters don't produce any data
+        BOOST_CHECK(setterResponse.get().at(0) == USBCommands::MESSAGE_END);
+    }
+}